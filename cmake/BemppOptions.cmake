@@ -8,6 +8,8 @@ option(WITH_ALUGRID "Have Alugrid" OFF)
 option(WITH_MKL "Use Intel MKL for BLAS and LAPACK functionality" OFF)
 option(WITH_GOTOBLAS "Use GotoBLAS for BLAS and LAPACK functionality" OFF)
 option(WITH_OPENBLAS "Use OpenBLAS for BLAS and LAPACK functionality" OFF)
+option(WITH_AVX "Use AVX2 and FMA instructions in the batched evaluation of kernels (the library will only run on CPUs supporting AVX2 and FMA)" OFF)
+option(WITH_AVX512 "Use AVX-512 instructions in the batched evaluation of kernels (the library will only run on CPUs supporting AVX-512F; takes precedence over WITH_AVX)" OFF)
 
 option(ENABLE_SINGLE_PRECISION "Enable support for single-precision calculations" ON)
 option(ENABLE_DOUBLE_PRECISION "Enable support for double-precision calculations" ON)
@@ -194,7 +194,8 @@ assembleWeakFormImpl(
     if (context.assemblyOptions().assemblyMode() == AssemblyOptions::DENSE)
         result = assembleJointOperatorWeakFormInDenseMode(
                     joinableOps, joinableOpWeights, verbose);
-    else if (context.assemblyOptions().assemblyMode() == AssemblyOptions::ACA)
+    else if (context.assemblyOptions().assemblyMode() == AssemblyOptions::ACA ||
+             context.assemblyOptions().assemblyMode() == AssemblyOptions::H2)
         result = assembleJointOperatorWeakFormInAcaMode(
                     context, joinableOps, joinableOpWeights);
     else
@@ -428,7 +429,7 @@ assembleJointOperatorWeakFormInAcaMode(
         nonlocalPart.reset(
                     AcaGlobalAssembler<BasisFunctionType, ResultType>::
                     assembleDetachedWeakForm(
-                        *this->dualToRange(), *this->domain(),
+                        this->dualToRange(), this->domain(),
                         stlAssemblersForNonlocalTerms,
                         stlAssemblersForNonlocalTerms,
                         stlSparseDiscreteTerms,
@@ -0,0 +1,271 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_ahmed.hpp"
+#include "bempp/common/config_trilinos.hpp"
+
+#ifdef WITH_AHMED
+#include "aca_approximate_cholesky_inverse.hpp"
+
+#include "ahmed_aux.hpp"
+#include "ahmed_parallel_lu.hpp"
+#include "discrete_aca_boundary_operator.hpp"
+#include "symmetry.hpp"
+
+#include "../fiber/explicit_instantiation.hpp"
+
+#ifdef WITH_TRILINOS
+#include <Thyra_DetachedSpmdVectorView.hpp>
+#include <Thyra_SpmdVectorSpaceDefaultBase.hpp>
+#endif
+
+#include <tbb/task_scheduler_init.h>
+#include <tbb/tick_count.h>
+
+namespace Bempp
+{
+
+template <typename ValueType>
+AcaApproximateCholeskyInverse<ValueType>::AcaApproximateCholeskyInverse(
+        const DiscreteAcaBoundaryOperator<ValueType>& fwdOp,
+        MagnitudeType delta,
+        VerbosityLevel::Level verbosityLevel) :
+    // All range-domain swaps intended!
+#ifdef WITH_TRILINOS
+    m_domainSpace(fwdOp.m_rangeSpace),
+    m_rangeSpace(fwdOp.m_domainSpace),
+#else
+    m_rowCount(fwdOp.columnCount()), m_columnCount(fwdOp.rowCount()),
+#endif
+    m_blockCluster(0), m_blocksU(0),
+    m_domainPermutation(fwdOp.m_rangePermutation),
+    m_rangePermutation(fwdOp.m_domainPermutation)
+{
+    if (!(fwdOp.m_symmetry & HERMITIAN))
+        throw std::invalid_argument(
+                "AcaApproximateCholeskyInverse::AcaApproximateCholeskyInverse(): "
+                "the decomposed operator must be stored as a Hermitian "
+                "H-matrix");
+
+    const bool verbosityAtLeastDefault =
+            (verbosityLevel >= VerbosityLevel::DEFAULT);
+    if (verbosityAtLeastDefault)
+        std::cout << "Starting H-Cholesky decomposition..." << std::endl;
+    tbb::tick_count start = tbb::tick_count::now();
+
+    const ParallelizationOptions& parallelOptions =
+            fwdOp.parallelizationOptions();
+    int maxThreadCount = 1;
+    if (!parallelOptions.isOpenClEnabled()) {
+        if (parallelOptions.maxThreadCount() == ParallelizationOptions::AUTO)
+            maxThreadCount = tbb::task_scheduler_init::automatic;
+        else
+            maxThreadCount = parallelOptions.maxThreadCount();
+    }
+    tbb::task_scheduler_init scheduler(maxThreadCount);
+
+    // The decomposition overwrites its input, so it operates on a copy of
+    // the H-matrix
+    const blcluster* fwdBlockCluster = fwdOp.m_blockCluster.get();
+    // Full-precision copies of mblocks stored in single precision, if any
+    typename DiscreteAcaBoundaryOperator<ValueType>::AhmedMblockArray
+            fwdBlocks = fwdOp.blocks();
+    m_blockCluster = copyBlockClusterTree(fwdBlockCluster);
+    const size_t blockCount = m_blockCluster->nleaves();
+    AhmedMblock** blocks = 0;
+    allocmbls(blockCount, blocks);
+    copyH(m_blockCluster, fwdBlocks.get(), blocks);
+    allocmbls(blockCount, m_blocksU);
+    bool result = false;
+    try {
+        result = computeHCholeskyDecompositionInParallel<ValueType>(
+                    m_blockCluster, blocks, m_blocksU,
+                    delta, fwdOp.m_maximumRank);
+    }
+    catch (...) {
+        freembls(m_blockCluster, blocks);
+        deleteFactor(); // the destructor will not be called
+        throw; // rethrow
+    }
+    freembls(m_blockCluster, blocks);
+    tbb::tick_count end = tbb::tick_count::now();
+    if (!result) {
+        deleteFactor(); // the destructor will not be called
+        throw std::runtime_error(
+                "AcaApproximateCholeskyInverse::AcaApproximateCholeskyInverse(): "
+                "Approximate Cholesky factorisation failed; the operator may "
+                "not be positive definite");
+    }
+
+    if (verbosityAtLeastDefault) {
+        std::cout << "H-Cholesky decomposition took "
+                  << (end - start).seconds() << " s" << std::endl;
+        size_t origMemory = sizeof(ValueType) *
+                size_t(rowCount()) * columnCount();
+        size_t ahmedMemory = sizeH(m_blockCluster, m_blocksU, 'U');
+        int maximumRank = Hmax_rank(m_blockCluster, m_blocksU, 'U');
+        std::cout << "\nNeeded storage: "
+                  << ahmedMemory / 1024. / 1024. << " MB.\n"
+                  << "Without approximation: "
+                  << origMemory / 1024. / 1024. << " MB.\n"
+                  << "Compressed to "
+                  << (100. * ahmedMemory) / origMemory << "%.\n"
+                  << "Maximum rank: " << maximumRank << ".\n"
+                  << std::endl;
+    }
+}
+
+template <>
+AcaApproximateCholeskyInverse<std::complex<float> >::AcaApproximateCholeskyInverse(
+        const DiscreteAcaBoundaryOperator<std::complex<float> >& fwdOp,
+        MagnitudeType delta,
+        VerbosityLevel::Level verbosityLevel) :
+    // All range-domain swaps intended!
+#ifdef WITH_TRILINOS
+    m_domainSpace(fwdOp.m_rangeSpace),
+    m_rangeSpace(fwdOp.m_domainSpace),
+#else
+    m_rowCount(fwdOp.columnCount()), m_columnCount(fwdOp.rowCount()),
+#endif
+    m_blockCluster(0), m_blocksU(0),
+    m_domainPermutation(fwdOp.m_rangePermutation),
+    m_rangePermutation(fwdOp.m_domainPermutation)
+{
+    // Ahmed doesn't define the H-matrix arithmetic routines for
+    // mblock<scomp>
+    throw std::runtime_error(
+                "AcaApproximateCholeskyInverse::AcaApproximateCholeskyInverse(): "
+                "due to a deficiency in Ahmed approximate Cholesky "
+                "factorisation of single-precision complex H matrices is not "
+                "supported");
+}
+
+template <typename ValueType>
+AcaApproximateCholeskyInverse<ValueType>::~AcaApproximateCholeskyInverse()
+{
+    deleteFactor();
+}
+
+template <typename ValueType>
+void AcaApproximateCholeskyInverse<ValueType>::deleteFactor()
+{
+    if (m_blockCluster)
+    {
+        if (m_blocksU)
+            freembls(m_blockCluster, m_blocksU);
+        delete m_blockCluster;
+        m_blockCluster = 0;
+    }
+}
+
+template <typename ValueType>
+unsigned int AcaApproximateCholeskyInverse<ValueType>::rowCount() const
+{
+#ifdef WITH_TRILINOS
+    return m_rangeSpace->dim();
+#else
+    return m_rowCount;
+#endif
+}
+
+template <typename ValueType>
+unsigned int AcaApproximateCholeskyInverse<ValueType>::columnCount() const
+{
+#ifdef WITH_TRILINOS
+    return m_domainSpace->dim();
+#else
+    return m_columnCount;
+#endif
+}
+
+template <typename ValueType>
+void AcaApproximateCholeskyInverse<ValueType>::addBlock(
+        const std::vector<int>& rows, const std::vector<int>& cols, const ValueType alpha,
+        arma::Mat<ValueType>& block) const
+{
+    throw std::runtime_error("AcaApproximateCholeskyInverse::addBlock(): "
+                             "not implemented");
+}
+
+#ifdef WITH_TRILINOS
+
+template <typename ValueType>
+Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType> >
+AcaApproximateCholeskyInverse<ValueType>::domain() const
+{
+    return m_domainSpace;
+}
+
+template <typename ValueType>
+Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType> >
+AcaApproximateCholeskyInverse<ValueType>::range() const
+{
+    return m_rangeSpace;
+}
+
+template <typename ValueType>
+bool AcaApproximateCholeskyInverse<ValueType>::opSupportedImpl(
+        Thyra::EOpTransp M_trans) const
+{
+    // The inverse of a Hermitian matrix is Hermitian
+    return (M_trans == Thyra::NOTRANS || M_trans == Thyra::CONJTRANS);
+}
+#endif // WITH_TRILINOS
+
+template <typename ValueType>
+void AcaApproximateCholeskyInverse<ValueType>::
+applyBuiltInImpl(const TranspositionMode trans,
+                 const arma::Col<ValueType>& x_in,
+                 arma::Col<ValueType>& y_inout,
+                 const ValueType alpha,
+                 const ValueType beta) const
+{
+    if (trans != NO_TRANSPOSE && trans != CONJUGATE_TRANSPOSE)
+        throw std::runtime_error(
+                "AcaApproximateCholeskyInverse::applyBuiltInImpl(): "
+                "transposition modes other than NO_TRANSPOSE and "
+                "CONJUGATE_TRANSPOSE are not supported");
+    if (columnCount() != x_in.n_rows || rowCount() != y_inout.n_rows)
+        throw std::invalid_argument(
+                "AcaApproximateCholeskyInverse::applyBuiltInImpl(): "
+                "incorrect vector length");
+
+    if (beta == static_cast<ValueType>(0.))
+        y_inout.fill(static_cast<ValueType>(0.));
+    else
+        y_inout *= beta;
+
+    // will act both as a permuted argument and permuted result
+    arma::Col<ValueType> permuted;
+    m_domainPermutation.permuteVector(x_in, permuted);
+
+    solveWithHCholeskyDecompositionInParallel(m_blockCluster, m_blocksU,
+                                              permuted.memptr());
+
+    arma::Col<ValueType> operatorActionResult;
+    m_rangePermutation.unpermuteVector(permuted, operatorActionResult);
+    y_inout += alpha * operatorActionResult;
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(AcaApproximateCholeskyInverse);
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
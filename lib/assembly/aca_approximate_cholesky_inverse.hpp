@@ -0,0 +1,135 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef bempp_aca_approximate_cholesky_inverse_hpp
+#define bempp_aca_approximate_cholesky_inverse_hpp
+
+#include "../common/common.hpp"
+
+#include "bempp/common/config_trilinos.hpp"
+#include "discrete_boundary_operator.hpp"
+
+#include "ahmed_aux_fwd.hpp"
+#include "index_permutation.hpp"
+#include "../fiber/scalar_traits.hpp"
+#include "../fiber/verbosity_level.hpp"
+
+#ifdef WITH_TRILINOS
+#include <Thyra_SpmdVectorSpaceBase_decl.hpp>
+#endif
+
+using Fiber::VerbosityLevel;
+
+namespace Bempp
+{
+
+/** \cond FORWARD_DECL */
+template <typename ValueType> class DiscreteAcaBoundaryOperator;
+/** \endcond */
+
+/** \ingroup composite_discrete_operators
+ *  \brief Approximate Cholesky decomposition of a Hermitian H-matrix.
+ *
+ *  This operator represents the inverse of a Hermitian positive-definite
+ *  H-matrix \f$A\f$ stored in the symmetric format (for example the weak form
+ *  of the Laplace single-layer operator assembled with the SYMMETRIC flag),
+ *  stored as an approximate H-Cholesky decomposition \f$A \approx U^H U\f$.
+ *  Only the factor \f$U\f$ is stored, so the decomposition requires about
+ *  half the memory and work of the LU decomposition computed by
+ *  AcaApproximateLuInverse.
+ *
+ *  Both the decomposition and the forward and backward substitutions are
+ *  parallelized with TBB; the number of threads is controlled by the
+ *  parallelization options of the decomposed operator.
+ */
+template <typename ValueType>
+class AcaApproximateCholeskyInverse : public DiscreteBoundaryOperator<ValueType>
+{
+public:
+    typedef typename Fiber::ScalarTraits<ValueType>::RealType MagnitudeType;
+
+    /** \brief Construct an approximate Cholesky decomposition of a
+    Hermitian H-matrix.
+
+    \param[in] fwdOp  Operator represented internally as a H-matrix. It must
+                      be stored in the symmetric format and flagged as
+                      HERMITIAN; otherwise std::invalid_argument is thrown.
+    \param[in] delta  Requested approximation accuracy.
+
+    If the decomposition fails, for example because \p fwdOp is not positive
+    definite, std::runtime_error is thrown. */
+    AcaApproximateCholeskyInverse(
+            const DiscreteAcaBoundaryOperator<ValueType>& fwdOp,
+            MagnitudeType delta,
+            VerbosityLevel::Level verbosityLevel = VerbosityLevel::DEFAULT);
+
+    virtual ~AcaApproximateCholeskyInverse();
+
+    virtual unsigned int rowCount() const;
+    virtual unsigned int columnCount() const;
+
+    virtual void addBlock(const std::vector<int>& rows,
+                          const std::vector<int>& cols,
+                          const ValueType alpha,
+                          arma::Mat<ValueType>& block) const;
+
+#ifdef WITH_TRILINOS
+public:
+    virtual Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType> > domain() const;
+    virtual Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType> > range() const;
+
+protected:
+    virtual bool opSupportedImpl(Thyra::EOpTransp M_trans) const;
+#endif
+
+private:
+    virtual void applyBuiltInImpl(const TranspositionMode trans,
+                                  const arma::Col<ValueType>& x_in,
+                                  arma::Col<ValueType>& y_inout,
+                                  const ValueType alpha,
+                                  const ValueType beta) const;
+
+    /** \cond PRIVATE */
+    void deleteFactor();
+    /** \endcond */
+
+private:
+    /** \cond PRIVATE */
+    typedef mblock<typename AhmedTypeTraits<ValueType>::Type> AhmedMblock;
+
+#ifdef WITH_TRILINOS
+    Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType> > m_domainSpace;
+    Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType> > m_rangeSpace;
+#else
+    unsigned int m_rowCount;
+    unsigned int m_columnCount;
+#endif
+
+    blcluster* m_blockCluster;
+    AhmedMblock** m_blocksU;
+
+    IndexPermutation m_domainPermutation;
+    IndexPermutation m_rangePermutation;
+    /** \endcond */
+};
+
+} // namespace Bempp
+
+#endif
@@ -26,7 +26,9 @@
 #include "aca_approximate_lu_inverse.hpp"
 
 #include "ahmed_aux.hpp"
+#include "ahmed_parallel_lu.hpp"
 #include "discrete_aca_boundary_operator.hpp"
+#include "symmetry.hpp"
 
 #include "../fiber/explicit_instantiation.hpp"
 #include "../fiber/serial_blas_region.hpp"
@@ -36,6 +38,7 @@
 #include <Thyra_SpmdVectorSpaceDefaultBase.hpp>
 #endif
 
+#include <tbb/task_scheduler_init.h>
 #include <tbb/tick_count.h>
 
 namespace Bempp
@@ -63,15 +66,58 @@ AcaApproximateLuInverse<ValueType>::AcaApproximateLuInverse(
         std::cout << "Starting H-LU decomposition..." << std::endl;
     tbb::tick_count start = tbb::tick_count::now();
     const blcluster* fwdBlockCluster = fwdOp.m_blockCluster.get();
-    bool result = genLUprecond(const_cast<blcluster*>(fwdBlockCluster),
-                               fwdOp.m_blocks.get(),
-                               delta, fwdOp.m_maximumRank,
-                               m_blockCluster, m_blocksL, m_blocksU, true);
+    // Full-precision copies of mblocks stored in single precision, if any
+    typename DiscreteAcaBoundaryOperator<ValueType>::AhmedMblockArray
+            fwdBlocks = fwdOp.blocks();
+    bool result = false;
+    if (fwdOp.m_symmetry & (SYMMETRIC | HERMITIAN))
+        // AHMED stores only the upper triangle of symmetric H-matrices, which
+        // the parallel H-LU decomposition below cannot handle, so this case
+        // still uses the serial genLUprecond()
+        result = genLUprecond(const_cast<blcluster*>(fwdBlockCluster),
+                              fwdBlocks.get(),
+                              delta, fwdOp.m_maximumRank,
+                              m_blockCluster, m_blocksL, m_blocksU, true);
+    else {
+        const ParallelizationOptions& parallelOptions =
+                fwdOp.parallelizationOptions();
+        int maxThreadCount = 1;
+        if (!parallelOptions.isOpenClEnabled()) {
+            if (parallelOptions.maxThreadCount() == ParallelizationOptions::AUTO)
+                maxThreadCount = tbb::task_scheduler_init::automatic;
+            else
+                maxThreadCount = parallelOptions.maxThreadCount();
+        }
+        tbb::task_scheduler_init scheduler(maxThreadCount);
+
+        // The decomposition overwrites its input, so it operates on a copy
+        // of the H-matrix
+        m_blockCluster = copyBlockClusterTree(fwdBlockCluster);
+        const size_t blockCount = m_blockCluster->nleaves();
+        AhmedMblock** blocks = 0;
+        allocmbls(blockCount, blocks);
+        copyH(m_blockCluster, fwdBlocks.get(), blocks);
+        allocmbls(blockCount, m_blocksL);
+        allocmbls(blockCount, m_blocksU);
+        try {
+            result = computeHLuDecompositionInParallel<ValueType>(
+                        m_blockCluster, blocks, m_blocksL, m_blocksU,
+                        delta, fwdOp.m_maximumRank);
+        }
+        catch (...) {
+            freembls(m_blockCluster, blocks);
+            deleteFactors(); // the destructor will not be called
+            throw; // rethrow
+        }
+        freembls(m_blockCluster, blocks);
+    }
     tbb::tick_count end = tbb::tick_count::now();
-    if (!result)
+    if (!result) {
+        deleteFactors(); // the destructor will not be called
         throw std::runtime_error(
                 "AcaApproximateLuInverse::AcaApproximateLuInverse(): "
                 "Approximate LU factorisation failed");
+    }
 
     if (verbosityAtLeastDefault) {
         std::cout << "H-LU decomposition took " << (end - start).seconds()
@@ -120,12 +166,21 @@ AcaApproximateLuInverse<std::complex<float> >::AcaApproximateLuInverse(
 
 template <typename ValueType>
 AcaApproximateLuInverse<ValueType>::~AcaApproximateLuInverse()
+{
+    deleteFactors();
+}
+
+template <typename ValueType>
+void AcaApproximateLuInverse<ValueType>::deleteFactors()
 {
     if (m_blockCluster)
     {
-        freembls(m_blockCluster, m_blocksL);
-        freembls(m_blockCluster, m_blocksU);
+        if (m_blocksL)
+            freembls(m_blockCluster, m_blocksL);
+        if (m_blocksU)
+            freembls(m_blockCluster, m_blocksU);
         delete m_blockCluster;
+        m_blockCluster = 0;
     }
 }
 
@@ -209,7 +264,8 @@ applyBuiltInImpl(const TranspositionMode trans,
     arma::Col<ValueType> permuted;
     m_domainPermutation.permuteVector(x_in, permuted);
 
-    HLU_solve(m_blockCluster, m_blocksL, m_blocksU, ahmedCast(permuted.memptr()));
+    solveWithHLuDecompositionInParallel(m_blockCluster, m_blocksL, m_blocksU,
+                                        permuted.memptr());
 
     arma::Col<ValueType> operatorActionResult;
     m_rangePermutation.unpermuteVector(permuted, operatorActionResult);
@@ -47,6 +47,11 @@ template <typename ValueType> class DiscreteAcaBoundaryOperator;
 
 /** \ingroup composite_discrete_operators
  *  \brief Approximate LU decomposition of a H-matrix
+ *
+ *  The decomposition of non-symmetric H-matrices and the forward and
+ *  backward substitutions are parallelized with TBB; the number of threads
+ *  is controlled by the parallelization options of the decomposed operator.
+ *  H-matrices stored in the symmetric format are decomposed serially.
  */
 template <typename ValueType>
 class AcaApproximateLuInverse : public DiscreteBoundaryOperator<ValueType>
@@ -90,7 +95,9 @@ private:
                                   const ValueType alpha,
                                   const ValueType beta) const;
 
-
+    /** \cond PRIVATE */
+    void deleteFactors();
+    /** \endcond */
 
 private:
     /** \cond PRIVATE */
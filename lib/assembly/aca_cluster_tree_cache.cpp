@@ -0,0 +1,341 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "aca_cluster_tree_cache.hpp"
+
+#include "../fiber/explicit_instantiation.hpp"
+#include "../space/space.hpp"
+
+#ifdef WITH_AHMED
+#include "ahmed_aux.hpp"
+#include "aca_options.hpp"
+#include "cluster_construction_helper.hpp"
+#include "index_permutation.hpp"
+#endif // WITH_AHMED
+
+#include <boost/weak_ptr.hpp>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <tbb/mutex.h>
+
+namespace Bempp
+{
+
+/** \cond PRIVATE */
+template <typename BasisFunctionType>
+struct AcaClusterTreeCache<BasisFunctionType>::Impl
+{
+    struct ClusterTreeKey
+    {
+        // Weak pointers are ordered by their control blocks, so a space
+        // created at the address of a destroyed one gets a different key
+        boost::weak_ptr<const Space<BasisFunctionType> > space;
+        bool indexWithGlobalDofs;
+        unsigned int minimumBlockSize;
+        unsigned int maximumBlockSize;
+        int clusterSplitting;
+
+        bool operator<(const ClusterTreeKey& other) const {
+            if (space < other.space)
+                return true;
+            if (other.space < space)
+                return false;
+            if (indexWithGlobalDofs != other.indexWithGlobalDofs)
+                return indexWithGlobalDofs < other.indexWithGlobalDofs;
+            if (minimumBlockSize != other.minimumBlockSize)
+                return minimumBlockSize < other.minimumBlockSize;
+            if (maximumBlockSize != other.maximumBlockSize)
+                return maximumBlockSize < other.maximumBlockSize;
+            return clusterSplitting < other.clusterSplitting;
+        }
+    };
+
+    struct BlockClusterTreeKey
+    {
+        const AhmedBemCluster* testTree;
+        const AhmedBemCluster* trialTree;
+        const AhmedBemBlcluster* referenceTree;
+        double eta;
+        bool symmetric;
+        bool useStrongAdmissibilityCondition;
+
+        bool operator<(const BlockClusterTreeKey& other) const {
+            if (testTree != other.testTree)
+                return testTree < other.testTree;
+            if (trialTree != other.trialTree)
+                return trialTree < other.trialTree;
+            if (referenceTree != other.referenceTree)
+                return referenceTree < other.referenceTree;
+            if (eta != other.eta)
+                return eta < other.eta;
+            if (symmetric != other.symmetric)
+                return symmetric < other.symmetric;
+            return useStrongAdmissibilityCondition <
+                    other.useStrongAdmissibilityCondition;
+        }
+    };
+
+    struct BlockClusterTreeEntry
+    {
+        shared_ptr<AhmedBemBlcluster> tree;
+        unsigned int blockCount;
+        // The block cluster tree stores pointers to these trees, so they must
+        // be kept alive (this also prevents their addresses from being
+        // reused by other trees while the entry exists)
+        shared_ptr<AhmedBemCluster> testTree, trialTree;
+        shared_ptr<AhmedBemBlcluster> referenceTree;
+    };
+
+    typedef std::map<ClusterTreeKey, ClusterTree> ClusterTreeMap;
+    typedef std::map<BlockClusterTreeKey, BlockClusterTreeEntry>
+    BlockClusterTreeMap;
+
+    Impl() : hitCount(0), missCount(0) {
+    }
+
+#ifdef WITH_AHMED
+    void eraseTreesOfDestroyedSpaces();
+#endif // WITH_AHMED
+
+    // Protects the maps and the counters
+    mutable tbb::mutex mutex;
+    // Serializes the construction of block cluster trees
+    tbb::mutex blockClusterTreeConstructionMutex;
+    ClusterTreeMap clusterTrees;
+    BlockClusterTreeMap blockClusterTrees;
+    size_t hitCount;
+    size_t missCount;
+};
+/** \endcond */
+
+#ifdef WITH_AHMED
+
+template <typename BasisFunctionType>
+void
+AcaClusterTreeCache<BasisFunctionType>::Impl::eraseTreesOfDestroyedSpaces()
+{
+    // Must be called with the mutex locked
+    std::set<const AhmedBemCluster*> erasedTrees;
+    typename ClusterTreeMap::iterator it = clusterTrees.begin();
+    while (it != clusterTrees.end())
+        if (it->first.space.expired()) {
+            erasedTrees.insert(it->second.root.get());
+            clusterTrees.erase(it++);
+        } else
+            ++it;
+    if (erasedTrees.empty())
+        return;
+
+    // Block cluster trees built from the erased trees can no longer be
+    // requested, and neither can those truncated to match them
+    std::set<const AhmedBemBlcluster*> erasedBlockTrees;
+    typename BlockClusterTreeMap::iterator bit = blockClusterTrees.begin();
+    while (bit != blockClusterTrees.end())
+        if (erasedTrees.count(bit->first.testTree) ||
+                erasedTrees.count(bit->first.trialTree)) {
+            erasedBlockTrees.insert(bit->second.tree.get());
+            blockClusterTrees.erase(bit++);
+        } else
+            ++bit;
+    bit = blockClusterTrees.begin();
+    while (bit != blockClusterTrees.end())
+        if (erasedBlockTrees.count(bit->first.referenceTree))
+            blockClusterTrees.erase(bit++);
+        else
+            ++bit;
+}
+
+#endif // WITH_AHMED
+
+template <typename BasisFunctionType>
+AcaClusterTreeCache<BasisFunctionType>::AcaClusterTreeCache() :
+    m_impl(new Impl)
+{
+}
+
+template <typename BasisFunctionType>
+AcaClusterTreeCache<BasisFunctionType>::~AcaClusterTreeCache()
+{
+}
+
+#ifdef WITH_AHMED
+
+template <typename BasisFunctionType>
+typename AcaClusterTreeCache<BasisFunctionType>::ClusterTree
+AcaClusterTreeCache<BasisFunctionType>::clusterTree(
+        const shared_ptr<const Space<BasisFunctionType> >& space,
+        bool indexWithGlobalDofs,
+        const AcaOptions& acaOptions)
+{
+    if (!space)
+        throw std::invalid_argument("AcaClusterTreeCache::clusterTree(): "
+                                    "space must not be null");
+
+    typename Impl::ClusterTreeKey key;
+    key.space = space;
+    key.indexWithGlobalDofs = indexWithGlobalDofs;
+    key.minimumBlockSize = acaOptions.minimumBlockSize;
+    key.maximumBlockSize = acaOptions.maximumBlockSize;
+    key.clusterSplitting = acaOptions.clusterSplitting;
+
+    {
+        tbb::mutex::scoped_lock lock(m_impl->mutex);
+        m_impl->eraseTreesOfDestroyedSpaces();
+        typename Impl::ClusterTreeMap::const_iterator it =
+                m_impl->clusterTrees.find(key);
+        if (it != m_impl->clusterTrees.end()) {
+            ++m_impl->hitCount;
+            return it->second;
+        }
+        ++m_impl->missCount;
+    }
+
+    // The construction of a cluster tree may run in parallel, so it is done
+    // without holding the lock
+    typedef ClusterConstructionHelper<BasisFunctionType> CCH;
+    ClusterTree tree;
+    if (!indexWithGlobalDofs && space->isDiscontinuous())
+        // Global and flat local DOFs of discontinuous spaces coincide, so the
+        // global-DOF tree can be reused
+        tree = clusterTree(space, true /*indexWithGlobalDofs*/, acaOptions);
+    else
+        CCH::constructBemCluster(*space, indexWithGlobalDofs, acaOptions,
+                                 tree.root,
+                                 tree.o2pPermutation,
+                                 tree.p2oPermutation);
+
+    tbb::mutex::scoped_lock lock(m_impl->mutex);
+    // If another thread has stored a tree in the meantime, use that one, so
+    // that block cluster trees built from it can be shared
+    return m_impl->clusterTrees.insert(std::make_pair(key, tree)).first->second;
+}
+
+template <typename BasisFunctionType>
+shared_ptr<typename AcaClusterTreeCache<BasisFunctionType>::AhmedBemBlcluster>
+AcaClusterTreeCache<BasisFunctionType>::blockClusterTree(
+        const AcaOptions& acaOptions,
+        bool symmetric,
+        const shared_ptr<AhmedBemCluster>& testTree,
+        const shared_ptr<AhmedBemCluster>& trialTree,
+        bool useStrongAdmissibilityCondition,
+        const shared_ptr<AhmedBemBlcluster>& referenceTree,
+        unsigned int& blockCount)
+{
+    typedef ClusterConstructionHelper<BasisFunctionType> CCH;
+    if (!testTree || !trialTree)
+        throw std::invalid_argument("AcaClusterTreeCache::blockClusterTree(): "
+                                    "cluster trees must not be null");
+
+    typename Impl::BlockClusterTreeKey key;
+    key.testTree = testTree.get();
+    key.trialTree = trialTree.get();
+    key.referenceTree = referenceTree.get();
+    key.eta = acaOptions.eta;
+    key.symmetric = symmetric;
+    key.useStrongAdmissibilityCondition = useStrongAdmissibilityCondition;
+
+    const bool cacheable = !acaOptions.recompress;
+    if (cacheable) {
+        tbb::mutex::scoped_lock lock(m_impl->mutex);
+        typename Impl::BlockClusterTreeMap::const_iterator it =
+                m_impl->blockClusterTrees.find(key);
+        if (it != m_impl->blockClusterTrees.end()) {
+            ++m_impl->hitCount;
+            blockCount = it->second.blockCount;
+            return it->second.tree;
+        }
+    }
+
+    // The construction of block cluster trees temporarily changes the
+    // admissibility condition used by the cluster trees, which may be shared
+    // with other threads, so constructions must not overlap. It is serial,
+    // so the mutex serializing it is not held while any TBB task runs.
+    typename Impl::BlockClusterTreeEntry entry;
+    {
+        tbb::mutex::scoped_lock constructionLock(
+                    m_impl->blockClusterTreeConstructionMutex);
+        entry.tree.reset(CCH::constructBemBlockCluster(
+                             acaOptions, symmetric, *testTree, *trialTree,
+                             useStrongAdmissibilityCondition,
+                             blockCount).release());
+    }
+    if (referenceTree) {
+        CCH::truncateBemBlockCluster(entry.tree.get(), referenceTree.get());
+        blockCount = entry.tree->nleaves();
+    }
+    entry.blockCount = blockCount;
+    entry.testTree = testTree;
+    entry.trialTree = trialTree;
+    entry.referenceTree = referenceTree;
+
+    tbb::mutex::scoped_lock lock(m_impl->mutex);
+    ++m_impl->missCount;
+    if (!cacheable)
+        return entry.tree;
+    // If another thread has stored a tree in the meantime, use that one
+    const typename Impl::BlockClusterTreeEntry& storedEntry =
+            m_impl->blockClusterTrees.insert(
+                std::make_pair(key, entry)).first->second;
+    blockCount = storedEntry.blockCount;
+    return storedEntry.tree;
+}
+
+#endif // WITH_AHMED
+
+template <typename BasisFunctionType>
+void AcaClusterTreeCache<BasisFunctionType>::clear()
+{
+    tbb::mutex::scoped_lock lock(m_impl->mutex);
+    m_impl->blockClusterTrees.clear();
+    m_impl->clusterTrees.clear();
+}
+
+template <typename BasisFunctionType>
+size_t AcaClusterTreeCache<BasisFunctionType>::clusterTreeCount() const
+{
+    tbb::mutex::scoped_lock lock(m_impl->mutex);
+    return m_impl->clusterTrees.size();
+}
+
+template <typename BasisFunctionType>
+size_t AcaClusterTreeCache<BasisFunctionType>::blockClusterTreeCount() const
+{
+    tbb::mutex::scoped_lock lock(m_impl->mutex);
+    return m_impl->blockClusterTrees.size();
+}
+
+template <typename BasisFunctionType>
+size_t AcaClusterTreeCache<BasisFunctionType>::hitCount() const
+{
+    tbb::mutex::scoped_lock lock(m_impl->mutex);
+    return m_impl->hitCount;
+}
+
+template <typename BasisFunctionType>
+size_t AcaClusterTreeCache<BasisFunctionType>::missCount() const
+{
+    tbb::mutex::scoped_lock lock(m_impl->mutex);
+    return m_impl->missCount;
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS(AcaClusterTreeCache);
+
+} // namespace Bempp
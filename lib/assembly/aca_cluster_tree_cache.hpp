@@ -0,0 +1,180 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef bempp_aca_cluster_tree_cache_hpp
+#define bempp_aca_cluster_tree_cache_hpp
+
+#include "../common/common.hpp"
+#include "bempp/common/config_ahmed.hpp"
+
+#include "../common/shared_ptr.hpp"
+#include "../fiber/scalar_traits.hpp"
+#include "ahmed_aux_fwd.hpp"
+
+#include <boost/scoped_ptr.hpp>
+
+namespace Bempp
+{
+
+/** \cond FORWARD_DECL */
+template <typename BasisFunctionType> class Space;
+struct AcaOptions;
+class IndexPermutation;
+/** \endcond */
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Cache of cluster trees used in ACA assembly.
+ *
+ *  The construction of the cluster trees of the test and trial spaces and of
+ *  the block cluster tree built from them depends only on the spaces, on the
+ *  type of DOF indexing (global or flat local) and on a few ACA parameters,
+ *  but not on the operator being discretized. An AcaClusterTreeCache object,
+ *  owned by a Context, stores these trees together with the associated index
+ *  permutations, so that operators assembled in the same context on the same
+ *  spaces can reuse them and proceed directly to the approximation of matrix
+ *  blocks. The caches of DOF lists built during assembly are not stored:
+ *  they can be large and are only useful during the assembly of a single
+ *  operator.
+ *
+ *  Cluster trees are identified by the space (held through a weak pointer),
+ *  the DOF indexing mode and the values of AcaOptions::minimumBlockSize,
+ *  AcaOptions::maximumBlockSize and AcaOptions::clusterSplitting. The cache
+ *  does not extend the lifetime of the spaces: once a space is destroyed,
+ *  the trees constructed for it, and the block cluster trees built from
+ *  them, are removed on the next call to clusterTree(). Block cluster trees
+ *  are additionally identified by the cluster trees they were built from,
+ *  the value of AcaOptions::eta, the symmetry of the matrix and the
+ *  admissibility condition.
+ *
+ *  All member functions are thread-safe. Trees are constructed without
+ *  holding the lock protecting the cache, so two threads requesting the same
+ *  missing tree may both construct it; only one copy is stored. */
+template <typename BasisFunctionType>
+class AcaClusterTreeCache
+{
+public:
+    typedef typename Fiber::ScalarTraits<BasisFunctionType>::RealType
+    CoordinateType;
+    typedef AhmedDofWrapper<CoordinateType> AhmedDofType;
+    typedef ExtendedBemCluster<AhmedDofType> AhmedBemCluster;
+    typedef bbxbemblcluster<AhmedDofType, AhmedDofType> AhmedBemBlcluster;
+
+    /** \brief Cluster tree of a space and associated data. */
+    struct ClusterTree
+    {
+        /** \brief Root of the cluster tree. */
+        shared_ptr<AhmedBemCluster> root;
+        /** \brief Map of original indices to permuted indices. */
+        shared_ptr<IndexPermutation> o2pPermutation;
+        /** \brief Map of permuted indices to original indices. */
+        shared_ptr<IndexPermutation> p2oPermutation;
+    };
+
+    /** \brief Constructor. */
+    AcaClusterTreeCache();
+
+    /** \brief Destructor. */
+    ~AcaClusterTreeCache();
+
+#ifdef WITH_AHMED
+    /** \brief Return the cluster tree of the space \p space.
+     *
+     *  The tree is constructed and stored in the cache if it is not there
+     *  yet.
+     *
+     *  \param[in] space
+     *    Space whose DOFs are to be clustered.
+     *  \param[in] indexWithGlobalDofs
+     *    If true, the tree is indexed with global DOFs, otherwise with flat
+     *    local DOFs.
+     *  \param[in] acaOptions
+     *    ACA parameters. */
+    ClusterTree clusterTree(const shared_ptr<const Space<BasisFunctionType> >& space,
+                            bool indexWithGlobalDofs,
+                            const AcaOptions& acaOptions);
+
+    /** \brief Return the block cluster tree built from the cluster trees
+     *  \p testTree and \p trialTree.
+     *
+     *  The tree is constructed and stored in the cache if it is not there
+     *  yet. If \p referenceTree is not null, the block cluster tree is
+     *  truncated so that its leaves correspond to those of \p referenceTree
+     *  (see ClusterConstructionHelper::truncateBemBlockCluster()).
+     *
+     *  If <tt>acaOptions.recompress</tt> is set, the H-matrix will be
+     *  agglomerated after assembly, which modifies its block cluster tree. In
+     *  this case a new tree is constructed on each call and it is not stored
+     *  in the cache.
+     *
+     *  \param[in] acaOptions
+     *    ACA parameters.
+     *  \param[in] symmetric
+     *    If true, a block cluster tree of a symmetric matrix is constructed.
+     *  \param[in] testTree
+     *    Root of the test cluster tree.
+     *  \param[in] trialTree
+     *    Root of the trial cluster tree.
+     *  \param[in] useStrongAdmissibilityCondition
+     *    Admissibility condition to use.
+     *  \param[in] referenceTree
+     *    Block cluster tree whose leaves the leaves of the returned tree should
+     *    correspond to, or null.
+     *  \param[out] blockCount
+     *    Number of leaves of the returned tree. */
+    shared_ptr<AhmedBemBlcluster> blockClusterTree(
+            const AcaOptions& acaOptions,
+            bool symmetric,
+            const shared_ptr<AhmedBemCluster>& testTree,
+            const shared_ptr<AhmedBemCluster>& trialTree,
+            bool useStrongAdmissibilityCondition,
+            const shared_ptr<AhmedBemBlcluster>& referenceTree,
+            unsigned int& blockCount);
+#endif // WITH_AHMED
+
+    /** \brief Remove all trees from the cache. */
+    void clear();
+
+    /** \brief Number of cluster trees stored in the cache. */
+    size_t clusterTreeCount() const;
+
+    /** \brief Number of block cluster trees stored in the cache. */
+    size_t blockClusterTreeCount() const;
+
+    /** \brief Number of requests for cluster or block cluster trees that
+     *  were satisfied from the cache. */
+    size_t hitCount() const;
+
+    /** \brief Number of requests for cluster or block cluster trees that
+     *  required the construction of a new tree. */
+    size_t missCount() const;
+
+private:
+    /** \cond PRIVATE */
+    AcaClusterTreeCache(const AcaClusterTreeCache& other);
+    AcaClusterTreeCache& operator=(const AcaClusterTreeCache& other);
+
+    struct Impl;
+    boost::scoped_ptr<Impl> m_impl;
+    /** \endcond */
+};
+
+} // namespace Bempp
+
+#endif
@@ -23,12 +23,14 @@
 
 #include "aca_global_assembler.hpp"
 
+#include "aca_cluster_tree_cache.hpp"
 #include "assembly_options.hpp"
 #include "block_coalescer.hpp"
 #include "cluster_construction_helper.hpp"
 #include "context.hpp"
 #include "evaluation_options.hpp"
 #include "index_permutation.hpp"
+#include "local_dof_lists_cache.hpp"
 #include "discrete_boundary_operator_composition.hpp"
 #include "discrete_sparse_boundary_operator.hpp"
 
@@ -44,13 +46,18 @@
 #include "../fiber/scalar_traits.hpp"
 #include "../space/space.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <sstream>
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
+#include <memory>
 
 #include <boost/type_traits/is_complex.hpp>
 
 #include <tbb/atomic.h>
+#include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 #include <tbb/task_scheduler_init.h>
 #include <tbb/concurrent_queue.h>
@@ -69,6 +76,7 @@
 #endif
 
 #include "discrete_aca_boundary_operator.hpp"
+#include "discrete_h2_boundary_operator.hpp"
 #include "modified_aca.hpp"
 #include "potential_operator_aca_assembly_helper.hpp"
 #include "scattered_range.hpp"
@@ -105,6 +113,122 @@ namespace
 {
 
 #ifdef WITH_AHMED
+// Recompress a low-rank block with AHMED's truncated SVD (QR decompositions
+// of both factors followed by an SVD of the small core matrix). The block is
+// replaced only if this reduces its storage. Return the number of values
+// saved.
+template <typename ResultType>
+size_t recompressLowRankBlock(
+        mblock<typename AhmedTypeTraits<ResultType>::Type>*& block,
+        double eps)
+{
+    typedef typename AhmedTypeTraits<ResultType>::Type AhmedResultType;
+    typedef mblock<AhmedResultType> AhmedMblock;
+
+    if (!block || !block->isLrM() || block->rank() == 0)
+        return 0;
+    const unsigned int rowCount = block->getn1();
+    const unsigned int colCount = block->getn2();
+    const unsigned int rank = block->rank();
+    AhmedResultType* data = block->getdata();
+    std::auto_ptr<AhmedMblock> recompressed(
+                new AhmedMblock(rowCount, colCount));
+    recompressed->cpyLrM_cmpr(rank, data, rowCount, data + rank * rowCount,
+                              colCount, eps, rank);
+    const size_t oldValueCount = block->nvals();
+    const size_t newValueCount = recompressed->nvals();
+    if (newValueCount >= oldValueCount)
+        return 0;
+    delete block;
+    block = recompressed.release();
+    return oldValueCount - newValueCount;
+}
+
+// Keeps track of the memory taken by the mblocks assembled so far and
+// decides how to react when it approaches AcaOptions::memoryBudget. Once
+// RECOMPRESSION_THRESHOLD of the budget is used, all subsequent low-rank
+// blocks are recompressed; once TRUNCATION_THRESHOLD is used, they are
+// recompressed with the tolerance multiplied by TRUNCATION_EPS_FACTOR, i.e.
+// their ranks are truncated at the expense of accuracy. If the budget is
+// exceeded, the remaining blocks are skipped and the assembly fails.
+class MemoryBudgetTracker
+{
+public:
+    explicit MemoryBudgetTracker(size_t budget) :
+        m_budget(budget)
+    {
+        m_usedMemory = 0;
+        m_assembledBlockCount = 0;
+        m_recompressedBlockCount = 0;
+        m_truncatedBlockCount = 0;
+        m_exceeded = false;
+    }
+
+    bool isActive() const {
+        return m_budget > 0;
+    }
+
+    bool isExceeded() const {
+        return m_exceeded;
+    }
+
+    // Tolerance to be used to recompress the next low-rank block or 0 if
+    // it should not be recompressed
+    double recompressionEps(double eps) const {
+        if (!isActive())
+            return 0.;
+        const double usedFraction = double(m_usedMemory) / m_budget;
+        if (usedFraction >= TRUNCATION_THRESHOLD)
+            return TRUNCATION_EPS_FACTOR * eps;
+        if (usedFraction >= RECOMPRESSION_THRESHOLD)
+            return eps;
+        return 0.;
+    }
+
+    void addBlock(size_t memory, double recompressionEps, double eps) {
+        ++m_assembledBlockCount;
+        if (recompressionEps > eps)
+            ++m_truncatedBlockCount;
+        else if (recompressionEps > 0.)
+            ++m_recompressedBlockCount;
+        if ((m_usedMemory += memory) > m_budget && isActive())
+            m_exceeded = true;
+    }
+
+    size_t usedMemory() const {
+        return m_usedMemory;
+    }
+
+    size_t truncatedBlockCount() const {
+        return m_truncatedBlockCount;
+    }
+
+    void printReport(std::ostream& out) const {
+        out << "Memory budget: " << m_budget / 1024. / 1024. << " MB, used "
+            << m_usedMemory / 1024. / 1024. << " MB by "
+            << m_assembledBlockCount << " blocks; "
+            << m_recompressedBlockCount << " blocks recompressed, "
+            << m_truncatedBlockCount << " blocks truncated to tolerance "
+            << "multiplied by " << TRUNCATION_EPS_FACTOR << ".\n";
+    }
+
+private:
+    static const double RECOMPRESSION_THRESHOLD;
+    static const double TRUNCATION_THRESHOLD;
+    static const double TRUNCATION_EPS_FACTOR;
+
+    size_t m_budget;
+    tbb::atomic<size_t> m_usedMemory;
+    tbb::atomic<size_t> m_assembledBlockCount;
+    tbb::atomic<size_t> m_recompressedBlockCount;
+    tbb::atomic<size_t> m_truncatedBlockCount;
+    tbb::atomic<bool> m_exceeded;
+};
+
+const double MemoryBudgetTracker::RECOMPRESSION_THRESHOLD = 0.75;
+const double MemoryBudgetTracker::TRUNCATION_THRESHOLD = 0.9;
+const double MemoryBudgetTracker::TRUNCATION_EPS_FACTOR = 10.;
+
 template <typename BasisFunctionType, typename ResultType,
           typename AcaAssemblyHelper>
 class AcaAssemblerLoopBody
@@ -127,6 +251,9 @@ public:
             BlockCoalescer<ResultType>* coalescer,
             const AcaOptions& options,
             tbb::atomic<size_t>& done,
+            tbb::atomic<size_t>& savedValueCount,
+            MemoryBudgetTracker& memoryBudgetTracker,
+            tbb::atomic<size_t>& denseAdmissibleBlockCount,
             bool verbose,
             bool symmetric,
             std::vector<ChunkStatistics>& stats) :
@@ -138,7 +265,11 @@ public:
         m_blocks(blocks),
         m_flatLocalBlocks(flatLocalBlocks),
         m_coalescer(coalescer),
-        m_options(options), m_done(done), m_verbose(verbose),
+        m_options(options), m_done(done),
+        m_savedValueCount(savedValueCount),
+        m_memoryBudgetTracker(memoryBudgetTracker),
+        m_denseAdmissibleBlockCount(denseAdmissibleBlockCount),
+        m_verbose(verbose),
         m_symmetric(symmetric),
         m_stats(stats)
     {
@@ -155,6 +286,9 @@ public:
                           << std::endl;
                 continue;
             }
+            if (m_memoryBudgetTracker.isExceeded())
+                // The assembly will fail anyway; don't waste time
+                continue;
             m_stats[leafClusterIndex].valid = true;
             m_stats[leafClusterIndex].chunkStart = r.begin();
             m_stats[leafClusterIndex].chunkSize = r.size();
@@ -181,6 +315,15 @@ public:
                 if (m_options.useAhmedAca)
                     apprx_unsym(*helper, blocks[cluster->getidx()],
                                 cluster, m_options.eps, m_options.maximumRank);
+                else if (m_options.useAcaPlus)
+                    apprx_unsym_plus(
+                                *helper, blocks[cluster->getidx()],
+                                cluster, m_options.eps, m_options.maximumRank);
+                else if (m_options.pivotBatchSize > 1)
+                    apprx_unsym_block(
+                                *helper, blocks[cluster->getidx()],
+                                cluster, m_options.eps, m_options.maximumRank,
+                                m_options.pivotBatchSize);
                 else
                     apprx_unsym_shooting(
                                 *helper, blocks[cluster->getidx()],
@@ -188,6 +331,7 @@ public:
             }
             if (m_leafClusters[leafClusterIndex]->isadm() &&
                     !blocks[cluster->getidx()]->isLrM()) {
+                ++m_denseAdmissibleBlockCount;
 // // Show clusters for which ACA failed
 //                std::cout << "global assembly: " << globalAssembly << "\n";
 //                typedef ExtendedBemCluster<AhmedDofType> AhmedBemCluster;
@@ -209,8 +353,21 @@ public:
             }
             if (!globalAssembly)
                 m_coalescer->coalesceBlock(cluster->getidx());
+            AhmedMblock*& assembledBlock =
+                    m_blocks[m_leafClusters[leafClusterIndex]->getidx()];
+            const double budgetEps =
+                    m_memoryBudgetTracker.recompressionEps(m_options.eps);
+            if (m_options.recompressLowRankBlocks || budgetEps > 0.)
+                m_savedValueCount += recompressLowRankBlock<ResultType>(
+                            assembledBlock,
+                            std::max(m_options.eps, budgetEps));
+            if (m_memoryBudgetTracker.isActive())
+                m_memoryBudgetTracker.addBlock(
+                            assembledBlock ?
+                                assembledBlock->nvals() * sizeof(ResultType) :
+                                0,
+                            budgetEps, m_options.eps);
             m_stats[leafClusterIndex].endTime = tbb::tick_count::now();
-            // TODO: recompress
             const int HASH_COUNT = 20;
             if (m_verbose)
                 progressbar(std::cout, TEXT, (++m_done) - 1,
@@ -229,12 +386,90 @@ private:
     BlockCoalescer<ResultType>* m_coalescer;
     const AcaOptions& m_options;
     tbb::atomic<size_t>& m_done;
+    tbb::atomic<size_t>& m_savedValueCount;
+    MemoryBudgetTracker& m_memoryBudgetTracker;
+    tbb::atomic<size_t>& m_denseAdmissibleBlockCount;
     bool m_verbose;
     LeafClusterIndexQueue& m_leafClusterIndexQueue;
     bool m_symmetric;
     std::vector<ChunkStatistics>& m_stats;
 };
 
+template <typename ResultType>
+void agglomerateInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ResultType>::Type>** blocks,
+        double eps, int maximumRank);
+
+template <typename ResultType>
+class AgglomerationLoopBody
+{
+public:
+    typedef mblock<typename AhmedTypeTraits<ResultType>::Type> AhmedMblock;
+
+    AgglomerationLoopBody(blcluster* parent, AhmedMblock** blocks,
+                          double eps, int maximumRank) :
+        m_parent(parent), m_blocks(blocks),
+        m_eps(eps), m_maximumRank(maximumRank)
+    {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int colSonCount = m_parent->getncs();
+        for (unsigned int i = r.begin(); i != r.end(); ++i) {
+            blcluster* son = m_parent->getson(i / colSonCount,
+                                              i % colSonCount);
+            if (son)
+                agglomerateInParallel<ResultType>(son, m_blocks,
+                                                  m_eps, m_maximumRank);
+        }
+    }
+
+private:
+    blcluster* m_parent;
+    AhmedMblock** m_blocks;
+    double m_eps;
+    int m_maximumRank;
+};
+
+// Recompress the part of an H-matrix corresponding to the block cluster tree
+// rooted at blockCluster. The subtrees of the sons of each node are
+// agglomerated concurrently (they do not share any mblocks); then the node
+// itself is coarsened if all its sons have become leaves.
+template <typename ResultType>
+void agglomerateInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ResultType>::Type>** blocks,
+        double eps, int maximumRank)
+{
+    // Subtrees with fewer leaves are agglomerated serially by AHMED
+    const unsigned int MIN_TASK_LEAF_COUNT = 64;
+
+    if (blockCluster->isleaf())
+        return;
+    if (blockCluster->nleaves() < MIN_TASK_LEAF_COUNT) {
+        agglH(blockCluster, blocks, eps, maximumRank);
+        return;
+    }
+
+    const unsigned int sonCount =
+            blockCluster->getnrs() * blockCluster->getncs();
+    typedef AgglomerationLoopBody<ResultType> Body;
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(0, sonCount, 1),
+                      Body(blockCluster, blocks, eps, maximumRank));
+
+    // AHMED only merges the sons of a block cluster if all of them are
+    // leaves. The sons have already been processed, so in that case agglH()
+    // only examines this level of the tree.
+    for (unsigned int r = 0; r < blockCluster->getnrs(); ++r)
+        for (unsigned int c = 0; c < blockCluster->getncs(); ++c) {
+            blcluster* son = blockCluster->getson(r, c);
+            if (son && !son->isleaf())
+                return;
+        }
+    agglH(blockCluster, blocks, eps, maximumRank);
+}
+
 void reallyGetClusterIds(const cluster& clusterTree,
                          const std::vector<unsigned int>& p2oDofs,
                          std::vector<unsigned int>& clusterIds,
@@ -405,6 +640,105 @@ void reorderIdentically(AhmedLeafClusterArray& leafClusters,
         assert(leafClusters[i]->getidx() == refLeafClusters[i]->getidx());
 }
 
+// Estimate the relative cost of assembling the block corresponding to a
+// leaf cluster. For admissible blocks, ACA evaluates about (n1 + n2) * r
+// entries, r being the expected rank. For inadmissible blocks, all n1 * n2
+// entries are evaluated, and those corresponding to DOFs with touching
+// supports require much more expensive singular quadrature.
+//
+// The number of such singular entries is not counted: the element
+// adjacency is not available at the level of the block cluster tree, and
+// the estimate only needs to order the blocks, not to predict their
+// assembly times. Instead, if the bounding boxes of the two clusters
+// touch, each DOF of the smaller cluster is assumed to have NEIGHBOUR_COUNT
+// neighbours in the other cluster, which is about right for DOFs
+// associated with vertices or elements of a shape-regular surface mesh.
+// Blocks whose bounding boxes are separated get no singular entries.
+template <typename CoordinateType>
+double estimateLeafAssemblyCost(blcluster* leafCluster,
+                                const AcaOptions& options)
+{
+    typedef AhmedDofWrapper<CoordinateType> AhmedDofType;
+    typedef ExtendedBemCluster<AhmedDofType> AhmedBemCluster;
+
+    // Cost of an entry evaluated with singular quadrature relative to that
+    // of a regular entry
+    const double SINGULAR_ENTRY_WEIGHT = 20.;
+    // Typical number of DOFs whose supports touch that of a given DOF
+    const double NEIGHBOUR_COUNT = 10.;
+
+    const double n1 = leafCluster->getn1(), n2 = leafCluster->getn2();
+    if (leafCluster->isadm()) {
+        double expectedRank = std::ceil(3. * std::log10(1. / options.eps));
+        expectedRank = std::min(expectedRank, double(options.maximumRank));
+        expectedRank = std::max(1., std::min(expectedRank, std::min(n1, n2)));
+        return (n1 + n2) * expectedRank;
+    }
+
+    double singularEntryCount = 0.;
+    const AhmedBemCluster* cluster1 =
+            dynamic_cast<const AhmedBemCluster*>(leafCluster->getcl1());
+    const AhmedBemCluster* cluster2 =
+            dynamic_cast<const AhmedBemCluster*>(leafCluster->getcl2());
+    if (cluster1 && cluster2 && cluster1->extDist2(cluster2) == 0.)
+        singularEntryCount =
+                std::min(n1 * n2, NEIGHBOUR_COUNT * std::min(n1, n2));
+    return n1 * n2 + (SINGULAR_ENTRY_WEIGHT - 1.) * singularEntryCount;
+}
+
+// In the hybrid mode, blocks admissible with respect to the local cluster
+// tree are approximated with ACA in the local DOF numbering
+template <typename CoordinateType>
+void estimateLeafAssemblyCosts(AhmedLeafClusterArray& leafClusters,
+                               AhmedLeafClusterArray& localLeafClusters,
+                               const AcaOptions& options,
+                               std::vector<double>& costs)
+{
+    costs.resize(leafClusters.size());
+    for (size_t i = 0; i < leafClusters.size(); ++i) {
+        blcluster* cluster = leafClusters[i];
+        if (options.mode == AcaOptions::HYBRID_ASSEMBLY &&
+                localLeafClusters[i]->isadm())
+            cluster = localLeafClusters[i];
+        costs[i] = estimateLeafAssemblyCost<CoordinateType>(cluster, options);
+    }
+}
+
+// Print the correlation between the estimated costs of blocks and the
+// measured assembly times, and the time during which the loop was winding
+// down (after the last block had been started)
+inline void reportSchedulingStatistics(
+        const std::vector<double>& costs,
+        const std::vector<ChunkStatistics>& stats,
+        const tbb::tick_count& loopStart, const tbb::tick_count& loopEnd)
+{
+    double sumX = 0., sumY = 0., sumXX = 0., sumYY = 0., sumXY = 0.;
+    size_t count = 0;
+    tbb::tick_count lastStart = loopStart;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (!stats[i].valid)
+            continue;
+        const double x = costs[i];
+        const double y = (stats[i].endTime - stats[i].startTime).seconds();
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumYY += y * y;
+        sumXY += x * y;
+        ++count;
+        if ((stats[i].startTime - lastStart).seconds() > 0.)
+            lastStart = stats[i].startTime;
+    }
+    const double denominator = std::sqrt((count * sumXX - sumX * sumX) *
+                                         (count * sumYY - sumY * sumY));
+    if (denominator > 0.)
+        std::cout << "Correlation between estimated and measured block "
+                     "assembly costs: "
+                  << (count * sumXY - sumX * sumY) / denominator << "\n";
+    std::cout << "Time between the start of the last block and the end of "
+                 "the ACA loop: " << (loopEnd - lastStart).seconds() << " s\n";
+}
+
 template <typename AcaAssemblyHelper,
           typename BasisFunctionType, typename ResultType>
 std::auto_ptr<DiscreteAcaBoundaryOperator<ResultType> >
@@ -449,13 +783,21 @@ assembleAcaOperator(
     const size_t testDofCount = test_o2pPermutation->size();
     const size_t trialDofCount = trial_o2pPermutation->size();
 
+    // Blocks are dispatched to threads in order of decreasing estimated
+    // cost, so that the most expensive ones do not end up at the tail of the
+    // loop
+    typedef typename Fiber::ScalarTraits<ResultType>::RealType CoordinateType;
     AhmedLeafClusterArray leafClusters(blclusterTree.get());
-    leafClusters.sortAccordingToClusterSize();
+    AhmedLeafClusterArray localLeafClusters(localBlclusterTree.get());
+    reorderIdentically(localLeafClusters, leafClusters);
+    std::vector<double> leafCosts;
+    estimateLeafAssemblyCosts<CoordinateType>(
+                leafClusters, localLeafClusters, acaOptions, leafCosts);
+    leafClusters.sortAccordingToCost(leafCosts);
     if (acaOptions.firstClusterIndex >= 0)
-        leafClusters.startWithClusterOfIndex(acaOptions.firstClusterIndex);
+        leafClusters.startWithClusterOfIndex(acaOptions.firstClusterIndex,
+                                             leafCosts);
     const size_t leafClusterCount = leafClusters.size();
-
-    AhmedLeafClusterArray localLeafClusters(localBlclusterTree.get());
     reorderIdentically(localLeafClusters, leafClusters);
 
     int maxThreadCount = 1;
@@ -469,6 +811,11 @@ assembleAcaOperator(
     tbb::task_scheduler_init scheduler(maxThreadCount);
     tbb::atomic<size_t> done;
     done = 0;
+    tbb::atomic<size_t> savedValueCount;
+    savedValueCount = 0;
+    MemoryBudgetTracker memoryBudgetTracker(acaOptions.memoryBudget);
+    tbb::atomic<size_t> denseAdmissibleBlockCount;
+    denseAdmissibleBlockCount = 0;
 
 #ifdef DUMP_DENSE_BLOCKS
     if (acaOptions.firstClusterIndex >= 0)
@@ -501,30 +848,69 @@ assembleAcaOperator(
     tbb::tick_count loopStart = tbb::tick_count::now();
     {
         Fiber::SerialBlasRegion region; // if possible, ensure that BLAS is single-threaded
-        tbb::parallel_for(tbb::blocked_range<size_t>(0, leafClusterCount),
+        // Each iteration pops the most expensive remaining block from the
+        // queue; a grain size of 1 lets idle threads steal any iterations
+        // not started yet
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, leafClusterCount, 1),
                           Body(helper, admissibleHelper,
                                leafClusters, localLeafClusters,
                                leafClusterIndexQueue,
                                blocks, decomposedBlocks,
                                coalescer.get(),
-                               acaOptions, done, verbosityAtLeastDefault,
-                               symmetric, chunkStats));
+                               acaOptions, done, savedValueCount,
+                               memoryBudgetTracker,
+                               denseAdmissibleBlockCount,
+                               verbosityAtLeastDefault,
+                               symmetric, chunkStats),
+                          tbb::simple_partitioner());
     }
     tbb::tick_count loopEnd = tbb::tick_count::now();
     if (verbosityAtLeastDefault) {
         std::cout << "\n"; // the progress bar doesn't print the final \n
         std::cout << "ACA loop took " << (loopEnd - loopStart).seconds() << " s"
                   << std::endl;
+        if (acaOptions.recompressLowRankBlocks)
+            std::cout << "Recompression of low-rank blocks saved "
+                      << sizeof(ResultType) * savedValueCount / 1024. / 1024.
+                      << " MB" << std::endl;
+        if (denseAdmissibleBlockCount > 0)
+            std::cout << "ACA failed to find a low-rank approximation of "
+                      << denseAdmissibleBlockCount << " admissible blocks; "
+                         "they are stored as dense matrices" << std::endl;
+        if (memoryBudgetTracker.isActive())
+            memoryBudgetTracker.printReport(std::cout);
     }
+    if (memoryBudgetTracker.isExceeded()) {
+        std::ostringstream report;
+        report << "assembleAcaOperator(): the H-matrix does not fit in the "
+                  "memory budget set in AcaOptions::memoryBudget even after "
+                  "recompression and rank truncation of low-rank blocks; the "
+                  "assembly has been aborted. ";
+        memoryBudgetTracker.printReport(report);
+        report << "Increase the budget or the ACA tolerance (eps).";
+        throw std::runtime_error(report.str());
+    }
+    if (verbosityAtLeastDefault && memoryBudgetTracker.truncatedBlockCount() > 0)
+        std::cout << "Warning: " << memoryBudgetTracker.truncatedBlockCount()
+                  << " low-rank blocks were truncated with a tolerance larger "
+                     "than AcaOptions::eps to keep within "
+                     "AcaOptions::memoryBudget" << std::endl;
 
-    // TODO: parallelise!
     if (acaOptions.recompress) {
         if (verbosityAtLeastDefault)
             std::cout << "About to start ACA agglomeration" << std::endl;
-        agglH(blclusterTree.get(), blocks.get(),
-              acaOptions.eps, acaOptions.maximumRank);
+        tbb::tick_count agglomerationStart = tbb::tick_count::now();
+        {
+            Fiber::SerialBlasRegion region;
+            agglomerateInParallel<ResultType>(
+                        blclusterTree.get(), blocks.get(),
+                        acaOptions.eps, acaOptions.maximumRank);
+        }
+        tbb::tick_count agglomerationEnd = tbb::tick_count::now();
         if (verbosityAtLeastDefault)
-            std::cout << "Agglomeration finished" << std::endl;
+            std::cout << "Agglomeration took "
+                      << (agglomerationEnd - agglomerationStart).seconds()
+                      << " s" << std::endl;
     }
 
     // // Dump timing data of individual chunks
@@ -567,6 +953,9 @@ assembleAcaOperator(
         if (indexWithGlobalDofs)
             std::cout << "Accessed "
                       << 100. * accessedFraction << "% matrix entries.\n";
+        helper->printDofListsCacheStatistics(std::cout);
+        if (admissibleHelper != helper)
+            admissibleHelper->printDofListsCacheStatistics(std::cout);
 
         tbb::tick_count::interval_t localAdmTime, globalAdmTime, inadmTime;
         for (size_t i = 0; i < leafClusterCount; ++i)
@@ -587,6 +976,8 @@ assembleAcaOperator(
                       << globalAdmTime.seconds() << " s\n";
             std::cout << "CPU time spent on assembly of inadmissible blocks: "
                       << inadmTime.seconds() << "\n";
+            reportSchedulingStatistics(leafCosts, chunkStats,
+                                       loopStart, loopEnd);
         }
         std::cout << std::endl;
     }
@@ -623,6 +1014,16 @@ assembleAcaOperator(
                                      *trial_o2pPermutation, // domain
                                      *test_o2pPermutation, // range
                                      parallelOptions));
+    if (acaOptions.singlePrecisionLowRankBlocks) {
+        // the operator must be the sole owner of the mblocks
+        coalescer.reset();
+        blocks.reset();
+        const size_t savedBytes = acaOp->storeLowRankBlocksInSinglePrecision();
+        if (verbosityAtLeastDefault)
+            std::cout << "Memory saved by storing low-rank blocks in single "
+                         "precision: " << savedBytes / 1048576. << " MB"
+                      << std::endl;
+    }
     return acaOp;
 }
 
@@ -634,8 +1035,8 @@ assembleAcaOperator(
 template <typename BasisFunctionType, typename ResultType>
 std::auto_ptr<DiscreteBoundaryOperator<ResultType> >
 AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
-        const Space<BasisFunctionType>& testSpace,
-        const Space<BasisFunctionType>& trialSpace,
+        const shared_ptr<const Space<BasisFunctionType> >& testSpace,
+        const shared_ptr<const Space<BasisFunctionType> >& trialSpace,
         const std::vector<LocalAssemblerForBoundaryOperators*>& localAssemblers,
         const std::vector<LocalAssemblerForBoundaryOperators*>&
         localAssemblersForAdmissibleBlocks,
@@ -667,7 +1068,10 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
     // in AcaWeakFormAssemblerLoopBody::operator() -- but operations on
     // symmetric/Hermitian matrices are not always trivial and we do need to be
     // able to test them properly.)
-    bool symmetric = symmetry & SYMMETRIC;
+    // H^2-matrices are constructed from H-matrices stored in the general
+    // format
+    const bool h2Mode = options.assemblyMode() == AssemblyOptions::H2;
+    bool symmetric = (symmetry & SYMMETRIC) && !h2Mode;
     if (symmetry & HERMITIAN && !(symmetry & SYMMETRIC) &&
             verbosityAtLeastDefault)
         std::cout << "Warning: assembly of non-symmetric Hermitian H-matrices "
@@ -682,9 +1086,9 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
 #endif // WITH_TRILINOS
 
     const size_t testDofCount = indexWithGlobalDofs ?
-                testSpace.globalDofCount() : testSpace.flatLocalDofCount();
+                testSpace->globalDofCount() : testSpace->flatLocalDofCount();
     const size_t trialDofCount = indexWithGlobalDofs ?
-                trialSpace.globalDofCount() : trialSpace.flatLocalDofCount();
+                trialSpace->globalDofCount() : trialSpace->flatLocalDofCount();
 
     if (symmetric && testDofCount != trialDofCount)
         throw std::invalid_argument("AcaGlobalAssembler::assembleDetachedWeakForm(): "
@@ -692,50 +1096,51 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
                                     "using test and trial spaces with different "
                                     "numbers of DOFs");
 
-    // Construct cluster trees indexed with global indices
+    // Construct cluster trees indexed with global indices, or take them from
+    // the cache if they have already been constructed for another operator
 
     // o2p: map of original indices to permuted indices
     // p2o: map of permuted indices to original indices
-    typedef ClusterConstructionHelper<BasisFunctionType> CCH;
-    shared_ptr<AhmedBemCluster> testClusterTree;
-    shared_ptr<IndexPermutation> test_o2pPermutation, test_p2oPermutation;
-    CCH::constructBemCluster(
-                testSpace, true /*indexWithGlobalDofs*/, acaOptions,
-                testClusterTree, test_o2pPermutation, test_p2oPermutation);
-    shared_ptr<AhmedBemCluster> trialClusterTree;
-    shared_ptr<IndexPermutation> trial_o2pPermutation, trial_p2oPermutation;
-    if (symmetric || &testSpace == &trialSpace) {
-        trialClusterTree = testClusterTree;
-        trial_o2pPermutation = test_o2pPermutation;
-        trial_p2oPermutation = test_p2oPermutation;
-    } else
-        CCH::constructBemCluster(
-                    trialSpace, true /*indexWithGlobalDofs*/, acaOptions,
-                    trialClusterTree, trial_o2pPermutation, trial_p2oPermutation);
+    typedef AcaClusterTreeCache<BasisFunctionType> ClusterTreeCache;
+    typedef typename ClusterTreeCache::ClusterTree ClusterTree;
+    shared_ptr<ClusterTreeCache> cache = context.acaClusterTreeCache();
+    const bool sameTrees = symmetric || testSpace == trialSpace;
+
+    ClusterTree testTree = cache->clusterTree(
+                testSpace, true /*indexWithGlobalDofs*/, acaOptions);
+    ClusterTree trialTree = testTree;
+    if (!sameTrees)
+        trialTree = cache->clusterTree(
+                    trialSpace, true /*indexWithGlobalDofs*/, acaOptions);
+    shared_ptr<AhmedBemCluster> testClusterTree = testTree.root;
+    shared_ptr<IndexPermutation> test_o2pPermutation = testTree.o2pPermutation;
+    shared_ptr<IndexPermutation> test_p2oPermutation = testTree.p2oPermutation;
+    shared_ptr<AhmedBemCluster> trialClusterTree = trialTree.root;
+    shared_ptr<IndexPermutation> trial_o2pPermutation = trialTree.o2pPermutation;
+    shared_ptr<IndexPermutation> trial_p2oPermutation = trialTree.p2oPermutation;
 
     // If necessary, construct cluster trees indexed with flat local indices
-    shared_ptr<AhmedBemCluster> testLocalClusterTree = testClusterTree;
-    shared_ptr<IndexPermutation> testLocal_o2pPermutation = test_o2pPermutation;
-    shared_ptr<IndexPermutation> testLocal_p2oPermutation = test_p2oPermutation;
-    shared_ptr<AhmedBemCluster> trialLocalClusterTree = trialClusterTree;
-    shared_ptr<IndexPermutation> trialLocal_o2pPermutation = trial_o2pPermutation;
-    shared_ptr<IndexPermutation> trialLocal_p2oPermutation = trial_p2oPermutation;
+    // (for discontinuous spaces they coincide with the global-index trees)
+    ClusterTree testLocalTree = testTree;
+    ClusterTree trialLocalTree = trialTree;
     if (!indexWithGlobalDofs) {
-        if (!testSpace.isDiscontinuous())
-            CCH::constructBemCluster(
-                        testSpace, false /*indexWithGlobalDofs*/, acaOptions,
-                        testLocalClusterTree,
-                        testLocal_o2pPermutation, testLocal_p2oPermutation);
-        if (symmetric || &testSpace == &trialSpace) {
-            trialLocalClusterTree = testLocalClusterTree;
-            trialLocal_o2pPermutation = testLocal_o2pPermutation;
-            trialLocal_p2oPermutation = testLocal_p2oPermutation;
-        } else if (!trialSpace.isDiscontinuous())
-            CCH::constructBemCluster(
-                        trialSpace, false /*indexWithGlobalDofs*/, acaOptions,
-                        trialLocalClusterTree,
-                        trialLocal_o2pPermutation, trialLocal_p2oPermutation);
+        testLocalTree = cache->clusterTree(
+                    testSpace, false /*indexWithGlobalDofs*/, acaOptions);
+        trialLocalTree = testLocalTree;
+        if (!sameTrees)
+            trialLocalTree = cache->clusterTree(
+                        trialSpace, false /*indexWithGlobalDofs*/, acaOptions);
     }
+    shared_ptr<AhmedBemCluster> testLocalClusterTree = testLocalTree.root;
+    shared_ptr<IndexPermutation> testLocal_o2pPermutation =
+            testLocalTree.o2pPermutation;
+    shared_ptr<IndexPermutation> testLocal_p2oPermutation =
+            testLocalTree.p2oPermutation;
+    shared_ptr<AhmedBemCluster> trialLocalClusterTree = trialLocalTree.root;
+    shared_ptr<IndexPermutation> trialLocal_o2pPermutation =
+            trialLocalTree.o2pPermutation;
+    shared_ptr<IndexPermutation> trialLocal_p2oPermutation =
+            trialLocalTree.p2oPermutation;
 
 //    // Export VTK plots showing the disctribution of leaf cluster ids
 //    std::vector<unsigned int> testClusterIds;
@@ -758,23 +1163,22 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
         // experiments indicate that for spaces with discontinuous basis
         // functions one gets faster assembly (although *slightly* higher memory
         // consumption) with the strong admissibility condition
-        (testSpace.isDiscontinuous() && trialSpace.isDiscontinuous());
-    shared_ptr<AhmedBemBlcluster> blclusterTree(
-                CCH::constructBemBlockCluster(acaOptions, symmetric,
-                                              *testClusterTree, *trialClusterTree,
-                                              useStrongAdmissibilityCondition,
-                                              blockCount).release());
+        (testSpace->isDiscontinuous() && trialSpace->isDiscontinuous());
+    shared_ptr<AhmedBemBlcluster> blclusterTree =
+            cache->blockClusterTree(acaOptions, symmetric,
+                                    testClusterTree, trialClusterTree,
+                                    useStrongAdmissibilityCondition,
+                                    shared_ptr<AhmedBemBlcluster>(),
+                                    blockCount);
     shared_ptr<AhmedBemBlcluster> localBlclusterTree = blclusterTree;
     if (!indexWithGlobalDofs &&
-            (!testSpace.isDiscontinuous() || !trialSpace.isDiscontinuous())) {
+            (!testSpace->isDiscontinuous() || !trialSpace->isDiscontinuous())) {
         unsigned int localBlockCount = 0;
-        localBlclusterTree.reset(
-                    CCH::constructBemBlockCluster(
-                        acaOptions, symmetric,
-                        *testLocalClusterTree, *trialLocalClusterTree,
-                        useStrongAdmissibilityCondition,
-                        localBlockCount).release());
-        CCH::truncateBemBlockCluster(localBlclusterTree.get(), blclusterTree.get());
+        localBlclusterTree = cache->blockClusterTree(
+                    acaOptions, symmetric,
+                    testLocalClusterTree, trialLocalClusterTree,
+                    useStrongAdmissibilityCondition,
+                    blclusterTree, localBlockCount);
         if (localBlclusterTree->nleaves() != blclusterTree->nleaves())
             throw std::runtime_error(
                 "AcaGlobalAssembler::assembleDetachedWeakForm(): "
@@ -788,11 +1192,11 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
 #ifdef DUMP_DENSE_BLOCKS
     std::vector<Point3D<CoordinateType> > testDofCenters, trialDofCenters;
     if (indexWithGlobalDofs) {
-        testSpace.getGlobalDofPositions(testDofCenters);
-        trialSpace.getGlobalDofPositions(trialDofCenters);
+        testSpace->getGlobalDofPositions(testDofCenters);
+        trialSpace->getGlobalDofPositions(trialDofCenters);
     } else {
-        testSpace.getFlatLocalDofPositions(testDofCenters);
-        trialSpace.getFlatLocalDofPositions(trialDofCenters);
+        testSpace->getFlatLocalDofPositions(testDofCenters);
+        trialSpace->getFlatLocalDofPositions(trialDofCenters);
     }
 #endif // DUMP_DENSE_BLOCKS
 
@@ -809,23 +1213,37 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
     assemblyOptionsWithGlobalIndices.switchToAcaMode(
                 acaOptionsWithGlobalIndices);
 
+    // The DOF lists are cached only for the duration of this assembly. If
+    // the test and trial spaces coincide, so do their permutations, and the
+    // lists can be shared; otherwise the helper creates the trial cache.
+    typedef LocalDofListsCache<BasisFunctionType> DofListsCache;
+    shared_ptr<DofListsCache> testDofListsCache(
+                new DofListsCache(*testSpace,
+                                  test_p2oPermutation->permutedIndices(),
+                                  true /*indexWithGlobalDofs*/,
+                                  acaOptions.maximumDofListsCacheMemory));
+    shared_ptr<DofListsCache> trialDofListsCache;
+    if (testSpace == trialSpace)
+        trialDofListsCache = testDofListsCache;
+
     // TODO: It might be better (more efficient and elegant)
     // to pass p2oPermutation than p2oDofs.
     // Also, it might be more logical to rename IndexPermutation to IndexMapping
     // and permute/unpermute to map/unmap.
     shared_ptr<AcaAssemblyHelper> helper(
                 new AcaAssemblyHelper(
-                    testSpace, trialSpace,
+                    *testSpace, *trialSpace,
                     test_p2oPermutation->permutedIndices(),
                     trial_p2oPermutation->permutedIndices(),
                     localAssemblers, sparseTermsToAdd,
                     denseTermMultipliers, sparseTermMultipliers,
-                    assemblyOptionsWithGlobalIndices));
+                    assemblyOptionsWithGlobalIndices,
+                    testDofListsCache, trialDofListsCache));
     shared_ptr<AcaAssemblyHelper> admissibleHelper = helper;
     if (!indexWithGlobalDofs)
         admissibleHelper.reset(
                     new AcaAssemblyHelper(
-                        testSpace, trialSpace,
+                        *testSpace, *trialSpace,
                         testLocal_p2oPermutation->permutedIndices(),
                         trialLocal_p2oPermutation->permutedIndices(),
                         localAssemblersForAdmissibleBlocks, sparseTermsToAdd,
@@ -835,20 +1253,20 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
     shared_ptr<const Epetra_CrsMatrix> testGlobalToLocal, trialGlobalToLocal;
     if (!indexWithGlobalDofs) {
         typedef DiscreteSparseBoundaryOperator<ResultType> SparseOp;
-        if (!testSpace.isDiscontinuous()) {
+        if (!testSpace->isDiscontinuous()) {
             shared_ptr<SparseOp> op =
                     constructOperatorMappingGlobalToFlatLocalDofs<
-                    BasisFunctionType, ResultType>(testSpace);
+                    BasisFunctionType, ResultType>(*testSpace);
             testGlobalToLocal = op->epetraMatrix();
             testGlobalToLocal = permuteEpetraCrsMatrix(
                         *testGlobalToLocal,
                         *test_p2oPermutation,
                         *testLocal_o2pPermutation);
         }
-        if (!trialSpace.isDiscontinuous()) {
+        if (!trialSpace->isDiscontinuous()) {
             shared_ptr<SparseOp> op =
                     constructOperatorMappingGlobalToFlatLocalDofs<
-                    BasisFunctionType, ResultType>(trialSpace);
+                    BasisFunctionType, ResultType>(*trialSpace);
             trialGlobalToLocal = op->epetraMatrix();
             trialGlobalToLocal = permuteEpetraCrsMatrix(
                         *trialGlobalToLocal,
@@ -873,6 +1291,20 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
                 );
 
     std::auto_ptr<DiscreteBndOp> result;
+    if (h2Mode) {
+        tbb::tick_count start = tbb::tick_count::now();
+        std::auto_ptr<DiscreteH2BoundaryOperator<ResultType> > h2Op(
+                    new DiscreteH2BoundaryOperator<ResultType>(*acaOp));
+        tbb::tick_count end = tbb::tick_count::now();
+        if (verbosityAtLeastDefault)
+            std::cout << "H2-matrix construction took "
+                      << (end - start).seconds() << " s.\n"
+                      << "Needed storage: "
+                      << h2Op->memory() / 1024. / 1024. << " MB.\n"
+                      << "Maximum cluster basis rank: "
+                      << h2Op->maximumRank() << "." << std::endl;
+        result = h2Op;
+    } else
         result = acaOp;
     return result;
 
@@ -886,8 +1318,8 @@ AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
 template <typename BasisFunctionType, typename ResultType>
 std::auto_ptr<DiscreteBoundaryOperator<ResultType> >
 AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
-        const Space<BasisFunctionType>& testSpace,
-        const Space<BasisFunctionType>& trialSpace,
+        const shared_ptr<const Space<BasisFunctionType> >& testSpace,
+        const shared_ptr<const Space<BasisFunctionType> >& trialSpace,
         LocalAssemblerForBoundaryOperators& localAssembler,
         LocalAssemblerForBoundaryOperators& localAssemblerForAdmissibleBlocks,
         const Context<BasisFunctionType, ResultType>& context,
@@ -71,8 +71,8 @@ public:
     LocalAssemblerForPotentialOperators;
 
     static std::auto_ptr<DiscreteBndOp> assembleDetachedWeakForm(
-            const Space<BasisFunctionType>& testSpace,
-            const Space<BasisFunctionType>& trialSpace,
+            const shared_ptr<const Space<BasisFunctionType> >& testSpace,
+            const shared_ptr<const Space<BasisFunctionType> >& trialSpace,
             const std::vector<LocalAssemblerForBoundaryOperators*>& localAssemblers,
             const std::vector<LocalAssemblerForBoundaryOperators*>&
             localAssemblersForAdmissibleBlocks,
@@ -83,8 +83,8 @@ public:
             int symmetry);
 
     static std::auto_ptr<DiscreteBndOp> assembleDetachedWeakForm(
-            const Space<BasisFunctionType>& testSpace,
-            const Space<BasisFunctionType>& trialSpace,
+            const shared_ptr<const Space<BasisFunctionType> >& testSpace,
+            const shared_ptr<const Space<BasisFunctionType> >& trialSpace,
             LocalAssemblerForBoundaryOperators& localAssembler,
             LocalAssemblerForBoundaryOperators& localAssemblerForAdmissibleBlocks,
             const Context<BasisFunctionType, ResultType>& context,
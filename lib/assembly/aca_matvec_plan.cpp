@@ -0,0 +1,934 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_ahmed.hpp"
+
+#ifdef WITH_AHMED
+
+#include "aca_matvec_plan.hpp"
+
+#include "aca_single_precision_factors.hpp"
+#include "ahmed_aux.hpp"
+#include "symmetry.hpp"
+
+#include "../common/complex_aux.hpp"
+#include "../fiber/explicit_instantiation.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace Bempp
+{
+
+namespace
+{
+
+// In H-matrices stored in the symmetric format, only diagonal leaves have
+// coinciding row and column clusters
+inline bool isDiagonalLeaf(const blcluster* cluster)
+{
+    return cluster->getb1() == cluster->getb2();
+}
+
+template <typename ValueType>
+double estimateMultiplicationCost(
+        blcluster* cluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>* block,
+        const AcaSinglePrecisionFactors<ValueType>* singlePrecisionFactors,
+        bool symmetricStorage)
+{
+    // The constant term accounts for the overhead of visiting a leaf
+    const double LEAF_OVERHEAD = 16.;
+    if (!block)
+        return LEAF_OVERHEAD;
+    double cost = 0.;
+    if (singlePrecisionFactors &&
+            singlePrecisionFactors->contains(cluster->getidx()))
+        // Single-precision factors take half as much memory traffic
+        cost = 0.5 * singlePrecisionFactors->rank(cluster->getidx()) *
+                (block->getn1() + block->getn2());
+    else if (block->isLrM())
+        cost = double(block->rank()) * (block->getn1() + block->getn2());
+    else
+        cost = double(block->nvals());
+    // Off-diagonal leaves of symmetric matrices are multiplied twice
+    if (symmetricStorage && !isDiagonalLeaf(cluster))
+        cost *= 2.;
+    return LEAF_OVERHEAD + cost;
+}
+
+// Perform the operation y += alpha * op(A) * x, where A is the matrix
+// stored in block. The arrays x and y store colCount columns in the
+// column-major order, separated by xStride and yStride elements, and point to
+// the first input and output row of the block, respectively.
+template <typename ValueType>
+void multiplyMblock(TranspositionMode trans, ValueType alpha,
+                    mblock<typename AhmedTypeTraits<ValueType>::Type>* block,
+                    ValueType* x, size_t xStride,
+                    ValueType* y, size_t yStride, size_t colCount)
+{
+    if (colCount == 1) {
+        if (trans == NO_TRANSPOSE)
+            block->mltaVec(ahmedCast(alpha), ahmedCast(x), ahmedCast(y));
+        else if (trans == TRANSPOSE)
+            block->mltatVec(ahmedCast(alpha), ahmedCast(x), ahmedCast(y));
+        else // trans == CONJUGATE_TRANSPOSE
+            block->mltahVec(ahmedCast(alpha), ahmedCast(x), ahmedCast(y));
+        return;
+    }
+
+    const bool lowRank = block->isLrM();
+    if (!lowRank && (block->isLtM() || block->isUtM() ||
+                     block->isSyM() || block->isHeM())) {
+        // Leave blocks with special storage schemes to AHMED
+        for (size_t col = 0; col < colCount; ++col)
+            multiplyMblock(trans, alpha, block, x + col * xStride, xStride,
+                           y + col * yStride, yStride, 1);
+        return;
+    }
+
+    // Gather the input rows of all columns, so that the data of the block
+    // are read only once
+    const size_t n1 = block->getn1(), n2 = block->getn2();
+    const size_t inputSize = (trans == NO_TRANSPOSE) ? n2 : n1;
+    const size_t outputSize = (trans == NO_TRANSPOSE) ? n1 : n2;
+    arma::Mat<ValueType> input(inputSize, colCount);
+    for (size_t col = 0; col < colCount; ++col)
+        std::copy(x + col * xStride, x + col * xStride + inputSize,
+                  input.colptr(col));
+
+    ValueType* data = reinterpret_cast<ValueType*>(block->getdata());
+    arma::Mat<ValueType> output;
+    if (lowRank) {
+        // Low-rank blocks are stored as A = U V^H, the n1 x k matrix U being
+        // followed by the n2 x k matrix V
+        const size_t rank = block->rank();
+        if (rank == 0)
+            return;
+        const arma::Mat<ValueType> U(data, n1, rank, false /* copy_aux_mem */);
+        const arma::Mat<ValueType> V(data + n1 * rank, n2, rank, false);
+        if (trans == NO_TRANSPOSE)
+            output = U * (V.t() * input);
+        else if (trans == TRANSPOSE)
+            output = arma::conj(V) * (U.st() * input);
+        else // trans == CONJUGATE_TRANSPOSE
+            output = V * (U.t() * input);
+    } else {
+        const arma::Mat<ValueType> D(data, n1, n2, false /* copy_aux_mem */);
+        if (trans == NO_TRANSPOSE)
+            output = D * input;
+        else if (trans == TRANSPOSE)
+            output = D.st() * input;
+        else // trans == CONJUGATE_TRANSPOSE
+            output = D.t() * input;
+    }
+
+    for (size_t col = 0; col < colCount; ++col) {
+        const ValueType* source = output.colptr(col);
+        ValueType* dest = y + col * yStride;
+        for (size_t row = 0; row < outputSize; ++row)
+            dest[row] += alpha * source[row];
+    }
+}
+
+// Perform the operation y += alpha * op(A) * x, where A = U V^H is a
+// low-rank block of size n1 x n2 whose factors U and V are stored one after
+// another in single precision. All sums are accumulated in the precision of
+// ValueType. The arrays x and y are laid out as in multiplyMblock().
+template <typename ValueType, typename SingleValueType>
+void multiplySinglePrecisionMblock(TranspositionMode trans, ValueType alpha,
+                                   const SingleValueType* factors,
+                                   size_t n1, size_t n2, size_t rank,
+                                   const ValueType* x, size_t xStride,
+                                   ValueType* y, size_t yStride,
+                                   size_t colCount)
+{
+    // op(A) = P Q^T, where P is the factor contributing to the output and Q
+    // the one contracted with the input:
+    // A = U V^H: P = U, Q = conj(V); A^T = conj(V) U^T: P = conj(V), Q = U;
+    // A^H = V U^H: P = V, Q = conj(U)
+    const SingleValueType* U = factors;
+    const SingleValueType* V = factors + n1 * rank;
+    const SingleValueType* P = (trans == NO_TRANSPOSE) ? U : V;
+    const SingleValueType* Q = (trans == NO_TRANSPOSE) ? V : U;
+    const size_t outputSize = (trans == NO_TRANSPOSE) ? n1 : n2;
+    const size_t inputSize = (trans == NO_TRANSPOSE) ? n2 : n1;
+    const bool conjugateP = (trans == TRANSPOSE);
+    const bool conjugateQ = (trans != TRANSPOSE);
+
+    // Each column of the factors is read once for all columns of x and y
+    std::vector<ValueType> t(rank * colCount);
+    for (size_t r = 0; r < rank; ++r) {
+        const SingleValueType* q = Q + r * inputSize;
+        for (size_t col = 0; col < colCount; ++col) {
+            const ValueType* xCol = x + col * xStride;
+            ValueType sum = 0.;
+            if (conjugateQ)
+                for (size_t i = 0; i < inputSize; ++i)
+                    sum += conj(static_cast<ValueType>(q[i])) * xCol[i];
+            else
+                for (size_t i = 0; i < inputSize; ++i)
+                    sum += static_cast<ValueType>(q[i]) * xCol[i];
+            t[r + col * rank] = alpha * sum;
+        }
+    }
+    for (size_t r = 0; r < rank; ++r) {
+        const SingleValueType* p = P + r * outputSize;
+        for (size_t col = 0; col < colCount; ++col) {
+            ValueType* yCol = y + col * yStride;
+            const ValueType coefficient = t[r + col * rank];
+            if (conjugateP)
+                for (size_t i = 0; i < outputSize; ++i)
+                    yCol[i] += conj(static_cast<ValueType>(p[i])) * coefficient;
+            else
+                for (size_t i = 0; i < outputSize; ++i)
+                    yCol[i] += static_cast<ValueType>(p[i]) * coefficient;
+        }
+    }
+}
+
+// Multiply the mblock of the leaf cluster, using single-precision factors
+// if they are available. x and y point to the first input and output row of
+// the block.
+template <typename ValueType>
+void multiplyLeafMblock(
+        TranspositionMode trans, ValueType alpha,
+        blcluster* cluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** blocks,
+        const AcaSinglePrecisionFactors<ValueType>* singlePrecisionFactors,
+        ValueType* x, size_t xStride,
+        ValueType* y, size_t yStride, size_t colCount)
+{
+    const size_t index = cluster->getidx();
+    if (singlePrecisionFactors && singlePrecisionFactors->contains(index))
+        multiplySinglePrecisionMblock(
+                    trans, alpha, singlePrecisionFactors->factors(index),
+                    cluster->getn1(), cluster->getn2(),
+                    singlePrecisionFactors->rank(index),
+                    x, xStride, y, yStride, colCount);
+    else
+        multiplyMblock(trans, alpha, blocks[index],
+                       x, xStride, y, yStride, colCount);
+}
+
+// Multiply a general leaf; x and y point to the full input and output arrays
+template <typename ValueType>
+void multiplyLeaf(TranspositionMode trans, ValueType alpha,
+                  blcluster* cluster,
+                  mblock<typename AhmedTypeTraits<ValueType>::Type>** blocks,
+                  const AcaSinglePrecisionFactors<ValueType>* singlePrecisionFactors,
+                  ValueType* x, size_t xStride,
+                  ValueType* y, size_t yStride, size_t colCount)
+{
+    if (trans == NO_TRANSPOSE)
+        multiplyLeafMblock(trans, alpha, cluster, blocks, singlePrecisionFactors,
+                           x + cluster->getb2(), xStride,
+                           y + cluster->getb1(), yStride, colCount);
+    else
+        multiplyLeafMblock(trans, alpha, cluster, blocks, singlePrecisionFactors,
+                           x + cluster->getb1(), xStride,
+                           y + cluster->getb2(), yStride, colCount);
+}
+
+// Multiply a diagonal leaf of a symmetric or Hermitian H-matrix; x and y
+// point to the full input and output arrays
+template <typename ValueType>
+void multiplyDiagonalLeaf(int symmetry, ValueType alpha,
+                          blcluster* cluster,
+                          mblock<typename AhmedTypeTraits<ValueType>::Type>** blocks,
+                          ValueType* x, size_t xStride,
+                          ValueType* y, size_t yStride, size_t colCount)
+{
+    // Let AHMED deal with the symmetric storage of the diagonal block
+    for (size_t col = 0; col < colCount; ++col)
+        if (symmetry & SYMMETRIC)
+            mltaSyHVec(ahmedCast(alpha), cluster, blocks,
+                       ahmedCast(x + col * xStride),
+                       ahmedCast(y + col * yStride));
+        else
+            mltaHeHVec(ahmedCast(alpha), cluster, blocks,
+                       ahmedCast(x + col * xStride),
+                       ahmedCast(y + col * yStride));
+}
+
+template <typename ValueType>
+void multiplySymmetricLeaf(int symmetry, ValueType alpha,
+                           blcluster* cluster,
+                           mblock<typename AhmedTypeTraits<ValueType>::Type>** blocks,
+                           const AcaSinglePrecisionFactors<ValueType>* singlePrecisionFactors,
+                           ValueType* x, size_t xStride,
+                           ValueType* y, size_t yStride, size_t colCount)
+{
+    if (isDiagonalLeaf(cluster))
+        multiplyDiagonalLeaf(symmetry, alpha, cluster, blocks,
+                             x, xStride, y, yStride, colCount);
+    else {
+        // The leaf represents both the block A and its mirror image A^T
+        // (for symmetric matrices) or A^H (for Hermitian ones)
+        multiplyLeaf(NO_TRANSPOSE, alpha, cluster, blocks,
+                     singlePrecisionFactors,
+                     x, xStride, y, yStride, colCount);
+        multiplyLeaf((symmetry & SYMMETRIC) ? TRANSPOSE : CONJUGATE_TRANSPOSE,
+                     alpha, cluster, blocks, singlePrecisionFactors,
+                     x, xStride, y, yStride, colCount);
+    }
+}
+
+// Multiply a single mblock product, writing the result to the array yOut
+// starting at the first row of the product's output range
+template <typename ValueType>
+void multiplyProduct(
+        const typename AcaMatvecPlan<ValueType>::MblockProduct& product,
+        TranspositionMode mirroredMode, int symmetry, ValueType alpha,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** blocks,
+        const AcaSinglePrecisionFactors<ValueType>* singlePrecisionFactors,
+        ValueType* x, size_t xStride,
+        ValueType* yOut, size_t yStride, size_t colCount)
+{
+    typedef AcaMatvecPlan<ValueType> Plan;
+    blcluster* cluster = product.cluster;
+    if (product.kind == Plan::DIRECT_PRODUCT)
+        multiplyLeafMblock(NO_TRANSPOSE, alpha, cluster, blocks,
+                           singlePrecisionFactors,
+                           x + cluster->getb2(), xStride,
+                           yOut, yStride, colCount);
+    else if (product.kind == Plan::MIRRORED_PRODUCT)
+        multiplyLeafMblock(mirroredMode, alpha, cluster, blocks,
+                           singlePrecisionFactors,
+                           x + cluster->getb1(), xStride,
+                           yOut, yStride, colCount);
+    else // product.kind == Plan::DIAGONAL_PRODUCT
+        // Diagonal products never straddle row ranges, so yOut always points
+        // into the full output array
+        multiplyDiagonalLeaf(symmetry, alpha, cluster, blocks,
+                             x, xStride, yOut - cluster->getb1(), yStride,
+                             colCount);
+}
+
+inline bool productStartsBefore(
+        const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b)
+{
+    return a.first < b.first;
+}
+
+template <typename ValueType>
+class WorkUnitMultiplicationLoopBody
+{
+    typedef mblock<typename AhmedTypeTraits<ValueType>::Type> AhmedMblock;
+public:
+    WorkUnitMultiplicationLoopBody(
+            TranspositionMode trans, int symmetry, ValueType alpha,
+            arma::Mat<ValueType>& x, arma::Mat<ValueType>& y,
+            std::vector<arma::Mat<ValueType> >& scratchMatrices,
+            const std::vector<blcluster*>& leafClusters,
+            const std::vector<size_t>& workUnitOffsets,
+            AhmedMblock** blocks,
+            const AcaSinglePrecisionFactors<ValueType>* singlePrecisionFactors) :
+        m_trans(trans), m_symmetry(symmetry), m_alpha(alpha), m_x(x), m_y(y),
+        m_scratchMatrices(scratchMatrices),
+        m_leafClusters(leafClusters), m_workUnitOffsets(workUnitOffsets),
+        m_blocks(blocks), m_singlePrecisionFactors(singlePrecisionFactors)
+    {
+    }
+
+    void operator() (const tbb::blocked_range<size_t>& r) const {
+        for (size_t unit = r.begin(); unit != r.end(); ++unit) {
+            // Work unit 0 writes directly to the output array, the others to
+            // their own scratch matrices
+            ValueType* y = 0;
+            if (unit == 0)
+                y = m_y.memptr();
+            else {
+                arma::Mat<ValueType>& scratch = m_scratchMatrices[unit - 1];
+                scratch.zeros(m_y.n_rows, m_y.n_cols);
+                y = scratch.memptr();
+            }
+            for (size_t i = m_workUnitOffsets[unit];
+                 i < m_workUnitOffsets[unit + 1]; ++i) {
+                blcluster* cluster = m_leafClusters[i];
+                if (m_symmetry & (SYMMETRIC | HERMITIAN))
+                    multiplySymmetricLeaf(m_symmetry, m_alpha, cluster,
+                                          m_blocks, m_singlePrecisionFactors,
+                                          m_x.memptr(), m_x.n_rows,
+                                          y, m_y.n_rows, m_y.n_cols);
+                else
+                    multiplyLeaf(m_trans, m_alpha, cluster,
+                                 m_blocks, m_singlePrecisionFactors,
+                                 m_x.memptr(), m_x.n_rows,
+                                 y, m_y.n_rows, m_y.n_cols);
+            }
+        }
+    }
+
+private:
+    TranspositionMode m_trans;
+    int m_symmetry;
+    ValueType m_alpha;
+    arma::Mat<ValueType>& m_x;
+    arma::Mat<ValueType>& m_y;
+    std::vector<arma::Mat<ValueType> >& m_scratchMatrices;
+    const std::vector<blcluster*>& m_leafClusters;
+    const std::vector<size_t>& m_workUnitOffsets;
+    AhmedMblock** m_blocks;
+    const AcaSinglePrecisionFactors<ValueType>* m_singlePrecisionFactors;
+};
+
+template <typename ValueType>
+class ScratchMatrixSummationLoopBody
+{
+public:
+    ScratchMatrixSummationLoopBody(
+            const std::vector<arma::Mat<ValueType> >& scratchMatrices,
+            size_t scratchMatrixCount,
+            arma::Mat<ValueType>& y) :
+        m_scratchMatrices(scratchMatrices),
+        m_scratchMatrixCount(scratchMatrixCount), m_y(y)
+    {
+    }
+
+    void operator() (const tbb::blocked_range<size_t>& r) const {
+        for (size_t col = 0; col < m_y.n_cols; ++col) {
+            ValueType* y = m_y.colptr(col);
+            for (size_t m = 0; m < m_scratchMatrixCount; ++m) {
+                const ValueType* scratch = m_scratchMatrices[m].colptr(col);
+                for (size_t row = r.begin(); row != r.end(); ++row)
+                    y[row] += scratch[row];
+            }
+        }
+    }
+
+private:
+    const std::vector<arma::Mat<ValueType> >& m_scratchMatrices;
+    size_t m_scratchMatrixCount;
+    arma::Mat<ValueType>& m_y;
+};
+
+template <typename ValueType>
+class StraddlingProductLoopBody
+{
+    typedef mblock<typename AhmedTypeTraits<ValueType>::Type> AhmedMblock;
+    typedef typename AcaMatvecPlan<ValueType>::RowPartition RowPartition;
+public:
+    StraddlingProductLoopBody(
+            TranspositionMode mirroredMode, int symmetry, ValueType alpha,
+            arma::Mat<ValueType>& x,
+            std::vector<arma::Mat<ValueType> >& scratchMatrices,
+            const RowPartition& partition,
+            AhmedMblock** blocks,
+            const AcaSinglePrecisionFactors<ValueType>* singlePrecisionFactors) :
+        m_mirroredMode(mirroredMode), m_symmetry(symmetry), m_alpha(alpha),
+        m_x(x), m_scratchMatrices(scratchMatrices), m_partition(partition),
+        m_blocks(blocks), m_singlePrecisionFactors(singlePrecisionFactors)
+    {
+    }
+
+    void operator() (const tbb::blocked_range<size_t>& r) const {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const size_t outputSize =
+                    m_partition.straddlingProducts[i].outputSize;
+            arma::Mat<ValueType>& scratch = m_scratchMatrices[i];
+            scratch.zeros(outputSize, m_x.n_cols);
+            multiplyProduct(m_partition.straddlingProducts[i],
+                            m_mirroredMode, m_symmetry, m_alpha, m_blocks,
+                            m_singlePrecisionFactors,
+                            m_x.memptr(), m_x.n_rows,
+                            scratch.memptr(), outputSize, m_x.n_cols);
+        }
+    }
+
+private:
+    TranspositionMode m_mirroredMode;
+    int m_symmetry;
+    ValueType m_alpha;
+    arma::Mat<ValueType>& m_x;
+    std::vector<arma::Mat<ValueType> >& m_scratchMatrices;
+    const RowPartition& m_partition;
+    AhmedMblock** m_blocks;
+    const AcaSinglePrecisionFactors<ValueType>* m_singlePrecisionFactors;
+};
+
+template <typename ValueType>
+class RowRangeMultiplicationLoopBody
+{
+    typedef mblock<typename AhmedTypeTraits<ValueType>::Type> AhmedMblock;
+    typedef typename AcaMatvecPlan<ValueType>::RowPartition RowPartition;
+    typedef typename AcaMatvecPlan<ValueType>::MblockProduct MblockProduct;
+public:
+    RowRangeMultiplicationLoopBody(
+            TranspositionMode mirroredMode, int symmetry, ValueType alpha,
+            arma::Mat<ValueType>& x, arma::Mat<ValueType>& y,
+            const std::vector<arma::Mat<ValueType> >& scratchMatrices,
+            const RowPartition& partition,
+            AhmedMblock** blocks,
+            const AcaSinglePrecisionFactors<ValueType>* singlePrecisionFactors) :
+        m_mirroredMode(mirroredMode), m_symmetry(symmetry), m_alpha(alpha),
+        m_x(x), m_y(y), m_scratchMatrices(scratchMatrices),
+        m_partition(partition), m_blocks(blocks),
+        m_singlePrecisionFactors(singlePrecisionFactors)
+    {
+    }
+
+    void operator() (const tbb::blocked_range<size_t>& r) const {
+        for (size_t unit = r.begin(); unit != r.end(); ++unit) {
+            // Products owned by this work unit write only to its row range
+            for (size_t i = m_partition.productOffsets[unit];
+                 i < m_partition.productOffsets[unit + 1]; ++i) {
+                const MblockProduct& product = m_partition.products[i];
+                multiplyProduct(product, m_mirroredMode, m_symmetry, m_alpha,
+                                m_blocks, m_singlePrecisionFactors,
+                                m_x.memptr(), m_x.n_rows,
+                                m_y.memptr() + product.outputStart,
+                                m_y.n_rows, m_y.n_cols);
+            }
+            // Add the parts of the straddling products falling into this
+            // row range
+            const size_t rangeBegin = m_partition.rowOffsets[unit];
+            const size_t rangeEnd = m_partition.rowOffsets[unit + 1];
+            for (size_t i = 0; i < m_partition.straddlingProducts.size(); ++i) {
+                const MblockProduct& product =
+                        m_partition.straddlingProducts[i];
+                const size_t begin = std::max(rangeBegin, product.outputStart);
+                const size_t end = std::min(
+                            rangeEnd, product.outputStart + product.outputSize);
+                for (size_t col = 0; col < m_y.n_cols; ++col) {
+                    ValueType* y = m_y.colptr(col);
+                    const ValueType* scratch =
+                            m_scratchMatrices[i].colptr(col) -
+                            product.outputStart;
+                    for (size_t row = begin; row < end; ++row)
+                        y[row] += scratch[row];
+                }
+            }
+        }
+    }
+
+private:
+    TranspositionMode m_mirroredMode;
+    int m_symmetry;
+    ValueType m_alpha;
+    arma::Mat<ValueType>& m_x;
+    arma::Mat<ValueType>& m_y;
+    const std::vector<arma::Mat<ValueType> >& m_scratchMatrices;
+    const RowPartition& m_partition;
+    AhmedMblock** m_blocks;
+    const AcaSinglePrecisionFactors<ValueType>* m_singlePrecisionFactors;
+};
+
+} // namespace
+
+template <typename ValueType>
+AcaMatvecPlan<ValueType>::AcaMatvecPlan(
+        blcluster* blockCluster,
+        const boost::shared_array<AhmedMblock*>& blocks,
+        int symmetry,
+        size_t workUnitCount,
+        Scheduling scheduling,
+        const shared_ptr<const AcaSinglePrecisionFactors<ValueType> >&
+        singlePrecisionFactors) :
+    m_blocks(blocks), m_singlePrecisionFactors(singlePrecisionFactors),
+    m_symmetry(symmetry), m_leafImbalance(1.)
+{
+    if (!blockCluster)
+        throw std::invalid_argument("AcaMatvecPlan::AcaMatvecPlan(): "
+                                    "blockCluster must not be null");
+    AhmedLeafClusterArray leafClusterArray(blockCluster);
+    std::vector<blcluster*> leafClusters(leafClusterArray.size());
+    for (size_t i = 0; i < leafClusterArray.size(); ++i)
+        leafClusters[i] = leafClusterArray[i];
+    workUnitCount = std::max<size_t>(1, std::min(workUnitCount,
+                                                 leafClusters.size()));
+
+    buildLeafPartition(leafClusters, workUnitCount);
+
+    // Products contributing to the output vector for each transposition mode
+    std::vector<MblockProduct> products[2];
+    size_t outputLengths[2] = { blockCluster->getn1(), blockCluster->getn2() };
+    const bool symmetricStorage = symmetry & (SYMMETRIC | HERMITIAN);
+    for (size_t i = 0; i < leafClusters.size(); ++i) {
+        blcluster* cluster = leafClusters[i];
+        MblockProduct direct = { cluster, DIRECT_PRODUCT,
+                                 cluster->getb1(), cluster->getn1() };
+        MblockProduct mirrored = { cluster, MIRRORED_PRODUCT,
+                                   cluster->getb2(), cluster->getn2() };
+        if (!symmetricStorage) {
+            products[0].push_back(direct);
+            products[1].push_back(mirrored);
+        } else if (isDiagonalLeaf(cluster)) {
+            direct.kind = DIAGONAL_PRODUCT;
+            products[0].push_back(direct);
+        } else {
+            products[0].push_back(direct);
+            products[0].push_back(mirrored);
+        }
+    }
+
+    // Row partitioning is only worthwhile if it does not make the load
+    // distribution much worse than leaf partitioning
+    const double MAX_ROW_PARTITIONING_IMBALANCE = 1.5;
+    size_t scratchMatrixCount = workUnitCount - 1;
+    for (int p = 0; p < 2; ++p) {
+        m_useRowPartitioning[p] = false;
+        if (scheduling == LEAF_PARTITIONING || (symmetricStorage && p == 1))
+            continue;
+        buildRowPartition(products[p], outputLengths[p], workUnitCount,
+                          m_rowPartitions[p]);
+        if (scheduling == ROW_PARTITIONING)
+            m_useRowPartitioning[p] = true;
+        else // scheduling == AUTO_SCHEDULING
+            m_useRowPartitioning[p] =
+                    workUnitCount > 1 &&
+                    m_rowPartitions[p].imbalance <=
+                    std::max(MAX_ROW_PARTITIONING_IMBALANCE, m_leafImbalance);
+        if (m_useRowPartitioning[p])
+            scratchMatrixCount = std::max(
+                        scratchMatrixCount,
+                        m_rowPartitions[p].straddlingProducts.size());
+        else
+            m_rowPartitions[p] = RowPartition();
+    }
+
+    m_scratchMatrices.resize(scratchMatrixCount);
+}
+
+template <typename ValueType>
+void AcaMatvecPlan<ValueType>::buildLeafPartition(
+        const std::vector<blcluster*>& leafClusters,
+        size_t workUnitCount)
+{
+    // Sort leaves by decreasing cost and assign each of them to the work unit
+    // with the smallest total cost so far (longest-processing-time-first
+    // heuristic)
+    const size_t leafClusterCount = leafClusters.size();
+    typedef std::pair<double, size_t> CostAndIndex;
+    std::vector<CostAndIndex> leafCosts(leafClusterCount);
+    const bool symmetricStorage = m_symmetry & (SYMMETRIC | HERMITIAN);
+    double totalCost = 0.;
+    for (size_t i = 0; i < leafClusterCount; ++i) {
+        leafCosts[i].first = estimateMultiplicationCost<ValueType>(
+                    leafClusters[i], m_blocks[leafClusters[i]->getidx()],
+                    m_singlePrecisionFactors.get(), symmetricStorage);
+        leafCosts[i].second = i;
+        totalCost += leafCosts[i].first;
+    }
+    std::sort(leafCosts.begin(), leafCosts.end(),
+              std::greater<CostAndIndex>());
+
+    std::priority_queue<CostAndIndex, std::vector<CostAndIndex>,
+            std::greater<CostAndIndex> > unitLoads;
+    for (size_t unit = 0; unit < workUnitCount; ++unit)
+        unitLoads.push(CostAndIndex(0., unit));
+    std::vector<size_t> leafUnits(leafClusterCount);
+    std::vector<size_t> unitLeafCounts(workUnitCount, 0);
+    double maxLoad = 0.;
+    for (size_t i = 0; i < leafClusterCount; ++i) {
+        CostAndIndex load = unitLoads.top();
+        unitLoads.pop();
+        load.first += leafCosts[i].first;
+        maxLoad = std::max(maxLoad, load.first);
+        leafUnits[i] = load.second;
+        ++unitLeafCounts[load.second];
+        unitLoads.push(load);
+    }
+    if (totalCost > 0.)
+        m_leafImbalance = maxLoad * workUnitCount / totalCost;
+
+    // Store the leaves of each work unit contiguously, in order of
+    // decreasing cost
+    m_workUnitOffsets.resize(workUnitCount + 1);
+    m_workUnitOffsets[0] = 0;
+    for (size_t unit = 0; unit < workUnitCount; ++unit)
+        m_workUnitOffsets[unit + 1] =
+                m_workUnitOffsets[unit] + unitLeafCounts[unit];
+    std::vector<size_t> nextSlot(m_workUnitOffsets.begin(),
+                                 m_workUnitOffsets.end() - 1);
+    m_leafClusters.resize(leafClusterCount);
+    for (size_t i = 0; i < leafClusterCount; ++i)
+        m_leafClusters[nextSlot[leafUnits[i]]++] =
+                leafClusters[leafCosts[i].second];
+}
+
+template <typename ValueType>
+double AcaMatvecPlan<ValueType>::productCost(
+        const MblockProduct& product) const
+{
+    return estimateMultiplicationCost<ValueType>(
+                product.cluster, m_blocks[product.cluster->getidx()],
+                m_singlePrecisionFactors.get(),
+                false /* each product is counted separately */);
+}
+
+template <typename ValueType>
+void AcaMatvecPlan<ValueType>::buildRowPartition(
+        const std::vector<MblockProduct>& products,
+        size_t outputLength, size_t workUnitCount,
+        RowPartition& partition) const
+{
+    // Order products by the start of their output ranges
+    const size_t productCount = products.size();
+    std::vector<std::pair<size_t, size_t> > order(productCount);
+    for (size_t i = 0; i < productCount; ++i)
+        order[i] = std::make_pair(products[i].outputStart, i);
+    std::stable_sort(order.begin(), order.end(), productStartsBefore);
+    std::vector<double> costs(productCount);
+    double totalCost = 0.;
+    for (size_t i = 0; i < productCount; ++i) {
+        costs[i] = productCost(products[i]);
+        totalCost += costs[i];
+    }
+
+    // Spread the cost of each product uniformly over its output range and
+    // find the cumulative cost of the rows preceding each row. Rows lying
+    // strictly inside the output range of a diagonal product cannot start a
+    // new row range, since diagonal products are multiplied by AHMED in one
+    // piece.
+    std::vector<double> densityChanges(outputLength + 1, 0.);
+    std::vector<int> diagonalInteriorChanges(outputLength + 1, 0);
+    for (size_t i = 0; i < productCount; ++i) {
+        const MblockProduct& product = products[i];
+        if (product.outputSize == 0)
+            continue;
+        const double density = costs[i] / product.outputSize;
+        densityChanges[product.outputStart] += density;
+        densityChanges[product.outputStart + product.outputSize] -= density;
+        if (product.kind == DIAGONAL_PRODUCT && product.outputSize > 1) {
+            ++diagonalInteriorChanges[product.outputStart + 1];
+            --diagonalInteriorChanges[product.outputStart +
+                                      product.outputSize];
+        }
+    }
+    std::vector<double> cumulativeCosts(outputLength + 1, 0.);
+    std::vector<char> canStartRange(outputLength + 1, true);
+    double density = 0.;
+    int diagonalInteriorDepth = 0;
+    for (size_t row = 0; row < outputLength; ++row) {
+        density += densityChanges[row];
+        diagonalInteriorDepth += diagonalInteriorChanges[row];
+        cumulativeCosts[row + 1] = cumulativeCosts[row] + density;
+        canStartRange[row] = diagonalInteriorDepth == 0;
+    }
+
+    // Row ranges may only start where some product starts; this keeps the
+    // number of straddling products small
+    std::vector<size_t> candidates;
+    std::vector<double> candidateCosts;
+    for (size_t i = 0; i < productCount; ++i) {
+        const size_t start = order[i].first;
+        if (start > 0 && start < outputLength && canStartRange[start] &&
+                (candidates.empty() || candidates.back() != start)) {
+            candidates.push_back(start);
+            candidateCosts.push_back(cumulativeCosts[start]);
+        }
+    }
+
+    partition.rowOffsets.resize(workUnitCount + 1);
+    partition.rowOffsets[0] = 0;
+    partition.rowOffsets[workUnitCount] = outputLength;
+    for (size_t unit = 1; unit < workUnitCount; ++unit) {
+        size_t cut = partition.rowOffsets[unit - 1];
+        if (!candidates.empty()) {
+            const double target = totalCost * unit / workUnitCount;
+            size_t k = std::lower_bound(candidateCosts.begin(),
+                                        candidateCosts.end(), target) -
+                    candidateCosts.begin();
+            if (k == candidates.size() ||
+                    (k > 0 && target - candidateCosts[k - 1] <
+                     candidateCosts[k] - target))
+                --k;
+            cut = std::max(cut, candidates[k]);
+        }
+        partition.rowOffsets[unit] = cut;
+    }
+
+    // Assign each product either to the work unit owning its whole output
+    // range or to the list of straddling products
+    std::vector<std::vector<size_t> > unitProducts(workUnitCount);
+    std::vector<double> unitCosts(workUnitCount, 0.);
+    double straddlingCost = 0., maxStraddlingCost = 0.;
+    partition.straddlingProducts.clear();
+    for (size_t i = 0; i < productCount; ++i) {
+        const MblockProduct& product = products[order[i].second];
+        const size_t unit =
+                std::upper_bound(partition.rowOffsets.begin(),
+                                 partition.rowOffsets.end() - 1,
+                                 product.outputStart) -
+                partition.rowOffsets.begin() - 1;
+        const double cost = costs[order[i].second];
+        if (product.outputStart + product.outputSize <=
+                partition.rowOffsets[unit + 1]) {
+            unitProducts[unit].push_back(order[i].second);
+            unitCosts[unit] += cost;
+        } else {
+            partition.straddlingProducts.push_back(product);
+            straddlingCost += cost;
+            maxStraddlingCost = std::max(maxStraddlingCost, cost);
+        }
+    }
+
+    partition.productOffsets.resize(workUnitCount + 1);
+    partition.productOffsets[0] = 0;
+    partition.products.clear();
+    partition.products.reserve(productCount -
+                               partition.straddlingProducts.size());
+    for (size_t unit = 0; unit < workUnitCount; ++unit) {
+        for (size_t i = 0; i < unitProducts[unit].size(); ++i)
+            partition.products.push_back(products[unitProducts[unit][i]]);
+        partition.productOffsets[unit + 1] = partition.products.size();
+    }
+
+    // Straddling products are multiplied in a separate parallel phase
+    // preceding the one in which the work units are processed
+    partition.imbalance = 1.;
+    if (totalCost > 0.) {
+        const double straddlingPhaseCost =
+                std::max(maxStraddlingCost, straddlingCost / workUnitCount);
+        const double maxUnitCost =
+                *std::max_element(unitCosts.begin(), unitCosts.end());
+        partition.imbalance = (straddlingPhaseCost + maxUnitCost) *
+                workUnitCount / totalCost;
+    }
+}
+
+template <typename ValueType>
+int AcaMatvecPlan<ValueType>::rowPartitionIndex(TranspositionMode trans)
+{
+    return trans == NO_TRANSPOSE ? 0 : 1;
+}
+
+template <typename ValueType>
+typename AcaMatvecPlan<ValueType>::Scheduling
+AcaMatvecPlan<ValueType>::scheduling(TranspositionMode trans) const
+{
+    return m_useRowPartitioning[rowPartitionIndex(trans)] ?
+                ROW_PARTITIONING : LEAF_PARTITIONING;
+}
+
+template <typename ValueType>
+double AcaMatvecPlan<ValueType>::imbalance(TranspositionMode trans) const
+{
+    const int p = rowPartitionIndex(trans);
+    return m_useRowPartitioning[p] ? m_rowPartitions[p].imbalance
+                                   : m_leafImbalance;
+}
+
+template <typename ValueType>
+void AcaMatvecPlan<ValueType>::apply(
+        TranspositionMode trans, ValueType alpha,
+        arma::Mat<ValueType>& x, arma::Mat<ValueType>& y) const
+{
+    if (trans != NO_TRANSPOSE && trans != TRANSPOSE &&
+            trans != CONJUGATE_TRANSPOSE)
+        throw std::invalid_argument("AcaMatvecPlan::apply(): "
+                                    "unsupported transposition mode");
+    if ((m_symmetry & (SYMMETRIC | HERMITIAN)) && trans != NO_TRANSPOSE)
+        throw std::invalid_argument("AcaMatvecPlan::apply(): "
+                                    "only NO_TRANSPOSE is supported for "
+                                    "symmetric and Hermitian H-matrices");
+    if (x.n_cols != y.n_cols)
+        throw std::invalid_argument("AcaMatvecPlan::apply(): "
+                                    "x and y must have the same number of "
+                                    "columns");
+    if (x.n_cols == 0)
+        return;
+
+    // Reuse the scratch matrices owned by the plan unless another thread is
+    // using them at the moment
+    std::vector<arma::Mat<ValueType> > temporaryScratchMatrices;
+    std::vector<arma::Mat<ValueType> >* scratchMatrices = &m_scratchMatrices;
+    tbb::mutex::scoped_lock lock;
+    if (!lock.try_acquire(m_scratchMutex)) {
+        temporaryScratchMatrices.resize(m_scratchMatrices.size());
+        scratchMatrices = &temporaryScratchMatrices;
+    }
+
+    if (m_useRowPartitioning[rowPartitionIndex(trans)])
+        applyRowPartitioned(trans, alpha, x, y, *scratchMatrices);
+    else
+        applyLeafPartitioned(trans, alpha, x, y, *scratchMatrices);
+}
+
+template <typename ValueType>
+void AcaMatvecPlan<ValueType>::applyLeafPartitioned(
+        TranspositionMode trans, ValueType alpha,
+        arma::Mat<ValueType>& x, arma::Mat<ValueType>& y,
+        std::vector<arma::Mat<ValueType> >& scratchMatrices) const
+{
+    const size_t unitCount = workUnitCount();
+    typedef WorkUnitMultiplicationLoopBody<ValueType> MultiplicationBody;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, unitCount, 1),
+                      MultiplicationBody(trans, m_symmetry, alpha, x, y,
+                                         scratchMatrices,
+                                         m_leafClusters, m_workUnitOffsets,
+                                         m_blocks.get(),
+                                         m_singlePrecisionFactors.get()),
+                      tbb::simple_partitioner());
+
+    if (unitCount > 1) {
+        typedef ScratchMatrixSummationLoopBody<ValueType> SummationBody;
+        const size_t GRAIN_SIZE = 4096;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, y.n_rows, GRAIN_SIZE),
+                          SummationBody(scratchMatrices, unitCount - 1, y));
+    }
+}
+
+template <typename ValueType>
+void AcaMatvecPlan<ValueType>::applyRowPartitioned(
+        TranspositionMode trans, ValueType alpha,
+        arma::Mat<ValueType>& x, arma::Mat<ValueType>& y,
+        std::vector<arma::Mat<ValueType> >& scratchMatrices) const
+{
+    const RowPartition& partition = m_rowPartitions[rowPartitionIndex(trans)];
+    TranspositionMode mirroredMode = trans;
+    if (m_symmetry & SYMMETRIC)
+        mirroredMode = TRANSPOSE;
+    else if (m_symmetry & HERMITIAN)
+        mirroredMode = CONJUGATE_TRANSPOSE;
+
+    const size_t straddlingProductCount = partition.straddlingProducts.size();
+    if (straddlingProductCount > 0) {
+        typedef StraddlingProductLoopBody<ValueType> StraddlingBody;
+        tbb::parallel_for(
+                    tbb::blocked_range<size_t>(0, straddlingProductCount, 1),
+                    StraddlingBody(mirroredMode, m_symmetry, alpha, x,
+                                   scratchMatrices, partition, m_blocks.get(),
+                                   m_singlePrecisionFactors.get()),
+                    tbb::simple_partitioner());
+    }
+
+    const size_t unitCount = partition.rowOffsets.size() - 1;
+    typedef RowRangeMultiplicationLoopBody<ValueType> MultiplicationBody;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, unitCount, 1),
+                      MultiplicationBody(mirroredMode, m_symmetry, alpha, x, y,
+                                         scratchMatrices, partition,
+                                         m_blocks.get(),
+                                         m_singlePrecisionFactors.get()),
+                      tbb::simple_partitioner());
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(AcaMatvecPlan);
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
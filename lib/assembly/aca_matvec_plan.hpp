@@ -0,0 +1,226 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef bempp_aca_matvec_plan_hpp
+#define bempp_aca_matvec_plan_hpp
+
+#include "../common/common.hpp"
+#include "bempp/common/config_ahmed.hpp"
+
+#ifdef WITH_AHMED
+
+#include "ahmed_aux_fwd.hpp"
+#include "transposition_mode.hpp"
+#include "../common/armadillo_fwd.hpp"
+#include "../common/boost_shared_array_fwd.hpp"
+#include "../common/shared_ptr.hpp"
+
+#include <vector>
+#include <tbb/mutex.h>
+
+namespace Bempp
+{
+
+/** \cond FORWARD_DECL */
+template <typename ValueType> class AcaSinglePrecisionFactors;
+/** \endcond */
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Reusable execution plan of the H-matrix-vector product.
+ *
+ *  The plan is built once for a given H-matrix and determines how the work
+ *  needed to multiply it by a vector is divided among threads. Two
+ *  strategies are available (see the Scheduling enumeration):
+ *
+ *  - in the LEAF_PARTITIONING mode, leaf block clusters are split into work
+ *    units of approximately equal cost (estimated from the number of values
+ *    stored in each mblock), regardless of their position in the matrix. Each
+ *    work unit accumulates its contribution in a separate full-length scratch
+ *    array, and these arrays are summed at the end.
+ *
+ *  - in the ROW_PARTITIONING mode, the output vector is split into
+ *    contiguous ranges of approximately equal cost, one per work unit, and
+ *    each work unit processes only the mblocks contributing to its range, so
+ *    that no thread writes outside its range and no global reduction is
+ *    needed. The few mblocks straddling the boundaries of these ranges are
+ *    multiplied beforehand into scratch arrays of their own size.
+ *
+ *  For symmetric and Hermitian H-matrices, only the blocks on and above the
+ *  diagonal are stored; each off-diagonal leaf then contributes both
+ *  <tt>A x</tt> and <tt>A^T x</tt> (or <tt>A^H x</tt>) to the result.
+ *
+ *  Low-rank mblocks whose factors are stored in an AcaSinglePrecisionFactors
+ *  object are multiplied using these single-precision factors, with all
+ *  sums accumulated in the precision of \p ValueType.
+ *
+ *  The structure of the plan is immutable; only the contents of the scratch
+ *  arrays change during apply(). If apply() is called concurrently from
+ *  several threads, the scratch arrays are used by one of them and the
+ *  remaining ones allocate temporary arrays. */
+template <typename ValueType>
+class AcaMatvecPlan
+{
+public:
+    typedef mblock<typename AhmedTypeTraits<ValueType>::Type> AhmedMblock;
+
+    /** \brief Strategy used to divide the work among threads. */
+    enum Scheduling {
+        /** \brief Use ROW_PARTITIONING if it balances the work well enough
+         *  and LEAF_PARTITIONING otherwise. */
+        AUTO_SCHEDULING,
+        /** \brief Distribute leaves among threads regardless of their
+         *  position; accumulate results in full-length scratch vectors. */
+        LEAF_PARTITIONING,
+        /** \brief Give each thread ownership of a contiguous range of the
+         *  output vector. */
+        ROW_PARTITIONING
+    };
+
+    /** \brief Constructor.
+     *
+     *  \param[in] blockCluster
+     *    Root of the block cluster tree of the H-matrix. (Should be const,
+     *    but AHMED is not const-correct.)
+     *  \param[in] blocks
+     *    Array of mblocks of the H-matrix.
+     *  \param[in] symmetry
+     *    H-matrix symmetry. Can be any combination of the flags defined in the
+     *    Symmetry enumeration type.
+     *  \param[in] workUnitCount
+     *    Requested number of work units; typically equal to the number of
+     *    threads that will execute the product.
+     *  \param[in] scheduling
+     *    Strategy used to divide the work among threads.
+     *  \param[in] singlePrecisionFactors
+     *    Single-precision factors used in place of the data of the
+     *    corresponding mblocks (may be null). */
+    AcaMatvecPlan(blcluster* blockCluster,
+                  const boost::shared_array<AhmedMblock*>& blocks,
+                  int symmetry,
+                  size_t workUnitCount,
+                  Scheduling scheduling = AUTO_SCHEDULING,
+                  const shared_ptr<const AcaSinglePrecisionFactors<ValueType> >&
+                  singlePrecisionFactors =
+                  shared_ptr<const AcaSinglePrecisionFactors<ValueType> >());
+
+    /** \brief Number of leaf block clusters covered by the plan. */
+    size_t leafClusterCount() const {
+        return m_leafClusters.size();
+    }
+
+    /** \brief Number of work units. */
+    size_t workUnitCount() const {
+        return m_workUnitOffsets.size() - 1;
+    }
+
+    /** \brief Strategy used in products with the transposition mode
+     *  \p trans. Never equal to AUTO_SCHEDULING. */
+    Scheduling scheduling(TranspositionMode trans = NO_TRANSPOSE) const;
+
+    /** \brief Estimated cost of the most expensive work unit divided by the
+     *  average cost of a work unit, for products with the transposition mode
+     *  \p trans. */
+    double imbalance(TranspositionMode trans = NO_TRANSPOSE) const;
+
+    /** \brief Perform the operation <tt>y += alpha * op(A) * x</tt>.
+     *
+     *  \p x and \p y must be expressed in the permuted (H-matrix) ordering.
+     *  They may have several columns (the same number for both); in that
+     *  case the data of each mblock are read only once for all columns.
+     *  For general H-matrices, \p trans must be NO_TRANSPOSE, TRANSPOSE or
+     *  CONJUGATE_TRANSPOSE. For symmetric and Hermitian H-matrices, only
+     *  NO_TRANSPOSE is supported; the remaining modes can be reduced to it by
+     *  complex conjugation of \p alpha, \p x and \p y. */
+    void apply(TranspositionMode trans, ValueType alpha,
+               arma::Mat<ValueType>& x, arma::Mat<ValueType>& y) const;
+
+    /** \cond PRIVATE */
+    enum ProductKind {
+        DIRECT_PRODUCT,   // y[b1...] += A x[b2...]
+        MIRRORED_PRODUCT, // y[b2...] += A^T x[b1...] or A^H x[b1...]
+        DIAGONAL_PRODUCT  // diagonal leaf of a symmetric H-matrix
+    };
+
+    struct MblockProduct {
+        blcluster* cluster;
+        ProductKind kind;
+        size_t outputStart;
+        size_t outputSize;
+    };
+
+    struct RowPartition {
+        // row range owned by work unit i:
+        // rowOffsets[i]...rowOffsets[i + 1] - 1
+        std::vector<size_t> rowOffsets;
+        // products contributing only to the range of work unit i:
+        // products[productOffsets[i]...productOffsets[i + 1] - 1]
+        std::vector<MblockProduct> products;
+        std::vector<size_t> productOffsets;
+        // products contributing to the ranges of several work units
+        std::vector<MblockProduct> straddlingProducts;
+        double imbalance;
+    };
+    /** \endcond */
+
+private:
+    /** \cond PRIVATE */
+    void buildLeafPartition(const std::vector<blcluster*>& leafClusters,
+                            size_t workUnitCount);
+    void buildRowPartition(const std::vector<MblockProduct>& products,
+                           size_t outputLength, size_t workUnitCount,
+                           RowPartition& partition) const;
+    double productCost(const MblockProduct& product) const;
+    // index of the row partition used with the transposition mode trans
+    static int rowPartitionIndex(TranspositionMode trans);
+    void applyLeafPartitioned(TranspositionMode trans, ValueType alpha,
+                              arma::Mat<ValueType>& x, arma::Mat<ValueType>& y,
+                              std::vector<arma::Mat<ValueType> >& scratch) const;
+    void applyRowPartitioned(TranspositionMode trans, ValueType alpha,
+                             arma::Mat<ValueType>& x, arma::Mat<ValueType>& y,
+                             std::vector<arma::Mat<ValueType> >& scratch) const;
+
+private:
+    boost::shared_array<AhmedMblock*> m_blocks;
+    shared_ptr<const AcaSinglePrecisionFactors<ValueType> >
+    m_singlePrecisionFactors;
+    int m_symmetry;
+
+    // Data used in the LEAF_PARTITIONING mode.
+    // Leaf clusters belonging to work unit i are stored in
+    // m_leafClusters[m_workUnitOffsets[i]...m_workUnitOffsets[i + 1] - 1]
+    std::vector<blcluster*> m_leafClusters;
+    std::vector<size_t> m_workUnitOffsets;
+    double m_leafImbalance;
+
+    // Data used in the ROW_PARTITIONING mode: partition 0 is used for
+    // NO_TRANSPOSE and partition 1 for TRANSPOSE and CONJUGATE_TRANSPOSE
+    RowPartition m_rowPartitions[2];
+    bool m_useRowPartitioning[2];
+
+    mutable std::vector<arma::Mat<ValueType> > m_scratchMatrices;
+    mutable tbb::mutex m_scratchMutex;
+    /** \endcond */
+};
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
+
+#endif
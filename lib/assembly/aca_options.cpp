@@ -29,14 +29,21 @@ AcaOptions::AcaOptions() :
     eta(1.2),
     minimumBlockSize(16),
     maximumBlockSize(std::numeric_limits<int>::max()),
+    clusterSplitting(BOUNDING_BOX_SPLITTING),
     maximumRank(std::numeric_limits<int>::max()),
     mode(GLOBAL_ASSEMBLY),
     reactionToUnsupportedMode(WARNING),
     recompress(false),
+    recompressLowRankBlocks(false),
+    singlePrecisionLowRankBlocks(false),
+    maximumDofListsCacheMemory(0),
+    memoryBudget(0),
     outputPostscript(false),
     outputFname("aca.ps"),
     scaling(1.0),
     useAhmedAca(false),
+    useAcaPlus(false),
+    pivotBatchSize(1),
     firstClusterIndex(-1),
     globalAssemblyBeforeCompression(true)
 {
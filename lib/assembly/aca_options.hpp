@@ -63,6 +63,34 @@ struct AcaOptions
      *  Default value: UINT_MAX. */
     unsigned int maximumBlockSize;
 
+    /** \brief Strategies of cluster splitting. See documentation of the
+     *  member \p clusterSplitting for more information. */
+    enum ClusterSplitting {
+        MIN_CLUSTER_SPLITTING,
+        BOUNDING_BOX_SPLITTING = MIN_CLUSTER_SPLITTING,
+        PRINCIPAL_COMPONENT_SPLITTING,
+        MAX_CLUSTER_SPLITTING = PRINCIPAL_COMPONENT_SPLITTING
+    };
+
+    /** \brief Strategy used to split clusters of DOFs into subclusters.
+     *
+     *  If set to \p BOUNDING_BOX_SPLITTING (default), each cluster is
+     *  bisected by a plane perpendicular to the longest side of the bounding
+     *  box of the reference points of its DOFs, passing through the centre
+     *  of that box.
+     *
+     *  If set to \p PRINCIPAL_COMPONENT_SPLITTING, each cluster is bisected
+     *  by a plane perpendicular to the principal axis of the reference
+     *  points of its DOFs (the eigenvector of their covariance matrix
+     *  corresponding to the largest eigenvalue), passing through their
+     *  centroid. On thin or elongated geometries whose features are not
+     *  aligned with the coordinate axes this usually produces more compact
+     *  clusters, and hence more admissible blocks and lower ranks.
+     *
+     *  In both cases independent subtrees of the cluster tree are
+     *  constructed in parallel. */
+    ClusterSplitting clusterSplitting;
+
     /** \brief Maximum rank of blocks stored in the low-rank format.
      *
      *  Blocks judged to have higher rank will be stored in the dense format.
@@ -202,14 +230,74 @@ struct AcaOptions
     /** \brief Recompress ACA matrix after construction?
      *
      *  If true, blocks of H matrices are agglomerated in an attempt to reduce
-     *  memory consumption.
-     *
-     *  Warning: this procedure is not parallelised yet, therefore it may be
-     *  slow.
+     *  memory consumption. Independent subtrees of the block cluster tree are
+     *  processed in parallel, and coarser levels are handled once all their
+     *  sons have been processed.
      *
      *  Default value: false. */
     bool recompress;
 
+    /** \brief Recompress each low-rank block right after its approximation?
+     *
+     *  If true, the factors of each block approximated with ACA are
+     *  recompressed with a truncated SVD (QR decompositions of the factors
+     *  followed by an SVD of a small core matrix) to the accuracy \p eps.
+     *  This is done by the thread that approximated the block and usually
+     *  reduces the ranks produced by ACA noticeably, lowering both memory
+     *  consumption and the cost of matrix-vector products.
+     *
+     *  Default value: false. */
+    bool recompressLowRankBlocks;
+
+    /** \brief Store the factors of suitable low-rank blocks in single
+     *  precision?
+     *
+     *  If true, after the H-matrix has been assembled, the factors of each
+     *  low-rank block whose rounding to single precision introduces an error
+     *  small compared with \p eps are converted to single precision, halving
+     *  the memory they occupy and the memory traffic of matrix-vector
+     *  products. Sums are still accumulated in double precision. Has no
+     *  effect on operators assembled in single precision.
+     *
+     *  \see DiscreteAcaBoundaryOperator::storeLowRankBlocksInSinglePrecision().
+     *
+     *  Default value: false. */
+    bool singlePrecisionLowRankBlocks;
+
+    /** \brief Memory budget (in bytes) of each cache of local DOF lists.
+     *
+     *  During ACA, the lists of elements and local DOFs corresponding to the
+     *  rows and columns of each requested block are cached, since the same
+     *  blocks are usually requested many times. If this parameter is
+     *  nonzero, the least recently used lists are evicted once their
+     *  estimated size exceeds this value. This limits the memory taken by the
+     *  caches at the price of occasionally rebuilding an evicted list.
+     *  Cache statistics, including hit rates, are printed at the end of the
+     *  assembly if the verbosity level is at least DEFAULT.
+     *
+     *  Default value: 0 (no limit).
+     */
+    size_t maximumDofListsCacheMemory;
+
+    /** \brief Memory budget (in bytes) of the assembled H-matrix.
+     *
+     *  If this parameter is nonzero, the memory taken by the blocks of the
+     *  H-matrix is tracked during the assembly. Once 75% of the budget is
+     *  used, all subsequently assembled low-rank blocks are recompressed (as
+     *  if \p recompressLowRankBlocks were set); once 90% is used, they are
+     *  recompressed with the tolerance 10 * \p eps, which truncates their
+     *  ranks at the expense of accuracy (a warning is then printed). If the
+     *  budget is exceeded nonetheless, the assembly is aborted and a
+     *  std::runtime_error describing the memory usage is thrown, rather
+     *  than letting the process run out of memory.
+     *
+     *  The budget covers only the values stored in the blocks, not the
+     *  cluster trees or other auxiliary data.
+     *
+     *  Default value: 0 (no limit).
+     */
+    size_t memoryBudget;
+
     /** \brief If true, hierarchical matrix structure will be written in
      *  PostScript format at the end of the assembly procedure.
      *
@@ -245,6 +333,42 @@ struct AcaOptions
      */
     bool useAhmedAca;
 
+    /** \brief Use ACA+ with a stochastic error estimator.
+     *
+     *  If true and \p useAhmedAca is false, unsymmetric admissible blocks
+     *  are approximated with the ACA+ algorithm, which searches for pivots in
+     *  a reference row and a reference column of the remainder rather than
+     *  in the last computed cross. When the usual stopping criterion is met,
+     *  the norm of the remainder is additionally estimated from a few
+     *  pseudorandomly chosen columns, and the iteration continues if the
+     *  estimate exceeds \p eps. This is more expensive per block than the
+     *  standard ACA, but more reliable: fewer admissible blocks end up
+     *  stored as dense matrices, e.g. for Helmholtz operators at higher
+     *  frequencies. The number of such blocks is printed at the end of the
+     *  assembly if the verbosity level is at least DEFAULT.
+     *
+     *  Takes precedence over \p pivotBatchSize.
+     *
+     *  Default value: false.
+     */
+    bool useAcaPlus;
+
+    /** \brief Number of pivot rows evaluated together by ACA.
+     *
+     *  If this parameter is greater than 1 and \p useAhmedAca is false,
+     *  unsymmetric admissible blocks are approximated with a block variant of
+     *  ACA, which selects up to \p pivotBatchSize pivots per iteration and
+     *  requests the corresponding rows and columns of the block in a single
+     *  call, sharing geometrical data and basis function values between them.
+     *  This reduces the overhead of evaluating rows and columns one by one at
+     *  the price of occasionally computing a few more crosses than
+     *  necessary. Symmetric blocks are always approximated with the standard
+     *  ACA.
+     *
+     *  Default value: 1 (standard, one pivot at a time).
+     */
+    unsigned int pivotBatchSize;
+
     /** \brief Index of the first block cluster to be approximated using ACA.
      *
      *  This parameter is included to facilitate debugging of ACA algorithms. If
@@ -0,0 +1,170 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_ahmed.hpp"
+
+#ifdef WITH_AHMED
+
+#include "aca_single_precision_factors.hpp"
+
+#include "ahmed_aux.hpp"
+#include "symmetry.hpp"
+
+#include "../common/armadillo_fwd.hpp"
+#include "../common/complex_aux.hpp"
+#include "../fiber/explicit_instantiation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Bempp
+{
+
+namespace
+{
+
+template <typename ValueType>
+double squaredFrobeniusNorm(const ValueType* data, size_t size)
+{
+    double result = 0.;
+    for (size_t i = 0; i < size; ++i) {
+        const ValueType value = data[i];
+        result += realPart(conj(value) * value);
+    }
+    return result;
+}
+
+} // namespace
+
+template <typename ValueType>
+const size_t AcaSinglePrecisionFactors<ValueType>::NOT_STORED;
+
+template <typename ValueType>
+AcaSinglePrecisionFactors<ValueType>::AcaSinglePrecisionFactors(
+        blcluster* blockCluster,
+        const boost::shared_array<AhmedMblock*>& blocks,
+        int symmetry, double eps) :
+    m_blockCount(0)
+{
+    AhmedLeafClusterArray leafClusters(blockCluster);
+    const size_t leafCount = leafClusters.size();
+    m_offsets.resize(leafCount, NOT_STORED);
+    m_ranks.resize(leafCount, 0);
+    const bool symmetricStorage = symmetry & (SYMMETRIC | HERMITIAN);
+
+    // Frobenius norms of the mblocks and of the whole H-matrix. Off-diagonal
+    // leaves of symmetric H-matrices represent two blocks.
+    std::vector<double> blockNorms(leafCount, 0.);
+    double squaredTotalNorm = 0.;
+    for (size_t i = 0; i < leafCount; ++i) {
+        blcluster* cluster = leafClusters[i];
+        const size_t index = cluster->getidx();
+        AhmedMblock* block = blocks[index];
+        const ValueType* data = reinterpret_cast<const ValueType*>(
+                    block->getdata());
+        double squaredNorm = 0.;
+        if (block->isLrM()) {
+            const size_t n1 = block->getn1(), n2 = block->getn2();
+            const size_t rank = block->rank();
+            if (rank > 0) {
+                // ||U V^H||_F^2 = trace((U^H U) (V^H V))
+                const arma::Mat<ValueType> U(const_cast<ValueType*>(data),
+                                             n1, rank, false);
+                const arma::Mat<ValueType> V(const_cast<ValueType*>(data) +
+                                             n1 * rank, n2, rank, false);
+                const arma::Mat<ValueType> UU = U.t() * U;
+                const arma::Mat<ValueType> VV = V.t() * V;
+                squaredNorm = std::max(
+                            0., double(realPart(arma::trace(UU * VV))));
+            }
+        } else
+            squaredNorm = squaredFrobeniusNorm(data, block->nvals());
+        blockNorms[index] = std::sqrt(squaredNorm);
+        const bool mirrored = symmetricStorage &&
+                cluster->getb1() != cluster->getb2();
+        squaredTotalNorm += mirrored ? 2. * squaredNorm : squaredNorm;
+    }
+    if (leafCount == 0)
+        return;
+    const double typicalBlockNorm =
+            std::sqrt(squaredTotalNorm / double(leafCount));
+
+    // Unit roundoff of single-precision numbers
+    const double u = 0.5 * std::numeric_limits<float>::epsilon();
+    const double SAFETY_FACTOR = 0.1;
+    std::vector<size_t> selected;
+    size_t valueCount = 0;
+    for (size_t i = 0; i < leafCount; ++i) {
+        blcluster* cluster = leafClusters[i];
+        const size_t index = cluster->getidx();
+        AhmedMblock* block = blocks[index];
+        if (!block->isLrM() || block->rank() == 0)
+            continue;
+        if (symmetricStorage && cluster->getb1() == cluster->getb2())
+            continue; // diagonal leaves are multiplied by AHMED
+        const size_t n1 = block->getn1(), n2 = block->getn2();
+        const size_t rank = block->rank();
+        const ValueType* data = reinterpret_cast<const ValueType*>(
+                    block->getdata());
+        const double normU = std::sqrt(squaredFrobeniusNorm(data, n1 * rank));
+        const double normV = std::sqrt(squaredFrobeniusNorm(data + n1 * rank,
+                                                            n2 * rank));
+        const double roundingError = 2. * u * normU * normV;
+        if (roundingError <= SAFETY_FACTOR * eps *
+                std::max(blockNorms[index], typicalBlockNorm)) {
+            selected.push_back(index);
+            m_offsets[index] = valueCount;
+            m_ranks[index] = rank;
+            valueCount += (n1 + n2) * rank;
+        }
+    }
+
+    m_blockCount = selected.size();
+    m_values.resize(valueCount);
+    for (size_t i = 0; i < selected.size(); ++i) {
+        const size_t index = selected[i];
+        AhmedMblock* block = blocks[index];
+        const ValueType* data = reinterpret_cast<const ValueType*>(
+                    block->getdata());
+        const size_t size = block->nvals();
+        SingleValueType* dest = &m_values[m_offsets[index]];
+        for (size_t j = 0; j < size; ++j)
+            dest[j] = static_cast<SingleValueType>(data[j]);
+    }
+}
+
+template <typename ValueType>
+void AcaSinglePrecisionFactors<ValueType>::restore(
+        size_t index, AhmedMblock* block) const
+{
+    block->setrank(m_ranks[index]);
+    ValueType* dest = reinterpret_cast<ValueType*>(block->getdata());
+    const SingleValueType* source = factors(index);
+    const size_t size = block->nvals();
+    for (size_t j = 0; j < size; ++j)
+        dest[j] = static_cast<ValueType>(source[j]);
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(AcaSinglePrecisionFactors);
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
@@ -0,0 +1,154 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef bempp_aca_single_precision_factors_hpp
+#define bempp_aca_single_precision_factors_hpp
+
+#include "../common/common.hpp"
+#include "bempp/common/config_ahmed.hpp"
+
+#ifdef WITH_AHMED
+
+#include "ahmed_aux_fwd.hpp"
+#include "../common/boost_shared_array_fwd.hpp"
+
+#include <complex>
+#include <vector>
+
+namespace Bempp
+{
+
+/** \cond PRIVATE */
+template <typename ValueType>
+struct SinglePrecisionTraits
+{
+    typedef ValueType Type;
+};
+
+template <>
+struct SinglePrecisionTraits<double>
+{
+    typedef float Type;
+};
+
+template <>
+struct SinglePrecisionTraits<std::complex<double> >
+{
+    typedef std::complex<float> Type;
+};
+/** \endcond */
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Single-precision copies of the factors of low-rank mblocks.
+ *
+ *  An object of this class stores the factors \f$U\f$ and \f$V\f$ of
+ *  selected low-rank mblocks \f$A = U V^H\f$ of an H-matrix in single
+ *  precision (\c float or <tt>std::complex<float></tt>), in the same layout
+ *  as AHMED (\f$U\f$ followed by \f$V\f$, both stored column by column).
+ *
+ *  An mblock is selected if the error caused by rounding its factors to
+ *  single precision, estimated as
+ *  \f$2 u \|U\|_F \|V\|_F\f$ with \f$u\f$ denoting the unit roundoff of
+ *  single-precision numbers, does not exceed
+ *  \f$0.1 \epsilon \max(\|A\|_F, \|H\|_F / \sqrt{n})\f$, where
+ *  \f$\epsilon\f$ is the ACA accuracy, \f$\|H\|_F\f$ the Frobenius norm of
+ *  the whole H-matrix and \f$n\f$ the number of its leaves. Thus, the
+ *  rounding error is small compared both with the ACA error of the mblock
+ *  itself and with the contribution of a typical mblock to the ACA error of
+ *  the whole H-matrix. Diagonal leaves of H-matrices stored in the symmetric
+ *  format are never selected.
+ *
+ *  This class does not modify the mblocks themselves; it is up to the owner
+ *  of the H-matrix to release the storage of the selected mblocks. */
+template <typename ValueType>
+class AcaSinglePrecisionFactors
+{
+public:
+    typedef mblock<typename AhmedTypeTraits<ValueType>::Type> AhmedMblock;
+    typedef typename SinglePrecisionTraits<ValueType>::Type SingleValueType;
+
+    /** \brief Constructor.
+     *
+     *  Select the low-rank mblocks that can be stored in single precision
+     *  and copy their factors.
+     *
+     *  \param[in] blockCluster
+     *    Root of the block cluster tree of the H-matrix. (Should be const,
+     *    but AHMED is not const-correct.)
+     *  \param[in] blocks
+     *    Array of mblocks of the H-matrix.
+     *  \param[in] symmetry
+     *    H-matrix symmetry. Can be any combination of the flags defined in the
+     *    Symmetry enumeration type.
+     *  \param[in] eps
+     *    Accuracy of the H-matrix approximation. */
+    AcaSinglePrecisionFactors(blcluster* blockCluster,
+                              const boost::shared_array<AhmedMblock*>& blocks,
+                              int symmetry, double eps);
+
+    /** \brief Number of mblocks whose factors are stored in this object. */
+    size_t blockCount() const {
+        return m_blockCount;
+    }
+
+    /** \brief Return true if the factors of the mblock with index \p index
+     *  are stored in this object. */
+    bool contains(size_t index) const {
+        return index < m_offsets.size() && m_offsets[index] != NOT_STORED;
+    }
+
+    /** \brief Rank of the mblock with index \p index. */
+    unsigned int rank(size_t index) const {
+        return m_ranks[index];
+    }
+
+    /** \brief Pointer to the factors of the mblock with index \p index. */
+    const SingleValueType* factors(size_t index) const {
+        return &m_values[m_offsets[index]];
+    }
+
+    /** \brief Store the factors of the mblock with index \p index, converted
+     *  back to the precision of \p ValueType, in \p block.
+     *
+     *  \p block must have the same dimensions as the original mblock. */
+    void restore(size_t index, AhmedMblock* block) const;
+
+    /** \brief Memory (in bytes) saved by storing the factors in single
+     *  precision, provided that the original mblocks release their storage. */
+    size_t savedBytes() const {
+        return m_values.size() * (sizeof(ValueType) - sizeof(SingleValueType));
+    }
+
+private:
+    /** \cond PRIVATE */
+    static const size_t NOT_STORED = static_cast<size_t>(-1);
+
+    size_t m_blockCount;
+    std::vector<size_t> m_offsets;
+    std::vector<unsigned int> m_ranks;
+    std::vector<SingleValueType> m_values;
+    /** \endcond */
+};
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
+
+#endif
@@ -109,6 +109,50 @@ struct AhmedDofWrapper : public BoundingBox<CoordinateType>
     }
 };
 
+// Wrappers of AHMED's routines multiplying symmetric H-matrices by vectors.
+// For real types symmetric and Hermitian matrices are the same thing.
+
+inline void mltaSyHVec(double d, blcluster* bl, mblock<double>** A, double* x,
+                       double* y)
+{
+    mltaHeHVec(d, bl, A, x, y);
+}
+
+inline void mltaSyHVec(float d, blcluster* bl, mblock<float>** A, float* x,
+                       float* y)
+{
+    mltaHeHVec(d, bl, A, x, y);
+}
+
+inline void mltaSyHVec(scomp d, blcluster* bl, mblock<scomp>** A, scomp* x,
+                       scomp* y)
+{
+    throw std::runtime_error("mltaSyHVec(): the overload of this function for "
+                             "complex single-precision numbers does not exist "
+                             "in AHMED");
+}
+
+// For real types, SyHh = SyH
+inline void mltaSyHhVec(double d, blcluster* bl, mblock<double>** A, double* x,
+                        double* y)
+{
+    mltaSyHVec(d, bl, A, x, y);
+}
+
+inline void mltaSyHhVec(float d, blcluster* bl, mblock<float>** A, float* x,
+                        float* y)
+{
+    mltaSyHVec(d, bl, A, x, y);
+}
+
+inline void mltaSyHhVec(scomp d, blcluster* bl, mblock<scomp>** A, scomp* x,
+                        scomp* y)
+{
+    throw std::runtime_error("mltaSyHhVec(): the overload of this function for "
+                             "complex single-precision numbers does not exist "
+                             "in AHMED");
+}
+
 template <typename ValueType>
 boost::shared_array<mblock<typename AhmedTypeTraits<ValueType>::Type>*>
 allocateAhmedMblockArray(size_t blockCount)
@@ -25,6 +25,7 @@
 #include <algorithm>
 #include <cmath>
 #include <stdexcept>
+#include <utility>
 
 #define BASMOD // prevent inclusion of Ahmed's basmod.h, which contains
                // a conflicting definition of swap()
@@ -49,6 +50,12 @@ bool isFirstClusterBigger(const blcluster* cluster1, const blcluster* cluster2)
             cluster2->getn1() * cluster2->getn2();
 }
 
+bool isFirstCostHigher(const std::pair<double, blcluster*>& a,
+                       const std::pair<double, blcluster*>& b)
+{
+    return a.first > b.first;
+}
+
 } // namespace
 
 AhmedLeafClusterArray::AhmedLeafClusterArray(blcluster* clusterTree) :
@@ -73,6 +80,23 @@ void AhmedLeafClusterArray::sortAccordingToClusterSize()
               isFirstClusterBigger);
 }
 
+void AhmedLeafClusterArray::sortAccordingToCost(std::vector<double>& costs)
+{
+    if (costs.size() != m_size)
+        throw std::invalid_argument("AhmedLeafClusterArray::"
+                                    "sortAccordingToCost(): "
+                                    "incorrect length of the costs vector");
+    std::vector<std::pair<double, blcluster*> > costsAndClusters(m_size);
+    for (size_t i = 0; i < m_size; ++i)
+        costsAndClusters[i] = std::make_pair(costs[i], m_leafClusters[i]);
+    std::stable_sort(costsAndClusters.begin(), costsAndClusters.end(),
+                     isFirstCostHigher);
+    for (size_t i = 0; i < m_size; ++i) {
+        costs[i] = costsAndClusters[i].first;
+        m_leafClusters[i] = costsAndClusters[i].second;
+    }
+}
+
 void AhmedLeafClusterArray::startWithClusterOfIndex(size_t index)
 {
     if (index >= m_size)
@@ -85,6 +109,24 @@ void AhmedLeafClusterArray::startWithClusterOfIndex(size_t index)
         }
 }
 
+void AhmedLeafClusterArray::startWithClusterOfIndex(size_t index,
+                                                    std::vector<double>& costs)
+{
+    if (costs.size() != m_size)
+        throw std::invalid_argument("AhmedLeafClusterArray::"
+                                    "startWithClusterOfIndex(): "
+                                    "incorrect length of the costs vector");
+    if (index >= m_size)
+        throw std::invalid_argument("AhmedLeafClusterArray::"
+                                    "startWithClusterOfIndex(): invalid index");
+    for (size_t i = 0; i < m_size; ++i)
+        if (m_leafClusters[i]->getidx() == index) {
+            std::swap(m_leafClusters[0], m_leafClusters[i]);
+            std::swap(costs[0], costs[i]);
+            break;
+        }
+}
+
 } // namespace Bempp
 
 #endif
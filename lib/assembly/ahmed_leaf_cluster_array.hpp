@@ -29,6 +29,8 @@
 
 #include "../common/boost_scoped_array_fwd.hpp"
 
+#include <vector>
+
 /** \cond FORWARD_DECL */
 class blcluster;
 /** \endcond */
@@ -62,8 +64,21 @@ public:
     /** \brief Sort cluster list, putting biggest clusters first. */
     void sortAccordingToClusterSize();
 
+    /** \brief Sort cluster list, putting most expensive clusters first.
+     *
+     *  On input, <tt>costs[i]</tt> should be the cost of the <em>i</em>th
+     *  cluster. On output, \p costs is permuted in the same way as the
+     *  cluster list. Clusters of equal cost keep their relative order. */
+    void sortAccordingToCost(std::vector<double>& costs);
+
     void startWithClusterOfIndex(size_t index);
 
+    /** \brief Move the cluster of index \p index to the front of the list.
+     *
+     *  \p costs is permuted in the same way as the cluster list, as in
+     *  sortAccordingToCost(). */
+    void startWithClusterOfIndex(size_t index, std::vector<double>& costs);
+
 private:
     boost::scoped_array<blcluster*> m_leafClusters;
     size_t m_size;
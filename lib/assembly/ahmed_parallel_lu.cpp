@@ -0,0 +1,957 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_ahmed.hpp"
+
+#ifdef WITH_AHMED
+
+#include "ahmed_parallel_lu.hpp"
+
+#include "ahmed_aux.hpp"
+
+#include "../fiber/explicit_instantiation.hpp"
+#include "../fiber/serial_blas_region.hpp"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <tbb/atomic.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace Bempp
+{
+
+namespace
+{
+
+// Subtrees with fewer leaves are processed serially by AHMED
+const unsigned int MIN_TASK_LEAF_COUNT = 16;
+
+// Return true if the sons of a diagonal block cluster form a square grid
+// with square diagonal sons, so that the block can be eliminated son by son
+bool hasSquareGridOfSons(const blcluster* cluster)
+{
+    if (cluster->isleaf() || cluster->getnrs() != cluster->getncs())
+        return false;
+    const unsigned int n = cluster->getnrs();
+    for (unsigned int r = 0; r < n; ++r)
+        for (unsigned int c = 0; c < n; ++c)
+            if (!cluster->getson(r, c))
+                return false;
+    for (unsigned int k = 0; k < n; ++k) {
+        const blcluster* son = cluster->getson(k, k);
+        if (son->getb1() != son->getb2() || son->getn1() != son->getn2())
+            return false;
+    }
+    return true;
+}
+
+// Return true if the sons of the block clusters a, b and c can be combined
+// in the product c = a * b son by son, i.e. if the row clusters of the sons
+// of a and c and the column clusters of the sons of b and c coincide, and
+// so do the column clusters of the sons of a and the row clusters of the
+// sons of b
+bool haveMatchingSons(const blcluster* a, const blcluster* b,
+                      const blcluster* c)
+{
+    if (a->isleaf() || b->isleaf() || c->isleaf())
+        return false;
+    const unsigned int rowCount = c->getnrs(), columnCount = c->getncs();
+    const unsigned int innerCount = a->getncs();
+    if (a->getnrs() != rowCount || b->getncs() != columnCount ||
+            b->getnrs() != innerCount)
+        return false;
+    for (unsigned int i = 0; i < rowCount; ++i)
+        for (unsigned int j = 0; j < columnCount; ++j) {
+            const blcluster* cSon = c->getson(i, j);
+            if (!cSon)
+                return false;
+            for (unsigned int k = 0; k < innerCount; ++k) {
+                const blcluster* aSon = a->getson(i, k);
+                const blcluster* bSon = b->getson(k, j);
+                if (!aSon || !bSon ||
+                        aSon->getb1() != cSon->getb1() ||
+                        aSon->getn1() != cSon->getn1() ||
+                        bSon->getb2() != cSon->getb2() ||
+                        bSon->getn2() != cSon->getn2() ||
+                        aSon->getb2() != bSon->getb1() ||
+                        aSon->getn2() != bSon->getn1())
+                    return false;
+            }
+        }
+    return true;
+}
+
+template <typename ValueType>
+class HLuDecomposition
+{
+public:
+    typedef typename AhmedTypeTraits<ValueType>::Type AhmedValueType;
+    typedef mblock<AhmedValueType> AhmedMblock;
+
+    HLuDecomposition(AhmedMblock** A, AhmedMblock** L, AhmedMblock** U,
+                     double eps, int maximumRank) :
+        m_A(A), m_L(L), m_U(U), m_eps(eps), m_maximumRank(maximumRank) {
+        m_failed = false;
+    }
+
+    bool failed() const {
+        return m_failed;
+    }
+
+    // Compute L_a and U_a such that L_a U_a = A_a
+    void decompose(blcluster* a);
+    // Solve L_l X = A_b for X, storing X in U_b
+    void solveLower(blcluster* l, blcluster* b);
+    // Solve X U_u = A_b for X, storing X in L_b
+    void solveUpper(blcluster* u, blcluster* b);
+    // Perform A_c -= L_l U_u
+    void multiplyAndSubtract(blcluster* l, blcluster* u, blcluster* c);
+
+private:
+    AhmedMblock** m_A;
+    AhmedMblock** m_L;
+    AhmedMblock** m_U;
+    double m_eps;
+    int m_maximumRank;
+    tbb::atomic<bool> m_failed;
+};
+
+// Triangular solves producing the kth row of U and the kth column of L
+// of the block cluster parent
+template <typename ValueType>
+class PanelLoopBody
+{
+public:
+    PanelLoopBody(HLuDecomposition<ValueType>& lu, blcluster* parent,
+                  unsigned int k) :
+        m_lu(lu), m_parent(parent), m_k(k) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int n = m_parent->getnrs();
+        const unsigned int m = n - m_k - 1;
+        blcluster* diagonalSon = m_parent->getson(m_k, m_k);
+        for (unsigned int t = r.begin(); t != r.end(); ++t)
+            if (t < m)
+                m_lu.solveLower(diagonalSon,
+                                m_parent->getson(m_k, m_k + 1 + t));
+            else
+                m_lu.solveUpper(diagonalSon,
+                                m_parent->getson(m_k + 1 + t - m, m_k));
+    }
+
+private:
+    HLuDecomposition<ValueType>& m_lu;
+    blcluster* m_parent;
+    unsigned int m_k;
+};
+
+// Schur-complement updates of the trailing sons of the block cluster parent
+// after the kth elimination step
+template <typename ValueType>
+class UpdateLoopBody
+{
+public:
+    UpdateLoopBody(HLuDecomposition<ValueType>& lu, blcluster* parent,
+                   unsigned int k) :
+        m_lu(lu), m_parent(parent), m_k(k) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int n = m_parent->getnrs();
+        const unsigned int m = n - m_k - 1;
+        for (unsigned int t = r.begin(); t != r.end(); ++t) {
+            const unsigned int i = m_k + 1 + t / m, j = m_k + 1 + t % m;
+            m_lu.multiplyAndSubtract(m_parent->getson(i, m_k),
+                                     m_parent->getson(m_k, j),
+                                     m_parent->getson(i, j));
+        }
+    }
+
+private:
+    HLuDecomposition<ValueType>& m_lu;
+    blcluster* m_parent;
+    unsigned int m_k;
+};
+
+// Forward substitution in the jth column of the block cluster b
+template <typename ValueType>
+class LowerSolveLoopBody
+{
+public:
+    LowerSolveLoopBody(HLuDecomposition<ValueType>& lu, blcluster* l,
+                       blcluster* b) :
+        m_lu(lu), m_l(l), m_b(b) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int n = m_l->getnrs();
+        for (unsigned int j = r.begin(); j != r.end(); ++j)
+            for (unsigned int i = 0; i < n; ++i) {
+                m_lu.solveLower(m_l->getson(i, i), m_b->getson(i, j));
+                for (unsigned int k = i + 1; k < n; ++k)
+                    m_lu.multiplyAndSubtract(m_l->getson(k, i),
+                                             m_b->getson(i, j),
+                                             m_b->getson(k, j));
+            }
+    }
+
+private:
+    HLuDecomposition<ValueType>& m_lu;
+    blcluster* m_l;
+    blcluster* m_b;
+};
+
+// Backward substitution in the ith row of the block cluster b
+template <typename ValueType>
+class UpperSolveLoopBody
+{
+public:
+    UpperSolveLoopBody(HLuDecomposition<ValueType>& lu, blcluster* u,
+                       blcluster* b) :
+        m_lu(lu), m_u(u), m_b(b) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int n = m_u->getncs();
+        for (unsigned int i = r.begin(); i != r.end(); ++i)
+            for (unsigned int j = 0; j < n; ++j) {
+                m_lu.solveUpper(m_u->getson(j, j), m_b->getson(i, j));
+                for (unsigned int k = j + 1; k < n; ++k)
+                    m_lu.multiplyAndSubtract(m_b->getson(i, j),
+                                             m_u->getson(j, k),
+                                             m_b->getson(i, k));
+            }
+    }
+
+private:
+    HLuDecomposition<ValueType>& m_lu;
+    blcluster* m_u;
+    blcluster* m_b;
+};
+
+// Products contributing to the son (i, j) of the block cluster c
+template <typename ValueType>
+class MultiplicationLoopBody
+{
+public:
+    MultiplicationLoopBody(HLuDecomposition<ValueType>& lu, blcluster* l,
+                           blcluster* u, blcluster* c) :
+        m_lu(lu), m_l(l), m_u(u), m_c(c) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int columnCount = m_c->getncs();
+        const unsigned int innerCount = m_l->getncs();
+        for (unsigned int t = r.begin(); t != r.end(); ++t) {
+            const unsigned int i = t / columnCount, j = t % columnCount;
+            for (unsigned int k = 0; k < innerCount; ++k)
+                m_lu.multiplyAndSubtract(m_l->getson(i, k),
+                                         m_u->getson(k, j),
+                                         m_c->getson(i, j));
+        }
+    }
+
+private:
+    HLuDecomposition<ValueType>& m_lu;
+    blcluster* m_l;
+    blcluster* m_u;
+    blcluster* m_c;
+};
+
+template <typename ValueType>
+void HLuDecomposition<ValueType>::decompose(blcluster* a)
+{
+    if (m_failed)
+        return;
+    if (a->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfSons(a)) {
+        if (!HLU(a, m_A, m_L, m_U, m_eps, m_maximumRank))
+            m_failed = true;
+        return;
+    }
+
+    const unsigned int n = a->getnrs();
+    for (unsigned int k = 0; k < n && !m_failed; ++k) {
+        decompose(a->getson(k, k));
+        const unsigned int m = n - k - 1;
+        if (m == 0 || m_failed)
+            continue;
+        tbb::parallel_for(tbb::blocked_range<unsigned int>(0, 2 * m, 1),
+                          PanelLoopBody<ValueType>(*this, a, k));
+        tbb::parallel_for(tbb::blocked_range<unsigned int>(0, m * m, 1),
+                          UpdateLoopBody<ValueType>(*this, a, k));
+    }
+}
+
+template <typename ValueType>
+void HLuDecomposition<ValueType>::solveLower(blcluster* l, blcluster* b)
+{
+    if (b->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfSons(l) ||
+            !haveMatchingSons(l, b, b)) {
+        LtHGeH_solve(l, m_L, b, m_A, b, m_U, m_eps, m_maximumRank);
+        return;
+    }
+    // The columns of b are independent
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(0, b->getncs(), 1),
+                      LowerSolveLoopBody<ValueType>(*this, l, b));
+}
+
+template <typename ValueType>
+void HLuDecomposition<ValueType>::solveUpper(blcluster* u, blcluster* b)
+{
+    if (b->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfSons(u) ||
+            !haveMatchingSons(b, u, b)) {
+        GeHUtH_solve(u, m_U, b, m_A, b, m_L, m_eps, m_maximumRank);
+        return;
+    }
+    // The rows of b are independent
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(0, b->getnrs(), 1),
+                      UpperSolveLoopBody<ValueType>(*this, u, b));
+}
+
+template <typename ValueType>
+void HLuDecomposition<ValueType>::multiplyAndSubtract(
+        blcluster* l, blcluster* u, blcluster* c)
+{
+    if (c->nleaves() < MIN_TASK_LEAF_COUNT || !haveMatchingSons(l, u, c)) {
+        mltaGeHGeH(ahmedCast(static_cast<ValueType>(-1.)),
+                   l, m_L, u, m_U, c, m_A, m_eps, m_maximumRank);
+        return;
+    }
+    // Each son of c is updated by a separate task
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(
+                          0, c->getnrs() * c->getncs(), 1),
+                      MultiplicationLoopBody<ValueType>(*this, l, u, c));
+}
+
+// Return true if the sons of a diagonal block cluster of an H-matrix stored
+// in the symmetric format form a square grid whose upper triangle, including
+// square diagonal sons, is present. AHMED stores only the upper triangle of
+// symmetric H-matrices.
+bool hasSquareGridOfUpperSons(const blcluster* cluster)
+{
+    if (cluster->isleaf() || cluster->getnrs() != cluster->getncs())
+        return false;
+    const unsigned int n = cluster->getnrs();
+    for (unsigned int r = 0; r < n; ++r)
+        for (unsigned int c = r; c < n; ++c)
+            if (!cluster->getson(r, c))
+                return false;
+    for (unsigned int k = 0; k < n; ++k) {
+        const blcluster* son = cluster->getson(k, k);
+        if (son->getb1() != son->getb2() || son->getn1() != son->getn2())
+            return false;
+    }
+    return true;
+}
+
+// Return true if the sons of the block clusters x, y and c can be combined
+// in the product c = x^H * y son by son
+bool haveMatchingSonsForAdjointProduct(const blcluster* x, const blcluster* y,
+                                       const blcluster* c)
+{
+    if (x->isleaf() || y->isleaf() || c->isleaf())
+        return false;
+    const unsigned int rowCount = c->getnrs(), columnCount = c->getncs();
+    const unsigned int innerCount = x->getnrs();
+    if (x->getncs() != rowCount || y->getncs() != columnCount ||
+            y->getnrs() != innerCount)
+        return false;
+    for (unsigned int i = 0; i < rowCount; ++i)
+        for (unsigned int j = 0; j < columnCount; ++j) {
+            const blcluster* cSon = c->getson(i, j);
+            if (!cSon)
+                continue; // not stored (lower triangle of a diagonal block)
+            for (unsigned int k = 0; k < innerCount; ++k) {
+                const blcluster* xSon = x->getson(k, i);
+                const blcluster* ySon = y->getson(k, j);
+                if (!xSon || !ySon ||
+                        xSon->getb2() != cSon->getb1() ||
+                        xSon->getn2() != cSon->getn1() ||
+                        ySon->getb2() != cSon->getb2() ||
+                        ySon->getn2() != cSon->getn2() ||
+                        xSon->getb1() != ySon->getb1() ||
+                        xSon->getn1() != ySon->getn1())
+                    return false;
+            }
+        }
+    return true;
+}
+
+template <typename ValueType>
+class HCholeskyDecomposition
+{
+public:
+    typedef typename AhmedTypeTraits<ValueType>::Type AhmedValueType;
+    typedef mblock<AhmedValueType> AhmedMblock;
+
+    HCholeskyDecomposition(AhmedMblock** A, AhmedMblock** U,
+                           double eps, int maximumRank) :
+        m_A(A), m_U(U), m_eps(eps), m_maximumRank(maximumRank) {
+        m_failed = false;
+    }
+
+    bool failed() const {
+        return m_failed;
+    }
+
+    // Compute U_a such that U_a^H U_a = A_a
+    void decompose(blcluster* a);
+    // Solve U_u^H X = A_b for X, storing X in U_b
+    void solveAdjoint(blcluster* u, blcluster* b);
+    // Perform A_c -= U_x^H U_y for an off-diagonal block cluster c
+    void multiplyAndSubtract(blcluster* x, blcluster* y, blcluster* c);
+    // Perform A_c -= U_x^H U_x for a diagonal block cluster c
+    void updateDiagonal(blcluster* x, blcluster* c);
+
+private:
+    AhmedMblock** m_A;
+    AhmedMblock** m_U;
+    double m_eps;
+    int m_maximumRank;
+    tbb::atomic<bool> m_failed;
+};
+
+// Enumeration of the pairs (i, j) with first <= i <= j < n
+class UpperTrianglePairs
+{
+public:
+    UpperTrianglePairs(unsigned int first, unsigned int n) {
+        for (unsigned int i = first; i < n; ++i)
+            for (unsigned int j = i; j < n; ++j)
+                m_pairs.push_back(std::make_pair(i, j));
+    }
+
+    unsigned int size() const {
+        return m_pairs.size();
+    }
+
+    const std::pair<unsigned int, unsigned int>& operator[](
+            unsigned int n) const {
+        return m_pairs[n];
+    }
+
+private:
+    std::vector<std::pair<unsigned int, unsigned int> > m_pairs;
+};
+
+// Triangular solves producing the kth row of U of the block cluster parent
+template <typename ValueType>
+class CholeskyPanelLoopBody
+{
+public:
+    CholeskyPanelLoopBody(HCholeskyDecomposition<ValueType>& cholesky,
+                          blcluster* parent, unsigned int k) :
+        m_cholesky(cholesky), m_parent(parent), m_k(k) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        blcluster* diagonalSon = m_parent->getson(m_k, m_k);
+        for (unsigned int j = r.begin(); j != r.end(); ++j)
+            m_cholesky.solveAdjoint(diagonalSon, m_parent->getson(m_k, j));
+    }
+
+private:
+    HCholeskyDecomposition<ValueType>& m_cholesky;
+    blcluster* m_parent;
+    unsigned int m_k;
+};
+
+// Updates of the stored trailing sons of the block cluster parent after the
+// kth elimination step
+template <typename ValueType>
+class CholeskyUpdateLoopBody
+{
+public:
+    CholeskyUpdateLoopBody(HCholeskyDecomposition<ValueType>& cholesky,
+                           blcluster* parent, unsigned int k,
+                           const UpperTrianglePairs& pairs) :
+        m_cholesky(cholesky), m_parent(parent), m_k(k), m_pairs(pairs) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        for (unsigned int t = r.begin(); t != r.end(); ++t) {
+            const unsigned int i = m_pairs[t].first, j = m_pairs[t].second;
+            if (i == j)
+                m_cholesky.updateDiagonal(m_parent->getson(m_k, i),
+                                          m_parent->getson(i, i));
+            else
+                m_cholesky.multiplyAndSubtract(m_parent->getson(m_k, i),
+                                               m_parent->getson(m_k, j),
+                                               m_parent->getson(i, j));
+        }
+    }
+
+private:
+    HCholeskyDecomposition<ValueType>& m_cholesky;
+    blcluster* m_parent;
+    unsigned int m_k;
+    const UpperTrianglePairs& m_pairs;
+};
+
+// Forward substitution with U_u^H in the jth column of the block cluster b
+template <typename ValueType>
+class AdjointSolveLoopBody
+{
+public:
+    AdjointSolveLoopBody(HCholeskyDecomposition<ValueType>& cholesky,
+                         blcluster* u, blcluster* b) :
+        m_cholesky(cholesky), m_u(u), m_b(b) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int n = m_u->getnrs();
+        for (unsigned int j = r.begin(); j != r.end(); ++j)
+            for (unsigned int i = 0; i < n; ++i) {
+                m_cholesky.solveAdjoint(m_u->getson(i, i), m_b->getson(i, j));
+                for (unsigned int k = i + 1; k < n; ++k)
+                    m_cholesky.multiplyAndSubtract(m_u->getson(i, k),
+                                                   m_b->getson(i, j),
+                                                   m_b->getson(k, j));
+            }
+    }
+
+private:
+    HCholeskyDecomposition<ValueType>& m_cholesky;
+    blcluster* m_u;
+    blcluster* m_b;
+};
+
+// Products contributing to the stored sons of the block cluster c
+template <typename ValueType>
+class AdjointMultiplicationLoopBody
+{
+public:
+    AdjointMultiplicationLoopBody(HCholeskyDecomposition<ValueType>& cholesky,
+                                  blcluster* x, blcluster* y, blcluster* c) :
+        m_cholesky(cholesky), m_x(x), m_y(y), m_c(c) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int columnCount = m_c->getncs();
+        const unsigned int innerCount = m_x->getnrs();
+        for (unsigned int t = r.begin(); t != r.end(); ++t) {
+            const unsigned int i = t / columnCount, j = t % columnCount;
+            blcluster* cSon = m_c->getson(i, j);
+            if (!cSon)
+                continue;
+            for (unsigned int k = 0; k < innerCount; ++k)
+                if (m_x == m_y && i == j)
+                    m_cholesky.updateDiagonal(m_x->getson(k, i), cSon);
+                else
+                    m_cholesky.multiplyAndSubtract(m_x->getson(k, i),
+                                                   m_y->getson(k, j), cSon);
+        }
+    }
+
+private:
+    HCholeskyDecomposition<ValueType>& m_cholesky;
+    blcluster* m_x;
+    blcluster* m_y;
+    blcluster* m_c;
+};
+
+template <typename ValueType>
+void HCholeskyDecomposition<ValueType>::decompose(blcluster* a)
+{
+    if (m_failed)
+        return;
+    if (a->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfUpperSons(a)) {
+        if (!HCholesky(a, m_A, m_U, m_eps, m_maximumRank))
+            m_failed = true;
+        return;
+    }
+
+    const unsigned int n = a->getnrs();
+    for (unsigned int k = 0; k < n && !m_failed; ++k) {
+        decompose(a->getson(k, k));
+        if (k + 1 == n || m_failed)
+            continue;
+        tbb::parallel_for(tbb::blocked_range<unsigned int>(k + 1, n, 1),
+                          CholeskyPanelLoopBody<ValueType>(*this, a, k));
+        UpperTrianglePairs pairs(k + 1, n);
+        tbb::parallel_for(tbb::blocked_range<unsigned int>(0, pairs.size(), 1),
+                          CholeskyUpdateLoopBody<ValueType>(*this, a, k,
+                                                            pairs));
+    }
+}
+
+template <typename ValueType>
+void HCholeskyDecomposition<ValueType>::solveAdjoint(blcluster* u,
+                                                     blcluster* b)
+{
+    if (b->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfUpperSons(u) ||
+            !haveMatchingSonsForAdjointProduct(u, b, b)) {
+        UtHhGeH_solve(u, m_U, b, m_A, b, m_U, m_eps, m_maximumRank);
+        return;
+    }
+    // The columns of b are independent
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(0, b->getncs(), 1),
+                      AdjointSolveLoopBody<ValueType>(*this, u, b));
+}
+
+template <typename ValueType>
+void HCholeskyDecomposition<ValueType>::multiplyAndSubtract(
+        blcluster* x, blcluster* y, blcluster* c)
+{
+    if (c->nleaves() < MIN_TASK_LEAF_COUNT ||
+            !haveMatchingSonsForAdjointProduct(x, y, c)) {
+        mltaGeHhGeH(ahmedCast(static_cast<ValueType>(-1.)),
+                    x, m_U, y, m_U, c, m_A, m_eps, m_maximumRank);
+        return;
+    }
+    // Each son of c is updated by a separate task
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(
+                          0, c->getnrs() * c->getncs(), 1),
+                      AdjointMultiplicationLoopBody<ValueType>(
+                          *this, x, y, c));
+}
+
+template <typename ValueType>
+void HCholeskyDecomposition<ValueType>::updateDiagonal(
+        blcluster* x, blcluster* c)
+{
+    if (c->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfUpperSons(c) ||
+            !haveMatchingSonsForAdjointProduct(x, x, c)) {
+        // Only the upper triangle of c is updated
+        mltaGeHhGeH_toHeH(ahmedCast(static_cast<ValueType>(-1.)),
+                          x, m_U, c, m_A, m_eps, m_maximumRank);
+        return;
+    }
+    // Each stored son of c is updated by a separate task
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(
+                          0, c->getnrs() * c->getncs(), 1),
+                      AdjointMultiplicationLoopBody<ValueType>(
+                          *this, x, x, c));
+}
+
+template <typename ValueType>
+class TriangularSolver
+{
+public:
+    typedef typename AhmedTypeTraits<ValueType>::Type AhmedValueType;
+    typedef mblock<AhmedValueType> AhmedMblock;
+
+    explicit TriangularSolver(AhmedValueType* x) :
+        m_x(x) {
+    }
+
+    // Overwrite the part of x corresponding to the rows of the diagonal
+    // block cluster a with the solution of L_a y = x
+    void solveLower(blcluster* a, AhmedMblock** L) const;
+    // Overwrite the part of x corresponding to the rows of the diagonal
+    // block cluster a with the solution of U_a y = x
+    void solveUpper(blcluster* a, AhmedMblock** U) const;
+    // Overwrite the part of x corresponding to the rows of the diagonal
+    // block cluster a with the solution of U_a^H y = x
+    void solveAdjointOfUpper(blcluster* a, AhmedMblock** U) const;
+    // Perform x_rows(c) -= blocks_c x_cols(c) or, if adjoint is true,
+    // x_cols(c) -= blocks_c^H x_rows(c)
+    void multiplyAndSubtract(blcluster* c, AhmedMblock** blocks,
+                             bool adjoint) const;
+
+private:
+    AhmedValueType* m_x;
+};
+
+// Subtract the contributions of the kth part of the solution from the parts
+// of the right-hand side listed in the range (as indices of the sons of
+// parent)
+template <typename ValueType>
+class SubstitutionLoopBody
+{
+public:
+    typedef typename TriangularSolver<ValueType>::AhmedMblock AhmedMblock;
+
+    SubstitutionLoopBody(const TriangularSolver<ValueType>& solver,
+                         blcluster* parent, unsigned int k,
+                         AhmedMblock** blocks, bool adjoint) :
+        m_solver(solver), m_parent(parent), m_k(k), m_blocks(blocks),
+        m_adjoint(adjoint) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        for (unsigned int i = r.begin(); i != r.end(); ++i)
+            if (m_adjoint)
+                m_solver.multiplyAndSubtract(m_parent->getson(m_k, i),
+                                             m_blocks, true);
+            else
+                m_solver.multiplyAndSubtract(m_parent->getson(i, m_k),
+                                             m_blocks, false);
+    }
+
+private:
+    const TriangularSolver<ValueType>& m_solver;
+    blcluster* m_parent;
+    unsigned int m_k;
+    AhmedMblock** m_blocks;
+    bool m_adjoint;
+};
+
+// Row sons of a block cluster write to disjoint parts of the output vector;
+// so do column sons if the block cluster is multiplied by its adjoint
+template <typename ValueType>
+class BlockRowLoopBody
+{
+public:
+    typedef typename TriangularSolver<ValueType>::AhmedMblock AhmedMblock;
+
+    BlockRowLoopBody(const TriangularSolver<ValueType>& solver,
+                     blcluster* parent, AhmedMblock** blocks, bool adjoint) :
+        m_solver(solver), m_parent(parent), m_blocks(blocks),
+        m_adjoint(adjoint) {
+    }
+
+    void operator() (const tbb::blocked_range<unsigned int>& r) const {
+        const unsigned int otherCount =
+                m_adjoint ? m_parent->getnrs() : m_parent->getncs();
+        for (unsigned int i = r.begin(); i != r.end(); ++i)
+            for (unsigned int j = 0; j < otherCount; ++j) {
+                blcluster* son = m_adjoint ? m_parent->getson(j, i) :
+                                             m_parent->getson(i, j);
+                if (son)
+                    m_solver.multiplyAndSubtract(son, m_blocks, m_adjoint);
+            }
+    }
+
+private:
+    const TriangularSolver<ValueType>& m_solver;
+    blcluster* m_parent;
+    AhmedMblock** m_blocks;
+    bool m_adjoint;
+};
+
+template <typename ValueType>
+void TriangularSolver<ValueType>::solveLower(
+        blcluster* a, AhmedMblock** L) const
+{
+    if (a->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfSons(a)) {
+        LtHVec_solve(a, L, m_x + a->getb1());
+        return;
+    }
+    const unsigned int n = a->getnrs();
+    for (unsigned int k = 0; k < n; ++k) {
+        solveLower(a->getson(k, k), L);
+        if (k + 1 < n)
+            tbb::parallel_for(tbb::blocked_range<unsigned int>(k + 1, n, 1),
+                              SubstitutionLoopBody<ValueType>(
+                                  *this, a, k, L, false));
+    }
+}
+
+template <typename ValueType>
+void TriangularSolver<ValueType>::solveUpper(
+        blcluster* a, AhmedMblock** U) const
+{
+    if (a->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfUpperSons(a)) {
+        UtHVec_solve(a, U, m_x + a->getb1());
+        return;
+    }
+    const unsigned int n = a->getnrs();
+    for (unsigned int k = n; k-- > 0; ) {
+        solveUpper(a->getson(k, k), U);
+        if (k > 0)
+            tbb::parallel_for(tbb::blocked_range<unsigned int>(0, k, 1),
+                              SubstitutionLoopBody<ValueType>(
+                                  *this, a, k, U, false));
+    }
+}
+
+template <typename ValueType>
+void TriangularSolver<ValueType>::solveAdjointOfUpper(
+        blcluster* a, AhmedMblock** U) const
+{
+    if (a->nleaves() < MIN_TASK_LEAF_COUNT || !hasSquareGridOfUpperSons(a)) {
+        UtHhVec_solve(a, U, m_x + a->getb1());
+        return;
+    }
+    const unsigned int n = a->getnrs();
+    for (unsigned int k = 0; k < n; ++k) {
+        solveAdjointOfUpper(a->getson(k, k), U);
+        if (k + 1 < n)
+            tbb::parallel_for(tbb::blocked_range<unsigned int>(k + 1, n, 1),
+                              SubstitutionLoopBody<ValueType>(
+                                  *this, a, k, U, true));
+    }
+}
+
+template <typename ValueType>
+void TriangularSolver<ValueType>::multiplyAndSubtract(
+        blcluster* c, AhmedMblock** blocks, bool adjoint) const
+{
+    if (c->isleaf()) {
+        AhmedMblock* block = blocks[c->getidx()];
+        if (block) {
+            if (adjoint)
+                block->mltahVec(ahmedCast(static_cast<ValueType>(-1.)),
+                                m_x + c->getb1(), m_x + c->getb2());
+            else
+                block->mltaVec(ahmedCast(static_cast<ValueType>(-1.)),
+                               m_x + c->getb2(), m_x + c->getb1());
+        }
+        return;
+    }
+    BlockRowLoopBody<ValueType> body(*this, c, blocks, adjoint);
+    tbb::blocked_range<unsigned int> rows(
+                0, adjoint ? c->getncs() : c->getnrs(), 1);
+    if (c->nleaves() < MIN_TASK_LEAF_COUNT)
+        body(rows);
+    else
+        tbb::parallel_for(rows, body);
+}
+
+} // namespace
+
+blcluster* copyBlockClusterTree(const blcluster* source)
+{
+    std::auto_ptr<blcluster> node(new blcluster(
+                                      source->getb1(), source->getb2(),
+                                      source->getn1(), source->getn2()));
+    if (source->isleaf()) {
+        node->setidx(source->getidx());
+        node->setadm(source->isadm());
+        node->setsep(source->issep());
+        return node.release();
+    }
+
+    const unsigned int rowSonCount = source->getnrs();
+    const unsigned int columnSonCount = source->getncs();
+    std::vector<blcluster*> sons(rowSonCount * columnSonCount, 0);
+    try {
+        for (unsigned int r = 0; r < rowSonCount; ++r)
+            for (unsigned int c = 0; c < columnSonCount; ++c) {
+                const blcluster* son = source->getson(r, c);
+                if (son)
+                    sons[r * columnSonCount + c] = copyBlockClusterTree(son);
+            }
+        node->setsons(rowSonCount, columnSonCount, &sons[0]);
+    }
+    catch (...) {
+        for (size_t i = 0; i < sons.size(); ++i)
+            delete sons[i];
+        throw; // rethrow
+    }
+    return node.release();
+}
+
+template <typename ValueType>
+bool computeHLuDecompositionInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** A,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** L,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** U,
+        double eps, int maximumRank)
+{
+    Fiber::SerialBlasRegion region;
+    HLuDecomposition<ValueType> lu(A, L, U, eps, maximumRank);
+    lu.decompose(blockCluster);
+    return !lu.failed();
+}
+
+template <typename ValueType>
+void solveWithHLuDecompositionInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** L,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** U,
+        ValueType* x)
+{
+    Fiber::SerialBlasRegion region;
+    TriangularSolver<ValueType> solver(ahmedCast(x));
+    solver.solveLower(blockCluster, L);
+    solver.solveUpper(blockCluster, U);
+}
+
+template <typename ValueType>
+bool computeHCholeskyDecompositionInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** A,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** U,
+        double eps, int maximumRank)
+{
+    Fiber::SerialBlasRegion region;
+    HCholeskyDecomposition<ValueType> cholesky(A, U, eps, maximumRank);
+    cholesky.decompose(blockCluster);
+    return !cholesky.failed();
+}
+
+template <typename ValueType>
+void solveWithHCholeskyDecompositionInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** U,
+        ValueType* x)
+{
+    Fiber::SerialBlasRegion region;
+    TriangularSolver<ValueType> solver(ahmedCast(x));
+    solver.solveAdjointOfUpper(blockCluster, U);
+    solver.solveUpper(blockCluster, U);
+}
+
+#define INSTANTIATE_DECOMPOSITIONS(RESULT) \
+    template bool computeHLuDecompositionInParallel<RESULT>( \
+            blcluster* blockCluster, \
+            mblock<AhmedTypeTraits<RESULT>::Type>** A, \
+            mblock<AhmedTypeTraits<RESULT>::Type>** L, \
+            mblock<AhmedTypeTraits<RESULT>::Type>** U, \
+            double eps, int maximumRank); \
+    template bool computeHCholeskyDecompositionInParallel<RESULT>( \
+            blcluster* blockCluster, \
+            mblock<AhmedTypeTraits<RESULT>::Type>** A, \
+            mblock<AhmedTypeTraits<RESULT>::Type>** U, \
+            double eps, int maximumRank)
+
+#define INSTANTIATE_SOLVERS(RESULT) \
+    template void solveWithHLuDecompositionInParallel<RESULT>( \
+            blcluster* blockCluster, \
+            mblock<AhmedTypeTraits<RESULT>::Type>** L, \
+            mblock<AhmedTypeTraits<RESULT>::Type>** U, \
+            RESULT* x); \
+    template void solveWithHCholeskyDecompositionInParallel<RESULT>( \
+            blcluster* blockCluster, \
+            mblock<AhmedTypeTraits<RESULT>::Type>** U, \
+            RESULT* x)
+
+#if defined(ENABLE_SINGLE_PRECISION)
+INSTANTIATE_DECOMPOSITIONS(float);
+INSTANTIATE_SOLVERS(float);
+#endif
+
+// AHMED does not provide the H-matrix arithmetic needed by the
+// decompositions for single-precision complex H-matrices (see
+// AcaApproximateLuInverse), but the solvers are still referenced
+#if defined(ENABLE_SINGLE_PRECISION) && (defined(ENABLE_COMPLEX_BASIS_FUNCTIONS) || defined(ENABLE_COMPLEX_KERNELS))
+INSTANTIATE_SOLVERS(std::complex<float>);
+#endif
+
+#if defined(ENABLE_DOUBLE_PRECISION)
+INSTANTIATE_DECOMPOSITIONS(double);
+INSTANTIATE_SOLVERS(double);
+#endif
+
+#if defined(ENABLE_DOUBLE_PRECISION) && (defined(ENABLE_COMPLEX_BASIS_FUNCTIONS) || defined(ENABLE_COMPLEX_KERNELS))
+INSTANTIATE_DECOMPOSITIONS(std::complex<double>);
+INSTANTIATE_SOLVERS(std::complex<double>);
+#endif
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
@@ -0,0 +1,140 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef bempp_ahmed_parallel_lu_hpp
+#define bempp_ahmed_parallel_lu_hpp
+
+#include "../common/common.hpp"
+
+#include "bempp/common/config_ahmed.hpp"
+
+#ifdef WITH_AHMED
+
+#include "ahmed_aux_fwd.hpp"
+
+namespace Bempp
+{
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Create a deep copy of a block cluster tree.
+ *
+ *  The copy consists of plain \c blcluster objects and preserves the
+ *  structure of the tree as well as the indices, admissibility and
+ *  separation flags of its leaves. The caller takes ownership of the
+ *  returned tree. */
+blcluster* copyBlockClusterTree(const blcluster* source);
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Compute the H-LU decomposition of an H-matrix in parallel.
+ *
+ *  On output, \p L and \p U contain the mblocks of a lower and an upper
+ *  triangular H-matrix, respectively, such that \f$LU \approx A\f$.
+ *
+ *  The decomposition follows the recursive block LU algorithm. For each
+ *  non-leaf diagonal block cluster whose sons form a square grid, the
+ *  elimination steps are processed in order; within a step, the
+ *  triangular solves producing the row of \f$U\f$ and the column of
+ *  \f$L\f$ run concurrently, and so do the Schur-complement updates of the
+ *  trailing blocks. Triangular solves and updates themselves recurse into
+ *  the block cluster tree, treating independent sons as separate tasks.
+ *  Small subtrees are handed to AHMED's serial routines.
+ *
+ *  \param[in] blockCluster
+ *    Block cluster tree of the H-matrix. (Should be const, but AHMED is not
+ *    const-correct.)
+ *  \param[in,out] A
+ *    Array of mblocks of the H-matrix. The mblocks are overwritten during
+ *    the decomposition.
+ *  \param[out] L, U
+ *    Arrays of the length <tt>blockCluster->nleaves()</tt> filled with null
+ *    pointers; the mblocks of the factors are allocated by this function.
+ *  \param[in] eps
+ *    Accuracy of the truncation of low-rank blocks.
+ *  \param[in] maximumRank
+ *    Maximum rank of low-rank blocks.
+ *
+ *  \returns true if the decomposition succeeded, false otherwise.
+ *
+ *  \note The mblocks of \p A must not be stored in the symmetric format. */
+template <typename ValueType>
+bool computeHLuDecompositionInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** A,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** L,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** U,
+        double eps, int maximumRank);
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Solve the system \f$LUx = b\f$ in parallel.
+ *
+ *  \p L and \p U should be the factors produced by
+ *  computeHLuDecompositionInParallel(). Forward and backward substitution
+ *  proceed through the diagonal blocks in order; the products of the
+ *  off-diagonal blocks with the already computed parts of the solution are
+ *  evaluated in parallel, each task updating a different range of rows.
+ *
+ *  On input, \p x should contain the right-hand side \f$b\f$; on output it
+ *  contains the solution \f$x\f$. */
+template <typename ValueType>
+void solveWithHLuDecompositionInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** L,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** U,
+        ValueType* x);
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Compute the H-Cholesky decomposition of a symmetric H-matrix in
+ *  parallel.
+ *
+ *  \p A should contain the mblocks of a Hermitian positive-definite
+ *  H-matrix stored in the symmetric format, i.e. only its upper triangle.
+ *  On output, \p U contains the mblocks of an upper triangular H-matrix
+ *  such that \f$U^H U \approx A\f$. The decomposition is parallelized in
+ *  the same way as in computeHLuDecompositionInParallel(); since only one
+ *  factor is computed and only the upper triangle of each trailing block
+ *  is updated, it takes about half the work and memory of the H-LU
+ *  decomposition.
+ *
+ *  \returns true if the decomposition succeeded, false otherwise (for
+ *  example if \p A is not positive definite). */
+template <typename ValueType>
+bool computeHCholeskyDecompositionInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** A,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** U,
+        double eps, int maximumRank);
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Solve the system \f$U^H Ux = b\f$ in parallel.
+ *
+ *  \p U should be the factor produced by
+ *  computeHCholeskyDecompositionInParallel(). The substitutions are
+ *  parallelized as in solveWithHLuDecompositionInParallel(). */
+template <typename ValueType>
+void solveWithHCholeskyDecompositionInParallel(
+        blcluster* blockCluster,
+        mblock<typename AhmedTypeTraits<ValueType>::Type>** U,
+        ValueType* x);
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
+
+#endif
@@ -58,6 +58,15 @@ void AssemblyOptions::switchToAcaMode(const AcaOptions& acaOptions)
     m_acaOptions = canonicalAcaOptions;
 }
 
+void AssemblyOptions::switchToH2Mode(const AcaOptions& acaOptions)
+{
+    AcaOptions globalAcaOptions = acaOptions;
+    globalAcaOptions.mode = AcaOptions::GLOBAL_ASSEMBLY;
+    globalAcaOptions.globalAssemblyBeforeCompression = true;
+    switchToAcaMode(globalAcaOptions);
+    m_assemblyMode = H2;
+}
+
 void AssemblyOptions::switchToDense()
 {
     switchToDenseMode();
@@ -55,7 +55,10 @@ public:
         /** \brief Assemble dense matrices. */
         DENSE,
         /** \brief Assemble hierarchical matrices using adaptive cross approximation (ACA). */
-        ACA
+        ACA,
+        /** \brief Assemble H<sup>2</sup>-matrices with nested cluster bases
+         *  (see DiscreteH2BoundaryOperator). */
+        H2
     };
 
     /** \brief Use dense-matrix representations of weak forms of boundary integral operators.
@@ -69,6 +72,26 @@ public:
      *  \param[in] acaOptions Parameters influencing the ACA algorithm. */
     void switchToAcaMode(const AcaOptions& acaOptions);
 
+    /** \brief Use H<sup>2</sup>-matrix representations of weak forms of
+     *  boundary integral operators.
+     *
+     *  The weak form is first assembled as an H-matrix by ACA, with the
+     *  parameters taken from \p acaOptions, and then converted into an
+     *  H<sup>2</sup>-matrix whose cluster bases have the same accuracy
+     *  (AcaOptions::eps). The H-matrix is always assembled in the
+     *  AcaOptions::GLOBAL_ASSEMBLY mode and stored in the general
+     *  (unsymmetric) format.
+     *
+     *  \note Since the H<sup>2</sup>-matrix is built from a fully assembled
+     *  H-matrix, its memory savings only apply after the assembly: the
+     *  peak memory consumption of the assembly is that of the ACA mode plus
+     *  the cluster bases and coupling matrices under construction.
+     *
+     *  This mode is most effective for operators with asymptotically smooth
+     *  kernels, such as those of the Laplace and modified Helmholtz
+     *  equations. */
+    void switchToH2Mode(const AcaOptions& acaOptions);
+
     /** \brief Use dense-matrix representations of weak forms of boundary integral operators.
      *
      *  \deprecated Use switchToDenseMode() instead. */
@@ -82,14 +105,14 @@ public:
 
     /** \brief Current assembly mode.
      *
-     *  The assembly mode can be changed by calling switchToDenseMode() or
-     *  switchToAcaMode(). */
+     *  The assembly mode can be changed by calling switchToDenseMode(),
+     *  switchToAcaMode() or switchToH2Mode(). */
     Mode assemblyMode() const;
 
     /** \brief Return the current adaptive cross approximation (ACA) settings.
      *
-     *  \note These settings are only used in the ACA assembly mode, i.e. when
-     *  assemblyMode() returns ACA. */
+     *  \note These settings are only used in the ACA and H2 assembly modes,
+     *  i.e. when assemblyMode() returns ACA or H2. */
     const AcaOptions& acaOptions() const;
 
     /** @}
@@ -91,9 +91,9 @@ void ClusterConstructionHelper<BasisFunctionType>::constructBemCluster(
                 ahmedDofCenters, &p2oDofs[0],
                 0, dofCount, acaOptions.maximumBlockSize,
                 strongAdmissibility);
-    cluster->createClusterTree(
-        acaOptions.minimumBlockSize,
-        &p2oDofs[0], &o2pDofs[0]);
+    cluster->createClusterTreeInParallel(
+        acaOptions.minimumBlockSize, &p2oDofs[0], &o2pDofs[0],
+        acaOptions.clusterSplitting == AcaOptions::PRINCIPAL_COMPONENT_SPLITTING);
     // cluster_pca stores a pointer to the first element of the array
     // dofCenters, but it is only used during construction of the
     // cluster tree. Now that the is done, we can deallocate
@@ -147,8 +147,9 @@ void ClusterConstructionHelper<BasisFunctionType>::constructBemCluster(
     cluster = boost::make_shared<AhmedBemCluster>(
                 ahmedDofCenters, &p2oDofs[0],
                 0, dofCount, acaOptions.maximumBlockSize);
-    cluster->createClusterTree(
-        acaOptions.minimumBlockSize, &p2oDofs[0], &o2pDofs[0]);
+    cluster->createClusterTreeInParallel(
+        acaOptions.minimumBlockSize, &p2oDofs[0], &o2pDofs[0],
+        acaOptions.clusterSplitting == AcaOptions::PRINCIPAL_COMPONENT_SPLITTING);
 
     // cluster_pca stores a pointer to the first element of the array
     // dofCenters, but it is only used during construction of the
@@ -14,6 +14,7 @@ namespace Bempp
 class GeometryFactory;
 template <typename ValueType> class DiscreteBoundaryOperator;
 template <typename BasisFunctionType, typename ResultType> class AbstractBoundaryOperator;
+template <typename BasisFunctionType> class AcaClusterTreeCache;
 /** \endcond */
 
 /** \ingroup weak_form_assembly
@@ -75,9 +76,21 @@ public:
         return m_quadStrategy;
     }
 
+    /** \brief Return the cache of cluster trees used in the assembly of weak
+     *  forms in the ACA mode.
+     *
+     *  Operators assembled in this context on the same spaces share their
+     *  cluster trees and block cluster trees; see AcaClusterTreeCache for
+     *  details. */
+    shared_ptr<AcaClusterTreeCache<BasisFunctionType> >
+    acaClusterTreeCache() const {
+        return m_acaClusterTreeCache;
+    }
+
 private:
     shared_ptr<const QuadratureStrategy> m_quadStrategy;
     AssemblyOptions m_assemblyOptions;
+    shared_ptr<AcaClusterTreeCache<BasisFunctionType> > m_acaClusterTreeCache;
 };
 
 } // namespace Bempp
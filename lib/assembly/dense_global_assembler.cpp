@@ -30,6 +30,7 @@
 #include "grid_function.hpp"
 #include "interpolated_function.hpp"
 #include "local_assembler_construction_helper.hpp"
+#include "symmetry.hpp"
 
 #include "../common/auto_timer.hpp"
 #include "../common/multidimensional_arrays.hpp"
@@ -51,11 +52,11 @@
 #include "../common/armadillo_fwd.hpp"
 #include "../common/boost_make_shared_fwd.hpp"
 #include "../common/complex_aux.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 
 #include <tbb/parallel_for.h>
-#include <tbb/spin_mutex.h>
 #include <tbb/task_scheduler_init.h>
 //#include <tbb/tick_count.h>
 
@@ -67,69 +68,108 @@ namespace Bempp
 namespace
 {
 
-// Body of parallel loop
+/** Add the local weak form of the pair of elements (\p testIndex,
+ *  \p trialIndex) to the appropriate entries of \p result. */
+template <typename BasisFunctionType, typename ResultType>
+void addLocalWeakForm(
+        int testIndex, int trialIndex,
+        const arma::Mat<ResultType>& localResult,
+        const std::vector<std::vector<GlobalDofIndex> >& testGlobalDofs,
+        const std::vector<std::vector<GlobalDofIndex> >& trialGlobalDofs,
+        const std::vector<std::vector<BasisFunctionType> >& testLocalDofWeights,
+        const std::vector<std::vector<BasisFunctionType> >& trialLocalDofWeights,
+        arma::Mat<ResultType>& result)
+{
+    const int testDofCount = testGlobalDofs[testIndex].size();
+    const int trialDofCount = trialGlobalDofs[trialIndex].size();
+    for (int trialDof = 0; trialDof < trialDofCount; ++trialDof) {
+        int trialGlobalDof = trialGlobalDofs[trialIndex][trialDof];
+        if (trialGlobalDof < 0)
+            continue;
+        for (int testDof = 0; testDof < testDofCount; ++testDof) {
+            int testGlobalDof = testGlobalDofs[testIndex][testDof];
+            if (testGlobalDof < 0)
+                continue;
+            assert(std::abs(testLocalDofWeights[testIndex][testDof]) > 0.);
+            assert(std::abs(trialLocalDofWeights[trialIndex][trialDof]) > 0.);
+            result(testGlobalDof, trialGlobalDof) +=
+                    conj(testLocalDofWeights[testIndex][testDof]) *
+                    trialLocalDofWeights[trialIndex][trialDof] *
+                    localResult(testDof, trialDof);
+        }
+    }
+}
+
+// Body of parallel loop. Processes the trial elements of a single colour
+// (see colourElements()). Because no two such elements share a global
+// DOF, they write to disjoint columns of the matrix, which can therefore be
+// updated without locking.
+//
+// If diagonalResults is not null, the test and trial elements coincide and
+// the weak form is symmetric or Hermitian. Then only the pairs with test
+// element index <= trial element index are integrated: the contributions of
+// the pairs with test index < trial index are added to the matrix, and the
+// local weak forms of the pairs of identical elements are stored in
+// diagonalResults for later serial assembly.
 
 template <typename BasisFunctionType, typename ResultType>
 class DenseWeakFormAssemblerLoopBody
 {
 public:
-    typedef tbb::spin_mutex MutexType;
-
     DenseWeakFormAssemblerLoopBody(
             const std::vector<int>& testIndices,
+            const std::vector<int>& trialIndices,
             const std::vector<std::vector<GlobalDofIndex> >& testGlobalDofs,
             const std::vector<std::vector<GlobalDofIndex> >& trialGlobalDofs,
             const std::vector<std::vector<BasisFunctionType> >& testLocalDofWeights,
             const std::vector<std::vector<BasisFunctionType> >& trialLocalDofWeights,
             Fiber::LocalAssemblerForOperators<ResultType>& assembler,
-            arma::Mat<ResultType>& result, MutexType& mutex) :
-        m_testIndices(testIndices),
+            arma::Mat<ResultType>& result,
+            std::vector<arma::Mat<ResultType> >* diagonalResults) :
+        m_testIndices(testIndices), m_trialIndices(trialIndices),
         m_testGlobalDofs(testGlobalDofs), m_trialGlobalDofs(trialGlobalDofs),
         m_testLocalDofWeights(testLocalDofWeights),
         m_trialLocalDofWeights(trialLocalDofWeights),
-        m_assembler(assembler), m_result(result), m_mutex(mutex) {
+        m_assembler(assembler), m_result(result),
+        m_diagonalResults(diagonalResults) {
     }
 
     void operator() (const tbb::blocked_range<size_t>& r) const {
-        const int elementCount = m_testIndices.size();
         std::vector<arma::Mat<ResultType> > localResult;
-        for (size_t trialIndex = r.begin(); trialIndex != r.end(); ++trialIndex) {
+        std::vector<int> upperTestIndices;
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const int trialIndex = m_trialIndices[i];
             // Evaluate integrals over pairs of the current trial element and
-            // all the test elements
-            m_assembler.evaluateLocalWeakForms(TEST_TRIAL, m_testIndices, trialIndex,
+            // all the test elements (or, in the symmetric case, the test
+            // elements with indices not exceeding trialIndex)
+            const std::vector<int>* testIndices = &m_testIndices;
+            if (m_diagonalResults) {
+                upperTestIndices.assign(m_testIndices.begin(),
+                                        m_testIndices.begin() + trialIndex + 1);
+                testIndices = &upperTestIndices;
+            }
+            m_assembler.evaluateLocalWeakForms(TEST_TRIAL, *testIndices, trialIndex,
                                                ALL_DOFS, localResult);
 
-            const int trialDofCount = m_trialGlobalDofs[trialIndex].size();
-            // Global assembly
-            {
-                MutexType::scoped_lock lock(m_mutex);
-                // Loop over test indices
-                for (int testIndex = 0; testIndex < elementCount; ++testIndex) {
-                    const int testDofCount = m_testGlobalDofs[testIndex].size();
-                    // Add the integrals to appropriate entries in the operator's matrix
-                    for (int trialDof = 0; trialDof < trialDofCount; ++trialDof) {
-                        int trialGlobalDof = m_trialGlobalDofs[trialIndex][trialDof];
-                        if (trialGlobalDof < 0)
-                            continue;
-                        for (int testDof = 0; testDof < testDofCount; ++testDof) {
-                            int testGlobalDof = m_testGlobalDofs[testIndex][testDof];
-                            if (testGlobalDof < 0)
-                                continue;
-                            assert(std::abs(m_testLocalDofWeights[testIndex][testDof]) > 0.);
-                            assert(std::abs(m_trialLocalDofWeights[trialIndex][trialDof]) > 0.);
-                            m_result(testGlobalDof, trialGlobalDof) +=
-                                    conj(m_testLocalDofWeights[testIndex][testDof]) *
-                                    m_trialLocalDofWeights[trialIndex][trialDof] *
-                                    localResult[testIndex](testDof, trialDof);
-                        }
-                    }
-                }
+            int elementCount = testIndices->size();
+            if (m_diagonalResults) {
+                --elementCount;
+                (*m_diagonalResults)[trialIndex] = localResult[elementCount];
             }
+            // Global assembly
+            // Loop over test indices
+            for (int testIndex = 0; testIndex < elementCount; ++testIndex)
+                // Add the integrals to appropriate entries in the operator's matrix
+                addLocalWeakForm(testIndex, trialIndex, localResult[testIndex],
+                                 m_testGlobalDofs, m_trialGlobalDofs,
+                                 m_testLocalDofWeights, m_trialLocalDofWeights,
+                                 m_result);
         }
     }
 
 private:
     const std::vector<int>& m_testIndices;
+    const std::vector<int>& m_trialIndices;
     const std::vector<std::vector<GlobalDofIndex> >& m_testGlobalDofs;
     const std::vector<std::vector<GlobalDofIndex> >& m_trialGlobalDofs;
     const std::vector<std::vector<BasisFunctionType> >& m_testLocalDofWeights;
@@ -137,13 +177,66 @@ private:
     // mutable OK because Assembler is thread-safe. (Alternative to "mutable" here:
     // make assembler's internal integrator map mutable)
     typename Fiber::LocalAssemblerForOperators<ResultType>& m_assembler;
-    // mutable OK because write access to this matrix is protected by a mutex
+    // mutable OK because different threads write to disjoint columns
     arma::Mat<ResultType>& m_result;
-
-    // mutex must be mutable because we need to lock and unlock it
-    MutexType& m_mutex;
+    // each element is written by a single thread
+    std::vector<arma::Mat<ResultType> >* m_diagonalResults;
 };
 
+/** Replace the square matrix \p result, containing the contributions of
+ *  the pairs of distinct elements with test index < trial index, by the
+ *  sum of these contributions and their mirror images, i.e. by
+ *  result + result^T (if \p hermitian is false) or result + result^H (if
+ *  \p hermitian is true). */
+template <typename ResultType>
+void addMirroredContributions(arma::Mat<ResultType>& result, bool hermitian)
+{
+    const size_t n = result.n_rows;
+    for (size_t col = 0; col < n; ++col) {
+        for (size_t row = 0; row < col; ++row) {
+            const ResultType upper = result(row, col);
+            const ResultType lower = result(col, row);
+            result(row, col) = upper + (hermitian ? conj(lower) : lower);
+            result(col, row) = lower + (hermitian ? conj(upper) : upper);
+        }
+        const ResultType diagonal = result(col, col);
+        result(col, col) = diagonal + (hermitian ? conj(diagonal) : diagonal);
+    }
+}
+
+/** Partition the elements into colours such that no two elements of the same
+ *  colour share a global DOF. Elements are coloured greedily in the order of
+ *  their indices and each colour lists its elements in increasing order, so
+ *  the partition (and hence the order in which contributions to each matrix
+ *  entry are summed) is deterministic. */
+void colourElements(
+    const std::vector<std::vector<GlobalDofIndex> >& globalDofs,
+    size_t globalDofCount,
+    std::vector<std::vector<int> >& colours)
+{
+    colours.clear();
+    // Colours of the elements processed so far that contain each DOF
+    std::vector<std::vector<int> > dofColours(globalDofCount);
+    std::vector<char> forbidden;
+    for (size_t element = 0; element < globalDofs.size(); ++element) {
+        const std::vector<GlobalDofIndex>& dofs = globalDofs[element];
+        forbidden.assign(colours.size(), false);
+        for (size_t i = 0; i < dofs.size(); ++i)
+            if (dofs[i] >= 0)
+                for (size_t j = 0; j < dofColours[dofs[i]].size(); ++j)
+                    forbidden[dofColours[dofs[i]][j]] = true;
+        const size_t colour =
+                std::find(forbidden.begin(), forbidden.end(), false) -
+                forbidden.begin();
+        if (colour == colours.size())
+            colours.push_back(std::vector<int>());
+        colours[colour].push_back(element);
+        for (size_t i = 0; i < dofs.size(); ++i)
+            if (dofs[i] >= 0)
+                dofColours[dofs[i]].push_back(colour);
+    }
+}
+
 /** Build a list of lists of global DOF indices corresponding to the local DOFs
  *  on each element of space.grid(). */
 template <typename BasisFunctionType>
@@ -184,7 +277,8 @@ assembleDetachedWeakForm(
         const Space<BasisFunctionType>& testSpace,
         const Space<BasisFunctionType>& trialSpace,
         LocalAssemblerForBoundaryOperators& assembler,
-        const Context<BasisFunctionType, ResultType>& context)
+        const Context<BasisFunctionType, ResultType>& context,
+        int symmetry)
 {
     const AssemblyOptions& options = context.assemblyOptions();
 
@@ -199,7 +293,6 @@ assembleDetachedWeakForm(
     } else
         gatherGlobalDofs(trialSpace, trialGlobalDofs, trialLocalDofWeights);
     const size_t testElementCount = testGlobalDofs.size();
-    const size_t trialElementCount = trialGlobalDofs.size();
 
     // Make a vector of all element indices
     std::vector<int> testIndices(testElementCount);
@@ -211,8 +304,21 @@ assembleDetachedWeakForm(
                                  trialSpace.globalDofCount());
     result.fill(0.);
 
+    // Colour the trial elements so that the elements of each colour can be
+    // processed in parallel without write conflicts
+    std::vector<std::vector<int> > trialColours;
+    colourElements(trialGlobalDofs, trialSpace.globalDofCount(), trialColours);
+
+    // If the weak form is symmetric or Hermitian and the test and trial
+    // spaces coincide, only the pairs of elements with test index <= trial
+    // index need to be integrated
+    const bool upperTriangleOnly =
+            (symmetry & (SYMMETRIC | HERMITIAN)) && &testSpace == &trialSpace;
+    std::vector<arma::Mat<ResultType> > diagonalResults;
+    if (upperTriangleOnly)
+        diagonalResults.resize(testElementCount);
+
     typedef DenseWeakFormAssemblerLoopBody<BasisFunctionType, ResultType> Body;
-    typename Body::MutexType mutex;
 
     const ParallelizationOptions& parallelOptions =
             options.parallelizationOptions();
@@ -226,10 +332,23 @@ assembleDetachedWeakForm(
     tbb::task_scheduler_init scheduler(maxThreadCount);
     {
         Fiber::SerialBlasRegion region;
-        tbb::parallel_for(tbb::blocked_range<size_t>(0, trialElementCount),
-                          Body(testIndices, testGlobalDofs, trialGlobalDofs,
-                               testLocalDofWeights, trialLocalDofWeights,
-                               assembler, result, mutex));
+        for (size_t colour = 0; colour < trialColours.size(); ++colour)
+            tbb::parallel_for(tbb::blocked_range<size_t>(
+                                  0, trialColours[colour].size()),
+                              Body(testIndices, trialColours[colour],
+                                   testGlobalDofs, trialGlobalDofs,
+                                   testLocalDofWeights, trialLocalDofWeights,
+                                   assembler, result,
+                                   upperTriangleOnly ? &diagonalResults : 0));
+    }
+
+    if (upperTriangleOnly) {
+        addMirroredContributions(result, !(symmetry & SYMMETRIC));
+        for (size_t element = 0; element < testElementCount; ++element)
+            addLocalWeakForm(element, element, diagonalResults[element],
+                             testGlobalDofs, trialGlobalDofs,
+                             testLocalDofWeights, trialLocalDofWeights,
+                             result);
     }
 
     //// Old serial code (TODO: decide whether to keep it behind e.g. #ifndef PARALLEL)
@@ -3,6 +3,8 @@
 
 #include "../common/common.hpp"
 
+#include "symmetry.hpp"
+
 #include <memory>
 
 namespace Fiber
@@ -34,12 +36,20 @@ public:
     typedef Fiber::LocalAssemblerForOperators<ResultType>
     LocalAssemblerForBoundaryOperators;
 
+    /** \brief Assemble the weak form of an operator as a dense matrix.
+     *
+     *  If \p symmetry contains the SYMMETRIC or HERMITIAN flag and
+     *  \p testSpace and \p trialSpace are the same object, only the
+     *  integrals over pairs of elements with test element index not greater
+     *  than the trial element index are evaluated; the remaining entries are
+     *  obtained by (conjugate) transposition. */
     static std::auto_ptr<DiscreteBoundaryOperator<ResultType> >
     assembleDetachedWeakForm(
             const Space<BasisFunctionType>& testSpace,
             const Space<BasisFunctionType>& trialSpace,
             LocalAssemblerForBoundaryOperators& assembler,
-            const Context<BasisFunctionType, ResultType>& context);
+            const Context<BasisFunctionType, ResultType>& context,
+            int symmetry = NO_SYMMETRY);
 };
 
 } // namespace Bempp
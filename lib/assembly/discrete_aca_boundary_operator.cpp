@@ -26,21 +26,22 @@
 #include "../common/shared_ptr.hpp"
 
 #include "ahmed_aux.hpp"
+#include "aca_approximate_cholesky_inverse.hpp"
 #include "aca_approximate_lu_inverse.hpp"
+#include "aca_matvec_plan.hpp"
+#include "aca_single_precision_factors.hpp"
 
-#include "../common/chunk_statistics.hpp"
 #include "../common/complex_aux.hpp"
 #include "../fiber/explicit_instantiation.hpp"
 #include "../fiber/serial_blas_region.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/type_traits/is_complex.hpp>
 
-#include <tbb/blocked_range.h>
-#include <tbb/concurrent_queue.h>
-#include <tbb/parallel_reduce.h>
 #include <tbb/task_scheduler_init.h>
 
 #ifdef WITH_TRILINOS
@@ -50,6 +51,40 @@
 namespace Bempp
 {
 
+namespace
+{
+
+// Deleter of arrays returned by DiscreteAcaBoundaryOperator::blocks() for
+// operators storing some mblocks in single precision. It deletes only the
+// mblocks restored to full precision and keeps the original array alive as
+// long as the returned one is in use.
+template <typename ValueType>
+class RestoredMblockArrayDeleter
+{
+public:
+    typedef mblock<typename AhmedTypeTraits<ValueType>::Type> AhmedMblock;
+
+    RestoredMblockArrayDeleter(
+            const boost::shared_array<AhmedMblock*>& originalBlocks,
+            size_t blockCount) :
+        m_originalBlocks(originalBlocks), m_blockCount(blockCount) {
+    }
+
+    void operator() (AhmedMblock** blocks) const {
+        if (blocks)
+            for (size_t i = 0; i < m_blockCount; ++i)
+                if (blocks[i] != m_originalBlocks[i])
+                    delete blocks[i];
+        delete[] blocks;
+    }
+
+private:
+    boost::shared_array<AhmedMblock*> m_originalBlocks;
+    size_t m_blockCount;
+};
+
+} // namespace
+
 void dumpblcluster(const blcluster* bl, const std::string& indent)
 {
     std::cout << indent << bl << " " << bl->getb1() << " " << bl->getb2() << " "
@@ -68,99 +103,6 @@ void dumpblcluster(const blcluster* bl, const std::string& indent)
 namespace
 {
 
-template <typename ValueType>
-class MblockMultiplicationLoopBody
-{
-    typedef mblock<typename AhmedTypeTraits<ValueType>::Type> AhmedMblock;
-public:
-    typedef tbb::concurrent_queue<size_t> LeafClusterIndexQueue;
-
-    MblockMultiplicationLoopBody(
-            TranspositionMode trans,
-            ValueType multiplier,
-            arma::Col<ValueType>& x,
-            arma::Col<ValueType>& y,
-            AhmedLeafClusterArray& leafClusters,
-            boost::shared_array<AhmedMblock*> blocks,
-            LeafClusterIndexQueue& leafClusterIndexQueue,
-            std::vector<ChunkStatistics>& stats) :
-        m_trans(trans),
-        m_multiplier(multiplier), m_x(x), m_local_y(y),
-        m_leafClusters(leafClusters), m_blocks(blocks),
-        m_leafClusterIndexQueue(leafClusterIndexQueue),
-        m_stats(stats)
-    {
-        if (trans != NO_TRANSPOSE && trans != TRANSPOSE &&
-            trans != CONJUGATE_TRANSPOSE)
-            throw std::invalid_argument(
-                "MblockMultiplicationLoopBody::MblockMultiplicationLoopBody(): "
-                "unsupported transposition mode");
-        // m_local_y.fill(static_cast<ValueType>(0.));
-    }
-
-    MblockMultiplicationLoopBody(MblockMultiplicationLoopBody& other, tbb::split) :
-        m_trans(other.m_trans),
-        m_multiplier(other.m_multiplier),
-        m_x(other.m_x), m_local_y(other.m_local_y.n_rows),
-        m_leafClusters(other.m_leafClusters), m_blocks(other.m_blocks),
-        m_leafClusterIndexQueue(other.m_leafClusterIndexQueue),
-        m_stats(other.m_stats)
-    {
-        m_local_y.fill(static_cast<ValueType>(0.));
-    }
-
-    template <typename Range>
-    void operator() (const Range& r) {
-        for (typename Range::const_iterator i = r.begin(); i != r.end(); ++i) {
-            size_t leafClusterIndex = -1;
-            if (!m_leafClusterIndexQueue.try_pop(leafClusterIndex)) {
-                std::cerr << "MblockMultiplicationLoopBody::operator(): "
-                             "Warning: try_pop failed; this shouldn't happen!"
-                          << std::endl;
-                continue;
-            }
-            m_stats[leafClusterIndex].valid = true;
-            m_stats[leafClusterIndex].chunkStart = r.begin();
-            m_stats[leafClusterIndex].chunkSize = r.size();
-            m_stats[leafClusterIndex].startTime = tbb::tick_count::now();
-
-            blcluster* cluster = m_leafClusters[leafClusterIndex];
-            if (m_trans == NO_TRANSPOSE)
-                m_blocks[cluster->getidx()]->mltaVec(
-                    ahmedCast(m_multiplier),
-                    ahmedCast(&m_x(cluster->getb2())),
-                    ahmedCast(&m_local_y(cluster->getb1())));
-            else if (m_trans == TRANSPOSE)
-                m_blocks[cluster->getidx()]->mltatVec(
-                    ahmedCast(m_multiplier),
-                    ahmedCast(&m_x(cluster->getb1())),
-                    ahmedCast(&m_local_y(cluster->getb2())));
-            else // m_trans == CONJUGATE_TRANSPOSE)
-                m_blocks[cluster->getidx()]->mltahVec(
-                    ahmedCast(m_multiplier),
-                    ahmedCast(&m_x(cluster->getb1())),
-                    ahmedCast(&m_local_y(cluster->getb2())));
-            m_stats[leafClusterIndex].endTime = tbb::tick_count::now();
-        }
-    }
-
-    void join(const MblockMultiplicationLoopBody& other) {
-        m_local_y += other.m_local_y;
-    }
-
-private:
-    TranspositionMode m_trans;
-    ValueType m_multiplier;
-    arma::Col<ValueType>& m_x;
-public:
-    arma::Col<ValueType> m_local_y;
-private:
-    AhmedLeafClusterArray& m_leafClusters;
-    boost::shared_array<AhmedMblock*> m_blocks;
-    LeafClusterIndexQueue& m_leafClusterIndexQueue;
-    std::vector<ChunkStatistics>& m_stats;
-};
-
 bool areEqual(const blcluster* op1, const blcluster* op2)
 {
     if (!op1 || !op2)
@@ -177,47 +119,6 @@ bool areEqual(const blcluster* op1, const blcluster* op2)
     return true;
 }
 
-inline void mltaSyHVec(double d, blcluster* bl, mblock<double>** A, double* x,
-                       double* y)
-{
-    mltaHeHVec(d, bl, A, x, y);
-}
-
-inline void mltaSyHVec(float d, blcluster* bl, mblock<float>** A, float* x,
-                       float* y)
-{
-    mltaHeHVec(d, bl, A, x, y);
-}
-
-inline void mltaSyHVec(scomp d, blcluster* bl, mblock<scomp>** A, scomp* x,
-                       scomp* y)
-{
-    throw std::runtime_error("mltaSyHVec(): the overload of this function for "
-                             "complex single-precision numbers does not exist "
-                             "in AHMED");
-}
-
-// For real types, SyHh = SyH
-inline void mltaSyHhVec(double d, blcluster* bl, mblock<double>** A, double* x,
-                        double* y)
-{
-    mltaSyHVec(d, bl, A, x, y);
-}
-
-inline void mltaSyHhVec(float d, blcluster* bl, mblock<float>** A, float* x,
-                        float* y)
-{
-    mltaSyHVec(d, bl, A, x, y);
-}
-
-inline void mltaSyHhVec(scomp d, blcluster* bl, mblock<scomp>** A, scomp* x,
-                        scomp* y)
-{
-    throw std::runtime_error("mltaSyHhVec(): the overload of this function for "
-                             "complex single-precision numbers does not exist "
-                             "in AHMED");
-}
-
 } // namespace
 
 template <typename ValueType>
@@ -331,21 +232,22 @@ asMatrix() const
     arma::Col<ValueType> unit(nCols );
     unit.fill(0.);
 
+    AhmedMblockArray fullPrecisionBlocks = blocks();
     for (unsigned int col = 0; col < nCols ; ++col)
     {
         if (col > 0)
             unit(col - 1) = 0.;
         unit(col) = 1.;
         if (m_symmetry & SYMMETRIC)
-            mltaSyHVec(1., nonconstBlockCluster, m_blocks.get(),
+            mltaSyHVec(1., nonconstBlockCluster, fullPrecisionBlocks.get(),
                        ahmedCast(unit.memptr()),
                        ahmedCast(permutedOutput.colptr(col)));
         else if (m_symmetry & HERMITIAN)
-            mltaHeHVec(1., nonconstBlockCluster, m_blocks.get(),
+            mltaHeHVec(1., nonconstBlockCluster, fullPrecisionBlocks.get(),
                        ahmedCast(unit.memptr()),
                        ahmedCast(permutedOutput.colptr(col)));
         else
-            mltaGeHVec(1., nonconstBlockCluster, m_blocks.get(),
+            mltaGeHVec(1., nonconstBlockCluster, fullPrecisionBlocks.get(),
                        ahmedCast(unit.memptr()),
                        ahmedCast(permutedOutput.colptr(col)));
     }
@@ -462,6 +364,20 @@ applyBuiltInImpl(const TranspositionMode trans,
                  arma::Col<ValueType>& y_inout,
                  const ValueType alpha,
                  const ValueType beta) const
+{
+    applyBuiltInImpl(trans, static_cast<const arma::Mat<ValueType>&>(x_in),
+                     static_cast<arma::Mat<ValueType>&>(y_inout),
+                     alpha, beta);
+}
+
+template <typename ValueType>
+void
+DiscreteAcaBoundaryOperator<ValueType>::
+applyBuiltInImpl(const TranspositionMode trans,
+                 const arma::Mat<ValueType>& x_in,
+                 arma::Mat<ValueType>& y_inout,
+                 const ValueType alpha,
+                 const ValueType beta) const
 {
     if (trans != NO_TRANSPOSE && trans != TRANSPOSE && trans != CONJUGATE_TRANSPOSE)
         throw std::runtime_error(
@@ -470,13 +386,11 @@ applyBuiltInImpl(const TranspositionMode trans,
                 "CONJUGATE_TRANSPOSE are not supported");
     bool transposed = (trans & TRANSPOSE);
 
-    const blcluster* blockCluster = m_blockCluster.get();
-    blcluster* nonconstBlockCluster = const_cast<blcluster*>(blockCluster);
-
     if ((!transposed && (columnCount() != x_in.n_rows ||
                          rowCount() != y_inout.n_rows)) ||
             (transposed && (rowCount() != x_in.n_rows ||
-                            columnCount() != y_inout.n_rows)))
+                            columnCount() != y_inout.n_rows)) ||
+            x_in.n_cols != y_inout.n_cols)
         throw std::invalid_argument(
                 "DiscreteAcaBoundaryOperator::applyBuiltInImpl(): "
                 "incorrect vector length");
@@ -486,95 +400,89 @@ applyBuiltInImpl(const TranspositionMode trans,
     else
         y_inout *= beta;
 
-    arma::Col<ValueType> permutedArgument;
+    // All columns are multiplied in a single traversal of the H-matrix
+    arma::Mat<ValueType> permutedArgument;
     if (!transposed)
-        m_domainPermutation.permuteVector(x_in, permutedArgument);
+        m_domainPermutation.permuteRows(x_in, permutedArgument);
     else
-        m_rangePermutation.permuteVector(x_in, permutedArgument);
+        m_rangePermutation.permuteRows(x_in, permutedArgument);
 
-    arma::Col<ValueType> permutedResult;
+    arma::Mat<ValueType> permutedResult;
     if (!transposed)
-        m_rangePermutation.permuteVector(y_inout, permutedResult);
+        m_rangePermutation.permuteRows(y_inout, permutedResult);
     else
-        m_domainPermutation.permuteVector(y_inout, permutedResult);
-
-    if (m_symmetry & SYMMETRIC) {
-        // TODO: parallelise
-        if (trans == NO_TRANSPOSE || trans == TRANSPOSE)
-            mltaSyHVec(ahmedCast(alpha), nonconstBlockCluster, m_blocks.get(),
-                       ahmedCast(permutedArgument.memptr()),
-                       ahmedCast(permutedResult.memptr()));
-        else // trans == CONJUGATE_TRANSPOSE
-            mltaSyHhVec(ahmedCast(alpha), nonconstBlockCluster, m_blocks.get(),
-                       ahmedCast(permutedArgument.memptr()),
-                       ahmedCast(permutedResult.memptr()));
-    }
-    else if (m_symmetry & HERMITIAN) {
-        // NO_TRANSPOSE and CONJUGATE_TRANSPOSE are equivalent
-        if (trans == NO_TRANSPOSE || trans == CONJUGATE_TRANSPOSE)
-            mltaHeHVec(ahmedCast(alpha), nonconstBlockCluster, m_blocks.get(),
-                       ahmedCast(permutedArgument.memptr()),
-                       ahmedCast(permutedResult.memptr()));
-        else { // trans == TRANSPOSE
-            // alpha A^T x + beta y = (alpha^* A^H x^* + beta^* y^*)^*
-            // = (alpha^* A x^* + beta^* y^*)^*
+        m_domainPermutation.permuteRows(y_inout, permutedResult);
+
+    shared_ptr<const AcaMatvecPlan<ValueType> > plan = matvecPlan();
+
+    // Only create a new scheduler if the number of threads is limited
+    // explicitly; otherwise TBB initializes itself automatically
+    tbb::task_scheduler_init scheduler(tbb::task_scheduler_init::deferred);
+    const int threadCount = matvecThreadCount();
+    if (threadCount != tbb::task_scheduler_init::automatic)
+        scheduler.initialize(threadCount);
+    Fiber::SerialBlasRegion region;
+
+    // For symmetric matrices NO_TRANSPOSE and TRANSPOSE are equivalent, and
+    // for Hermitian ones NO_TRANSPOSE and CONJUGATE_TRANSPOSE. The remaining
+    // mode is reduced to one of these by complex conjugation:
+    // alpha A^T x + beta y = (alpha^* A^H x^* + beta^* y^*)^*
+    // = (alpha^* A x^* + beta^* y^*)^* for Hermitian matrices, and
+    // alpha A^H x + beta y = (alpha^* A^T x^* + beta^* y^*)^*
+    // = (alpha^* A x^* + beta^* y^*)^* for symmetric ones.
+    const bool conjugate =
+            ((m_symmetry & SYMMETRIC) && trans == CONJUGATE_TRANSPOSE) ||
+            (!(m_symmetry & SYMMETRIC) && (m_symmetry & HERMITIAN) &&
+             trans == TRANSPOSE);
+    if (m_symmetry & (SYMMETRIC | HERMITIAN)) {
+        if (conjugate) {
             permutedArgument = arma::conj(permutedArgument);
             permutedResult = arma::conj(permutedResult);
             ValueType alphaConj = conj(alpha);
-            mltaHeHVec(ahmedCast(alphaConj), nonconstBlockCluster, m_blocks.get(),
-                       ahmedCast(permutedArgument.memptr()),
-                       ahmedCast(permutedResult.memptr()));
+            plan->apply(NO_TRANSPOSE, alphaConj,
+                        permutedArgument, permutedResult);
             permutedResult = arma::conj(permutedResult);
-        }
-    }
-    else {
-//        if (trans == NO_TRANSPOSE)
-//            mltaGeHVec(ahmedCast(alpha), nonconstBlockCluster, m_blocks.get(),
-//                       ahmedCast(permutedArgument.memptr()),
-//                       ahmedCast(permutedResult.memptr()));
-//        else // trans == CONJUGATE_TRANSPOSE
-//            mltaGeHhVec(ahmedCast(alpha), nonconstBlockCluster, m_blocks.get(),
-//                        ahmedCast(permutedArgument.memptr()),
-//                        ahmedCast(permutedResult.memptr()));
-
-        AhmedLeafClusterArray leafClusters(nonconstBlockCluster);
-        leafClusters.sortAccordingToClusterSize();
-        const size_t leafClusterCount = leafClusters.size();
-
-        int maxThreadCount = 1;
-        if (!m_parallelizationOptions.isOpenClEnabled()) {
-            if (m_parallelizationOptions.maxThreadCount() ==
-                    ParallelizationOptions::AUTO)
-                maxThreadCount = tbb::task_scheduler_init::automatic;
-            else
-                maxThreadCount = m_parallelizationOptions.maxThreadCount();
-        }
-        tbb::task_scheduler_init scheduler(maxThreadCount);
-
-        std::vector<ChunkStatistics> chunkStats(leafClusterCount);
-
-        typedef MblockMultiplicationLoopBody<ValueType> Body;
-        typename Body::LeafClusterIndexQueue leafClusterIndexQueue;
-        for (size_t i = 0; i < leafClusterCount; ++i)
-            leafClusterIndexQueue.push(i);
-
-        // std::cout << "----------------------------\nperm Arg\n" << permutedArgument;
-        // std::cout << "perm Res\n" << permutedResult;
-        Body body(trans,
-                  alpha, permutedArgument, permutedResult,
-                  leafClusters, m_blocks,
-                  leafClusterIndexQueue, chunkStats);
-        {
-            Fiber::SerialBlasRegion region;
-            tbb::parallel_reduce(tbb::blocked_range<size_t>(0, leafClusterCount),
-                                 body);
-        }
-        permutedResult = body.m_local_y;
-    }
+        } else
+            plan->apply(NO_TRANSPOSE, alpha, permutedArgument, permutedResult);
+    } else
+        plan->apply(trans, alpha, permutedArgument, permutedResult);
+
     if (!transposed)
-        m_rangePermutation.unpermuteVector(permutedResult, y_inout);
+        m_rangePermutation.unpermuteRows(permutedResult, y_inout);
     else
-        m_domainPermutation.unpermuteVector(permutedResult, y_inout);
+        m_domainPermutation.unpermuteRows(permutedResult, y_inout);
+}
+
+template <typename ValueType>
+int
+DiscreteAcaBoundaryOperator<ValueType>::matvecThreadCount() const
+{
+    if (m_parallelizationOptions.isOpenClEnabled())
+        return 1;
+    if (m_parallelizationOptions.maxThreadCount() ==
+            ParallelizationOptions::AUTO)
+        return tbb::task_scheduler_init::automatic;
+    return m_parallelizationOptions.maxThreadCount();
+}
+
+template <typename ValueType>
+shared_ptr<const AcaMatvecPlan<ValueType> >
+DiscreteAcaBoundaryOperator<ValueType>::matvecPlan() const
+{
+    tbb::mutex::scoped_lock lock(m_matvecPlanMutex);
+    if (!m_matvecPlan) {
+        int workUnitCount = matvecThreadCount();
+        if (workUnitCount == tbb::task_scheduler_init::automatic)
+            workUnitCount = tbb::task_scheduler_init::default_num_threads();
+        blcluster* nonconstBlockCluster =
+                const_cast<AhmedBemBlcluster*>(m_blockCluster.get());
+        m_matvecPlan.reset(new AcaMatvecPlan<ValueType>(
+                               nonconstBlockCluster, m_blocks, m_symmetry,
+                               workUnitCount,
+                               AcaMatvecPlan<ValueType>::AUTO_SCHEDULING,
+                               m_singlePrecisionFactors));
+    }
+    return m_matvecPlan;
 }
 
 template <typename ValueType>
@@ -582,9 +490,66 @@ void
 DiscreteAcaBoundaryOperator<ValueType>::
 makeAllMblocksDense()
 {
+    if (m_singlePrecisionFactors) {
+        m_blocks = blocks();
+        m_singlePrecisionFactors.reset();
+    }
     for (unsigned int i = 0; i < m_blockCluster->nleaves(); ++i)
         if (m_blocks[i]->isLrM())
             m_blocks[i]->convLrM_toGeM();
+    // The costs of work units stored in the matvec plan are no longer valid
+    tbb::mutex::scoped_lock lock(m_matvecPlanMutex);
+    m_matvecPlan.reset();
+}
+
+template <typename ValueType>
+size_t
+DiscreteAcaBoundaryOperator<ValueType>::
+storeLowRankBlocksInSinglePrecision()
+{
+    typedef typename AcaSinglePrecisionFactors<ValueType>::SingleValueType
+            SingleValueType;
+    if (sizeof(SingleValueType) == sizeof(ValueType) || m_singlePrecisionFactors)
+        return 0;
+    // The mblocks of the H-matrix are about to be replaced, so nobody else
+    // may hold pointers to them
+    if (!m_sharedBlocks.empty() || m_blocks.use_count() > 1)
+        throw std::runtime_error(
+                "DiscreteAcaBoundaryOperator::"
+                "storeLowRankBlocksInSinglePrecision(): "
+                "mblocks of this operator are shared with other objects");
+
+    blcluster* nonconstBlockCluster =
+            const_cast<AhmedBemBlcluster*>(m_blockCluster.get());
+    shared_ptr<const AcaSinglePrecisionFactors<ValueType> > factors(
+                new AcaSinglePrecisionFactors<ValueType>(
+                    nonconstBlockCluster, m_blocks, m_symmetry, m_eps));
+    if (factors->blockCount() == 0)
+        return 0;
+
+    // Replace the converted mblocks with empty low-rank blocks of the same
+    // size, releasing their storage
+    const size_t blockCount = m_blockCluster->nleaves();
+    for (size_t i = 0; i < blockCount; ++i)
+        if (factors->contains(i)) {
+            AhmedMblock* emptyBlock =
+                    new AhmedMblock(m_blocks[i]->getn1(), m_blocks[i]->getn2());
+            emptyBlock->setrank(0);
+            delete m_blocks[i];
+            m_blocks[i] = emptyBlock;
+        }
+    m_singlePrecisionFactors = factors;
+
+    tbb::mutex::scoped_lock lock(m_matvecPlanMutex);
+    m_matvecPlan.reset();
+    return factors->savedBytes();
+}
+
+template <typename ValueType>
+size_t
+DiscreteAcaBoundaryOperator<ValueType>::singlePrecisionSavedBytes() const
+{
+    return m_singlePrecisionFactors ? m_singlePrecisionFactors->savedBytes() : 0;
 }
 
 template <typename ValueType>
@@ -606,8 +571,9 @@ int
 DiscreteAcaBoundaryOperator<ValueType>::actualMaximumRank() const
 {
     // const_cast because Ahmed is not const-correct
+    AhmedMblockArray fullPrecisionBlocks = blocks();
     return Hmax_rank(const_cast<AhmedBemBlcluster*>(m_blockCluster.get()),
-                     m_blocks.get());
+                     fullPrecisionBlocks.get());
 }
 
 template <typename ValueType>
@@ -628,7 +594,23 @@ template <typename ValueType>
 typename DiscreteAcaBoundaryOperator<ValueType>::AhmedMblockArray
 DiscreteAcaBoundaryOperator<ValueType>::blocks() const
 {
-    return m_blocks;
+    if (!m_singlePrecisionFactors)
+        return m_blocks;
+    const size_t blockCount = m_blockCluster->nleaves();
+    AhmedMblock** restoredBlocks = new AhmedMblock*[blockCount];
+    std::copy(m_blocks.get(), m_blocks.get() + blockCount, restoredBlocks);
+    AhmedMblockArray result(restoredBlocks,
+                            RestoredMblockArrayDeleter<ValueType>(
+                                m_blocks, blockCount));
+    for (size_t i = 0; i < blockCount; ++i)
+        if (m_singlePrecisionFactors->contains(i)) {
+            std::auto_ptr<AhmedMblock> block(
+                        new AhmedMblock(m_blocks[i]->getn1(),
+                                        m_blocks[i]->getn2()));
+            m_singlePrecisionFactors->restore(i, block.get());
+            restoredBlocks[i] = block.release();
+        }
+    return result;
 }
 
 template <typename ValueType>
@@ -638,6 +620,22 @@ DiscreteAcaBoundaryOperator<ValueType>::blockCount() const
     return m_blockCluster->nleaves();
 }
 
+template <typename ValueType>
+size_t
+DiscreteAcaBoundaryOperator<ValueType>::denseAdmissibleBlockCount() const
+{
+    blcluster* nonconstBlockCluster =
+            const_cast<AhmedBemBlcluster*>(m_blockCluster.get());
+    AhmedLeafClusterArray leafClusters(nonconstBlockCluster);
+    size_t result = 0;
+    for (size_t i = 0; i < leafClusters.size(); ++i) {
+        blcluster* cluster = leafClusters[i];
+        if (cluster->isadm() && !m_blocks[cluster->getidx()]->isLrM())
+            ++result;
+    }
+    return result;
+}
+
 template <typename ValueType>
 const IndexPermutation&
 DiscreteAcaBoundaryOperator<ValueType>::domainPermutation() const
@@ -709,8 +707,10 @@ shared_ptr<const DiscreteBoundaryOperator<ValueType> > acaOperatorSum(
                                         sumBlockCluster.get()));
     boost::shared_array<AhmedMblock*> sumBlocks =
             allocateAhmedMblockArray<ValueType>(sumBlockCluster.get());
-    copyH(nonConstSumBlockCluster, acaOp1->m_blocks.get(), sumBlocks.get());
-    addGeHGeH(nonConstSumBlockCluster, sumBlocks.get(), acaOp2->m_blocks.get(),
+    boost::shared_array<AhmedMblock*> blocks1 = acaOp1->blocks();
+    boost::shared_array<AhmedMblock*> blocks2 = acaOp2->blocks();
+    copyH(nonConstSumBlockCluster, blocks1.get(), sumBlocks.get());
+    addGeHGeH(nonConstSumBlockCluster, sumBlocks.get(), blocks2.get(),
               eps, maximumRank);
     shared_ptr<const DiscreteBoundaryOperator<ValueType> > result(
                 new DiscreteAcaBoundaryOperator<ValueType> (
@@ -816,6 +816,18 @@ shared_ptr<const DiscreteBoundaryOperator<ValueType> > acaOperatorApproximateLuI
     return result;
 }
 
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType> > acaOperatorApproximateCholeskyInverse(
+        const shared_ptr<const DiscreteBoundaryOperator<ValueType> >& op,
+        double delta)
+{
+    shared_ptr<const DiscreteAcaBoundaryOperator<ValueType> > acaOp =
+            DiscreteAcaBoundaryOperator<ValueType>::castToAca(op);
+    shared_ptr<const DiscreteBoundaryOperator<ValueType> > result(
+                new AcaApproximateCholeskyInverse<ValueType>(*acaOp, delta));
+    return result;
+}
+
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(DiscreteAcaBoundaryOperator);
 
 #define INSTANTIATE_FREE_FUNCTIONS(RESULT) \
@@ -834,6 +846,10 @@ FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(DiscreteAcaBoundaryOperator);
             const RESULT& multiplier); \
     template shared_ptr<const DiscreteBoundaryOperator<RESULT> > \
         acaOperatorApproximateLuInverse( \
+            const shared_ptr<const DiscreteBoundaryOperator<RESULT> >& op, \
+            double delta); \
+    template shared_ptr<const DiscreteBoundaryOperator<RESULT> > \
+        acaOperatorApproximateCholeskyInverse( \
             const shared_ptr<const DiscreteBoundaryOperator<RESULT> >& op, \
             double delta)
 
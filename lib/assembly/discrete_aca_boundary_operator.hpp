@@ -36,7 +36,9 @@
 #include "../fiber/scalar_traits.hpp"
 
 #include <iostream>
+#include <string>
 #include "../common/boost_shared_array_fwd.hpp"
+#include <tbb/mutex.h>
 
 #ifdef WITH_TRILINOS
 #include <Teuchos_RCP.hpp>
@@ -51,7 +53,10 @@ void dumpblcluster(const blcluster* bl, const std::string& indent);
 // Forward declarations
 
 /** \cond FORWARD_DECL */
+template <typename ValueType> class AcaApproximateCholeskyInverse;
 template <typename ValueType> class AcaApproximateLuInverse;
+template <typename ValueType> class AcaMatvecPlan;
+template <typename ValueType> class AcaSinglePrecisionFactors;
 template <typename ValueType> class DiscreteAcaBoundaryOperator;
 /** \endcond */
 
@@ -135,6 +140,79 @@ shared_ptr<const DiscreteBoundaryOperator<ValueType> > acaOperatorApproximateLuI
         const shared_ptr<const DiscreteBoundaryOperator<ValueType> >& op,
         double delta);
 
+/** \relates DiscreteAcaBoundaryOperator
+ *  \brief Cholesky inverse of a Hermitian positive-definite discrete boundary
+ *  operator stored as a H-matrix.
+ *
+ *  \p op must be stored as a Hermitian H-matrix, as are real-valued operators
+ *  assembled in ACA mode with the SYMMETRIC flag (for example the Laplace
+ *  single-layer operator). Compared with acaOperatorApproximateLuInverse(),
+ *  the decomposition takes about half the memory and time.
+ *
+ *  \param[in] op Discrete boundary operator for which to compute the
+ *  Cholesky inverse.
+ *  \param[in] delta Approximation accuracy of the inverse.
+ *
+ *  \return A shared pointer to a newly allocated discrete boundary operator
+ *  representing the (approximate) inverse of \p op and stored as
+ *  an (approximate) Cholesky decomposition of \p op. */
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType> > acaOperatorApproximateCholeskyInverse(
+        const shared_ptr<const DiscreteBoundaryOperator<ValueType> >& op,
+        double delta);
+
+/** \relates DiscreteAcaBoundaryOperator
+ *  \brief Save a discrete boundary operator stored as a H-matrix to a file.
+ *
+ *  The block cluster tree, all mblocks and the domain and range index
+ *  permutations are written in a versioned binary format, which can later be
+ *  read by loadAcaOperator(). All sections of the file are aligned to 64-byte
+ *  boundaries and the numerical data of each mblock are stored contiguously,
+ *  so that the file can be memory-mapped read-only. Integers and
+ *  floating-point numbers are stored in the native byte order of the machine
+ *  that wrote the file.
+ *
+ *  A std::bad_cast exception is thrown if the input operator can not be cast
+ *  to DiscreteAcaBoundaryOperator. A std::runtime_error is thrown if the
+ *  file can not be written.
+ *
+ *  \param[in] op Discrete boundary operator to be saved.
+ *  \param[in] fileName Name of the file to be created (or overwritten). */
+template <typename ValueType>
+void saveAcaOperator(
+        const shared_ptr<const DiscreteBoundaryOperator<ValueType> >& op,
+        const std::string& fileName);
+
+/** \relates DiscreteAcaBoundaryOperator
+ *  \brief Load a discrete boundary operator stored as a H-matrix from a file
+ *  created by saveAcaOperator().
+ *
+ *  The file is memory-mapped read-only for the duration of the call and the
+ *  data of each mblock are copied once from the mapping to the storage
+ *  managed by AHMED.
+ *
+ *  A std::runtime_error is thrown if the file can not be opened, was written
+ *  by an incompatible version of BEM++ or on a machine with a different byte
+ *  order, stores values of a type other than \p ValueType, or is corrupt.
+ *
+ *  \param[in] fileName Name of the file to be read.
+ *  \param[in] parallelizationOptions
+ *    Options determining the maximum number of threads used in the apply()
+ *    routine of the returned operator.
+ *
+ *  \return A shared pointer to a newly allocated discrete boundary operator
+ *  identical to the one that was saved in the file \p fileName.
+ *
+ *  \note The returned operator does not store the (non-block) cluster trees
+ *  used to construct its block cluster tree. It can be applied, added to and
+ *  multiplied by scalars and used to construct an approximate LU inverse as
+ *  usual. */
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType> > loadAcaOperator(
+        const std::string& fileName,
+        const ParallelizationOptions& parallelizationOptions =
+            ParallelizationOptions());
+
 // class DiscreteAcaBoundaryOperator
 
 /** \ingroup discrete_boundary_operators
@@ -144,6 +222,7 @@ template <typename ValueType>
 class DiscreteAcaBoundaryOperator :
         public DiscreteBoundaryOperator<ValueType>
 {
+    friend class AcaApproximateCholeskyInverse<ValueType>;
     friend class AcaApproximateLuInverse<ValueType>;
     friend shared_ptr<const DiscreteBoundaryOperator<ValueType> > acaOperatorSum<>(
             const shared_ptr<const DiscreteBoundaryOperator<ValueType> >& op1,
@@ -201,9 +280,6 @@ public:
      *    depends and which therefore must stay alive for the lifetime
      *    of this operator. Useful for constructing ACA operators that
      *    combine mblocks of several other operators.
-     *
-     *  \note Currently the apply() routine is only parallelized for
-     *  non-Hermitian H-matrices.
      */
     DiscreteAcaBoundaryOperator(
             unsigned int rowCount, unsigned int columnCount,
@@ -248,9 +324,6 @@ public:
      *    of this operator. Useful for constructing ACA operators that
      *    combine mblocks of several other operators.
      *
-     *  \note Currently the apply() routine is only parallelized for
-     *  non-Hermitian H-matrices.
-     *
      *  \deprecated This constructor is deprecated. Use the non-deprecated
      *  constructor. */
     DiscreteAcaBoundaryOperator(
@@ -295,9 +368,6 @@ public:
      *    of this operator. Useful for constructing ACA operators that
      *    combine mblocks of several other operators.
      *
-     *  \note Currently the apply() routine is only parallelized for
-     *  non-Hermitian H-matrices.
-     *
      *  \deprecated This constructor is deprecated. Use the non-deprecated
      *  constructor.
      */
@@ -334,6 +404,35 @@ public:
      *  Sometimes useful for debugging. */
     void makeAllMblocksDense();
 
+    /** \brief Store the factors of suitable low-rank mblocks in single
+     *  precision.
+     *
+     *  The factors of each low-rank mblock whose rounding to single precision
+     *  introduces an error small compared with the accuracy of the H-matrix
+     *  approximation (see AcaSinglePrecisionFactors for the precise criterion)
+     *  are converted to single precision and the storage of the original
+     *  mblock is released. Matrix-vector products use the single-precision
+     *  factors directly, accumulating all sums in the precision of
+     *  \p ValueType. blocks() returns full-precision copies of the converted
+     *  mblocks, so that all other operations remain available.
+     *
+     *  This function does nothing if \p ValueType is itself a single-precision
+     *  type.
+     *
+     *  \returns The number of bytes saved.
+     *
+     *  \throws std::runtime_error if the mblocks of this operator are shared
+     *  with other objects (for example with a blocked operator created by
+     *  asDiscreteAcaBoundaryOperator()). */
+    size_t storeLowRankBlocksInSinglePrecision();
+
+    /** \brief Return the number of bytes saved by storing low-rank mblocks in
+     *  single precision.
+     *
+     *  Zero is returned if storeLowRankBlocksInSinglePrecision() has not been
+     *  called or has converted no blocks. */
+    size_t singlePrecisionSavedBytes() const;
+
     /** \brief Downcast a reference to a DiscreteBoundaryOperator object to
      *  DiscreteAcaBoundaryOperator.
      *
@@ -371,6 +470,10 @@ public:
     /** \brief Return the mblocks making up the H-matrix represented by this
      *  operator.
      *
+     *  If storeLowRankBlocksInSinglePrecision() has been called, the mblocks
+     *  whose factors are stored in single precision are converted back to
+     *  full precision on each call of this function.
+     *
      *  \note This function returns a shared array of pointers to
      *  *non-constant* blocks. However, you must not modify it! This is just
      *  a workaround for AHMED's lack of const-correctness. */
@@ -379,6 +482,13 @@ public:
     /** \brief Return the number of mblocks making up this operator. */
     size_t blockCount() const;
 
+    /** \brief Return the number of admissible mblocks stored as dense
+     *  matrices.
+     *
+     *  These are the blocks for which ACA failed to find a low-rank
+     *  approximation of the requested accuracy. */
+    size_t denseAdmissibleBlockCount() const;
+
     /** \brief Return the domain index permutation. */
     const IndexPermutation& domainPermutation() const;
 
@@ -408,6 +518,16 @@ private:
                                   arma::Col<ValueType>& y_inout,
                                   const ValueType alpha,
                                   const ValueType beta) const;
+    virtual void applyBuiltInImpl(const TranspositionMode trans,
+                                  const arma::Mat<ValueType>& x_in,
+                                  arma::Mat<ValueType>& y_inout,
+                                  const ValueType alpha,
+                                  const ValueType beta) const;
+
+    /** \cond PRIVATE */
+    shared_ptr<const AcaMatvecPlan<ValueType> > matvecPlan() const;
+    int matvecThreadCount() const;
+    /** \endcond */
 
 private:
     /** \cond PRIVATE */
@@ -424,11 +544,18 @@ private:
 
     shared_ptr<const AhmedBemBlcluster> m_blockCluster;
     AhmedMblockArray m_blocks;
+    // Set by storeLowRankBlocksInSinglePrecision()
+    shared_ptr<const AcaSinglePrecisionFactors<ValueType> >
+    m_singlePrecisionFactors;
 
     IndexPermutation m_domainPermutation;
     IndexPermutation m_rangePermutation;
     ParallelizationOptions m_parallelizationOptions;
     std::vector<AhmedConstMblockArray> m_sharedBlocks;
+
+    // Built on first use by applyBuiltInImpl() and reused afterwards
+    mutable shared_ptr<const AcaMatvecPlan<ValueType> > m_matvecPlan;
+    mutable tbb::mutex m_matvecPlanMutex;
     /** \endcond */
 };
 
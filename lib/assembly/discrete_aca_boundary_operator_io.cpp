@@ -0,0 +1,532 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_ahmed.hpp"
+#ifdef WITH_AHMED
+
+#include "discrete_aca_boundary_operator.hpp"
+
+#include "ahmed_aux.hpp"
+#include "../common/shared_ptr.hpp"
+#include "../common/to_string.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <cassert>
+#include <complex>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace Bempp
+{
+
+namespace
+{
+
+// Layout of files created by saveAcaOperator() (format version 1):
+//
+// - header (FileHeader);
+// - block cluster tree: one NodeRecord per node, in depth-first order; each
+//   node is followed by the subtrees rooted at its sons (row by row); missing
+//   sons (present e.g. in trees of symmetric H-matrices) are represented by
+//   records with the NULL_NODE flag set;
+// - range index permutation: rowCount 32-bit unsigned integers;
+// - domain index permutation: columnCount 32-bit unsigned integers;
+// - mblock descriptors: one MblockRecord per leaf of the block cluster tree;
+// - values stored in the mblocks, laid out as in AHMED.
+//
+// Each section, and the values of each mblock, start at an offset divisible
+// by fileSectionAlignment.
+
+const char fileMagic[8] = { 'B', 'E', 'M', 'P', 'P', 'H', 'M', 'X' };
+const boost::uint32_t currentFileVersion = 1;
+const boost::uint32_t byteOrderMark = 0x01020304u;
+const boost::uint64_t fileSectionAlignment = 64;
+
+struct FileHeader
+{
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t byteOrderMark;
+    boost::uint32_t valueTypeCode;
+    boost::uint32_t valueSize;
+    boost::uint32_t rowCount;
+    boost::uint32_t columnCount;
+    boost::int32_t maximumRank;
+    boost::int32_t symmetry;
+    double eps;
+    boost::uint64_t nodeCount;
+    boost::uint64_t mblockCount;
+    boost::uint64_t nodeOffset;
+    boost::uint64_t rangePermutationOffset;
+    boost::uint64_t domainPermutationOffset;
+    boost::uint64_t mblockOffset;
+    boost::uint64_t fileSize;
+};
+
+enum NodeFlags {
+    NULL_NODE = 1,
+    ADMISSIBLE_NODE = 2,
+    SEPARATED_NODE = 4,
+    // node is a bbxbemblcluster rather than a plain blcluster
+    BEM_NODE = 8
+};
+
+struct NodeRecord
+{
+    boost::uint32_t b1, b2, n1, n2;
+    boost::uint32_t rowSonCount, columnSonCount;
+    boost::uint32_t index; // index of the mblock (leaves only)
+    boost::uint32_t flags;
+};
+
+enum MblockStorage {
+    GENERAL_STORAGE = 0,
+    LOW_RANK_STORAGE = 1,
+    HERMITIAN_STORAGE = 2,
+    SYMMETRIC_STORAGE = 3,
+    LOWER_TRIANGULAR_STORAGE = 4,
+    UPPER_TRIANGULAR_STORAGE = 5
+};
+
+struct MblockRecord
+{
+    boost::uint32_t storage;
+    boost::uint32_t rank;
+    boost::uint32_t n1, n2;
+    boost::uint64_t valueCount;
+    boost::uint64_t valueOffset;
+};
+
+template <typename ValueType> struct ValueTypeCode;
+template <> struct ValueTypeCode<float> { enum { value = 1 }; };
+template <> struct ValueTypeCode<double> { enum { value = 2 }; };
+template <> struct ValueTypeCode<std::complex<float> > { enum { value = 3 }; };
+template <> struct ValueTypeCode<std::complex<double> > { enum { value = 4 }; };
+
+inline boost::uint64_t alignedOffset(boost::uint64_t offset)
+{
+    return (offset + fileSectionAlignment - 1) /
+            fileSectionAlignment * fileSectionAlignment;
+}
+
+template <typename AhmedBemBlcluster>
+void flattenBlockCluster(blcluster* node, std::vector<NodeRecord>& nodes)
+{
+    NodeRecord record;
+    std::memset(&record, 0, sizeof(record));
+    if (!node) {
+        record.flags = NULL_NODE;
+        nodes.push_back(record);
+        return;
+    }
+    record.b1 = node->getb1();
+    record.b2 = node->getb2();
+    record.n1 = node->getn1();
+    record.n2 = node->getn2();
+    if (dynamic_cast<AhmedBemBlcluster*>(node))
+        record.flags |= BEM_NODE;
+    if (node->isleaf()) {
+        record.index = node->getidx();
+        if (node->isadm())
+            record.flags |= ADMISSIBLE_NODE;
+        if (node->issep())
+            record.flags |= SEPARATED_NODE;
+        nodes.push_back(record);
+    } else {
+        record.rowSonCount = node->getnrs();
+        record.columnSonCount = node->getncs();
+        nodes.push_back(record);
+        for (unsigned int row = 0; row < node->getnrs(); ++row)
+            for (unsigned int col = 0; col < node->getncs(); ++col)
+                flattenBlockCluster<AhmedBemBlcluster>(
+                            node->getson(row, col), nodes);
+    }
+}
+
+template <typename AhmedBemBlcluster>
+std::auto_ptr<blcluster> unflattenBlockCluster(
+        const NodeRecord* nodes, size_t nodeCount, size_t& position)
+{
+    if (position >= nodeCount)
+        throw std::runtime_error("loadAcaOperator(): "
+                                 "block cluster tree is truncated");
+    const NodeRecord& record = nodes[position++];
+    std::auto_ptr<blcluster> node;
+    if (record.flags & NULL_NODE)
+        return node;
+    if (record.flags & BEM_NODE)
+        node.reset(new AhmedBemBlcluster(record.b1, record.b2,
+                                         record.n1, record.n2));
+    else
+        node.reset(new blcluster(record.b1, record.b2, record.n1, record.n2));
+
+    const size_t sonCount =
+            size_t(record.rowSonCount) * size_t(record.columnSonCount);
+    if (sonCount == 0) { // leaf
+        node->setidx(record.index);
+        node->setadm((record.flags & ADMISSIBLE_NODE) != 0);
+        node->setsep((record.flags & SEPARATED_NODE) != 0);
+    } else {
+        std::vector<blcluster*> sons(sonCount, 0);
+        try {
+            for (size_t i = 0; i < sonCount; ++i)
+                sons[i] = unflattenBlockCluster<AhmedBemBlcluster>(
+                            nodes, nodeCount, position).release();
+            node->setsons(record.rowSonCount, record.columnSonCount,
+                          &sons[0]);
+        }
+        catch (...) {
+            for (size_t i = 0; i < sonCount; ++i)
+                delete sons[i];
+            throw; // rethrow
+        }
+    }
+    return node;
+}
+
+// Write size bytes starting at data at the given offset of the file, which
+// must not precede the current position; the gap is filled with zeros
+void writeSection(std::ostream& out, boost::uint64_t& position,
+                  boost::uint64_t offset, const void* data,
+                  boost::uint64_t size)
+{
+    assert(offset >= position);
+    const char padding[fileSectionAlignment] = { 0 };
+    while (position < offset) {
+        const boost::uint64_t chunk =
+                std::min(offset - position, fileSectionAlignment);
+        out.write(padding, chunk);
+        position += chunk;
+    }
+    if (size > 0)
+        out.write(static_cast<const char*>(data), size);
+    position += size;
+}
+
+void checkSection(boost::uint64_t offset, boost::uint64_t size,
+                  boost::uint64_t fileSize, const std::string& sectionName)
+{
+    if (offset % fileSectionAlignment != 0 || offset > fileSize ||
+            size > fileSize - offset)
+        throw std::runtime_error("loadAcaOperator(): " + sectionName +
+                                 " lies outside the file or is misaligned");
+}
+
+std::vector<unsigned int> readPermutation(
+        const char* data, const FileHeader& header,
+        boost::uint64_t offset, boost::uint32_t size,
+        const std::string& permutationName)
+{
+    checkSection(offset, size * sizeof(boost::uint32_t), header.fileSize,
+                 permutationName);
+    const boost::uint32_t* storedIndices =
+            reinterpret_cast<const boost::uint32_t*>(data + offset);
+    std::vector<unsigned int> indices(storedIndices, storedIndices + size);
+    std::vector<bool> used(size, false);
+    for (size_t i = 0; i < size; ++i) {
+        if (indices[i] >= size || used[indices[i]])
+            throw std::runtime_error("loadAcaOperator(): " + permutationName +
+                                     " is not a permutation");
+        used[indices[i]] = true;
+    }
+    return indices;
+}
+
+} // namespace
+
+template <typename ValueType>
+void saveAcaOperator(
+        const shared_ptr<const DiscreteBoundaryOperator<ValueType> >& op,
+        const std::string& fileName)
+{
+    typedef DiscreteAcaBoundaryOperator<ValueType> AcaOp;
+    typedef typename AcaOp::AhmedBemBlcluster AhmedBemBlcluster;
+    typedef typename AcaOp::AhmedMblock AhmedMblock;
+    typedef typename AhmedTypeTraits<ValueType>::Type AhmedValueType;
+
+    shared_ptr<const AcaOp> acaOp = AcaOp::castToAca(op);
+    shared_ptr<const AhmedBemBlcluster> blockCluster = acaOp->blockCluster();
+    typename AcaOp::AhmedMblockArray blocks = acaOp->blocks();
+    const size_t mblockCount = acaOp->blockCount();
+
+    // Describe the contents of all sections
+    std::vector<NodeRecord> nodes;
+    flattenBlockCluster<AhmedBemBlcluster>(
+                const_cast<AhmedBemBlcluster*>(blockCluster.get()), nodes);
+    const std::vector<unsigned int>& rangeIndices =
+            acaOp->rangePermutation().permutedIndices();
+    const std::vector<unsigned int>& domainIndices =
+            acaOp->domainPermutation().permutedIndices();
+    std::vector<boost::uint32_t> storedRangeIndices(
+                rangeIndices.begin(), rangeIndices.end());
+    std::vector<boost::uint32_t> storedDomainIndices(
+                domainIndices.begin(), domainIndices.end());
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = currentFileVersion;
+    header.byteOrderMark = byteOrderMark;
+    header.valueTypeCode = ValueTypeCode<ValueType>::value;
+    header.valueSize = sizeof(AhmedValueType);
+    header.rowCount = acaOp->rowCount();
+    header.columnCount = acaOp->columnCount();
+    header.maximumRank = acaOp->maximumRank();
+    header.symmetry = acaOp->symmetry();
+    header.eps = acaOp->eps();
+    header.nodeCount = nodes.size();
+    header.mblockCount = mblockCount;
+    header.nodeOffset = alignedOffset(sizeof(FileHeader));
+    header.rangePermutationOffset = alignedOffset(
+                header.nodeOffset + nodes.size() * sizeof(NodeRecord));
+    header.domainPermutationOffset = alignedOffset(
+                header.rangePermutationOffset +
+                storedRangeIndices.size() * sizeof(boost::uint32_t));
+    header.mblockOffset = alignedOffset(
+                header.domainPermutationOffset +
+                storedDomainIndices.size() * sizeof(boost::uint32_t));
+
+    std::vector<MblockRecord> mblockRecords(mblockCount);
+    boost::uint64_t offset = header.mblockOffset +
+            mblockCount * sizeof(MblockRecord);
+    for (size_t b = 0; b < mblockCount; ++b) {
+        AhmedMblock* block = blocks[b];
+        MblockRecord& record = mblockRecords[b];
+        std::memset(&record, 0, sizeof(record));
+        record.n1 = block->getn1();
+        record.n2 = block->getn2();
+        if (block->isLrM()) {
+            record.storage = LOW_RANK_STORAGE;
+            record.rank = block->rank();
+        } else if (block->isHeM())
+            record.storage = HERMITIAN_STORAGE;
+        else if (block->isSyM())
+            record.storage = SYMMETRIC_STORAGE;
+        else if (block->isLtM())
+            record.storage = LOWER_TRIANGULAR_STORAGE;
+        else if (block->isUtM())
+            record.storage = UPPER_TRIANGULAR_STORAGE;
+        else
+            record.storage = GENERAL_STORAGE;
+        record.valueCount = block->nvals();
+        record.valueOffset = alignedOffset(offset);
+        offset = record.valueOffset + record.valueCount * sizeof(AhmedValueType);
+    }
+    header.fileSize = offset;
+
+    // Write the sections
+    std::ofstream out(fileName.c_str(), std::ios::out | std::ios::binary);
+    if (!out)
+        throw std::runtime_error("saveAcaOperator(): cannot open file '" +
+                                 fileName + "' for writing");
+    boost::uint64_t position = 0;
+    writeSection(out, position, 0, &header, sizeof(header));
+    writeSection(out, position, header.nodeOffset, &nodes[0],
+                 nodes.size() * sizeof(NodeRecord));
+    if (!storedRangeIndices.empty())
+        writeSection(out, position, header.rangePermutationOffset,
+                     &storedRangeIndices[0],
+                     storedRangeIndices.size() * sizeof(boost::uint32_t));
+    if (!storedDomainIndices.empty())
+        writeSection(out, position, header.domainPermutationOffset,
+                     &storedDomainIndices[0],
+                     storedDomainIndices.size() * sizeof(boost::uint32_t));
+    if (mblockCount > 0)
+        writeSection(out, position, header.mblockOffset, &mblockRecords[0],
+                     mblockCount * sizeof(MblockRecord));
+    for (size_t b = 0; b < mblockCount; ++b)
+        writeSection(out, position, mblockRecords[b].valueOffset,
+                     blocks[b]->getdata(),
+                     mblockRecords[b].valueCount * sizeof(AhmedValueType));
+    out.close();
+    if (!out)
+        throw std::runtime_error("saveAcaOperator(): error while writing "
+                                 "file '" + fileName + "'");
+}
+
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType> > loadAcaOperator(
+        const std::string& fileName,
+        const ParallelizationOptions& parallelizationOptions)
+{
+    typedef DiscreteAcaBoundaryOperator<ValueType> AcaOp;
+    typedef typename AcaOp::AhmedBemBlcluster AhmedBemBlcluster;
+    typedef typename AcaOp::AhmedMblock AhmedMblock;
+    typedef typename AhmedTypeTraits<ValueType>::Type AhmedValueType;
+
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+    try {
+        boost::interprocess::file_mapping(
+                    fileName.c_str(), boost::interprocess::read_only).swap(mapping);
+        boost::interprocess::mapped_region(
+                    mapping, boost::interprocess::read_only).swap(region);
+    }
+    catch (boost::interprocess::interprocess_exception& e) {
+        throw std::runtime_error("loadAcaOperator(): cannot map file '" +
+                                 fileName + "': " + e.what());
+    }
+    const char* data = static_cast<const char*>(region.get_address());
+    const boost::uint64_t fileSize = region.get_size();
+
+    // Header
+    FileHeader header;
+    if (fileSize < sizeof(header))
+        throw std::runtime_error("loadAcaOperator(): file '" + fileName +
+                                 "' is too short");
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0)
+        throw std::runtime_error("loadAcaOperator(): file '" + fileName +
+                                 "' was not created by saveAcaOperator()");
+    if (header.byteOrderMark != byteOrderMark)
+        throw std::runtime_error("loadAcaOperator(): file '" + fileName +
+                                 "' was written on a machine with "
+                                 "different byte order");
+    if (header.version < 1 || header.version > currentFileVersion)
+        throw std::runtime_error("loadAcaOperator(): file '" + fileName +
+                                 "' uses an unsupported format version (" +
+                                 toString(header.version) + ")");
+    if (header.valueTypeCode != ValueTypeCode<ValueType>::value ||
+            header.valueSize != sizeof(AhmedValueType))
+        throw std::runtime_error("loadAcaOperator(): file '" + fileName +
+                                 "' stores values of a different type");
+    if (header.fileSize != fileSize)
+        throw std::runtime_error("loadAcaOperator(): file '" + fileName +
+                                 "' is truncated or corrupt");
+
+    // Block cluster tree
+    checkSection(header.nodeOffset, header.nodeCount * sizeof(NodeRecord),
+                 fileSize, "block cluster tree");
+    const NodeRecord* nodes =
+            reinterpret_cast<const NodeRecord*>(data + header.nodeOffset);
+    size_t position = 0;
+    std::auto_ptr<blcluster> root = unflattenBlockCluster<AhmedBemBlcluster>(
+                nodes, header.nodeCount, position);
+    if (!dynamic_cast<AhmedBemBlcluster*>(root.get()) ||
+            position != header.nodeCount ||
+            root->getn1() != header.rowCount ||
+            root->getn2() != header.columnCount)
+        throw std::runtime_error("loadAcaOperator(): "
+                                 "block cluster tree is corrupt");
+    shared_ptr<const AhmedBemBlcluster> blockCluster(
+                static_cast<AhmedBemBlcluster*>(root.release()));
+
+    // Each mblock must be referenced by exactly one leaf of matching size
+    std::vector<const NodeRecord*> leafOfMblock(header.mblockCount, 0);
+    for (size_t n = 0; n < header.nodeCount; ++n)
+        if (!(nodes[n].flags & NULL_NODE) &&
+                (nodes[n].rowSonCount == 0 || nodes[n].columnSonCount == 0)) {
+            if (nodes[n].index >= header.mblockCount ||
+                    leafOfMblock[nodes[n].index])
+                throw std::runtime_error("loadAcaOperator(): "
+                                         "block cluster tree is corrupt");
+            leafOfMblock[nodes[n].index] = &nodes[n];
+        }
+
+    // Index permutations
+    IndexPermutation rangePermutation(
+                readPermutation(data, header, header.rangePermutationOffset,
+                                header.rowCount, "range index permutation"));
+    IndexPermutation domainPermutation(
+                readPermutation(data, header, header.domainPermutationOffset,
+                                header.columnCount, "domain index permutation"));
+
+    // Mblocks
+    checkSection(header.mblockOffset,
+                 header.mblockCount * sizeof(MblockRecord),
+                 fileSize, "mblock descriptors");
+    const MblockRecord* mblockRecords =
+            reinterpret_cast<const MblockRecord*>(data + header.mblockOffset);
+    boost::shared_array<AhmedMblock*> blocks =
+            allocateAhmedMblockArray<ValueType>(header.mblockCount);
+    for (size_t b = 0; b < header.mblockCount; ++b) {
+        const MblockRecord& record = mblockRecords[b];
+        if (!leafOfMblock[b] || leafOfMblock[b]->n1 != record.n1 ||
+                leafOfMblock[b]->n2 != record.n2)
+            throw std::runtime_error("loadAcaOperator(): mblock " +
+                                     toString(b) + " does not match the "
+                                     "block cluster tree");
+        checkSection(record.valueOffset,
+                     record.valueCount * sizeof(AhmedValueType),
+                     fileSize, "data of mblock " + toString(b));
+        // from now on, the block will be deallocated by the deleter of
+        // the blocks array
+        AhmedMblock* block = blocks[b] = new AhmedMblock(record.n1, record.n2);
+        switch (record.storage) {
+        case GENERAL_STORAGE: block->setGeM(); break;
+        case LOW_RANK_STORAGE: block->setrank(record.rank); break;
+        case HERMITIAN_STORAGE: block->setHeM(); break;
+        case SYMMETRIC_STORAGE: block->setSyM(); break;
+        case LOWER_TRIANGULAR_STORAGE: block->setLtM(); break;
+        case UPPER_TRIANGULAR_STORAGE: block->setUtM(); break;
+        default:
+            throw std::runtime_error("loadAcaOperator(): mblock " +
+                                     toString(b) + " has unknown storage type");
+        }
+        if (block->nvals() != record.valueCount)
+            throw std::runtime_error("loadAcaOperator(): mblock " +
+                                     toString(b) + " has invalid size");
+        std::memcpy(block->getdata(), data + record.valueOffset,
+                    record.valueCount * sizeof(AhmedValueType));
+    }
+
+    shared_ptr<const DiscreteBoundaryOperator<ValueType> > result(
+                new AcaOp(header.rowCount, header.columnCount,
+                          header.eps, header.maximumRank, header.symmetry,
+                          blockCluster, blocks,
+                          domainPermutation, rangePermutation,
+                          parallelizationOptions));
+    return result;
+}
+
+#define INSTANTIATE_FREE_FUNCTIONS(RESULT) \
+    template void saveAcaOperator( \
+            const shared_ptr<const DiscreteBoundaryOperator<RESULT> >& op, \
+            const std::string& fileName); \
+    template shared_ptr<const DiscreteBoundaryOperator<RESULT> > \
+        loadAcaOperator( \
+            const std::string& fileName, \
+            const ParallelizationOptions& parallelizationOptions)
+
+#if defined(ENABLE_SINGLE_PRECISION)
+INSTANTIATE_FREE_FUNCTIONS(float);
+#endif
+
+#if defined(ENABLE_SINGLE_PRECISION) && (defined(ENABLE_COMPLEX_BASIS_FUNCTIONS) || defined(ENABLE_COMPLEX_KERNELS))
+INSTANTIATE_FREE_FUNCTIONS(std::complex<float>);
+#endif
+
+#if defined(ENABLE_DOUBLE_PRECISION)
+INSTANTIATE_FREE_FUNCTIONS(double);
+#endif
+
+#if defined(ENABLE_DOUBLE_PRECISION) && (defined(ENABLE_COMPLEX_BASIS_FUNCTIONS) || defined(ENABLE_COMPLEX_KERNELS))
+INSTANTIATE_FREE_FUNCTIONS(std::complex<double>);
+#endif
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
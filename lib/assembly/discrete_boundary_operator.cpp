@@ -31,7 +31,7 @@
 
 #include "../fiber/explicit_instantiation.hpp"
 
-#include <Thyra_DetachedSpmdVectorView.hpp>
+#include <Thyra_DetachedMultiVectorView.hpp>
 
 namespace Bempp
 {
@@ -80,6 +80,18 @@ DiscreteBoundaryOperator<ValueType>::apply(
                                     "vectors x_in and y_inout must have "
                                     "the same number of columns");
 
+    applyBuiltInImpl(trans, x_in, y_inout, alpha, beta);
+}
+
+template <typename ValueType>
+void
+DiscreteBoundaryOperator<ValueType>::applyBuiltInImpl(
+        const TranspositionMode trans,
+        const arma::Mat<ValueType>& x_in,
+        arma::Mat<ValueType>& y_inout,
+        const ValueType alpha,
+        const ValueType beta) const
+{
     for (size_t i = 0; i < x_in.n_cols; ++i) {
         const arma::Col<ValueType> x_in_col = x_in.unsafe_col(i);
         arma::Col<ValueType> y_inout_col = y_inout.unsafe_col(i);
@@ -131,27 +143,38 @@ void DiscreteBoundaryOperator<ValueType>::applyImpl(
     TEUCHOS_ASSERT(Y_inout->range()->isCompatible(*this->range()));
     TEUCHOS_ASSERT(Y_inout->domain()->isCompatible(*X_in.domain()));
 
-    const Ordinal colCount = X_in.domain()->dim();
-
-    // Loop over the input columns
-
-    for (Ordinal col = 0; col < colCount; ++col) {
-        // Get access the the elements of X_in's and Y_inout's column #col
-        Thyra::ConstDetachedSpmdVectorView<ValueType> xVec(X_in.col(col));
-        Thyra::DetachedSpmdVectorView<ValueType> yVec(Y_inout->col(col));
-        const Teuchos::ArrayRCP<const ValueType> xArray(xVec.sv().values());
-        const Teuchos::ArrayRCP<ValueType> yArray(yVec.sv().values());
-
-        // Wrap the Trilinos array in an Armadillo vector. const_cast is used
-        // because it's more natural to have a const arma::Col<ValueType> array
-        // than an arma::Col<const ValueType> one.
-        const arma::Col<ValueType> xCol(
-                    const_cast<ValueType*>(xArray.get()), xArray.size(),
-                    false /* copy_aux_mem */);
-        arma::Col<ValueType> yCol(yArray.get(), yArray.size(), false);
-
+    // Get access to the elements of X_in and Y_inout. The detached views
+    // avoid copying the data if the columns are stored contiguously.
+    Thyra::ConstDetachedMultiVectorView<ValueType> xView(X_in);
+    Thyra::DetachedMultiVectorView<ValueType> yView(*Y_inout);
+    const Ordinal xRowCount = xView.subDim(), yRowCount = yView.subDim();
+    const Ordinal colCount = xView.numSubCols();
+
+    // Wrap the Trilinos arrays in Armadillo matrices, so that all columns
+    // are processed by a single call to applyBuiltInImpl(). const_cast is
+    // used because it's more natural to have a const arma::Mat<ValueType>
+    // array than an arma::Mat<const ValueType> one.
+    if (xView.leadingDim() == xRowCount && yView.leadingDim() == yRowCount) {
+        const arma::Mat<ValueType> xMat(
+                    const_cast<ValueType*>(xView.values()),
+                    xRowCount, colCount, false /* copy_aux_mem */);
+        arma::Mat<ValueType> yMat(yView.values(), yRowCount, colCount, false);
+        applyBuiltInImpl(static_cast<TranspositionMode>(M_trans),
+                         xMat, yMat, alpha, beta);
+    } else {
+        arma::Mat<ValueType> xMat(xRowCount, colCount);
+        arma::Mat<ValueType> yMat(yRowCount, colCount);
+        for (Ordinal col = 0; col < colCount; ++col) {
+            for (Ordinal row = 0; row < xRowCount; ++row)
+                xMat(row, col) = xView(row, col);
+            for (Ordinal row = 0; row < yRowCount; ++row)
+                yMat(row, col) = yView(row, col);
+        }
         applyBuiltInImpl(static_cast<TranspositionMode>(M_trans),
-                         xCol, yCol, alpha, beta);
+                         xMat, yMat, alpha, beta);
+        for (Ordinal col = 0; col < colCount; ++col)
+            for (Ordinal row = 0; row < yRowCount; ++row)
+                yView(row, col) = yMat(row, col);
     }
 }
 #endif
@@ -238,6 +238,17 @@ private:
                                   arma::Col<ValueType>& y_inout,
                                   const ValueType alpha,
                                   const ValueType beta) const = 0;
+    /** \brief Apply the operator to all columns of \p x_in at once.
+     *
+     *  The default implementation calls the single-vector overload of
+     *  applyBuiltInImpl() for each column. Subclasses that can process
+     *  several vectors more efficiently than one by one (e.g. reading each
+     *  matrix block only once per batch of vectors) should override it. */
+    virtual void applyBuiltInImpl(const TranspositionMode trans,
+                                  const arma::Mat<ValueType>& x_in,
+                                  arma::Mat<ValueType>& y_inout,
+                                  const ValueType alpha,
+                                  const ValueType beta) const;
 };
 
 /** \relates DiscreteBoundaryOperator
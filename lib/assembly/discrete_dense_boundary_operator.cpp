@@ -117,6 +117,21 @@ void DiscreteDenseBoundaryOperator<ValueType>::applyBuiltInImpl(
         const ValueType alpha,
         const ValueType beta) const
 {
+    applyBuiltInImpl(trans, static_cast<const arma::Mat<ValueType>&>(x_in),
+                     static_cast<arma::Mat<ValueType>&>(y_inout),
+                     alpha, beta);
+}
+
+template <typename ValueType>
+void DiscreteDenseBoundaryOperator<ValueType>::applyBuiltInImpl(
+        const TranspositionMode trans,
+        const arma::Mat<ValueType>& x_in,
+        arma::Mat<ValueType>& y_inout,
+        const ValueType alpha,
+        const ValueType beta) const
+{
+    // Armadillo dispatches the products below to GEMM if x_in has several
+    // columns and to GEMV otherwise
     if (beta == static_cast<ValueType>(0.))
         y_inout.fill(static_cast<ValueType>(0.));
     else
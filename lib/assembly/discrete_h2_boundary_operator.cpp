@@ -0,0 +1,983 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_ahmed.hpp"
+#include "bempp/common/config_trilinos.hpp"
+#ifdef WITH_AHMED
+
+#include "discrete_h2_boundary_operator.hpp"
+
+#include "ahmed_aux.hpp"
+#include "discrete_aca_boundary_operator.hpp"
+#include "symmetry.hpp"
+
+#include "../common/armadillo_fwd.hpp"
+#include "../common/complex_aux.hpp"
+#include "../fiber/explicit_instantiation.hpp"
+#include "../fiber/scalar_traits.hpp"
+#include "../fiber/serial_blas_region.hpp"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <utility>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#ifdef WITH_TRILINOS
+#include <Thyra_SpmdVectorSpaceDefaultBase.hpp>
+#endif
+
+namespace Bempp
+{
+
+namespace
+{
+
+typedef std::pair<unsigned int, unsigned int> Range; // (begin, size)
+
+// Order ranges by their first index and, among ranges with the same first
+// index, from the largest to the smallest, so that in a laminar family each
+// range precedes the ranges it contains
+struct RangeComparator
+{
+    bool operator()(const Range& a, const Range& b) const {
+        if (a.first != b.first)
+            return a.first < b.first;
+        return a.second > b.second;
+    }
+};
+
+void collectRanges(blcluster* bc,
+                   std::vector<Range>& rowRanges,
+                   std::vector<Range>& columnRanges)
+{
+    rowRanges.push_back(Range(bc->getb1(), bc->getn1()));
+    columnRanges.push_back(Range(bc->getb2(), bc->getn2()));
+    if (bc->isleaf())
+        return;
+    for (unsigned int r = 0; r < bc->getnrs(); ++r)
+        for (unsigned int c = 0; c < bc->getncs(); ++c) {
+            blcluster* son = bc->getson(r, c);
+            if (son)
+                collectRanges(son, rowRanges, columnRanges);
+        }
+}
+
+// Build the cluster tree formed by a laminar family of index ranges. On
+// output, the nodes of tree are stored in pre-order and nodeIndices maps
+// each range to the index of its node.
+template <typename ClusterBasis>
+void buildClusterTree(std::vector<Range>& ranges,
+                      std::vector<ClusterBasis>& tree,
+                      std::vector<size_t>& parents,
+                      std::map<Range, size_t>& nodeIndices)
+{
+    std::sort(ranges.begin(), ranges.end(), RangeComparator());
+    ranges.erase(std::unique(ranges.begin(), ranges.end()), ranges.end());
+
+    const size_t NO_PARENT = static_cast<size_t>(-1);
+    tree.resize(ranges.size());
+    parents.assign(ranges.size(), NO_PARENT);
+    std::vector<size_t> stack;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        const Range& range = ranges[i];
+        while (!stack.empty()) {
+            const Range& top = ranges[stack.back()];
+            if (range.first + range.second <= top.first + top.second)
+                break;
+            stack.pop_back();
+        }
+        tree[i].begin = range.first;
+        tree[i].size = range.second;
+        tree[i].nested = false;
+        if (!stack.empty()) {
+            parents[i] = stack.back();
+            tree[stack.back()].sons.push_back(i);
+        }
+        stack.push_back(i);
+        nodeIndices[range] = i;
+    }
+
+    // A node is nested if its sons cover it exactly (being disjoint, they
+    // do so if their sizes add up to the node's size)
+    for (size_t i = 0; i < tree.size(); ++i) {
+        size_t sonSizes = 0;
+        for (size_t s = 0; s < tree[i].sons.size(); ++s)
+            sonSizes += tree[tree[i].sons[s]].size;
+        tree[i].nested = !tree[i].sons.empty() && sonSizes == tree[i].size;
+    }
+}
+
+// Number of leading singular values to keep so that the Frobenius norm of
+// the discarded part does not exceed tolerance
+template <typename CoordinateType>
+unsigned int truncatedRank(const arma::Col<CoordinateType>& singularValues,
+                           double tolerance)
+{
+    double discarded = 0.;
+    unsigned int rank = singularValues.n_rows;
+    while (rank > 0) {
+        const double sigma = singularValues(rank - 1);
+        if (discarded + sigma * sigma > tolerance * tolerance)
+            break;
+        discarded += sigma * sigma;
+        --rank;
+    }
+    return rank;
+}
+
+// Data of a low-rank block A = U V^H used during the construction of the
+// cluster bases
+template <typename ValueType>
+struct FarBlock
+{
+    size_t rowNode;
+    size_t columnNode;
+    unsigned int rowBegin;
+    unsigned int columnBegin;
+    arma::Mat<ValueType> U;
+    arma::Mat<ValueType> V;
+    // Weights such that the column spaces and singular values of
+    // U rowWeight and V columnWeight coincide with those of A and A^H,
+    // scaled by 1 / ||A||_F
+    arma::Mat<ValueType> rowWeight;
+    arma::Mat<ValueType> columnWeight;
+    // Coefficients of U and V in the bases of rowNode and columnNode
+    arma::Mat<ValueType> rowCoefficients;
+    arma::Mat<ValueType> columnCoefficients;
+};
+
+// Weight W such that X = Z W^H with Z having orthonormal columns
+template <typename ValueType>
+void orthogonalWeight(const arma::Mat<ValueType>& X, arma::Mat<ValueType>& W)
+{
+    typedef typename Fiber::ScalarTraits<ValueType>::RealType CoordinateType;
+    arma::Mat<ValueType> Z, R;
+    arma::Col<CoordinateType> s;
+    if (!arma::svd_econ(Z, s, R, X))
+        throw std::runtime_error("DiscreteH2BoundaryOperator::"
+                                 "DiscreteH2BoundaryOperator(): "
+                                 "singular value decomposition failed");
+    W = R;
+    for (size_t j = 0; j < s.n_rows; ++j)
+        W.col(j) *= s(j);
+}
+
+// Construct the cluster basis of one side (rows or columns) of the
+// H^2-matrix. For each block, factor(b) is the factor (U or V) spanning the
+// block's range on this side, weight(b) the corresponding weight and
+// coefficients(b) receives the coefficients of the factor in the basis of
+// the block's node.
+template <typename ValueType, typename ClusterBasis, typename Side>
+void buildClusterBases(std::vector<ClusterBasis>& tree,
+                       const std::vector<size_t>& parents,
+                       std::vector<FarBlock<ValueType> >& blocks,
+                       const Side& side, double tolerance)
+{
+    typedef typename Fiber::ScalarTraits<ValueType>::RealType CoordinateType;
+    const size_t nodeCount = tree.size();
+    const size_t NO_PARENT = static_cast<size_t>(-1);
+
+    // Top-down: the blocks whose factors must be represented by the basis
+    // of each node. If a node is nested, its basis must represent all the
+    // blocks its parent represents; these come first in the list.
+    std::vector<std::vector<size_t> > covers(nodeCount);
+    std::vector<std::vector<size_t> > ownBlocks(nodeCount);
+    for (size_t b = 0; b < blocks.size(); ++b)
+        ownBlocks[side.node(blocks[b])].push_back(b);
+    for (size_t n = 0; n < nodeCount; ++n) {
+        const size_t parent = parents[n];
+        if (parent != NO_PARENT && tree[parent].nested)
+            covers[n] = covers[parent];
+        covers[n].insert(covers[n].end(),
+                         ownBlocks[n].begin(), ownBlocks[n].end());
+    }
+
+    // Bottom-up: coefficients[n][j] holds the coefficients of the part of
+    // the factor of block covers[n][j] lying in node n, expressed in the
+    // basis of node n
+    std::vector<std::vector<arma::Mat<ValueType> > > coefficients(nodeCount);
+    for (size_t n = nodeCount; n-- > 0; ) {
+        ClusterBasis& node = tree[n];
+        const std::vector<size_t>& cover = covers[n];
+        std::vector<arma::Mat<ValueType> >& nodeCoefficients =
+                coefficients[n];
+        nodeCoefficients.resize(cover.size());
+
+        // Rank of the space spanned by the sons' bases (nested nodes) or
+        // number of indices (other nodes)
+        unsigned int sourceRank = node.size;
+        std::vector<unsigned int> sonOffsets;
+        if (node.nested) {
+            sourceRank = 0;
+            for (size_t s = 0; s < node.sons.size(); ++s) {
+                sonOffsets.push_back(sourceRank);
+                sourceRank += tree[node.sons[s]].matrix.n_cols;
+            }
+        }
+
+        // Factors of the covered blocks in the source space
+        std::vector<arma::Mat<ValueType> > sources(cover.size());
+        size_t weightedColumnCount = 0;
+        for (size_t j = 0; j < cover.size(); ++j) {
+            const FarBlock<ValueType>& block = blocks[cover[j]];
+            const arma::Mat<ValueType>& factor = side.factor(block);
+            if (node.nested) {
+                sources[j].set_size(sourceRank, factor.n_cols);
+                for (size_t s = 0; s < node.sons.size(); ++s) {
+                    const arma::Mat<ValueType>& sonCoefficients =
+                            coefficients[node.sons[s]][j];
+                    if (sonCoefficients.n_rows > 0)
+                        sources[j].rows(sonOffsets[s], sonOffsets[s] +
+                                        sonCoefficients.n_rows - 1) =
+                                sonCoefficients;
+                }
+            } else {
+                const unsigned int offset = node.begin - side.begin(block);
+                sources[j] = factor.rows(offset, offset + node.size - 1);
+            }
+            weightedColumnCount += side.weight(block).n_cols;
+        }
+        if (node.nested)
+            for (size_t s = 0; s < node.sons.size(); ++s)
+                std::vector<arma::Mat<ValueType> >().swap(
+                            coefficients[node.sons[s]]);
+
+        // Orthonormal basis of the dominant part of the weighted sources
+        arma::Mat<ValueType> basis(sourceRank, 0);
+        if (sourceRank > 0 && weightedColumnCount > 0) {
+            arma::Mat<ValueType> weighted(sourceRank, weightedColumnCount);
+            size_t column = 0;
+            for (size_t j = 0; j < cover.size(); ++j) {
+                const arma::Mat<ValueType>& weight =
+                        side.weight(blocks[cover[j]]);
+                weighted.cols(column, column + weight.n_cols - 1) =
+                        sources[j] * weight;
+                column += weight.n_cols;
+            }
+            arma::Mat<ValueType> left, right;
+            arma::Col<CoordinateType> s;
+            if (!arma::svd_econ(left, s, right, weighted))
+                throw std::runtime_error("DiscreteH2BoundaryOperator::"
+                                         "DiscreteH2BoundaryOperator(): "
+                                         "singular value decomposition failed");
+            const unsigned int rank = truncatedRank(s, tolerance);
+            if (rank > 0)
+                basis = left.cols(0, rank - 1);
+        }
+        node.matrix = basis;
+
+        for (size_t j = 0; j < cover.size(); ++j) {
+            if (basis.n_cols > 0)
+                nodeCoefficients[j] = basis.t() * sources[j];
+            else
+                nodeCoefficients[j].zeros(0, sources[j].n_cols);
+        }
+        for (size_t j = 0; j < ownBlocks[n].size(); ++j) {
+            const size_t position = cover.size() - ownBlocks[n].size() + j;
+            side.coefficients(blocks[ownBlocks[n][j]]) =
+                    nodeCoefficients[position];
+        }
+        // The coefficients of roots and of sons of non-nested nodes are
+        // not needed any more
+        if (parents[n] == NO_PARENT || !tree[parents[n]].nested)
+            std::vector<arma::Mat<ValueType> >().swap(nodeCoefficients);
+    }
+}
+
+template <typename ValueType>
+struct RowSide
+{
+    size_t node(const FarBlock<ValueType>& b) const {
+        return b.rowNode;
+    }
+    unsigned int begin(const FarBlock<ValueType>& b) const {
+        return b.rowBegin;
+    }
+    const arma::Mat<ValueType>& factor(const FarBlock<ValueType>& b) const {
+        return b.U;
+    }
+    const arma::Mat<ValueType>& weight(const FarBlock<ValueType>& b) const {
+        return b.rowWeight;
+    }
+    arma::Mat<ValueType>& coefficients(FarBlock<ValueType>& b) const {
+        return b.rowCoefficients;
+    }
+};
+
+template <typename ValueType>
+struct ColumnSide
+{
+    size_t node(const FarBlock<ValueType>& b) const {
+        return b.columnNode;
+    }
+    unsigned int begin(const FarBlock<ValueType>& b) const {
+        return b.columnBegin;
+    }
+    const arma::Mat<ValueType>& factor(const FarBlock<ValueType>& b) const {
+        return b.V;
+    }
+    const arma::Mat<ValueType>& weight(const FarBlock<ValueType>& b) const {
+        return b.columnWeight;
+    }
+    arma::Mat<ValueType>& coefficients(FarBlock<ValueType>& b) const {
+        return b.columnCoefficients;
+    }
+};
+
+// Group the nodes of a cluster tree stored in pre-order by their depth
+template <typename ClusterBasis>
+void groupNodesByLevel(const std::vector<ClusterBasis>& tree,
+                       std::vector<std::vector<size_t> >& levels)
+{
+    levels.clear();
+    std::vector<size_t> depths(tree.size(), 0);
+    for (size_t n = 0; n < tree.size(); ++n) {
+        // Parents precede their sons, so the depth of n is already known
+        if (depths[n] >= levels.size())
+            levels.resize(depths[n] + 1);
+        levels[depths[n]].push_back(n);
+        for (size_t s = 0; s < tree[n].sons.size(); ++s)
+            depths[tree[n].sons[s]] = depths[n] + 1;
+    }
+}
+
+template <typename ValueType, typename ClusterBasis>
+class ForwardTransformLoopBody
+{
+public:
+    ForwardTransformLoopBody(
+            const std::vector<ClusterBasis>& tree,
+            const std::vector<size_t>& nodes,
+            const arma::Mat<ValueType>& x,
+            std::vector<arma::Mat<ValueType> >& coefficients) :
+        m_tree(tree), m_nodes(nodes), m_x(x), m_coefficients(coefficients)
+    {
+    }
+
+    void operator() (const tbb::blocked_range<size_t>& r) const {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const size_t n = m_nodes[i];
+            const ClusterBasis& node = m_tree[n];
+            const arma::Mat<ValueType>& matrix = node.matrix;
+            arma::Mat<ValueType>& result = m_coefficients[n];
+            result.zeros(matrix.n_cols, m_x.n_cols);
+            if (matrix.n_cols == 0)
+                continue;
+            if (!node.nested) {
+                result = matrix.t() * m_x.rows(node.begin,
+                                               node.begin + node.size - 1);
+                continue;
+            }
+            unsigned int offset = 0;
+            for (size_t s = 0; s < node.sons.size(); ++s) {
+                const arma::Mat<ValueType>& sonCoefficients =
+                        m_coefficients[node.sons[s]];
+                if (sonCoefficients.n_rows > 0)
+                    result += matrix.rows(
+                                offset,
+                                offset + sonCoefficients.n_rows - 1).t() *
+                            sonCoefficients;
+                offset += sonCoefficients.n_rows;
+            }
+        }
+    }
+
+private:
+    const std::vector<ClusterBasis>& m_tree;
+    const std::vector<size_t>& m_nodes;
+    const arma::Mat<ValueType>& m_x;
+    std::vector<arma::Mat<ValueType> >& m_coefficients;
+};
+
+template <typename ValueType, typename ClusterBasis>
+class BackwardTransformLoopBody
+{
+public:
+    BackwardTransformLoopBody(
+            const std::vector<ClusterBasis>& tree,
+            const std::vector<size_t>& nodes,
+            std::vector<arma::Mat<ValueType> >& coefficients,
+            arma::Mat<ValueType>& y) :
+        m_tree(tree), m_nodes(nodes), m_coefficients(coefficients), m_y(y)
+    {
+    }
+
+    // The nodes of a level are disjoint and each node has a single parent,
+    // so no two nodes write to the same rows of y or to the same son
+    void operator() (const tbb::blocked_range<size_t>& r) const {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const size_t n = m_nodes[i];
+            const ClusterBasis& node = m_tree[n];
+            const arma::Mat<ValueType>& matrix = node.matrix;
+            const arma::Mat<ValueType>& nodeCoefficients = m_coefficients[n];
+            if (matrix.n_cols == 0)
+                continue;
+            if (!node.nested) {
+                m_y.rows(node.begin, node.begin + node.size - 1) +=
+                        matrix * nodeCoefficients;
+                continue;
+            }
+            unsigned int offset = 0;
+            for (size_t s = 0; s < node.sons.size(); ++s) {
+                arma::Mat<ValueType>& sonCoefficients =
+                        m_coefficients[node.sons[s]];
+                if (sonCoefficients.n_rows > 0)
+                    sonCoefficients += matrix.rows(
+                                offset, offset + sonCoefficients.n_rows - 1) *
+                            nodeCoefficients;
+                offset += sonCoefficients.n_rows;
+            }
+        }
+    }
+
+private:
+    const std::vector<ClusterBasis>& m_tree;
+    const std::vector<size_t>& m_nodes;
+    std::vector<arma::Mat<ValueType> >& m_coefficients;
+    arma::Mat<ValueType>& m_y;
+};
+
+// Multiply the coupling matrices, accumulating the coefficients of each
+// target cluster in a single task
+template <typename ValueType, typename ClusterBasis, typename CouplingBlock>
+class CouplingLoopBody
+{
+public:
+    CouplingLoopBody(
+            bool conjugateTranspose,
+            const std::vector<ClusterBasis>& targetTree,
+            const std::vector<CouplingBlock>& blocks,
+            const std::vector<std::vector<size_t> >& blocksOfTargetClusters,
+            const std::vector<arma::Mat<ValueType> >& sourceCoefficients,
+            size_t columnCount,
+            std::vector<arma::Mat<ValueType> >& targetCoefficients) :
+        m_conjugateTranspose(conjugateTranspose), m_targetTree(targetTree),
+        m_blocks(blocks), m_blocksOfTargetClusters(blocksOfTargetClusters),
+        m_sourceCoefficients(sourceCoefficients),
+        m_columnCount(columnCount), m_targetCoefficients(targetCoefficients)
+    {
+    }
+
+    void operator() (const tbb::blocked_range<size_t>& r) const {
+        for (size_t n = r.begin(); n != r.end(); ++n) {
+            arma::Mat<ValueType>& result = m_targetCoefficients[n];
+            result.zeros(m_targetTree[n].matrix.n_cols, m_columnCount);
+            const std::vector<size_t>& blockIndices =
+                    m_blocksOfTargetClusters[n];
+            for (size_t b = 0; b < blockIndices.size(); ++b) {
+                const CouplingBlock& block = m_blocks[blockIndices[b]];
+                if (m_conjugateTranspose)
+                    result += block.coupling.t() *
+                            m_sourceCoefficients[block.rowCluster];
+                else
+                    result += block.coupling *
+                            m_sourceCoefficients[block.columnCluster];
+            }
+        }
+    }
+
+private:
+    bool m_conjugateTranspose;
+    const std::vector<ClusterBasis>& m_targetTree;
+    const std::vector<CouplingBlock>& m_blocks;
+    const std::vector<std::vector<size_t> >& m_blocksOfTargetClusters;
+    const std::vector<arma::Mat<ValueType> >& m_sourceCoefficients;
+    size_t m_columnCount;
+    std::vector<arma::Mat<ValueType> >& m_targetCoefficients;
+};
+
+// Multiply the dense blocks whose target clusters belong to a single level
+// of the target tree. These clusters are disjoint, so the tasks write to
+// disjoint rows of y.
+template <typename ValueType, typename DenseBlock>
+class NearFieldLoopBody
+{
+public:
+    NearFieldLoopBody(
+            bool conjugateTranspose,
+            const std::vector<size_t>& nodes,
+            const std::vector<DenseBlock>& blocks,
+            const std::vector<std::vector<size_t> >& blocksOfTargetClusters,
+            const arma::Mat<ValueType>& x,
+            arma::Mat<ValueType>& y) :
+        m_conjugateTranspose(conjugateTranspose), m_nodes(nodes),
+        m_blocks(blocks), m_blocksOfTargetClusters(blocksOfTargetClusters),
+        m_x(x), m_y(y)
+    {
+    }
+
+    void operator() (const tbb::blocked_range<size_t>& r) const {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const std::vector<size_t>& blockIndices =
+                    m_blocksOfTargetClusters[m_nodes[i]];
+            for (size_t b = 0; b < blockIndices.size(); ++b) {
+                const DenseBlock& block = m_blocks[blockIndices[b]];
+                const arma::Mat<ValueType>& data = block.data;
+                if (m_conjugateTranspose)
+                    m_y.rows(block.columnBegin,
+                             block.columnBegin + data.n_cols - 1) +=
+                            data.t() * m_x.rows(
+                                block.rowBegin,
+                                block.rowBegin + data.n_rows - 1);
+                else
+                    m_y.rows(block.rowBegin,
+                             block.rowBegin + data.n_rows - 1) +=
+                            data * m_x.rows(
+                                block.columnBegin,
+                                block.columnBegin + data.n_cols - 1);
+            }
+        }
+    }
+
+private:
+    bool m_conjugateTranspose;
+    const std::vector<size_t>& m_nodes;
+    const std::vector<DenseBlock>& m_blocks;
+    const std::vector<std::vector<size_t> >& m_blocksOfTargetClusters;
+    const arma::Mat<ValueType>& m_x;
+    arma::Mat<ValueType>& m_y;
+};
+
+template <typename ClusterBasis>
+size_t clusterBasisMemory(const std::vector<ClusterBasis>& tree,
+                          size_t valueSize)
+{
+    size_t result = 0;
+    for (size_t n = 0; n < tree.size(); ++n)
+        result += tree[n].matrix.n_elem * valueSize;
+    return result;
+}
+
+} // namespace
+
+template <typename ValueType>
+DiscreteH2BoundaryOperator<ValueType>::DiscreteH2BoundaryOperator(
+        const DiscreteAcaBoundaryOperator<ValueType>& acaOp, double eps) :
+#ifdef WITH_TRILINOS
+    m_domainSpace(Thyra::defaultSpmdVectorSpace<ValueType>(
+                      acaOp.columnCount())),
+    m_rangeSpace(Thyra::defaultSpmdVectorSpace<ValueType>(acaOp.rowCount())),
+#else
+    m_rowCount(acaOp.rowCount()), m_columnCount(acaOp.columnCount()),
+#endif
+    m_eps(eps < 0. ? acaOp.eps() : eps),
+    m_domainPermutation(acaOp.domainPermutation()),
+    m_rangePermutation(acaOp.rangePermutation())
+{
+    typedef typename DiscreteAcaBoundaryOperator<ValueType>::AhmedMblock
+            AhmedMblock;
+    typedef typename Fiber::ScalarTraits<ValueType>::RealType CoordinateType;
+
+    if (acaOp.symmetry() & (SYMMETRIC | HERMITIAN))
+        throw std::invalid_argument(
+                "DiscreteH2BoundaryOperator::DiscreteH2BoundaryOperator(): "
+                "H-matrices stored in the symmetric or Hermitian format "
+                "are not supported");
+
+    blcluster* blockCluster = const_cast<blcluster*>(
+                static_cast<const blcluster*>(acaOp.blockCluster().get()));
+    typename DiscreteAcaBoundaryOperator<ValueType>::AhmedMblockArray blocks =
+            acaOp.blocks();
+
+    // Cluster trees
+    std::vector<Range> rowRanges, columnRanges;
+    collectRanges(blockCluster, rowRanges, columnRanges);
+    std::vector<size_t> rowParents, columnParents;
+    std::map<Range, size_t> rowNodes, columnNodes;
+    buildClusterTree(rowRanges, m_rowTree, rowParents, rowNodes);
+    buildClusterTree(columnRanges, m_columnTree, columnParents, columnNodes);
+
+    // Leaves
+    std::vector<FarBlock<ValueType> > farBlocks;
+    AhmedLeafClusterArray leafClusters(blockCluster);
+    for (size_t i = 0; i < leafClusters.size(); ++i) {
+        blcluster* cluster = leafClusters[i];
+        AhmedMblock* block = blocks[cluster->getidx()];
+        const unsigned int n1 = cluster->getn1(), n2 = cluster->getn2();
+        ValueType* data = reinterpret_cast<ValueType*>(block->getdata());
+        if (block->isLrM()) {
+            const unsigned int rank = block->rank();
+            if (rank == 0)
+                continue;
+            FarBlock<ValueType> farBlock;
+            farBlock.rowNode = rowNodes[Range(cluster->getb1(), n1)];
+            farBlock.columnNode = columnNodes[Range(cluster->getb2(), n2)];
+            farBlock.rowBegin = cluster->getb1();
+            farBlock.columnBegin = cluster->getb2();
+            farBlock.U = arma::Mat<ValueType>(data, n1, rank);
+            farBlock.V = arma::Mat<ValueType>(data + n1 * rank, n2, rank);
+            orthogonalWeight(farBlock.V, farBlock.rowWeight);
+            orthogonalWeight(farBlock.U, farBlock.columnWeight);
+            // Scale the weights so that the block's contribution to the
+            // cluster bases does not depend on its magnitude
+            const CoordinateType norm =
+                    arma::norm(farBlock.U * farBlock.rowWeight, "fro");
+            if (norm == 0.)
+                continue;
+            farBlock.rowWeight /= norm;
+            farBlock.columnWeight /= norm;
+            farBlocks.push_back(farBlock);
+        } else {
+            if (block->isLtM() || block->isUtM() ||
+                    block->isSyM() || block->isHeM())
+                throw std::invalid_argument(
+                        "DiscreteH2BoundaryOperator::"
+                        "DiscreteH2BoundaryOperator(): "
+                        "triangular and symmetric mblocks are not supported");
+            DenseBlock denseBlock;
+            denseBlock.rowCluster = rowNodes[Range(cluster->getb1(), n1)];
+            denseBlock.columnCluster =
+                    columnNodes[Range(cluster->getb2(), n2)];
+            denseBlock.rowBegin = cluster->getb1();
+            denseBlock.columnBegin = cluster->getb2();
+            denseBlock.data = arma::Mat<ValueType>(data, n1, n2);
+            m_denseBlocks.push_back(denseBlock);
+        }
+    }
+
+    // Cluster bases. Each weighted block has unit norm, so truncating at
+    // eps / 2 on both sides keeps the relative error of each block within
+    // the order of eps.
+    const double tolerance = 0.5 * m_eps;
+    buildClusterBases(m_rowTree, rowParents, farBlocks,
+                      RowSide<ValueType>(), tolerance);
+    buildClusterBases(m_columnTree, columnParents, farBlocks,
+                      ColumnSide<ValueType>(), tolerance);
+
+    // Coupling matrices
+    for (size_t b = 0; b < farBlocks.size(); ++b) {
+        const FarBlock<ValueType>& farBlock = farBlocks[b];
+        if (farBlock.rowCoefficients.n_rows == 0 ||
+                farBlock.columnCoefficients.n_rows == 0)
+            continue;
+        CouplingBlock couplingBlock;
+        couplingBlock.rowCluster = farBlock.rowNode;
+        couplingBlock.columnCluster = farBlock.columnNode;
+        couplingBlock.coupling = farBlock.rowCoefficients *
+                farBlock.columnCoefficients.t();
+        m_couplingBlocks.push_back(couplingBlock);
+    }
+
+    // Work lists of the matrix-vector product
+    groupNodesByLevel(m_rowTree, m_rowLevels);
+    groupNodesByLevel(m_columnTree, m_columnLevels);
+    m_couplingBlocksOfRowClusters.resize(m_rowTree.size());
+    m_couplingBlocksOfColumnClusters.resize(m_columnTree.size());
+    for (size_t b = 0; b < m_couplingBlocks.size(); ++b) {
+        m_couplingBlocksOfRowClusters[m_couplingBlocks[b].rowCluster]
+                .push_back(b);
+        m_couplingBlocksOfColumnClusters[m_couplingBlocks[b].columnCluster]
+                .push_back(b);
+    }
+    m_denseBlocksOfRowClusters.resize(m_rowTree.size());
+    m_denseBlocksOfColumnClusters.resize(m_columnTree.size());
+    for (size_t b = 0; b < m_denseBlocks.size(); ++b) {
+        m_denseBlocksOfRowClusters[m_denseBlocks[b].rowCluster].push_back(b);
+        m_denseBlocksOfColumnClusters[m_denseBlocks[b].columnCluster]
+                .push_back(b);
+    }
+}
+
+template <typename ValueType>
+arma::Mat<ValueType>
+DiscreteH2BoundaryOperator<ValueType>::
+asMatrix() const
+{
+    arma::Mat<ValueType> identity(columnCount(), columnCount());
+    identity.eye();
+    arma::Mat<ValueType> result(rowCount(), columnCount());
+    applyBuiltInImpl(NO_TRANSPOSE, identity, result,
+                     static_cast<ValueType>(1.), static_cast<ValueType>(0.));
+    return result;
+}
+
+template <typename ValueType>
+unsigned int
+DiscreteH2BoundaryOperator<ValueType>::
+rowCount() const
+{
+#ifdef WITH_TRILINOS
+    return m_rangeSpace->dim();
+#else
+    return m_rowCount;
+#endif
+}
+
+template <typename ValueType>
+unsigned int
+DiscreteH2BoundaryOperator<ValueType>::
+columnCount() const
+{
+#ifdef WITH_TRILINOS
+    return m_domainSpace->dim();
+#else
+    return m_columnCount;
+#endif
+}
+
+template <typename ValueType>
+void
+DiscreteH2BoundaryOperator<ValueType>::
+addBlock(const std::vector<int>& rows,
+         const std::vector<int>& cols,
+         const ValueType alpha,
+         arma::Mat<ValueType>& block) const
+{
+    throw std::runtime_error("DiscreteH2BoundaryOperator::"
+                             "addBlock(): not implemented yet");
+}
+
+template <typename ValueType>
+double
+DiscreteH2BoundaryOperator<ValueType>::eps() const
+{
+    return m_eps;
+}
+
+template <typename ValueType>
+size_t
+DiscreteH2BoundaryOperator<ValueType>::memory() const
+{
+    const size_t valueSize = sizeof(ValueType);
+    size_t result = clusterBasisMemory(m_rowTree, valueSize) +
+            clusterBasisMemory(m_columnTree, valueSize);
+    for (size_t b = 0; b < m_couplingBlocks.size(); ++b)
+        result += m_couplingBlocks[b].coupling.n_elem * valueSize;
+    for (size_t b = 0; b < m_denseBlocks.size(); ++b)
+        result += m_denseBlocks[b].data.n_elem * valueSize;
+    return result;
+}
+
+template <typename ValueType>
+int
+DiscreteH2BoundaryOperator<ValueType>::maximumRank() const
+{
+    int result = 0;
+    for (size_t n = 0; n < m_rowTree.size(); ++n)
+        result = std::max(result, int(m_rowTree[n].matrix.n_cols));
+    for (size_t n = 0; n < m_columnTree.size(); ++n)
+        result = std::max(result, int(m_columnTree[n].matrix.n_cols));
+    return result;
+}
+
+template <typename ValueType>
+size_t
+DiscreteH2BoundaryOperator<ValueType>::admissibleBlockCount() const
+{
+    return m_couplingBlocks.size();
+}
+
+template <typename ValueType>
+size_t
+DiscreteH2BoundaryOperator<ValueType>::denseBlockCount() const
+{
+    return m_denseBlocks.size();
+}
+
+#ifdef WITH_TRILINOS
+template <typename ValueType>
+Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType> >
+DiscreteH2BoundaryOperator<ValueType>::
+domain() const
+{
+    return m_domainSpace;
+}
+
+template <typename ValueType>
+Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType> >
+DiscreteH2BoundaryOperator<ValueType>::
+range() const
+{
+    return m_rangeSpace;
+}
+
+template <typename ValueType>
+bool
+DiscreteH2BoundaryOperator<ValueType>::
+opSupportedImpl(Thyra::EOpTransp M_trans) const
+{
+    return (M_trans == Thyra::NOTRANS || M_trans == Thyra::TRANS ||
+            M_trans == Thyra::CONJTRANS);
+}
+#endif // WITH_TRILINOS
+
+template <typename ValueType>
+void
+DiscreteH2BoundaryOperator<ValueType>::
+applyBuiltInImpl(const TranspositionMode trans,
+                 const arma::Col<ValueType>& x_in,
+                 arma::Col<ValueType>& y_inout,
+                 const ValueType alpha,
+                 const ValueType beta) const
+{
+    applyBuiltInImpl(trans, static_cast<const arma::Mat<ValueType>&>(x_in),
+                     static_cast<arma::Mat<ValueType>&>(y_inout),
+                     alpha, beta);
+}
+
+template <typename ValueType>
+void
+DiscreteH2BoundaryOperator<ValueType>::
+applyBuiltInImpl(const TranspositionMode trans,
+                 const arma::Mat<ValueType>& x_in,
+                 arma::Mat<ValueType>& y_inout,
+                 const ValueType alpha,
+                 const ValueType beta) const
+{
+    if (trans != NO_TRANSPOSE && trans != TRANSPOSE && trans != CONJUGATE_TRANSPOSE)
+        throw std::runtime_error(
+                "DiscreteH2BoundaryOperator::applyBuiltInImpl(): "
+                "transposition modes other than NO_TRANSPOSE, TRANSPOSE and "
+                "CONJUGATE_TRANSPOSE are not supported");
+    bool transposed = (trans & TRANSPOSE);
+
+    if ((!transposed && (columnCount() != x_in.n_rows ||
+                         rowCount() != y_inout.n_rows)) ||
+            (transposed && (rowCount() != x_in.n_rows ||
+                            columnCount() != y_inout.n_rows)) ||
+            x_in.n_cols != y_inout.n_cols)
+        throw std::invalid_argument(
+                "DiscreteH2BoundaryOperator::applyBuiltInImpl(): "
+                "incorrect vector length");
+
+    if (beta == static_cast<ValueType>(0.))
+        y_inout.fill(static_cast<ValueType>(0.));
+    else
+        y_inout *= beta;
+
+    arma::Mat<ValueType> permutedArgument;
+    if (!transposed)
+        m_domainPermutation.permuteRows(x_in, permutedArgument);
+    else
+        m_rangePermutation.permuteRows(x_in, permutedArgument);
+
+    arma::Mat<ValueType> permutedResult;
+    if (!transposed)
+        m_rangePermutation.permuteRows(y_inout, permutedResult);
+    else
+        m_domainPermutation.permuteRows(y_inout, permutedResult);
+
+    // alpha A^T x + beta y = (alpha^* A^H x^* + beta^* y^*)^*
+    if (trans == TRANSPOSE) {
+        permutedArgument = arma::conj(permutedArgument);
+        permutedResult = arma::conj(permutedResult);
+        applyPermuted(true, conj(alpha), permutedArgument, permutedResult);
+        permutedResult = arma::conj(permutedResult);
+    } else
+        applyPermuted(trans == CONJUGATE_TRANSPOSE, alpha,
+                      permutedArgument, permutedResult);
+
+    if (!transposed)
+        m_rangePermutation.unpermuteRows(permutedResult, y_inout);
+    else
+        m_domainPermutation.unpermuteRows(permutedResult, y_inout);
+}
+
+template <typename ValueType>
+void
+DiscreteH2BoundaryOperator<ValueType>::
+applyPermuted(bool conjugateTranspose, const ValueType alpha,
+              const arma::Mat<ValueType>& x, arma::Mat<ValueType>& y) const
+{
+    // Each task multiplies small matrices; a multithreaded BLAS would only
+    // oversubscribe the cores
+    Fiber::SerialBlasRegion region;
+
+    const arma::Mat<ValueType> scaledX = alpha * x;
+    const std::vector<ClusterBasis>& sourceTree =
+            conjugateTranspose ? m_rowTree : m_columnTree;
+    const std::vector<ClusterBasis>& targetTree =
+            conjugateTranspose ? m_columnTree : m_rowTree;
+    const std::vector<std::vector<size_t> >& sourceLevels =
+            conjugateTranspose ? m_rowLevels : m_columnLevels;
+    const std::vector<std::vector<size_t> >& targetLevels =
+            conjugateTranspose ? m_columnLevels : m_rowLevels;
+
+    // Far field
+    std::vector<arma::Mat<ValueType> > sourceCoefficients;
+    forwardTransform(sourceTree, sourceLevels, scaledX, sourceCoefficients);
+    std::vector<arma::Mat<ValueType> > targetCoefficients(targetTree.size());
+    typedef CouplingLoopBody<ValueType, ClusterBasis, CouplingBlock>
+            CouplingBody;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, targetTree.size()),
+                      CouplingBody(conjugateTranspose, targetTree,
+                                   m_couplingBlocks,
+                                   conjugateTranspose ?
+                                       m_couplingBlocksOfColumnClusters :
+                                       m_couplingBlocksOfRowClusters,
+                                   sourceCoefficients, x.n_cols,
+                                   targetCoefficients));
+    backwardTransform(targetTree, targetLevels, targetCoefficients, y);
+
+    // Near field. Dense blocks of clusters on different levels may overlap,
+    // so the levels are processed one after another.
+    typedef NearFieldLoopBody<ValueType, DenseBlock> NearFieldBody;
+    const std::vector<std::vector<size_t> >& denseBlocksOfTargetClusters =
+            conjugateTranspose ? m_denseBlocksOfColumnClusters :
+                                 m_denseBlocksOfRowClusters;
+    for (size_t l = 0; l < targetLevels.size(); ++l)
+        tbb::parallel_for(tbb::blocked_range<size_t>(
+                              0, targetLevels[l].size()),
+                          NearFieldBody(conjugateTranspose, targetLevels[l],
+                                        m_denseBlocks,
+                                        denseBlocksOfTargetClusters,
+                                        scaledX, y));
+}
+
+template <typename ValueType>
+void
+DiscreteH2BoundaryOperator<ValueType>::
+forwardTransform(const std::vector<ClusterBasis>& tree,
+                 const std::vector<std::vector<size_t> >& levels,
+                 const arma::Mat<ValueType>& x,
+                 std::vector<arma::Mat<ValueType> >& coefficients)
+{
+    // Process the levels from the deepest one, since the coefficients of a
+    // nested node are computed from those of its sons
+    typedef ForwardTransformLoopBody<ValueType, ClusterBasis> Body;
+    coefficients.resize(tree.size());
+    for (size_t l = levels.size(); l-- > 0; )
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, levels[l].size()),
+                          Body(tree, levels[l], x, coefficients));
+}
+
+template <typename ValueType>
+void
+DiscreteH2BoundaryOperator<ValueType>::
+backwardTransform(const std::vector<ClusterBasis>& tree,
+                  const std::vector<std::vector<size_t> >& levels,
+                  std::vector<arma::Mat<ValueType> >& coefficients,
+                  arma::Mat<ValueType>& y)
+{
+    // Process the levels from the root, since each nested node passes its
+    // coefficients on to its sons
+    typedef BackwardTransformLoopBody<ValueType, ClusterBasis> Body;
+    for (size_t l = 0; l < levels.size(); ++l)
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, levels[l].size()),
+                          Body(tree, levels[l], coefficients, y));
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(DiscreteH2BoundaryOperator);
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
@@ -0,0 +1,239 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_trilinos.hpp"
+#include "bempp/common/config_ahmed.hpp"
+
+#ifdef WITH_AHMED
+
+#ifndef bempp_discrete_h2_boundary_operator_hpp
+#define bempp_discrete_h2_boundary_operator_hpp
+
+#include "../common/common.hpp"
+
+#include "discrete_boundary_operator.hpp"
+#include "index_permutation.hpp"
+#include "../common/armadillo_fwd.hpp"
+
+#include <vector>
+
+#ifdef WITH_TRILINOS
+#include <Teuchos_RCP.hpp>
+#include <Thyra_SpmdVectorSpaceBase_decl.hpp>
+#endif
+
+namespace Bempp
+{
+
+/** \cond FORWARD_DECL */
+template <typename ValueType> class DiscreteAcaBoundaryOperator;
+/** \endcond */
+
+/** \ingroup discrete_boundary_operators
+ *  \brief Discrete boundary operator stored as an H<sup>2</sup>-matrix.
+ *
+ *  An H<sup>2</sup>-matrix has the same block structure as the H-matrix from
+ *  which it is constructed, but each admissible block \f$b = t \times s\f$ is
+ *  represented as \f$Q_t S_b P_s^H\f$, where \f$Q_t\f$ and \f$P_s\f$ are
+ *  orthonormal bases associated with the row cluster \f$t\f$ and the column
+ *  cluster \f$s\f$, shared by all blocks in the same block row (column), and
+ *  \f$S_b\f$ is a small coupling matrix. The cluster bases are nested: the
+ *  basis of a cluster is expressed through the bases of its sons by a
+ *  transfer matrix. For asymptotically smooth kernels of bounded rank, such
+ *  as those of the Laplace and modified Helmholtz equations, storage and
+ *  matrix-vector products therefore cost \f$O(N)\f$ rather than
+ *  \f$O(N \log N)\f$ operations. Inadmissible blocks are stored as dense
+ *  matrices.
+ *
+ *  The cluster bases are obtained by algebraic recompression of the low-rank
+ *  blocks of an H-matrix produced by ACA: the basis of each row (column)
+ *  cluster is spanned by the dominant left (right) singular vectors of all
+ *  blocks whose row (column) cluster contains it, weighted by the blocks'
+ *  other factors, and truncated with relative accuracy \p eps.
+ *
+ *  Operators of this type are produced in the AssemblyOptions::H2 assembly
+ *  mode. */
+template <typename ValueType>
+class DiscreteH2BoundaryOperator :
+        public DiscreteBoundaryOperator<ValueType>
+{
+public:
+    /** \brief Constructor.
+     *
+     *  Convert the H-matrix \p acaOp into an H<sup>2</sup>-matrix with the
+     *  same block structure.
+     *
+     *  \param[in] acaOp
+     *    Operator to convert. Its H-matrix must not be stored in the
+     *    symmetric or Hermitian format.
+     *  \param[in] eps
+     *    Relative accuracy of the cluster bases. If negative, the accuracy
+     *    used in the assembly of \p acaOp is taken. */
+    explicit DiscreteH2BoundaryOperator(
+            const DiscreteAcaBoundaryOperator<ValueType>& acaOp,
+            double eps = -1.);
+
+    virtual arma::Mat<ValueType> asMatrix() const;
+
+    virtual unsigned int rowCount() const;
+    virtual unsigned int columnCount() const;
+
+    virtual void addBlock(const std::vector<int>& rows,
+                          const std::vector<int>& cols,
+                          const ValueType alpha,
+                          arma::Mat<ValueType>& block) const;
+
+    /** \brief Accuracy of the cluster bases. */
+    double eps() const;
+
+    /** \brief Memory (in bytes) taken by the cluster bases, coupling
+     *  matrices and dense blocks. */
+    size_t memory() const;
+
+    /** \brief Largest rank of the row and column cluster bases. */
+    int maximumRank() const;
+
+    /** \brief Number of admissible blocks represented by coupling
+     *  matrices. */
+    size_t admissibleBlockCount() const;
+
+    /** \brief Number of blocks stored as dense matrices. */
+    size_t denseBlockCount() const;
+
+#ifdef WITH_TRILINOS
+public:
+    virtual Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType> > domain() const;
+    virtual Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType> > range() const;
+
+protected:
+    virtual bool opSupportedImpl(Thyra::EOpTransp M_trans) const;
+#endif
+
+private:
+    virtual void applyBuiltInImpl(const TranspositionMode trans,
+                                  const arma::Col<ValueType>& x_in,
+                                  arma::Col<ValueType>& y_inout,
+                                  const ValueType alpha,
+                                  const ValueType beta) const;
+    virtual void applyBuiltInImpl(const TranspositionMode trans,
+                                  const arma::Mat<ValueType>& x_in,
+                                  arma::Mat<ValueType>& y_inout,
+                                  const ValueType alpha,
+                                  const ValueType beta) const;
+
+public:
+    /** \cond PRIVATE */
+    // Node of a cluster tree with its cluster basis. If the node is nested,
+    // i.e. its sons cover it exactly, matrix is the transfer matrix
+    // expressing the node's basis in terms of the (stacked) bases of its
+    // sons; otherwise it is the explicit basis, with one row per index of
+    // the cluster. Nodes are stored in pre-order, so each node precedes all
+    // its descendants.
+    struct ClusterBasis
+    {
+        unsigned int begin;
+        unsigned int size;
+        std::vector<size_t> sons;
+        bool nested;
+        arma::Mat<ValueType> matrix;
+    };
+
+    // Admissible block represented by the coupling matrix of the bases of
+    // its row and column clusters
+    struct CouplingBlock
+    {
+        size_t rowCluster;
+        size_t columnCluster;
+        arma::Mat<ValueType> coupling;
+    };
+
+    // Block stored as a dense matrix
+    struct DenseBlock
+    {
+        size_t rowCluster;
+        size_t columnCluster;
+        unsigned int rowBegin;
+        unsigned int columnBegin;
+        arma::Mat<ValueType> data;
+    };
+    /** \endcond */
+
+private:
+    /** \cond PRIVATE */
+    // Compute y += alpha * A x (NO_TRANSPOSE) or y += alpha * A^H x
+    // (CONJUGATE_TRANSPOSE) in permuted ordering
+    void applyPermuted(bool conjugateTranspose, const ValueType alpha,
+                       const arma::Mat<ValueType>& x,
+                       arma::Mat<ValueType>& y) const;
+
+    // Forward transformation: coefficients of x in the bases of all
+    // clusters of the given tree, whose nodes are grouped by depth in levels
+    static void forwardTransform(
+            const std::vector<ClusterBasis>& tree,
+            const std::vector<std::vector<size_t> >& levels,
+            const arma::Mat<ValueType>& x,
+            std::vector<arma::Mat<ValueType> >& coefficients);
+
+    // Backward transformation: add the expansions with the given
+    // coefficients of all clusters of the given tree to y. The coefficients
+    // are overwritten.
+    static void backwardTransform(
+            const std::vector<ClusterBasis>& tree,
+            const std::vector<std::vector<size_t> >& levels,
+            std::vector<arma::Mat<ValueType> >& coefficients,
+            arma::Mat<ValueType>& y);
+
+private:
+#ifdef WITH_TRILINOS
+    Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType> > m_domainSpace;
+    Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType> > m_rangeSpace;
+#else
+    unsigned int m_rowCount;
+    unsigned int m_columnCount;
+#endif
+    double m_eps;
+
+    std::vector<ClusterBasis> m_rowTree;
+    std::vector<ClusterBasis> m_columnTree;
+    std::vector<CouplingBlock> m_couplingBlocks;
+    std::vector<DenseBlock> m_denseBlocks;
+
+    // Indices of the nodes of the row and column trees grouped by depth.
+    // Nodes of the same depth are disjoint, so they can be processed in
+    // parallel.
+    std::vector<std::vector<size_t> > m_rowLevels;
+    std::vector<std::vector<size_t> > m_columnLevels;
+    // Indices of the coupling and dense blocks grouped by their row and
+    // column clusters
+    std::vector<std::vector<size_t> > m_couplingBlocksOfRowClusters;
+    std::vector<std::vector<size_t> > m_couplingBlocksOfColumnClusters;
+    std::vector<std::vector<size_t> > m_denseBlocksOfRowClusters;
+    std::vector<std::vector<size_t> > m_denseBlocksOfColumnClusters;
+
+    IndexPermutation m_domainPermutation;
+    IndexPermutation m_rangePermutation;
+    /** \endcond */
+};
+
+} // namespace Bempp
+
+#endif // WITH_AHMED
+
+#endif
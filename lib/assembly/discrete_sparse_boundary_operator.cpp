@@ -37,6 +37,7 @@
 #include <stdexcept>
 
 #include <Epetra_Map.h>
+#include <Epetra_MultiVector.h>
 #include <Epetra_Vector.h>
 #include <Epetra_CrsMatrix.h>
 #include <Epetra_SerialComm.h>
@@ -49,19 +50,21 @@ namespace Bempp
 namespace
 {
 
+// The matrices x_in and y_inout may have several columns; all of them are
+// multiplied in a single pass over the sparse matrix.
 template <typename ValueType>
 void reallyApplyBuiltInImpl(const Epetra_CrsMatrix& mat,
                             const TranspositionMode trans,
-                            const arma::Col<ValueType>& x_in,
-                            arma::Col<ValueType>& y_inout,
+                            const arma::Mat<ValueType>& x_in,
+                            arma::Mat<ValueType>& y_inout,
                             const ValueType alpha,
                             const ValueType beta);
 
 template <>
 void reallyApplyBuiltInImpl<double>(const Epetra_CrsMatrix& mat,
                                     const TranspositionMode trans,
-                                    const arma::Col<double>& x_in,
-                                    arma::Col<double>& y_inout,
+                                    const arma::Mat<double>& x_in,
+                                    arma::Mat<double>& y_inout,
                                     const double alpha,
                                     const double beta)
 {
@@ -72,45 +75,54 @@ void reallyApplyBuiltInImpl<double>(const Epetra_CrsMatrix& mat,
         assert(mat.NumGlobalCols() == static_cast<int>(x_in.n_rows));
         assert(mat.NumGlobalRows() == static_cast<int>(y_inout.n_rows));
     }
+    assert(x_in.n_cols == y_inout.n_cols);
+    if (x_in.n_cols == 0)
+        return;
 
     Epetra_Map map_x((int) x_in.n_rows, 0, Epetra_SerialComm());
     Epetra_Map map_y((int) y_inout.n_rows, 0, Epetra_SerialComm());
 
-    Epetra_Vector vec_x(View, map_x, const_cast<double*>(x_in.memptr()));
+    Epetra_MultiVector vec_x(View, map_x, const_cast<double*>(x_in.memptr()),
+                             (int) x_in.n_rows, (int) x_in.n_cols);
     // vec_temp will store the result of matrix * x_in
-    Epetra_Vector vec_temp(map_y, false /* no need to initialise to zero */);
+    Epetra_MultiVector vec_temp(map_y, (int) y_inout.n_cols,
+                                false /* no need to initialise to zero */);
 
     mat.Multiply(trans == TRANSPOSE || trans == CONJUGATE_TRANSPOSE,
                  vec_x, vec_temp);
 
-    if (beta == 0.)
-        for (size_t i = 0; i < y_inout.n_rows; ++i)
-            y_inout(i) = alpha * vec_temp[i];
-    else
-        for (size_t i = 0; i < y_inout.n_rows; ++i)
-            y_inout(i) = alpha * vec_temp[i] + beta * y_inout(i);
+    for (size_t col = 0; col < y_inout.n_cols; ++col) {
+        const double* temp = vec_temp[col];
+        double* y = y_inout.colptr(col);
+        if (beta == 0.)
+            for (size_t i = 0; i < y_inout.n_rows; ++i)
+                y[i] = alpha * temp[i];
+        else
+            for (size_t i = 0; i < y_inout.n_rows; ++i)
+                y[i] = alpha * temp[i] + beta * y[i];
+    }
 }
 
 template <>
 void reallyApplyBuiltInImpl<float>(const Epetra_CrsMatrix& mat,
                                    const TranspositionMode trans,
-                                   const arma::Col<float>& x_in,
-                                   arma::Col<float>& y_inout,
+                                   const arma::Mat<float>& x_in,
+                                   arma::Mat<float>& y_inout,
                                    const float alpha,
                                    const float beta)
 {
-    // Copy the float vectors to double vectors
-    arma::Col<double> x_in_double(x_in.n_rows);
+    // Copy the float matrices to double matrices
+    arma::Mat<double> x_in_double(x_in.n_rows, x_in.n_cols);
     std::copy(x_in.begin(), x_in.end(), x_in_double.begin());
-    arma::Col<double> y_inout_double(y_inout.n_rows);
+    arma::Mat<double> y_inout_double(y_inout.n_rows, y_inout.n_cols);
     if (beta != 0.f)
         std::copy(y_inout.begin(), y_inout.end(), y_inout_double.begin());
 
-    // Do the operation on the double vectors
+    // Do the operation on the double matrices
     reallyApplyBuiltInImpl<double>(
                 mat, trans, x_in_double, y_inout_double, alpha, beta);
 
-    // Copy the result back to the float vector
+    // Copy the result back to the float matrix
     std::copy(y_inout_double.begin(), y_inout_double.end(), y_inout.begin());
 }
 
@@ -118,8 +130,8 @@ template <>
 void reallyApplyBuiltInImpl<std::complex<float> >(
         const Epetra_CrsMatrix& mat,
         const TranspositionMode trans,
-        const arma::Col<std::complex<float> >& x_in,
-        arma::Col<std::complex<float> >& y_inout,
+        const arma::Mat<std::complex<float> >& x_in,
+        arma::Mat<std::complex<float> >& y_inout,
         const std::complex<float> alpha,
         const std::complex<float> beta)
 {
@@ -131,18 +143,18 @@ void reallyApplyBuiltInImpl<std::complex<float> >(
         y_inout *= beta;
 
     // Separate the real and imaginary components and store them in
-    // double-precision vectors
-    arma::Col<double> x_real(x_in.n_rows);
-    for (size_t i = 0; i < x_in.n_rows; ++i)
+    // double-precision matrices
+    arma::Mat<double> x_real(x_in.n_rows, x_in.n_cols);
+    for (size_t i = 0; i < x_in.n_elem; ++i)
         x_real(i) = x_in(i).real();
-    arma::Col<double> x_imag(x_in.n_rows);
-    for (size_t i = 0; i < x_in.n_rows; ++i)
+    arma::Mat<double> x_imag(x_in.n_rows, x_in.n_cols);
+    for (size_t i = 0; i < x_in.n_elem; ++i)
         x_imag(i) = x_in(i).imag();
-    arma::Col<double> y_real(y_inout.n_rows);
-    for (size_t i = 0; i < y_inout.n_rows; ++i)
+    arma::Mat<double> y_real(y_inout.n_rows, y_inout.n_cols);
+    for (size_t i = 0; i < y_inout.n_elem; ++i)
         y_real(i) = y_inout(i).real();
-    arma::Col<double> y_imag(y_inout.n_rows);
-    for (size_t i = 0; i < y_inout.n_rows; ++i)
+    arma::Mat<double> y_imag(y_inout.n_rows, y_inout.n_cols);
+    for (size_t i = 0; i < y_inout.n_elem; ++i)
         y_imag(i) = y_inout(i).imag();
 
     // Do the "+= alpha A x" part (in steps)
@@ -155,8 +167,8 @@ void reallyApplyBuiltInImpl<std::complex<float> >(
     reallyApplyBuiltInImpl<double>(
                 mat, trans, x_imag, y_imag, alpha.real(), 1.);
 
-    // Copy the result back to the complex vector
-    for (size_t i = 0; i < y_inout.n_rows; ++i)
+    // Copy the result back to the complex matrix
+    for (size_t i = 0; i < y_inout.n_elem; ++i)
         y_inout(i) = std::complex<float>(y_real(i), y_imag(i));
 }
 
@@ -164,8 +176,8 @@ template <>
 void reallyApplyBuiltInImpl<std::complex<double> >(
         const Epetra_CrsMatrix& mat,
         const TranspositionMode trans,
-        const arma::Col<std::complex<double> >& x_in,
-        arma::Col<std::complex<double> >& y_inout,
+        const arma::Mat<std::complex<double> >& x_in,
+        arma::Mat<std::complex<double> >& y_inout,
         const std::complex<double> alpha,
         const std::complex<double> beta)
 {
@@ -177,10 +189,10 @@ void reallyApplyBuiltInImpl<std::complex<double> >(
         y_inout *= beta;
 
     // Separate the real and imaginary components
-    arma::Col<double> x_real(arma::real(x_in));
-    arma::Col<double> x_imag(arma::imag(x_in));
-    arma::Col<double> y_real(arma::real(y_inout));
-    arma::Col<double> y_imag(arma::imag(y_inout));
+    arma::Mat<double> x_real(arma::real(x_in));
+    arma::Mat<double> x_imag(arma::imag(x_in));
+    arma::Mat<double> y_real(arma::real(y_inout));
+    arma::Mat<double> y_imag(arma::imag(y_inout));
 
     // Do the "+= alpha A x" part (in steps)
     reallyApplyBuiltInImpl<double>(
@@ -192,8 +204,8 @@ void reallyApplyBuiltInImpl<std::complex<double> >(
     reallyApplyBuiltInImpl<double>(
                 mat, trans, x_imag, y_imag, alpha.real(), 1.);
 
-    // Copy the result back to the complex vector
-    for (size_t i = 0; i < y_inout.n_rows; ++i)
+    // Copy the result back to the complex matrix
+    for (size_t i = 0; i < y_inout.n_elem; ++i)
         y_inout(i) = std::complex<double>(y_real(i), y_imag(i));
 }
 
@@ -445,6 +457,19 @@ void DiscreteSparseBoundaryOperator<ValueType>::applyBuiltInImpl(
         arma::Col<ValueType>& y_inout,
         const ValueType alpha,
         const ValueType beta) const
+{
+    applyBuiltInImpl(trans, static_cast<const arma::Mat<ValueType>&>(x_in),
+                     static_cast<arma::Mat<ValueType>&>(y_inout),
+                     alpha, beta);
+}
+
+template <typename ValueType>
+void DiscreteSparseBoundaryOperator<ValueType>::applyBuiltInImpl(
+        const TranspositionMode trans,
+        const arma::Mat<ValueType>& x_in,
+        arma::Mat<ValueType>& y_inout,
+        const ValueType alpha,
+        const ValueType beta) const
 {
     TranspositionMode realTrans = trans;
     bool transposed = isTransposed();
@@ -126,6 +126,7 @@ assembleWeakFormInternalImpl2(
         return shared_ptr<DiscreteBoundaryOperator<ResultType> >(
                     assembleWeakFormInDenseMode(assembler, context).release());
     case AssemblyOptions::ACA:
+    case AssemblyOptions::H2:
         return shared_ptr<DiscreteBoundaryOperator<ResultType> >(
                     assembleWeakFormInAcaMode(assembler, context).release());
     default:
@@ -150,7 +151,8 @@ assembleWeakFormInDenseMode(
     const Space<BasisFunctionType>& trialSpace = *this->domain();
 
     return DenseGlobalAssembler<BasisFunctionType, ResultType>::
-            assembleDetachedWeakForm(testSpace, trialSpace, assembler, context);
+            assembleDetachedWeakForm(testSpace, trialSpace, assembler, context,
+                                     this->symmetry());
 }
 
 template <typename BasisFunctionType, typename KernelType, typename ResultType>
@@ -160,12 +162,9 @@ assembleWeakFormInAcaMode(
         LocalAssembler& assembler,
         const Context<BasisFunctionType, ResultType>& context) const
 {
-    const Space<BasisFunctionType>& testSpace = *this->dualToRange();
-    const Space<BasisFunctionType>& trialSpace = *this->domain();
-
     // TODO: replace second assembler with assembler for admissible blocks
     return AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
-                testSpace, trialSpace, assembler, assembler,
+                this->dualToRange(), this->domain(), assembler, assembler,
                 context, this->symmetry() & SYMMETRIC);
 }
 /** \endcond */
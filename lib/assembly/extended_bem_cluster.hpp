@@ -30,6 +30,11 @@
 
 #include <bbxbemcluster.h>
 
+#include <algorithm>
+#include <cmath>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 namespace Bempp
 {
 
@@ -165,6 +170,28 @@ public:
         this->seticom(po_perm[this->geticom()]);
     }
 
+    /** \brief Construct the cluster tree in parallel.
+     *
+     *  This is an alternative to createClusterTree(), which is serial and
+     *  always splits clusters along the longest side of their bounding
+     *  boxes. Here clusters with more than \p bmin DOFs are bisected either
+     *  in the same way (if \p principalComponentSplitting is false) or by a
+     *  plane perpendicular to the principal axis of the reference points of
+     *  their DOFs and passing through their centroid. The two subtrees of
+     *  each sufficiently large cluster are constructed in parallel.
+     *
+     *  The sons are attached to their parents through the protected data
+     *  members of AHMED's cluster class, exactly as in
+     *  cluster::createClusterTree(). */
+    void createClusterTreeInParallel(const unsigned bmin,
+                                     unsigned* op_perm, unsigned* po_perm,
+                                     bool principalComponentSplitting) {
+        createSubtree(bmin, op_perm, principalComponentSplitting);
+        for (unsigned i = this->nbeg; i < this->nend; ++i)
+            po_perm[op_perm[i]] = i;
+        permuteCentroidIndices(po_perm);
+    }
+
     double getcom(unsigned i) const {
         return (this->xminmax[i + 3] + this->xminmax[i]) / 2.;
     }
@@ -243,6 +270,173 @@ public:
             }
     }
 
+private:
+    // Clusters with fewer DOFs have their subtrees constructed serially
+    enum { MIN_PARALLEL_CLUSTER_SIZE = 4096 };
+
+    struct ProjectionIsBelow
+    {
+        ProjectionIsBelow(const T* dofs, const double* direction,
+                          double threshold) :
+            m_dofs(dofs), m_direction(direction), m_threshold(threshold) {
+        }
+
+        bool operator()(unsigned index) const {
+            return projection(m_dofs[index], m_direction) < m_threshold;
+        }
+
+        const T* m_dofs;
+        const double* m_direction;
+        double m_threshold;
+    };
+
+    struct ProjectionIsLess
+    {
+        ProjectionIsLess(const T* dofs, const double* direction) :
+            m_dofs(dofs), m_direction(direction) {
+        }
+
+        bool operator()(unsigned index1, unsigned index2) const {
+            return projection(m_dofs[index1], m_direction) <
+                    projection(m_dofs[index2], m_direction);
+        }
+
+        const T* m_dofs;
+        const double* m_direction;
+    };
+
+    class SubtreeLoopBody
+    {
+    public:
+        SubtreeLoopBody(ExtendedBemCluster& parent, unsigned bmin,
+                        unsigned* op_perm, bool principalComponentSplitting) :
+            m_parent(parent), m_bmin(bmin), m_op_perm(op_perm),
+            m_principalComponentSplitting(principalComponentSplitting) {
+        }
+
+        void operator()(const tbb::blocked_range<unsigned int>& r) const {
+            for (unsigned int i = r.begin(); i < r.end(); ++i)
+                static_cast<ExtendedBemCluster*>(m_parent.getson(i))->
+                        createSubtree(m_bmin, m_op_perm,
+                                      m_principalComponentSplitting);
+        }
+
+    private:
+        ExtendedBemCluster& m_parent;
+        unsigned m_bmin;
+        unsigned* m_op_perm;
+        bool m_principalComponentSplitting;
+    };
+
+    static double projection(const T& dof, const double* direction) {
+        double result = 0.;
+        for (int i = 0; i < Dim; ++i)
+            result += dof.getcenter(i) * direction[i];
+        return result;
+    }
+
+    // Find the principal axis of the reference points of the DOFs of this
+    // cluster (by power iteration, starting from the longest side of the
+    // bounding box, which is the initial value of \p direction) and the
+    // projection of their centroid onto it
+    void getPrincipalAxis(const unsigned* op_perm, double* direction,
+                          double& centroidProjection) const {
+        const unsigned n = this->nend - this->nbeg;
+        double centroid[Dim] = {0., 0., 0.};
+        for (unsigned j = this->nbeg; j < this->nend; ++j)
+            for (int i = 0; i < Dim; ++i)
+                centroid[i] += this->dofs[op_perm[j]].getcenter(i);
+        for (int i = 0; i < Dim; ++i)
+            centroid[i] /= n;
+        double covariance[Dim][Dim] = {{0., 0., 0.}, {0., 0., 0.}, {0., 0., 0.}};
+        for (unsigned j = this->nbeg; j < this->nend; ++j) {
+            const T& dof = this->dofs[op_perm[j]];
+            double d[Dim];
+            for (int i = 0; i < Dim; ++i)
+                d[i] = dof.getcenter(i) - centroid[i];
+            for (int i = 0; i < Dim; ++i)
+                for (int k = 0; k < Dim; ++k)
+                    covariance[i][k] += d[i] * d[k];
+        }
+
+        const int ITERATION_COUNT = 32;
+        for (int iter = 0; iter < ITERATION_COUNT; ++iter) {
+            double v[Dim] = {0., 0., 0.};
+            for (int i = 0; i < Dim; ++i)
+                for (int k = 0; k < Dim; ++k)
+                    v[i] += covariance[i][k] * direction[k];
+            double norm = 0.;
+            for (int i = 0; i < Dim; ++i)
+                norm += v[i] * v[i];
+            norm = std::sqrt(norm);
+            if (norm == 0.)
+                break; // all points coincide; keep the current direction
+            for (int i = 0; i < Dim; ++i)
+                direction[i] = v[i] / norm;
+        }
+        centroidProjection = 0.;
+        for (int i = 0; i < Dim; ++i)
+            centroidProjection += centroid[i] * direction[i];
+    }
+
+    // Reorder op_perm[nbeg...nend) so that the DOFs belonging to the first
+    // son precede those belonging to the second one and return the index of
+    // the first DOF of the second son
+    unsigned split(unsigned* op_perm, bool principalComponentSplitting) const {
+        double direction[Dim] = {0., 0., 0.};
+        direction[this->maindir] = 1.;
+        double threshold = this->cntrdir;
+        if (principalComponentSplitting)
+            getPrincipalAxis(op_perm, direction, threshold);
+        unsigned* begin = op_perm + this->nbeg;
+        unsigned* end = op_perm + this->nend;
+        unsigned* middle = std::partition(
+                    begin, end,
+                    ProjectionIsBelow(this->dofs, direction, threshold));
+        if (middle == begin || middle == end) {
+            // All reference points lie on one side of the splitting plane
+            // (typically because they coincide): bisect the list of DOFs
+            middle = begin + (end - begin) / 2;
+            std::nth_element(begin, middle, end,
+                             ProjectionIsLess(this->dofs, direction));
+        }
+        return middle - op_perm;
+    }
+
+    void createSubtree(const unsigned bmin, unsigned* op_perm,
+                       bool principalComponentSplitting) {
+        if (this->size() <= bmin)
+            return;
+        const unsigned middle = split(op_perm, principalComponentSplitting);
+
+        // The sons (and the array of pointers to them) are deleted by the
+        // destructor of AHMED's cluster class
+        this->sons = new cluster*[2];
+        this->sons[0] = this->sons[1] = 0;
+        this->nsons = 2;
+        this->sons[0] = clone(op_perm, this->nbeg, middle);
+        this->sons[1] = clone(op_perm, middle, this->nend);
+
+        // The sons own disjoint parts of op_perm, so they can be processed
+        // concurrently
+        SubtreeLoopBody body(*this, bmin, op_perm,
+                             principalComponentSplitting);
+        if (this->size() >= MIN_PARALLEL_CLUSTER_SIZE)
+            tbb::parallel_for(tbb::blocked_range<unsigned int>(0, 2, 1), body);
+        else
+            body(tbb::blocked_range<unsigned int>(0, 2, 1));
+        this->nrcl = 1 + this->sons[0]->getncl() + this->sons[1]->getncl();
+    }
+
+    // Replace the original index of the DOF closest to the centroid of each
+    // cluster by its permuted index (cf. createClusterTree())
+    void permuteCentroidIndices(const unsigned* po_perm) {
+        this->seticom(po_perm[this->geticom()]);
+        for (int i = 0; i < this->getns(); ++i)
+            static_cast<ExtendedBemCluster*>(this->getson(i))->
+                    permuteCentroidIndices(po_perm);
+    }
+
 private:
     unsigned int m_maximumBlockSize;
     bool m_strongAdmissibility;
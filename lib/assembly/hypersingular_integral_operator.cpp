@@ -196,6 +196,7 @@ assembleWeakFormInternal(
         return shared_ptr<DiscreteBoundaryOperator<ResultType> >(
                     assembleWeakFormInDenseMode(standardAssembler, context).release());
     case AssemblyOptions::ACA:
+    case AssemblyOptions::H2:
         return shared_ptr<DiscreteBoundaryOperator<ResultType> >(
                     assembleWeakFormInAcaMode(
                         standardAssembler, offDiagonalAssembler, context).release());
@@ -221,7 +222,8 @@ assembleWeakFormInDenseMode(
     const Space<BasisFunctionType>& trialSpace = *this->domain();
 
     return DenseGlobalAssembler<BasisFunctionType, ResultType>::
-            assembleDetachedWeakForm(testSpace, trialSpace, assembler, context);
+            assembleDetachedWeakForm(testSpace, trialSpace, assembler, context,
+                                     this->symmetry());
 }
 
 template <typename BasisFunctionType, typename KernelType, typename ResultType>
@@ -231,11 +233,9 @@ assembleWeakFormInAcaMode(
         LocalAssembler& standardAssembler, LocalAssembler& offDiagonalAssembler,
         const Context<BasisFunctionType, ResultType>& context) const
 {
-    const Space<BasisFunctionType>& testSpace = *this->dualToRange();
-    const Space<BasisFunctionType>& trialSpace = *this->domain();
-
     return AcaGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
-                testSpace, trialSpace, standardAssembler, offDiagonalAssembler,
+                this->dualToRange(), this->domain(),
+                standardAssembler, offDiagonalAssembler,
                 context, this->symmetry() & SYMMETRIC);
 }
 /** \endcond */
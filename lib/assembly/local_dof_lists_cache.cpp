@@ -23,6 +23,8 @@
 #include "../fiber/explicit_instantiation.hpp"
 #include "../space/space.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <map>
 #include <set>
 #include <utility>
@@ -30,22 +32,68 @@
 namespace Bempp
 {
 
+namespace
+{
+
+// Parameters of the sharded LRU cache used when a memory budget is set
+const size_t MAXIMUM_SHARD_COUNT = 16;
+const size_t MINIMUM_SHARD_MEMORY = 1024 * 1024;
+
+template <typename T>
+size_t vectorMemoryUsage(const std::vector<T>& v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+template <typename T>
+size_t nestedVectorMemoryUsage(const std::vector<std::vector<T> >& v)
+{
+    size_t result = vectorMemoryUsage(v);
+    for (size_t i = 0; i < v.size(); ++i)
+        result += vectorMemoryUsage(v[i]);
+    return result;
+}
+
+template <typename BasisFunctionType>
+size_t estimateMemoryUsage(const LocalDofLists<BasisFunctionType>& lists)
+{
+    return sizeof(LocalDofLists<BasisFunctionType>) +
+            vectorMemoryUsage(lists.originalIndices) +
+            vectorMemoryUsage(lists.elementIndices) +
+            nestedVectorMemoryUsage(lists.localDofIndices) +
+            nestedVectorMemoryUsage(lists.localDofWeights) +
+            nestedVectorMemoryUsage(lists.arrayIndices);
+}
+
+} // namespace
+
 template <typename BasisFunctionType>
 LocalDofListsCache<BasisFunctionType>::LocalDofListsCache(
         const Space<BasisFunctionType>& space,
         const std::vector<unsigned int>& p2o,
-        bool indexWithGlobalDofs) :
-    m_space(space), m_p2o(p2o), m_indexWithGlobalDofs(indexWithGlobalDofs)
+        bool indexWithGlobalDofs,
+        size_t maximumMemory) :
+    m_space(space), m_p2o(p2o), m_indexWithGlobalDofs(indexWithGlobalDofs),
+    m_maximumMemory(maximumMemory),
+    m_shardCount(0), m_maximumShardMemory(0)
 {
+    m_memoryUsage = 0;
+    m_peakMemoryUsage = 0;
+    m_hitCount = 0;
+    m_missCount = 0;
+    m_evictionCount = 0;
+    if (m_maximumMemory > 0) {
+        m_shardCount = std::max<size_t>(
+                    1, std::min(MAXIMUM_SHARD_COUNT,
+                                m_maximumMemory / MINIMUM_SHARD_MEMORY));
+        m_maximumShardMemory = m_maximumMemory / m_shardCount;
+        m_shards.reset(new Shard[m_shardCount]);
+    }
 }
 
 template <typename BasisFunctionType>
 LocalDofListsCache<BasisFunctionType>::~LocalDofListsCache()
 {
-    for (typename LocalDofListsMap::const_iterator it = m_map.begin();
-         it != m_map.end(); ++it)
-        delete it->second;
-    m_map.clear();
 }
 
 template <typename BasisFunctionType>
@@ -61,33 +109,196 @@ LocalDofListsCache<BasisFunctionType>::get(int start, int indexCount)
         return result;
     }
 
-    std::pair<int, int> key(start, indexCount);
-    typename LocalDofListsMap::const_iterator it = m_map.find(key);
-    if (it != m_map.end()) {
-        return make_shared_from_ref(*it->second);
+    const Key key(start, indexCount);
+    if (m_maximumMemory == 0)
+        return getFromUnboundedMap(key);
+    else
+        return getFromShard(key);
+}
+
+template <typename BasisFunctionType>
+typename LocalDofListsCache<BasisFunctionType>::ListsPtr
+LocalDofListsCache<BasisFunctionType>::getFromUnboundedMap(const Key& key)
+{
+    typename UnboundedMap::const_iterator it = m_unboundedMap.find(key);
+    if (it != m_unboundedMap.end()) {
+        ++m_hitCount;
+        return it->second;
     }
+    ++m_missCount;
 
     // The relevant local DOF list doesn't exist yet and must be created.
-    LocalDofLists<BasisFunctionType>* newLists = new LocalDofLists<BasisFunctionType>;
-    findLocalDofs(start, indexCount,
+    // Another thread may construct the same list in the meantime; the list
+    // inserted first is kept.
+    size_t memory = 0;
+    ListsPtr newLists = constructLists(key, memory);
+    std::pair<typename UnboundedMap::iterator, bool> result =
+            m_unboundedMap.insert(std::make_pair(key, newLists));
+    if (result.second)
+        addToMemoryUsage(memory);
+    return result.first->second;
+}
+
+template <typename BasisFunctionType>
+typename LocalDofListsCache<BasisFunctionType>::ListsPtr
+LocalDofListsCache<BasisFunctionType>::getFromShard(const Key& key)
+{
+    const size_t hash = size_t(key.first) * 2654435761u + size_t(key.second);
+    Shard& shard = m_shards[hash % m_shardCount];
+    {
+        tbb::mutex::scoped_lock lock(shard.mutex);
+        typename LocalDofListsMap::iterator it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            ++m_hitCount;
+            // Mark the entry as the most recently used one
+            shard.usage.splice(shard.usage.begin(), shard.usage,
+                               it->second.usagePosition);
+            return it->second.lists;
+        }
+    }
+    ++m_missCount;
+
+    // The list is constructed without holding the lock, so another thread
+    // may construct the same list in the meantime
+    size_t memory = 0;
+    ListsPtr newLists = constructLists(key, memory);
+    if (memory > m_maximumShardMemory)
+        // Too large to be cached at all
+        return newLists;
+
+    tbb::mutex::scoped_lock lock(shard.mutex);
+    typename LocalDofListsMap::iterator it = shard.map.find(key);
+    if (it != shard.map.end())
+        // Another thread was faster; use its list
+        return it->second.lists;
+
+    Entry entry;
+    entry.lists = newLists;
+    entry.memory = memory;
+    shard.usage.push_front(key);
+    entry.usagePosition = shard.usage.begin();
+    shard.map.insert(std::make_pair(key, entry));
+    shard.memoryUsage += memory;
+    addToMemoryUsage(memory);
+    while (shard.memoryUsage > m_maximumShardMemory)
+        evictLeastRecentlyUsed(shard);
+    return newLists;
+}
+
+template <typename BasisFunctionType>
+typename LocalDofListsCache<BasisFunctionType>::ListsPtr
+LocalDofListsCache<BasisFunctionType>::constructLists(
+        const Key& key, size_t& memory) const
+{
+    shared_ptr<LocalDofLists<BasisFunctionType> > newLists(
+        new LocalDofLists<BasisFunctionType>);
+    findLocalDofs(key.first, key.second,
                   newLists->originalIndices, newLists->elementIndices,
                   newLists->localDofIndices, newLists->localDofWeights,
                   newLists->arrayIndices);
+    memory = estimateMemoryUsage(*newLists);
+    return newLists;
+}
 
-    // Attempt to insert the newly created DOF list into the map
-    std::pair<typename LocalDofListsMap::iterator, bool> result =
-            m_map.insert(std::make_pair(key, newLists));
-    if (result.second)
-        // Insertion succeeded. The newly created DOF list will be deleted in
-        // our own destructor
-        ;
-    else
-        // Insertion failed -- another thread was faster. Delete the newly
-        // created DOF list.
-        delete newLists;
+template <typename BasisFunctionType>
+void LocalDofListsCache<BasisFunctionType>::evictLeastRecentlyUsed(
+        Shard& shard)
+{
+    // Must be called with the mutex of the shard locked
+    assert(!shard.usage.empty());
+    typename LocalDofListsMap::iterator it = shard.map.find(shard.usage.back());
+    assert(it != shard.map.end());
+    shard.memoryUsage -= it->second.memory;
+    m_memoryUsage -= it->second.memory;
+    shard.map.erase(it);
+    shard.usage.pop_back();
+    ++m_evictionCount;
+}
 
-    // Return pointer to the DOF list that ended up in the map.
-    return make_shared_from_ref(*result.first->second);
+template <typename BasisFunctionType>
+void LocalDofListsCache<BasisFunctionType>::addToMemoryUsage(size_t memory)
+{
+    const size_t usage = (m_memoryUsage += memory);
+    size_t peak = m_peakMemoryUsage;
+    while (usage > peak) {
+        const size_t oldPeak = m_peakMemoryUsage.compare_and_swap(usage, peak);
+        if (oldPeak == peak)
+            break;
+        peak = oldPeak;
+    }
+}
+
+template <typename BasisFunctionType>
+size_t LocalDofListsCache<BasisFunctionType>::maximumMemory() const
+{
+    return m_maximumMemory;
+}
+
+template <typename BasisFunctionType>
+size_t LocalDofListsCache<BasisFunctionType>::memoryUsage() const
+{
+    return m_memoryUsage;
+}
+
+template <typename BasisFunctionType>
+size_t LocalDofListsCache<BasisFunctionType>::peakMemoryUsage() const
+{
+    return m_peakMemoryUsage;
+}
+
+template <typename BasisFunctionType>
+size_t LocalDofListsCache<BasisFunctionType>::size() const
+{
+    if (m_maximumMemory == 0)
+        return m_unboundedMap.size();
+    size_t result = 0;
+    for (size_t i = 0; i < m_shardCount; ++i) {
+        tbb::mutex::scoped_lock lock(m_shards[i].mutex);
+        result += m_shards[i].map.size();
+    }
+    return result;
+}
+
+template <typename BasisFunctionType>
+size_t LocalDofListsCache<BasisFunctionType>::hitCount() const
+{
+    return m_hitCount;
+}
+
+template <typename BasisFunctionType>
+size_t LocalDofListsCache<BasisFunctionType>::missCount() const
+{
+    return m_missCount;
+}
+
+template <typename BasisFunctionType>
+size_t LocalDofListsCache<BasisFunctionType>::evictionCount() const
+{
+    return m_evictionCount;
+}
+
+template <typename BasisFunctionType>
+double LocalDofListsCache<BasisFunctionType>::hitRate() const
+{
+    const size_t hitCount = m_hitCount;
+    const size_t requestCount = hitCount + m_missCount;
+    return requestCount == 0 ? 0. : double(hitCount) / requestCount;
+}
+
+template <typename BasisFunctionType>
+void LocalDofListsCache<BasisFunctionType>::printStatistics(
+        std::ostream& out, const char* name) const
+{
+    const size_t requestCount = m_hitCount + m_missCount;
+    out << name << ": " << size() << " lists, "
+        << memoryUsage() / 1024. / 1024. << " MB (peak "
+        << peakMemoryUsage() / 1024. / 1024. << " MB";
+    if (m_maximumMemory > 0)
+        out << ", budget " << m_maximumMemory / 1024. / 1024. << " MB in "
+            << m_shardCount << (m_shardCount == 1 ? " shard" : " shards");
+    out << "), hit rate " << 100. * hitRate()
+        << "% of " << requestCount << " requests, "
+        << evictionCount() << " evictions.\n";
 }
 
 template <typename BasisFunctionType>
@@ -25,7 +25,13 @@
 #include "../common/shared_ptr.hpp"
 #include "../common/types.hpp"
 
+#include <boost/scoped_array.hpp>
+#include <tbb/atomic.h>
 #include <tbb/concurrent_unordered_map.h>
+#include <tbb/mutex.h>
+#include <list>
+#include <map>
+#include <utility>
 #include <vector>
 #include <iostream>
 
@@ -57,14 +63,39 @@ struct LocalDofLists
 
 /** \ingroup weak_form_assembly_internal
  *
- *  \brief Cache of LocalDofLists objects. */
+ *  \brief Cache of LocalDofLists objects.
+ *
+ *  Without a memory budget, the lists are stored in a
+ *  tbb::concurrent_unordered_map and get() takes no lock.
+ *
+ *  The cache can also be given a memory budget. Once the estimated size of
+ *  the stored LocalDofLists objects exceeds it, the least recently used
+ *  objects are evicted; they remain valid as long as any client holds a
+ *  pointer to them and are rebuilt if requested again. To reduce contention,
+ *  the lists are then distributed among up to 16 shards according to their
+ *  index range. Each shard has its own lock, LRU order and an equal part of
+ *  the budget, but no less than 1 MB, so small budgets use fewer shards.
+ *
+ *  All member functions are thread-safe. */
 template <typename BasisFunctionType>
 class LocalDofListsCache
 {
 public:
+    /** \brief Constructor.
+     *
+     *  \param[in] space
+     *    Space whose DOFs are described by the cached lists.
+     *  \param[in] p2o
+     *    Map of permuted (AHMED) indices to original DOF indices.
+     *  \param[in] indexWithGlobalDofs
+     *    If true, original indices refer to global DOFs, otherwise to flat
+     *    local DOFs.
+     *  \param[in] maximumMemory
+     *    Memory budget (in bytes) of the cache. 0 means no limit. */
     LocalDofListsCache(const Space<BasisFunctionType>& space,
                        const std::vector<unsigned int>& p2o,
-                       bool indexWithGlobalDofs);
+                       bool indexWithGlobalDofs,
+                       size_t maximumMemory = 0);
     ~LocalDofListsCache();
 
     /** \brief Return the LocalDofLists object describing the DOFs corresponding to
@@ -72,6 +103,39 @@ public:
     shared_ptr<const LocalDofLists<BasisFunctionType> > get(
         int start, int indexCount);
 
+    /** \brief Memory budget of the cache in bytes (0 if unlimited). */
+    size_t maximumMemory() const;
+
+    /** \brief Estimated memory (in bytes) taken by the cached lists. */
+    size_t memoryUsage() const;
+
+    /** \brief Largest value of memoryUsage() observed so far. */
+    size_t peakMemoryUsage() const;
+
+    /** \brief Number of cached lists. */
+    size_t size() const;
+
+    /** \brief Number of calls to get() served from the cache.
+     *
+     *  Requests for single indices, which are never cached, are not
+     *  counted. */
+    size_t hitCount() const;
+
+    /** \brief Number of calls to get() that required the construction of a
+     *  new LocalDofLists object. */
+    size_t missCount() const;
+
+    /** \brief Number of lists evicted to keep within the memory budget. */
+    size_t evictionCount() const;
+
+    /** \brief Fraction of the counted calls to get() served from the
+     *  cache. */
+    double hitRate() const;
+
+    /** \brief Print the cache statistics to \p out, starting with the line
+     *  label \p name. */
+    void printStatistics(std::ostream& out, const char* name) const;
+
 private:
     void findLocalDofs(
         int start,
@@ -92,13 +156,52 @@ private:
 
 private:
     /** \cond PRIVATE */
+    typedef std::pair<int, int> Key;
+    typedef shared_ptr<const LocalDofLists<BasisFunctionType> > ListsPtr;
+    typedef tbb::concurrent_unordered_map<Key, ListsPtr> UnboundedMap;
+
+    typedef std::list<Key> UsageList;
+    struct Entry
+    {
+        ListsPtr lists;
+        size_t memory;
+        typename UsageList::iterator usagePosition;
+    };
+    typedef std::map<Key, Entry> LocalDofListsMap;
+    struct Shard
+    {
+        Shard() : memoryUsage(0) {}
+
+        tbb::mutex mutex;
+        LocalDofListsMap map;
+        // Keys of the cached lists, most recently used first
+        UsageList usage;
+        size_t memoryUsage;
+    };
+
+    ListsPtr getFromUnboundedMap(const Key& key);
+    ListsPtr getFromShard(const Key& key);
+    ListsPtr constructLists(const Key& key, size_t& memory) const;
+    void evictLeastRecentlyUsed(Shard& shard);
+    void addToMemoryUsage(size_t memory);
+
     const Space<BasisFunctionType>& m_space;
     const std::vector<unsigned int>& m_p2o;
     bool m_indexWithGlobalDofs;
+    size_t m_maximumMemory;
+
+    // Used if m_maximumMemory == 0
+    UnboundedMap m_unboundedMap;
+    // Used if m_maximumMemory > 0
+    boost::scoped_array<Shard> m_shards;
+    size_t m_shardCount;
+    size_t m_maximumShardMemory;
 
-    typedef tbb::concurrent_unordered_map<std::pair<int, int>,
-        const LocalDofLists<BasisFunctionType>*> LocalDofListsMap;
-    LocalDofListsMap m_map;
+    tbb::atomic<size_t> m_memoryUsage;
+    tbb::atomic<size_t> m_peakMemoryUsage;
+    tbb::atomic<size_t> m_hitCount;
+    tbb::atomic<size_t> m_missCount;
+    tbb::atomic<size_t> m_evictionCount;
     /** \endcond */
 };
 
@@ -36,8 +36,14 @@
 #pragma warning(default:381)
 #endif
 
+#include "../common/complex_aux.hpp"
+#include "../fiber/scalar_traits.hpp"
+
+#include <algorithm>
 #include <boost/scoped_array.hpp>
+#include <complex>
 #include <limits>
+#include <vector>
 
 namespace Bempp
 {
@@ -210,6 +216,581 @@ void apprx_unsym_shooting(
     apprx_unsym_generic(&ACAs<T, MATGEN_T>, MatGen, mbl, bl, eps, rankmax);
 }
 
+/** \cond PRIVATE */
+// Orders (magnitude, index) pairs by decreasing magnitude and increasing index
+template <typename abs_T>
+struct CompareCandidates
+{
+    bool operator()(const std::pair<abs_T, unsigned>& a,
+                    const std::pair<abs_T, unsigned>& b) const {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+};
+
+// Standard-library equivalents of AHMED's scalar types
+template <typename T>
+struct AhmedToStdType
+{
+    typedef T Type;
+};
+
+template <>
+struct AhmedToStdType<scomp>
+{
+    typedef std::complex<float> Type;
+};
+
+template <>
+struct AhmedToStdType<dcomp>
+{
+    typedef std::complex<double> Type;
+};
+/** \endcond */
+
+/** \brief Wrapper of an ACA assembly helper passed to ACAb().
+ *
+ *  It forwards the calls made by AHMED to the helper and stores the number
+ *  of pivots to be evaluated at a time. */
+template <typename MATGEN_T>
+class BatchedMatGen
+{
+public:
+    typedef typename MATGEN_T::AhmedResultType AhmedResultType;
+    typedef typename MATGEN_T::MagnitudeType MagnitudeType;
+
+    BatchedMatGen(MATGEN_T& matGen, unsigned batchSize) :
+        m_matGen(matGen), m_batchSize(std::max(1u, batchSize)) {
+    }
+
+    unsigned batchSize() const {
+        return m_batchSize;
+    }
+
+    void cmpbl(unsigned b1, unsigned n1, unsigned b2, unsigned n2,
+               AhmedResultType* data,
+               const cluster* c1 = 0, const cluster* c2 = 0,
+               bool countAccessedEntries = true) const {
+        m_matGen.cmpbl(b1, n1, b2, n2, data, c1, c2, countAccessedEntries);
+    }
+
+    void cmpblsym(unsigned b1, unsigned n1, AhmedResultType* data,
+                  const cluster* c1 = 0,
+                  bool countAccessedEntries = true) const {
+        m_matGen.cmpblsym(b1, n1, data, c1, countAccessedEntries);
+    }
+
+    void cmprows(unsigned b1, const std::vector<unsigned>& rows,
+                 unsigned b2, unsigned n2, AhmedResultType* data,
+                 const cluster* c1 = 0, const cluster* c2 = 0) const {
+        m_matGen.cmprows(b1, rows, b2, n2, data, c1, c2);
+    }
+
+    void cmpcols(unsigned b1, unsigned n1,
+                 unsigned b2, const std::vector<unsigned>& cols,
+                 AhmedResultType* data,
+                 const cluster* c1 = 0, const cluster* c2 = 0) const {
+        m_matGen.cmpcols(b1, n1, b2, cols, data, c1, c2);
+    }
+
+    MagnitudeType scale(unsigned b1, unsigned n1, unsigned b2, unsigned n2,
+                        const cluster* c1 = 0, const cluster* c2 = 0) const {
+        return m_matGen.scale(b1, n1, b2, n2, c1, c2);
+    }
+
+    MagnitudeType relativeScale(unsigned b1, unsigned n1,
+                                unsigned b2, unsigned n2,
+                                const cluster* c1 = 0,
+                                const cluster* c2 = 0) const {
+        return m_matGen.relativeScale(b1, n1, b2, n2, c1, c2);
+    }
+
+private:
+    MATGEN_T& m_matGen;
+    unsigned m_batchSize;
+};
+
+// Block variant of ACA. Instead of a single row (or column) at a time, it
+// evaluates batches of up to MatGen.batchSize() rows of the remainder in a
+// single call to MatGen.cmprows(), selects pivots in them by Gaussian
+// elimination with complete pivoting, evaluates the corresponding columns in a
+// single call to MatGen.cmpcols() and appends one cross per pivot. The rows of
+// the next batch are those with the largest entries in the last computed
+// column of U. The iteration stops once a cross is small compared with the
+// current approximation.
+//
+// Returns true if the approximation has converged, false otherwise.
+template<class T, class MATGEN_T>
+bool ACAb(MATGEN_T& MatGen, unsigned b1, unsigned n1, unsigned b2, unsigned n2,
+          double eps, unsigned kmax, unsigned i0, unsigned& k, T* &U, T* &V,
+          const cluster* c1, const cluster* c2)
+{
+    typedef typename AhmedToStdType<T>::Type StdT;
+    typedef typename Fiber::ScalarTraits<StdT>::RealType abs_T;
+
+    const unsigned batchSize = std::min(MatGen.batchSize(), n1);
+    const abs_T scale = MatGen.scale(b1, n1, b2, n2, c1, c2);
+    // Entries smaller than this are considered to be zero
+    const abs_T tiny = std::numeric_limits<abs_T>::epsilon() * scale;
+
+    U = new T[(kmax+1)*n1]; // these arrays are expected to be
+    V = new T[(kmax+1)*n2]; // deallocated by the caller
+    StdT* u = reinterpret_cast<StdT*>(U);
+    StdT* v = reinterpret_cast<StdT*>(V);
+    k = 0;
+
+    std::vector<char> rowEvaluated(n1, false);
+    unsigned evaluatedRowCount = 0;
+    abs_T nrms2 = 0.; // squared Frobenius norm of U V^H
+
+    // Initial batch: the row i0 and rows spread evenly over the block
+    std::vector<unsigned> rows;
+    for (unsigned l = 0; l < batchSize; ++l) {
+        const unsigned row = (i0 + (l * n1) / batchSize) % n1;
+        if (!rowEvaluated[row]) {
+            rowEvaluated[row] = true;
+            rows.push_back(row);
+        }
+    }
+
+    std::vector<StdT> R, C, pivotRows;
+    std::vector<unsigned> pivotRowIndices, cols;
+    std::vector<char> rowPivoted;
+    while (!rows.empty()) {
+        evaluatedRowCount += rows.size();
+        const unsigned m = rows.size();
+
+        // Evaluate the rows of the remainder (stored columnwise in R)
+        R.resize(m * n2);
+        MatGen.cmprows(b1, rows, b2, n2,
+                       reinterpret_cast<typename MATGEN_T::AhmedResultType*>(
+                           &R[0]), c1, c2);
+        for (unsigned l = 0; l < k; ++l)
+            for (unsigned j = 0; j < n2; ++j) {
+                const StdT vj = conj(v[l * n2 + j]);
+                for (unsigned r = 0; r < m; ++r)
+                    R[j * m + r] -= u[l * n1 + rows[r]] * vj;
+            }
+
+        // Select pivots by Gaussian elimination with complete pivoting,
+        // saving the eliminated rows (the remainder rows with the crosses
+        // of the preceding pivots subtracted)
+        pivotRowIndices.clear();
+        cols.clear();
+        pivotRows.clear();
+        rowPivoted.assign(m, false);
+        for (unsigned t = 0; t < m; ++t) {
+            abs_T maxAbs = 0.;
+            unsigned pr = m, pc = n2;
+            for (unsigned j = 0; j < n2; ++j)
+                for (unsigned r = 0; r < m; ++r)
+                    if (!rowPivoted[r] && std::abs(R[j * m + r]) > maxAbs) {
+                        maxAbs = std::abs(R[j * m + r]);
+                        pr = r;
+                        pc = j;
+                    }
+            if (maxAbs <= tiny)
+                break; // the remainder vanishes in all remaining rows
+            rowPivoted[pr] = true;
+            pivotRowIndices.push_back(pr);
+            cols.push_back(pc);
+            for (unsigned j = 0; j < n2; ++j)
+                pivotRows.push_back(R[j * m + pr]);
+            const StdT pivot = R[pc * m + pr];
+            for (unsigned r = 0; r < m; ++r)
+                if (!rowPivoted[r]) {
+                    const StdT factor = R[pc * m + r] / pivot;
+                    for (unsigned j = 0; j < n2; ++j)
+                        R[j * m + r] -= factor * R[j * m + pr];
+                }
+        }
+        const unsigned q = cols.size();
+
+        if (q > 0) {
+            // Evaluate the columns of the remainder (stored columnwise in C)
+            C.resize(n1 * q);
+            MatGen.cmpcols(b1, n1, b2, cols,
+                           reinterpret_cast<typename MATGEN_T::AhmedResultType*>(
+                               &C[0]), c1, c2);
+            for (unsigned l = 0; l < k; ++l)
+                for (unsigned t = 0; t < q; ++t) {
+                    const StdT vj = conj(v[l * n2 + cols[t]]);
+                    for (unsigned i = 0; i < n1; ++i)
+                        C[t * n1 + i] -= u[l * n1 + i] * vj;
+                }
+
+            // Append the crosses
+            for (unsigned t = 0; t < q; ++t) {
+                if (k >= kmax)
+                    return false;
+                const StdT* pivotRow = &pivotRows[t * n2];
+                const unsigned i = rows[pivotRowIndices[t]];
+                const StdT pivot = C[t * n1 + i];
+                if (std::abs(pivot) <= tiny)
+                    break; // inconsistent with the elimination; start anew
+                StdT* uk = u + k * n1;
+                StdT* vk = v + k * n2;
+                abs_T unorm2 = 0., vnorm2 = 0.;
+                for (unsigned ii = 0; ii < n1; ++ii) {
+                    uk[ii] = C[t * n1 + ii] / pivot;
+                    unorm2 += realPart(conj(uk[ii]) * uk[ii]);
+                }
+                for (unsigned j = 0; j < n2; ++j) {
+                    vk[j] = conj(pivotRow[j]);
+                    vnorm2 += realPart(conj(vk[j]) * vk[j]);
+                }
+                // Subtract the new cross from the remaining columns
+                for (unsigned s = t + 1; s < q; ++s) {
+                    const StdT vj = pivotRow[cols[s]];
+                    for (unsigned ii = 0; ii < n1; ++ii)
+                        C[s * n1 + ii] -= uk[ii] * vj;
+                }
+
+                // Update the norm of the approximation
+                StdT sum = 0.;
+                for (unsigned l = 0; l < k; ++l) {
+                    StdT uu = 0., vv = 0.;
+                    for (unsigned ii = 0; ii < n1; ++ii)
+                        uu += conj(u[l * n1 + ii]) * uk[ii];
+                    for (unsigned j = 0; j < n2; ++j)
+                        vv += conj(vk[j]) * v[l * n2 + j];
+                    sum += uu * vv;
+                }
+                const abs_T nrmlsk2 = unorm2 * vnorm2;
+                nrms2 += 2. * realPart(sum) + nrmlsk2;
+                ++k;
+                if (nrmlsk2 < eps * eps * nrms2)
+                    return true;
+            }
+        }
+
+        if (q == 0 && k > 0)
+            // The remainder vanishes in all rows of this batch
+            return true;
+        if (evaluatedRowCount == n1)
+            // All rows of the block have been reproduced exactly
+            return true;
+
+        // Select the rows of the next batch
+        std::vector<std::pair<abs_T, unsigned> > candidates;
+        for (unsigned i = 0; i < n1; ++i)
+            if (!rowEvaluated[i])
+                candidates.push_back(std::make_pair(
+                                         k > 0 ? std::abs(u[(k - 1) * n1 + i]) :
+                                                 abs_T(0.), i));
+        const unsigned nextBatchSize =
+                std::min<size_t>(batchSize, candidates.size());
+        std::partial_sort(candidates.begin(),
+                          candidates.begin() + nextBatchSize,
+                          candidates.end(),
+                          CompareCandidates<abs_T>());
+        rows.clear();
+        for (unsigned r = 0; r < nextBatchSize; ++r) {
+            rows.push_back(candidates[r].second);
+            rowEvaluated[candidates[r].second] = true;
+        }
+    }
+    return true;
+}
+
+template<class T,class T1,class T2, class MATGEN_T>
+void apprx_unsym_block(
+        MATGEN_T& MatGen, mblock<T>* &mbl, bbxbemblcluster<T1,T2>* bl,
+        double eps, unsigned rankmax, unsigned batchSize)
+{
+    BatchedMatGen<MATGEN_T> batchedMatGen(MatGen, batchSize);
+    apprx_unsym_generic(&ACAb<T, BatchedMatGen<MATGEN_T> >,
+                        batchedMatGen, mbl, bl, eps, rankmax);
+}
+
+/** \cond PRIVATE */
+// Linear congruential generator used to choose reference and sample indices
+// reproducibly (and without touching the global state of std::rand()).
+class AcaRandomGenerator
+{
+public:
+    explicit AcaRandomGenerator(unsigned long seed) :
+        m_state(seed % 2147483647UL) {
+        if (m_state == 0)
+            m_state = 1;
+    }
+
+    // Return a pseudorandom number from [0, n)
+    unsigned operator()(unsigned n) {
+        m_state = (16807UL * m_state) % 2147483647UL;
+        return static_cast<unsigned>(m_state % n);
+    }
+
+private:
+    unsigned long m_state;
+};
+
+// Evaluate row i of the remainder A - U V^H of a block
+template <class StdT, class MATGEN_T>
+void evaluateRemainderRow(MATGEN_T& MatGen, unsigned b1, unsigned n1,
+                          unsigned b2, unsigned n2, unsigned i,
+                          unsigned k, const StdT* u, const StdT* v,
+                          const cluster* c1, const cluster* c2,
+                          std::vector<StdT>& row)
+{
+    row.resize(n2);
+    MatGen.cmpbl(b1 + i, 1, b2, n2,
+                 reinterpret_cast<typename MATGEN_T::AhmedResultType*>(&row[0]),
+                 c1, c2);
+    for (unsigned l = 0; l < k; ++l) {
+        const StdT ul = u[l * n1 + i];
+        for (unsigned j = 0; j < n2; ++j)
+            row[j] -= ul * conj(v[l * n2 + j]);
+    }
+}
+
+// Evaluate column j of the remainder A - U V^H of a block
+template <class StdT, class MATGEN_T>
+void evaluateRemainderColumn(MATGEN_T& MatGen, unsigned b1, unsigned n1,
+                             unsigned b2, unsigned n2, unsigned j,
+                             unsigned k, const StdT* u, const StdT* v,
+                             const cluster* c1, const cluster* c2,
+                             std::vector<StdT>& col)
+{
+    col.resize(n1);
+    MatGen.cmpbl(b1, n1, b2 + j, 1,
+                 reinterpret_cast<typename MATGEN_T::AhmedResultType*>(&col[0]),
+                 c1, c2);
+    for (unsigned l = 0; l < k; ++l) {
+        const StdT vl = conj(v[l * n2 + j]);
+        for (unsigned i = 0; i < n1; ++i)
+            col[i] -= u[l * n1 + i] * vl;
+    }
+}
+
+// Return the index of the entry of largest magnitude among those not marked
+// as used, or x.size() if all are used
+template <class StdT>
+unsigned argmaxOfUnused(const std::vector<StdT>& x,
+                        const std::vector<char>& used)
+{
+    unsigned result = x.size();
+    typename Fiber::ScalarTraits<StdT>::RealType maxAbs = -1.;
+    for (unsigned i = 0; i < x.size(); ++i)
+        if (!used[i] && std::abs(x[i]) > maxAbs) {
+            maxAbs = std::abs(x[i]);
+            result = i;
+        }
+    return result;
+}
+
+// Return the index of a pseudorandomly chosen entry not marked as used, or
+// used.size() if all are used
+inline unsigned randomUnused(AcaRandomGenerator& random,
+                             const std::vector<char>& used,
+                             unsigned usedCount)
+{
+    const unsigned n = used.size();
+    if (usedCount >= n)
+        return n;
+    unsigned skip = random(n - usedCount);
+    for (unsigned i = 0; i < n; ++i)
+        if (!used[i] && skip-- == 0)
+            return i;
+    return n;
+}
+/** \endcond */
+
+// ACA+ (Grasedyck, Computing 74 (2005) 205-223) with a stochastic error
+// estimator.
+//
+// Pivots are not searched for in the last computed row or column, as in the
+// standard ACA, but in a reference row and a reference column of the
+// remainder, which are updated after each step and replaced by pseudorandom
+// ones once they are used as pivots or vanish. This prevents the algorithm
+// from stalling on blocks with zero or nearly zero rows and columns (e.g.
+// blocks of double-layer operators on flat surface patches), which would
+// otherwise end up stored as dense matrices.
+//
+// When the usual heuristic stopping criterion is met, the Frobenius norm of
+// the remainder is estimated from a few pseudorandomly chosen columns. If the
+// estimate exceeds the tolerance, the worst of these columns becomes the next
+// pivot column and the iteration continues.
+//
+// Returns true if the approximation has converged, false otherwise.
+template<class T, class MATGEN_T>
+bool ACAp(MATGEN_T& MatGen, unsigned b1, unsigned n1, unsigned b2, unsigned n2,
+          double eps, unsigned kmax, unsigned i0, unsigned& k, T* &U, T* &V,
+          const cluster* c1, const cluster* c2)
+{
+    typedef typename AhmedToStdType<T>::Type StdT;
+    typedef typename Fiber::ScalarTraits<StdT>::RealType abs_T;
+
+    // Number of columns used by the error estimator
+    const unsigned SAMPLE_COUNT = 8;
+
+    const abs_T scale = MatGen.scale(b1, n1, b2, n2, c1, c2);
+    // Entries smaller than this are considered to be zero
+    const abs_T tiny = std::numeric_limits<abs_T>::epsilon() * scale;
+
+    U = new T[(kmax+1)*n1]; // these arrays are expected to be
+    V = new T[(kmax+1)*n2]; // deallocated by the caller
+    StdT* u = reinterpret_cast<StdT*>(U);
+    StdT* v = reinterpret_cast<StdT*>(V);
+    k = 0;
+
+    AcaRandomGenerator random(1000003UL * b1 + b2 + 1);
+    std::vector<char> rowUsed(n1, false), colUsed(n2, false);
+    unsigned usedRowCount = 0, usedColCount = 0;
+    abs_T nrms2 = 0.; // squared Frobenius norm of U V^H
+
+    std::vector<StdT> refRow, refCol, row, col, sample;
+    unsigned iRef = i0 % n1;
+    unsigned jRef = random(n2);
+    evaluateRemainderRow(MatGen, b1, n1, b2, n2, iRef, k, u, v, c1, c2, refRow);
+    evaluateRemainderColumn(MatGen, b1, n1, b2, n2, jRef, k, u, v, c1, c2,
+                            refCol);
+
+    // Pivot column proposed by the error estimator (n2 if none)
+    unsigned proposedCol = n2;
+    while (usedRowCount < n1 && usedColCount < n2) {
+        unsigned i = n1, j = n2;
+        if (proposedCol < n2) {
+            j = proposedCol;
+            proposedCol = n2;
+            col.swap(sample);
+            i = argmaxOfUnused(col, rowUsed);
+            if (i < n1)
+                evaluateRemainderRow(MatGen, b1, n1, b2, n2, i, k, u, v,
+                                     c1, c2, row);
+        } else {
+            const unsigned iMax = argmaxOfUnused(refCol, rowUsed);
+            const unsigned jMax = argmaxOfUnused(refRow, colUsed);
+            const abs_T refColMax = iMax < n1 ? std::abs(refCol[iMax]) : 0.;
+            const abs_T refRowMax = jMax < n2 ? std::abs(refRow[jMax]) : 0.;
+            if (refColMax > tiny && refColMax >= refRowMax) {
+                i = iMax;
+                evaluateRemainderRow(MatGen, b1, n1, b2, n2, i, k, u, v,
+                                     c1, c2, row);
+                j = argmaxOfUnused(row, colUsed);
+                evaluateRemainderColumn(MatGen, b1, n1, b2, n2, j, k, u, v,
+                                        c1, c2, col);
+            } else if (refRowMax > tiny) {
+                j = jMax;
+                evaluateRemainderColumn(MatGen, b1, n1, b2, n2, j, k, u, v,
+                                        c1, c2, col);
+                i = argmaxOfUnused(col, rowUsed);
+                evaluateRemainderRow(MatGen, b1, n1, b2, n2, i, k, u, v,
+                                     c1, c2, row);
+            }
+        }
+
+        bool converged = false;
+        if (i == n1 || j == n2 || std::abs(row[j]) <= tiny) {
+            // The pivot candidates vanish; check whether the rest of the
+            // remainder does too
+            if (i < n1) {
+                rowUsed[i] = true;
+                ++usedRowCount;
+            }
+            if (j < n2) {
+                colUsed[j] = true;
+                ++usedColCount;
+            }
+            converged = true;
+        } else {
+            if (k >= kmax)
+                return false;
+            // Append the cross u_k v_k^H
+            const StdT pivot = row[j];
+            StdT* uk = u + k * n1;
+            StdT* vk = v + k * n2;
+            abs_T unorm2 = 0., vnorm2 = 0.;
+            for (unsigned ii = 0; ii < n1; ++ii) {
+                uk[ii] = col[ii] / pivot;
+                unorm2 += realPart(conj(uk[ii]) * uk[ii]);
+            }
+            for (unsigned jj = 0; jj < n2; ++jj) {
+                vk[jj] = conj(row[jj]);
+                vnorm2 += realPart(conj(vk[jj]) * vk[jj]);
+            }
+            StdT sum = 0.;
+            for (unsigned l = 0; l < k; ++l) {
+                StdT uu = 0., vv = 0.;
+                for (unsigned ii = 0; ii < n1; ++ii)
+                    uu += conj(u[l * n1 + ii]) * uk[ii];
+                for (unsigned jj = 0; jj < n2; ++jj)
+                    vv += conj(vk[jj]) * v[l * n2 + jj];
+                sum += uu * vv;
+            }
+            const abs_T nrmlsk2 = unorm2 * vnorm2;
+            nrms2 += 2. * realPart(sum) + nrmlsk2;
+            ++k;
+            rowUsed[i] = true;
+            colUsed[j] = true;
+            ++usedRowCount;
+            ++usedColCount;
+            converged = nrmlsk2 < eps * eps * nrms2;
+
+            // Update the reference row and column, replacing them if they
+            // have been used as pivots
+            for (unsigned jj = 0; jj < n2; ++jj)
+                refRow[jj] -= uk[iRef] * conj(vk[jj]);
+            for (unsigned ii = 0; ii < n1; ++ii)
+                refCol[ii] -= uk[ii] * conj(vk[jRef]);
+        }
+        if (usedRowCount >= n1 || usedColCount >= n2)
+            return true; // the block is reproduced exactly
+        if (rowUsed[iRef] ||
+                std::abs(refRow[argmaxOfUnused(refRow, colUsed)]) <= tiny) {
+            iRef = randomUnused(random, rowUsed, usedRowCount);
+            evaluateRemainderRow(MatGen, b1, n1, b2, n2, iRef, k, u, v,
+                                 c1, c2, refRow);
+        }
+        if (colUsed[jRef] ||
+                std::abs(refCol[argmaxOfUnused(refCol, rowUsed)]) <= tiny) {
+            jRef = randomUnused(random, colUsed, usedColCount);
+            evaluateRemainderColumn(MatGen, b1, n1, b2, n2, jRef, k, u, v,
+                                    c1, c2, refCol);
+        }
+        if (!converged)
+            continue;
+
+        // Stochastic error estimate: ||R||_F^2 is approximated by the mean
+        // squared norm of a few unused columns of the remainder R times the
+        // number of unused columns (used columns of R vanish)
+        const unsigned sampleCount =
+                std::min(SAMPLE_COUNT, n2 - usedColCount);
+        std::vector<char> sampled(colUsed);
+        abs_T sampleNorm2Sum = 0., worstNorm2 = -1.;
+        for (unsigned s = 0; s < sampleCount; ++s) {
+            const unsigned jj =
+                    randomUnused(random, sampled, usedColCount + s);
+            sampled[jj] = true;
+            evaluateRemainderColumn(MatGen, b1, n1, b2, n2, jj, k, u, v,
+                                    c1, c2, col);
+            abs_T norm2 = 0.;
+            for (unsigned ii = 0; ii < n1; ++ii)
+                norm2 += realPart(conj(col[ii]) * col[ii]);
+            sampleNorm2Sum += norm2;
+            if (norm2 > worstNorm2) {
+                worstNorm2 = norm2;
+                proposedCol = jj;
+                sample.swap(col);
+            }
+        }
+        const abs_T estimatedError2 =
+                sampleNorm2Sum * (n2 - usedColCount) / sampleCount;
+        if (estimatedError2 <= eps * eps * nrms2 ||
+                worstNorm2 <= tiny * tiny * n1)
+            return true;
+        // Otherwise continue with the worst sampled column as the pivot
+    }
+    return true;
+}
+
+template<class T,class T1,class T2, class MATGEN_T>
+void apprx_unsym_plus(
+        MATGEN_T& MatGen, mblock<T>* &mbl, bbxbemblcluster<T1,T2>* bl,
+        double eps, unsigned rankmax)
+{
+    apprx_unsym_generic(&ACAp<T, MATGEN_T>, MatGen, mbl, bl, eps, rankmax);
+}
+
 } // namespace Bempp
 
 #endif // WITH_AHMED
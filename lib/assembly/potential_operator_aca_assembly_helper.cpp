@@ -67,7 +67,8 @@ PotentialOperatorAcaAssemblyHelper(
     m_options(options),
     m_indexWithGlobalDofs(m_options.acaOptions().mode != AcaOptions::HYBRID_ASSEMBLY),
     m_trialDofListsCache(new LocalDofListsCache<BasisFunctionType>(
-                            m_trialSpace, m_p2oTrialDofs, m_indexWithGlobalDofs))
+                            m_trialSpace, m_p2oTrialDofs, m_indexWithGlobalDofs,
+                            m_options.acaOptions().maximumDofListsCacheMemory))
 {
     if (assemblers.empty())
         throw std::invalid_argument(
@@ -99,6 +100,35 @@ PotentialOperatorAcaAssemblyHelper(
     resetAccessedEntryCount();
 }
 
+template <typename BasisFunctionType, typename ResultType>
+void PotentialOperatorAcaAssemblyHelper<BasisFunctionType, ResultType>::cmprows(
+        unsigned b1, const std::vector<unsigned>& rows,
+        unsigned b2, unsigned n2, AhmedResultType* ahmedData,
+        const cluster* c1, const cluster* c2, bool countAccessedEntries) const
+{
+    const size_t n1 = rows.size();
+    arma::Mat<ResultType> row(1, n2);
+    for (size_t i = 0; i < n1; ++i) {
+        cmpbl(b1 + rows[i], 1, b2, n2, ahmedCast(row.memptr()), c1, c2,
+              countAccessedEntries);
+        for (size_t col = 0; col < n2; ++col)
+            ahmedData[i + col * n1] = ahmedCast(row(0, col));
+    }
+}
+
+template <typename BasisFunctionType, typename ResultType>
+void PotentialOperatorAcaAssemblyHelper<BasisFunctionType, ResultType>::cmpcols(
+        unsigned b1, unsigned n1,
+        unsigned b2, const std::vector<unsigned>& cols,
+        AhmedResultType* ahmedData,
+        const cluster* c1, const cluster* c2, bool countAccessedEntries) const
+{
+    // Columns are stored contiguously, so they can be evaluated in place
+    for (size_t j = 0; j < cols.size(); ++j)
+        cmpbl(b1, n1, b2 + cols[j], 1, ahmedData + j * n1, c1, c2,
+              countAccessedEntries);
+}
+
 template <typename BasisFunctionType, typename ResultType>
 typename PotentialOperatorAcaAssemblyHelper<BasisFunctionType, ResultType>::MagnitudeType
 PotentialOperatorAcaAssemblyHelper<BasisFunctionType, ResultType>::estimateMinimumDistance(
@@ -391,6 +421,14 @@ resetAccessedEntryCount()
     m_accessedEntryCount = 0;
 }
 
+template <typename BasisFunctionType, typename ResultType>
+void
+PotentialOperatorAcaAssemblyHelper<BasisFunctionType, ResultType>::
+printDofListsCacheStatistics(std::ostream& out) const
+{
+    m_trialDofListsCache->printStatistics(out, "Trial DOF lists cache");
+}
+
 // Explicit instantiations
 
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS_AND_RESULT(PotentialOperatorAcaAssemblyHelper);
@@ -30,6 +30,7 @@
 #include "../fiber/scalar_traits.hpp"
 
 #include <tbb/atomic.h>
+#include <iosfwd>
 #include <vector>
 
 /** \cond FORWARD_DECL */
@@ -95,6 +96,29 @@ public:
                   const cluster* c1 = 0,
                   bool countAccessedEntries = true) const;
 
+    /** \brief Evaluate selected rows of a block.
+     *
+     *  Store the entries of the rows with indices <tt>b1 + rows[i]</tt> and
+     *  columns \p b2, ..., <tt>b2 + n2 - 1</tt> (in permuted ordering)
+     *  columnwise in \p data. The rows are evaluated one by one with
+     *  cmpbl(). */
+    void cmprows(unsigned b1, const std::vector<unsigned>& rows,
+                 unsigned b2, unsigned n2, AhmedResultType* data,
+                 const cluster* c1 = 0, const cluster* c2 = 0,
+                 bool countAccessedEntries = true) const;
+
+    /** \brief Evaluate selected columns of a block.
+     *
+     *  Store the entries of the rows \p b1, ..., <tt>b1 + n1 - 1</tt> and
+     *  columns with indices <tt>b2 + cols[j]</tt> (in permuted ordering)
+     *  columnwise in \p data. The columns are evaluated one by one with
+     *  cmpbl(). */
+    void cmpcols(unsigned b1, unsigned n1,
+                 unsigned b2, const std::vector<unsigned>& cols,
+                 AhmedResultType* data,
+                 const cluster* c1 = 0, const cluster* c2 = 0,
+                 bool countAccessedEntries = true) const;
+
     /** \brief Expected size of the entries in this block. */
     MagnitudeType scale(unsigned b1, unsigned n1, unsigned b2, unsigned n2,
                         const cluster* c1 = 0, const cluster* c2 = 0) const;
@@ -112,6 +136,10 @@ public:
      *  accessed so far. */
     void resetAccessedEntryCount();
 
+    /** \brief Print the statistics of the caches of local DOF lists used by
+     *  this object, including their hit rates, to \p out. */
+    void printDofListsCacheStatistics(std::ostream& out) const;
+
 private:
     MagnitudeType estimateMinimumDistance(
             const cluster* c1, const cluster* c2) const;
@@ -49,6 +49,50 @@
 namespace Bempp
 {
 
+namespace
+{
+
+// Combine the DOF lists corresponding to the AHMED matrix indices
+// start + offsets[i], i = 0, 1, ..., into a single LocalDofLists object
+// whose array indices are the positions i in the vector offsets. Each element
+// is listed only once, even if it is shared by several DOFs.
+template <typename BasisFunctionType>
+void gatherLocalDofLists(LocalDofListsCache<BasisFunctionType>& cache,
+                         unsigned start, const std::vector<unsigned>& offsets,
+                         LocalDofLists<BasisFunctionType>& result)
+{
+    boost::unordered_map<int, size_t> elementPositions;
+    result.originalIndices.resize(offsets.size());
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        shared_ptr<const LocalDofLists<BasisFunctionType> > dofLists =
+                cache.get(start + offsets[i], 1);
+        result.originalIndices[i] = dofLists->originalIndices[0];
+        for (size_t e = 0; e < dofLists->elementIndices.size(); ++e) {
+            const int element = dofLists->elementIndices[e];
+            std::pair<boost::unordered_map<int, size_t>::iterator, bool>
+                    insertion = elementPositions.insert(
+                        std::make_pair(element, result.elementIndices.size()));
+            if (insertion.second) {
+                result.elementIndices.push_back(element);
+                result.localDofIndices.push_back(std::vector<LocalDofIndex>());
+                result.localDofWeights.push_back(
+                            std::vector<BasisFunctionType>());
+                result.arrayIndices.push_back(std::vector<int>());
+            }
+            const size_t position = insertion.first->second;
+            for (size_t d = 0; d < dofLists->localDofIndices[e].size(); ++d) {
+                result.localDofIndices[position].push_back(
+                            dofLists->localDofIndices[e][d]);
+                result.localDofWeights[position].push_back(
+                            dofLists->localDofWeights[e][d]);
+                result.arrayIndices[position].push_back(i);
+            }
+        }
+    }
+}
+
+} // namespace
+
 template <typename BasisFunctionType, typename ResultType>
 WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::WeakFormAcaAssemblyHelper(
         const Space<BasisFunctionType>& testSpace,
@@ -59,7 +103,11 @@ WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::WeakFormAcaAssemblyHel
         const std::vector<const DiscreteLinOp*>& sparseTermsToAdd,
         const std::vector<ResultType>& denseTermsMultipliers,
         const std::vector<ResultType>& sparseTermsMultipliers,
-        const AssemblyOptions& options) :
+        const AssemblyOptions& options,
+        const shared_ptr<LocalDofListsCache<BasisFunctionType> >&
+        testDofListsCache,
+        const shared_ptr<LocalDofListsCache<BasisFunctionType> >&
+        trialDofListsCache) :
     m_testSpace(testSpace), m_trialSpace(trialSpace),
     m_p2oTestDofs(p2oTestDofs), m_p2oTrialDofs(p2oTrialDofs),
     m_assemblers(assemblers), m_sparseTermsToAdd(sparseTermsToAdd),
@@ -67,10 +115,16 @@ WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::WeakFormAcaAssemblyHel
     m_sparseTermsMultipliers(sparseTermsMultipliers),
     m_options(options),
     m_indexWithGlobalDofs(m_options.acaOptions().mode != AcaOptions::HYBRID_ASSEMBLY),
-    m_testDofListsCache(new LocalDofListsCache<BasisFunctionType>(
-                            m_testSpace, m_p2oTestDofs, m_indexWithGlobalDofs)),
-    m_trialDofListsCache(new LocalDofListsCache<BasisFunctionType>(
-                            m_trialSpace, m_p2oTrialDofs, m_indexWithGlobalDofs))
+    m_testDofListsCache(testDofListsCache ?
+                            testDofListsCache :
+                            boost::make_shared<LocalDofListsCache<BasisFunctionType> >(
+                                m_testSpace, m_p2oTestDofs, m_indexWithGlobalDofs,
+                                m_options.acaOptions().maximumDofListsCacheMemory)),
+    m_trialDofListsCache(trialDofListsCache ?
+                             trialDofListsCache :
+                             boost::make_shared<LocalDofListsCache<BasisFunctionType> >(
+                                 m_trialSpace, m_p2oTrialDofs, m_indexWithGlobalDofs,
+                                 m_options.acaOptions().maximumDofListsCacheMemory))
     //,
 //    m_trialDofListsCache(&testSpace == &trialSpace &&
 //                         std::equal(p2oTestDofs.begin(), p2oTestDofs.end(),
@@ -286,34 +340,8 @@ void WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::cmpbl(
         // likely to need all or almost all local DOFs from most elements.
         // Evaluate the full local weak form for each pair of test and trial
         // elements and then select the entries that we need.
-
-        Fiber::_2dArray<arma::Mat<ResultType> > localResult;
-        for (size_t nTerm = 0; nTerm < m_assemblers.size(); ++nTerm)
-        {
-            m_assemblers[nTerm]->evaluateLocalWeakForms(
-                    testElementIndices, trialElementIndices, localResult,
-                    minDist);
-            for (size_t nTrialElem = 0;
-                 nTrialElem < trialElementIndices.size();
-                 ++nTrialElem)
-                for (size_t nTrialDof = 0;
-                     nTrialDof < trialLocalDofs[nTrialElem].size();
-                     ++nTrialDof)
-                    for (size_t nTestElem = 0;
-                         nTestElem < testElementIndices.size();
-                         ++nTestElem)
-                        for (size_t nTestDof = 0;
-                             nTestDof < testLocalDofs[nTestElem].size();
-                             ++nTestDof)
-                            result(blockRows[nTestElem][nTestDof],
-                                   blockCols[nTrialElem][nTrialDof]) +=
-                                    m_denseTermsMultipliers[nTerm] *
-                                    conj(testLocalDofWeights[nTestElem][nTestDof]) *
-                                    trialLocalDofWeights[nTrialElem][nTrialDof] *
-                                    localResult(nTestElem, nTrialElem)
-                                    (testLocalDofs[nTestElem][nTestDof],
-                                     trialLocalDofs[nTrialElem][nTrialDof]);
-        }
+        evaluateDenseTermsForElementPairs(*testDofLists, *trialDofLists,
+                                          minDist, result);
     }
     else
     {
@@ -387,6 +415,117 @@ void WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::cmpblsym(
             *ahmedData++ = ahmedCast(block(row, col));
 }
 
+template <typename BasisFunctionType, typename ResultType>
+void WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::cmprows(
+        unsigned b1, const std::vector<unsigned>& rows,
+        unsigned b2, unsigned n2, AhmedResultType* ahmedData,
+        const cluster* c1, const cluster* c2, bool countAccessedEntries) const
+{
+    const size_t n1 = rows.size();
+    if (countAccessedEntries)
+        m_accessedEntryCount += n1 * n2;
+    const CoordinateType minDist = estimateMinimumDistance(c1, c2);
+
+    LocalDofLists<BasisFunctionType> testDofLists;
+    gatherLocalDofLists(*m_testDofListsCache, b1, rows, testDofLists);
+    shared_ptr<const LocalDofLists<BasisFunctionType> > trialDofLists =
+            m_trialDofListsCache->get(b2, n2);
+
+    ResultType* data = reinterpret_cast<ResultType*>(ahmedData);
+    arma::Mat<ResultType> result(data, n1, n2, false /*copy_aux_mem*/,
+                                 true /*strict*/);
+    result.fill(0.);
+    evaluateDenseTermsForElementPairs(testDofLists, *trialDofLists,
+                                      minDist, result);
+    if (m_indexWithGlobalDofs)
+        for (size_t nTerm = 0; nTerm < m_sparseTermsToAdd.size(); ++nTerm)
+            m_sparseTermsToAdd[nTerm]->addBlock(
+                        testDofLists.originalIndices,
+                        trialDofLists->originalIndices,
+                        m_sparseTermsMultipliers[nTerm], result);
+}
+
+template <typename BasisFunctionType, typename ResultType>
+void WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::cmpcols(
+        unsigned b1, unsigned n1,
+        unsigned b2, const std::vector<unsigned>& cols,
+        AhmedResultType* ahmedData,
+        const cluster* c1, const cluster* c2, bool countAccessedEntries) const
+{
+    const size_t n2 = cols.size();
+    if (countAccessedEntries)
+        m_accessedEntryCount += n1 * n2;
+    const CoordinateType minDist = estimateMinimumDistance(c1, c2);
+
+    shared_ptr<const LocalDofLists<BasisFunctionType> > testDofLists =
+            m_testDofListsCache->get(b1, n1);
+    LocalDofLists<BasisFunctionType> trialDofLists;
+    gatherLocalDofLists(*m_trialDofListsCache, b2, cols, trialDofLists);
+
+    ResultType* data = reinterpret_cast<ResultType*>(ahmedData);
+    arma::Mat<ResultType> result(data, n1, n2, false /*copy_aux_mem*/,
+                                 true /*strict*/);
+    result.fill(0.);
+    evaluateDenseTermsForElementPairs(*testDofLists, trialDofLists,
+                                      minDist, result);
+    if (m_indexWithGlobalDofs)
+        for (size_t nTerm = 0; nTerm < m_sparseTermsToAdd.size(); ++nTerm)
+            m_sparseTermsToAdd[nTerm]->addBlock(
+                        testDofLists->originalIndices,
+                        trialDofLists.originalIndices,
+                        m_sparseTermsMultipliers[nTerm], result);
+}
+
+template <typename BasisFunctionType, typename ResultType>
+void WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::
+evaluateDenseTermsForElementPairs(
+        const LocalDofLists<BasisFunctionType>& testDofLists,
+        const LocalDofLists<BasisFunctionType>& trialDofLists,
+        CoordinateType minDist,
+        arma::Mat<ResultType>& result) const
+{
+    const std::vector<int>& testElementIndices = testDofLists.elementIndices;
+    const std::vector<int>& trialElementIndices = trialDofLists.elementIndices;
+    const std::vector<std::vector<LocalDofIndex> >& testLocalDofs =
+            testDofLists.localDofIndices;
+    const std::vector<std::vector<LocalDofIndex> >& trialLocalDofs =
+            trialDofLists.localDofIndices;
+    const std::vector<std::vector<BasisFunctionType> >& testLocalDofWeights =
+            testDofLists.localDofWeights;
+    const std::vector<std::vector<BasisFunctionType> >& trialLocalDofWeights =
+            trialDofLists.localDofWeights;
+    const std::vector<std::vector<int> >& blockRows = testDofLists.arrayIndices;
+    const std::vector<std::vector<int> >& blockCols = trialDofLists.arrayIndices;
+
+    Fiber::_2dArray<arma::Mat<ResultType> > localResult;
+    for (size_t nTerm = 0; nTerm < m_assemblers.size(); ++nTerm)
+    {
+        m_assemblers[nTerm]->evaluateLocalWeakForms(
+                testElementIndices, trialElementIndices, localResult,
+                minDist);
+        for (size_t nTrialElem = 0;
+             nTrialElem < trialElementIndices.size();
+             ++nTrialElem)
+            for (size_t nTrialDof = 0;
+                 nTrialDof < trialLocalDofs[nTrialElem].size();
+                 ++nTrialDof)
+                for (size_t nTestElem = 0;
+                     nTestElem < testElementIndices.size();
+                     ++nTestElem)
+                    for (size_t nTestDof = 0;
+                         nTestDof < testLocalDofs[nTestElem].size();
+                         ++nTestDof)
+                        result(blockRows[nTestElem][nTestDof],
+                               blockCols[nTrialElem][nTrialDof]) +=
+                                m_denseTermsMultipliers[nTerm] *
+                                conj(testLocalDofWeights[nTestElem][nTestDof]) *
+                                trialLocalDofWeights[nTrialElem][nTrialDof] *
+                                localResult(nTestElem, nTrialElem)
+                                (testLocalDofs[nTestElem][nTestDof],
+                                 trialLocalDofs[nTrialElem][nTrialDof]);
+    }
+}
+
 template <typename BasisFunctionType, typename ResultType>
 typename WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::MagnitudeType
 WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::scale(
@@ -449,6 +588,16 @@ resetAccessedEntryCount()
     m_accessedEntryCount = 0;
 }
 
+template <typename BasisFunctionType, typename ResultType>
+void
+WeakFormAcaAssemblyHelper<BasisFunctionType, ResultType>::
+printDofListsCacheStatistics(std::ostream& out) const
+{
+    m_testDofListsCache->printStatistics(out, "Test DOF lists cache");
+    if (m_trialDofListsCache != m_testDofListsCache)
+        m_trialDofListsCache->printStatistics(out, "Trial DOF lists cache");
+}
+
 // Explicit instantiations
 
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS_AND_RESULT(WeakFormAcaAssemblyHelper);
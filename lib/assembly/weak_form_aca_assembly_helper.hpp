@@ -30,6 +30,7 @@
 #include "../fiber/scalar_traits.hpp"
 
 #include <tbb/atomic.h>
+#include <iosfwd>
 #include <vector>
 
 /** \cond FORWARD_DECL */
@@ -52,6 +53,7 @@ namespace Bempp
 class AssemblyOptions;
 template <typename ResultType> class DiscreteBoundaryOperator;
 template <typename BasisFunctionType> class LocalDofListsCache;
+template <typename BasisFunctionType> struct LocalDofLists;
 template <typename BasisFunctionType> class Space;
 /** \endcond */
 
@@ -68,6 +70,12 @@ public:
     typedef typename Fiber::ScalarTraits<ResultType>::RealType MagnitudeType;
     typedef typename AhmedTypeTraits<ResultType>::Type AhmedResultType;
 
+    /** \brief Constructor.
+     *
+     *  \p testDofListsCache and \p trialDofListsCache may point to caches of
+     *  DOF lists shared with other helpers. They must have been constructed
+     *  for the same spaces, permutations and DOF indexing mode. If they are
+     *  null, new caches are created. */
     WeakFormAcaAssemblyHelper(const Space<BasisFunctionType>& testSpace,
                               const Space<BasisFunctionType>& trialSpace,
                               const std::vector<unsigned int>& p2oTestDofs,
@@ -76,7 +84,13 @@ public:
                               const std::vector<const DiscreteLinOp*>& sparseTermsToAdd,
                               const std::vector<ResultType>& denseTermsMultipliers,
                               const std::vector<ResultType>& sparseTermsMultipliers,
-                              const AssemblyOptions& options);
+                              const AssemblyOptions& options,
+                              const shared_ptr<LocalDofListsCache<BasisFunctionType> >&
+                              testDofListsCache =
+                              shared_ptr<LocalDofListsCache<BasisFunctionType> >(),
+                              const shared_ptr<LocalDofListsCache<BasisFunctionType> >&
+                              trialDofListsCache =
+                              shared_ptr<LocalDofListsCache<BasisFunctionType> >());
 
     /** \brief Evaluate entries of a general block.
      *
@@ -95,6 +109,33 @@ public:
                   const cluster* c1 = 0,
                   bool countAccessedEntries = true) const;
 
+    /** \brief Evaluate selected rows of a block.
+     *
+     *  Store the entries of the rows with indices <tt>b1 + rows[i]</tt> and
+     *  columns \p b2, ..., <tt>b2 + n2 - 1</tt> (in permuted ordering)
+     *  columnwise in \p data, which must have room for
+     *  <tt>rows.size() * n2</tt> values. All rows are evaluated in a single
+     *  call to the local assemblers, so that geometrical data and basis
+     *  function values are shared between them. Used by the block variant of
+     *  ACA (see AcaOptions::pivotBatchSize). */
+    void cmprows(unsigned b1, const std::vector<unsigned>& rows,
+                 unsigned b2, unsigned n2, AhmedResultType* data,
+                 const cluster* c1 = 0, const cluster* c2 = 0,
+                 bool countAccessedEntries = true) const;
+
+    /** \brief Evaluate selected columns of a block.
+     *
+     *  Store the entries of the rows \p b1, ..., <tt>b1 + n1 - 1</tt> and
+     *  columns with indices <tt>b2 + cols[j]</tt> (in permuted ordering)
+     *  columnwise in \p data, which must have room for
+     *  <tt>n1 * cols.size()</tt> values. All columns are evaluated in a
+     *  single call to the local assemblers. */
+    void cmpcols(unsigned b1, unsigned n1,
+                 unsigned b2, const std::vector<unsigned>& cols,
+                 AhmedResultType* data,
+                 const cluster* c1 = 0, const cluster* c2 = 0,
+                 bool countAccessedEntries = true) const;
+
     /** \brief Expected magnitude of the entries in this block. */
     MagnitudeType scale(unsigned b1, unsigned n1, unsigned b2, unsigned n2,
                         const cluster* c1 = 0, const cluster* c2 = 0) const;
@@ -112,10 +153,20 @@ public:
      *  accessed so far. */
     void resetAccessedEntryCount();
 
+    /** \brief Print the statistics of the caches of local DOF lists used by
+     *  this object, including their hit rates, to \p out. */
+    void printDofListsCacheStatistics(std::ostream& out) const;
+
 private:
     MagnitudeType estimateMinimumDistance(
             const cluster* c1, const cluster* c2) const;
 
+    void evaluateDenseTermsForElementPairs(
+            const LocalDofLists<BasisFunctionType>& testDofLists,
+            const LocalDofLists<BasisFunctionType>& trialDofLists,
+            CoordinateType minDist,
+            arma::Mat<ResultType>& result) const;
+
 private:
     /** \cond PRIVATE */
     const Space<BasisFunctionType>& m_testSpace;
@@ -79,7 +79,7 @@ inline void _2dArray<T>::init_memory(size_t extent0, size_t extent1)
 #ifdef FIBER_CHECK_ARRAY_BOUNDS
     check_extents(extent0, extent1);
 #endif
-    m_storage = new T[extent0 * extent1];
+    m_storage = allocateArrayStorage<T>(extent0 * extent1);
     m_owns = true;
     m_extents[0] = extent0;
     m_extents[1] = extent1;
@@ -89,7 +89,7 @@ template <typename T>
 inline void _2dArray<T>::free_memory()
 {
     if (m_owns && m_storage)
-        delete[] m_storage;
+        freeArrayStorage(m_storage, m_extents[0] * m_extents[1]);
     m_owns = false;
     m_storage = 0;
 }
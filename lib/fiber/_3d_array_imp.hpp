@@ -83,7 +83,7 @@ inline void _3dArray<T>::init_memory(size_t extent0, size_t extent1, size_t exte
 #ifdef FIBER_CHECK_ARRAY_BOUNDS
     check_extents(extent0, extent1, extent2);
 #endif
-    m_storage = new T[extent0 * extent1 * extent2];
+    m_storage = allocateArrayStorage<T>(extent0 * extent1 * extent2);
     m_owns = true;
     m_strict = false;
     m_extents[0] = extent0;
@@ -106,7 +106,8 @@ template <typename T>
 inline void _3dArray<T>::free_memory()
 {
     if (m_owns && m_storage)
-        delete[] m_storage;
+        freeArrayStorage(m_storage,
+                         m_extents[0] * m_extents[1] * m_extents[2]);
     m_owns = false;
     m_storage = 0;
 }
@@ -159,7 +160,8 @@ inline void _3dArray<T>::set_size(size_t extent0, size_t extent1, size_t extent2
                                      "number of elements stored in an array "
                                      "created in the strict mode is not allowed");
         if (m_owns) {
-            delete[] m_storage;
+            freeArrayStorage(m_storage,
+                             m_extents[0] * m_extents[1] * m_extents[2]);
             m_storage = 0;
         }
         if (extent0 * extent1 * extent2 != 0)
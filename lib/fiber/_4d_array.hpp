@@ -23,6 +23,8 @@
 
 #include "../common/common.hpp"
 
+#include "array_memory_pool.hpp"
+
 #include <stdexcept>
 
 #ifndef NDEBUG
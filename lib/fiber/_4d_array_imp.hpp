@@ -86,7 +86,8 @@ inline void _4dArray<T>::init_memory(size_t extent0, size_t extent1,
 #ifdef FIBER_CHECK_ARRAY_BOUNDS
     check_extents(extent0, extent1, extent2, extent3);
 #endif
-    m_storage = new T[extent0 * extent1 * extent2 * extent3];
+    m_storage = allocateArrayStorage<T>(
+                extent0 * extent1 * extent2 * extent3);
     m_owns = true;
     m_extents[0] = extent0;
     m_extents[1] = extent1;
@@ -98,7 +99,8 @@ template <typename T>
 inline void _4dArray<T>::free_memory()
 {
     if (m_owns && m_storage)
-        delete[] m_storage;
+        freeArrayStorage(m_storage,
+                         m_extents[0] * m_extents[1] * m_extents[2] * m_extents[3]);
     m_owns = false;
     m_storage = 0;
 }
@@ -153,14 +155,16 @@ inline void _4dArray<T>::set_size(size_t extent0, size_t extent1, size_t extent2
     }
     else {
         if (m_owns && m_storage) {
-            delete[] m_storage;
+            freeArrayStorage(m_storage,
+                             m_extents[0] * m_extents[1] * m_extents[2] * m_extents[3]);
             m_storage = 0;
         }
         m_extents[0] = extent0;
         m_extents[1] = extent1;
         m_extents[2] = extent2;
         m_extents[3] = extent3;
-        m_storage = new T[extent0 * extent1 * extent2 * extent3];
+        m_storage = allocateArrayStorage<T>(
+                    extent0 * extent1 * extent2 * extent3);
         m_owns = true;
     }
 }
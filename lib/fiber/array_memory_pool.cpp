@@ -0,0 +1,177 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "array_memory_pool.hpp"
+
+#include <tbb/enumerable_thread_specific.h>
+#include <new>
+#include <vector>
+
+namespace Fiber
+{
+
+namespace
+{
+
+// Block sizes are MIN_BLOCK_SIZE << k for k = 0, ..., SIZE_CLASS_COUNT - 1
+const size_t MIN_BLOCK_SIZE = 64;
+const int SIZE_CLASS_COUNT = 15;
+const size_t DEFAULT_CACHE_LIMIT = 16 * 1024 * 1024;
+const size_t DEFAULT_RETAINED_CACHE_SIZE = 1024 * 1024;
+
+int sizeClass(size_t bytes)
+{
+    int k = 0;
+    size_t blockSize = MIN_BLOCK_SIZE;
+    while (blockSize < bytes) {
+        blockSize <<= 1;
+        ++k;
+    }
+    return k;
+}
+
+size_t blockSize(int sizeClass)
+{
+    return MIN_BLOCK_SIZE << sizeClass;
+}
+
+struct ThreadCache
+{
+    ThreadCache() : cachedBytes(0) {}
+
+    ~ThreadCache() {
+        for (int k = 0; k < SIZE_CLASS_COUNT; ++k)
+            for (size_t i = 0; i < freeBlocks[k].size(); ++i)
+                ::operator delete(freeBlocks[k][i]);
+    }
+
+    std::vector<void*> freeBlocks[SIZE_CLASS_COUNT];
+    size_t cachedBytes;
+    ArrayMemoryPoolStatistics statistics;
+};
+
+typedef tbb::enumerable_thread_specific<ThreadCache> ThreadCaches;
+
+// Never destroyed, so that arrays destroyed during static destruction can
+// still return their storage safely
+ThreadCaches& threadCaches()
+{
+    static ThreadCaches* caches = new ThreadCaches;
+    return *caches;
+}
+
+} // namespace
+
+void* ArrayMemoryPool::allocate(size_t bytes)
+{
+    ThreadCache& cache = threadCaches().local();
+    ++cache.statistics.allocationCount;
+    if (bytes > maxPooledBlockSize()) {
+        ++cache.statistics.systemAllocationCount;
+        return ::operator new(bytes);
+    }
+    const int k = sizeClass(bytes);
+    std::vector<void*>& freeBlocks = cache.freeBlocks[k];
+    if (freeBlocks.empty()) {
+        ++cache.statistics.systemAllocationCount;
+        return ::operator new(blockSize(k));
+    }
+    void* p = freeBlocks.back();
+    freeBlocks.pop_back();
+    cache.cachedBytes -= blockSize(k);
+    ++cache.statistics.reuseCount;
+    return p;
+}
+
+void ArrayMemoryPool::deallocate(void* p, size_t bytes)
+{
+    if (!p)
+        return;
+    ThreadCache& cache = threadCaches().local();
+    ++cache.statistics.deallocationCount;
+    if (bytes > maxPooledBlockSize()) {
+        ::operator delete(p);
+        return;
+    }
+    const int k = sizeClass(bytes);
+    if (cache.cachedBytes + blockSize(k) > defaultCacheLimit()) {
+        ::operator delete(p);
+        ++cache.statistics.releasedBlockCount;
+        return;
+    }
+    cache.freeBlocks[k].push_back(p);
+    cache.cachedBytes += blockSize(k);
+}
+
+void ArrayMemoryPool::releaseCachedMemory(size_t maxCachedBytes)
+{
+    ThreadCache& cache = threadCaches().local();
+    for (int k = SIZE_CLASS_COUNT - 1;
+         k >= 0 && cache.cachedBytes > maxCachedBytes; --k) {
+        std::vector<void*>& freeBlocks = cache.freeBlocks[k];
+        while (!freeBlocks.empty() && cache.cachedBytes > maxCachedBytes) {
+            ::operator delete(freeBlocks.back());
+            freeBlocks.pop_back();
+            cache.cachedBytes -= blockSize(k);
+            ++cache.statistics.releasedBlockCount;
+        }
+    }
+}
+
+size_t ArrayMemoryPool::maxPooledBlockSize()
+{
+    return blockSize(SIZE_CLASS_COUNT - 1);
+}
+
+size_t ArrayMemoryPool::defaultCacheLimit()
+{
+    return DEFAULT_CACHE_LIMIT;
+}
+
+size_t ArrayMemoryPool::defaultRetainedCacheSize()
+{
+    return DEFAULT_RETAINED_CACHE_SIZE;
+}
+
+ArrayMemoryPoolStatistics ArrayMemoryPool::statistics()
+{
+    ArrayMemoryPoolStatistics result;
+    ThreadCaches& caches = threadCaches();
+    for (ThreadCaches::const_iterator it = caches.begin();
+         it != caches.end(); ++it) {
+        const ArrayMemoryPoolStatistics& s = it->statistics;
+        result.allocationCount += s.allocationCount;
+        result.reuseCount += s.reuseCount;
+        result.systemAllocationCount += s.systemAllocationCount;
+        result.deallocationCount += s.deallocationCount;
+        result.releasedBlockCount += s.releasedBlockCount;
+        result.cachedBytes += it->cachedBytes;
+    }
+    return result;
+}
+
+void ArrayMemoryPool::resetStatistics()
+{
+    ThreadCaches& caches = threadCaches();
+    for (ThreadCaches::iterator it = caches.begin(); it != caches.end(); ++it)
+        it->statistics = ArrayMemoryPoolStatistics();
+}
+
+} // namespace Fiber
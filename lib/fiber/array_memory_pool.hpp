@@ -0,0 +1,180 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_array_memory_pool_hpp
+#define fiber_array_memory_pool_hpp
+
+#include "../common/common.hpp"
+
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/is_complex.hpp>
+#include <boost/utility/enable_if.hpp>
+#include <cstddef>
+#include <memory>
+
+namespace Fiber
+{
+
+/** \brief Allocation counters of ArrayMemoryPool.
+ *
+ *  All counters except cachedBytes are summed over all threads since the
+ *  last call to ArrayMemoryPool::resetStatistics(). */
+struct ArrayMemoryPoolStatistics
+{
+    ArrayMemoryPoolStatistics() :
+        allocationCount(0), reuseCount(0), systemAllocationCount(0),
+        deallocationCount(0), releasedBlockCount(0), cachedBytes(0)
+    {}
+
+    /** \brief Number of blocks requested from the pool. */
+    size_t allocationCount;
+    /** \brief Number of requests served from a block returned earlier. */
+    size_t reuseCount;
+    /** \brief Number of requests forwarded to the system allocator. */
+    size_t systemAllocationCount;
+    /** \brief Number of blocks returned to the pool. */
+    size_t deallocationCount;
+    /** \brief Number of cached blocks given back to the system allocator. */
+    size_t releasedBlockCount;
+    /** \brief Number of bytes currently held in the free lists of all
+     *  threads. */
+    size_t cachedBytes;
+};
+
+/** \brief Thread-local pool of memory blocks used by the multidimensional
+ *  arrays of Fiber.
+ *
+ *  The local assemblers create and destroy large numbers of short-lived
+ *  _2dArray, _3dArray and _4dArray objects, mostly of a few recurring sizes.
+ *  Instead of returning their storage to the system allocator, this pool
+ *  keeps the freed blocks in per-thread free lists, one for each power-of-two
+ *  size class, and hands them out again on subsequent requests of the same
+ *  thread. No locking is involved. Blocks freed by a thread other than the
+ *  one that allocated them simply join the free lists of the freeing thread.
+ *
+ *  Blocks larger than maxPooledBlockSize() bytes are not pooled, and no
+ *  thread caches more than defaultCacheLimit() bytes. */
+class ArrayMemoryPool
+{
+public:
+    /** \brief Return a block of at least \p bytes bytes, suitably aligned
+     *  for any fundamental type. */
+    static void* allocate(size_t bytes);
+
+    /** \brief Return the block \p p, obtained from allocate(bytes), to the
+     *  pool.
+     *
+     *  If caching the block would make the calling thread hold more than
+     *  defaultCacheLimit() bytes, the block is given back to the system
+     *  allocator instead. */
+    static void deallocate(void* p, size_t bytes);
+
+    /** \brief Release the blocks cached by the calling thread.
+     *
+     *  Free blocks are given back to the system allocator, starting from the
+     *  largest size class, until the calling thread caches at most
+     *  \p maxCachedBytes bytes. The local assemblers call this function with
+     *  the default argument at the end of each evaluateLocalWeakForms() call,
+     *  so that the arrays used only by an occasional expensive call do not
+     *  stay cached until the end of the assembly. */
+    static void releaseCachedMemory(
+            size_t maxCachedBytes = defaultRetainedCacheSize());
+
+    /** \brief Largest block size (in bytes) handled by the pool. */
+    static size_t maxPooledBlockSize();
+
+    /** \brief Maximum number of bytes cached by a thread. */
+    static size_t defaultCacheLimit();
+
+    /** \brief Default number of bytes retained by releaseCachedMemory().
+     *
+     *  This is smaller than defaultCacheLimit(). */
+    static size_t defaultRetainedCacheSize();
+
+    /** \brief Return the allocation counters summed over all threads.
+     *
+     *  This function must not be called concurrently with allocations. */
+    static ArrayMemoryPoolStatistics statistics();
+
+    /** \brief Zero the allocation counters of all threads.
+     *
+     *  This function must not be called concurrently with allocations. */
+    static void resetStatistics();
+};
+
+/** \cond PRIVATE */
+namespace detail
+{
+
+template <typename T>
+struct IsPoolableArrayElement
+{
+    enum { value = boost::is_arithmetic<T>::value ||
+           boost::is_complex<T>::value };
+};
+
+} // namespace detail
+/** \endcond */
+
+/** \brief Allocate storage for \p count elements of type \p T.
+ *
+ *  Storage for arithmetic and complex types is obtained from
+ *  ArrayMemoryPool; complex elements are value-initialised and arithmetic
+ *  ones are left uninitialised, as with <tt>new T[count]</tt>. Other types
+ *  are allocated with <tt>new T[count]</tt>. */
+template <typename T>
+inline typename boost::enable_if_c<
+detail::IsPoolableArrayElement<T>::value, T*>::type
+allocateArrayStorage(size_t count)
+{
+    T* p = static_cast<T*>(ArrayMemoryPool::allocate(count * sizeof(T)));
+    if (boost::is_complex<T>::value)
+        std::uninitialized_fill(p, p + count, T());
+    return p;
+}
+
+template <typename T>
+inline typename boost::disable_if_c<
+detail::IsPoolableArrayElement<T>::value, T*>::type
+allocateArrayStorage(size_t count)
+{
+    return new T[count];
+}
+
+/** \brief Free storage obtained from allocateArrayStorage<T>(count). */
+template <typename T>
+inline typename boost::enable_if_c<
+detail::IsPoolableArrayElement<T>::value, void>::type
+freeArrayStorage(T* p, size_t count)
+{
+    ArrayMemoryPool::deallocate(p, count * sizeof(T));
+}
+
+template <typename T>
+inline typename boost::disable_if_c<
+detail::IsPoolableArrayElement<T>::value, void>::type
+freeArrayStorage(T* p, size_t /* count */)
+{
+    delete[] p;
+}
+
+} // namespace Fiber
+
+#endif
@@ -0,0 +1,153 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_basis_data_cache_hpp
+#define fiber_basis_data_cache_hpp
+
+#include "../common/common.hpp"
+
+#include "basis.hpp"
+#include "basis_data.hpp"
+#include "collection_of_3d_arrays.hpp"
+#include "collection_of_basis_transformations.hpp"
+#include "geometrical_data.hpp"
+#include "scalar_traits.hpp"
+#include "types.hpp"
+
+#include "../common/armadillo_fwd.hpp"
+#include <map>
+
+namespace Fiber
+{
+
+/** \brief Cache of basis function values at reference quadrature points.
+ *
+ *  The values and derivatives of the shape functions of a basis at a fixed
+ *  set of points on the reference element do not depend on the element. An
+ *  object of this class evaluates them on the first request for a given
+ *  combination of basis, transformation collection, set of points and local
+ *  DOF index, and reuses them afterwards. If the transformations do not
+ *  depend on any geometrical data (as is the case, for instance, for the
+ *  values of scalar shape functions), their results are cached as well;
+ *  otherwise only the transformations are applied on each element.
+ *
+ *  Cache entries are identified by the addresses of the basis, the
+ *  transformation collection and the matrix of points, which must therefore
+ *  remain alive and unmodified as long as the cache is used. This class is
+ *  not thread-safe; integrators keep one cache per thread. */
+template <typename BasisFunctionType>
+class BasisDataCache
+{
+public:
+    typedef typename ScalarTraits<BasisFunctionType>::RealType CoordinateType;
+
+    /** \brief Return the values of the transformations \p transformations of
+     *  the functions of \p basis at the points \p localPoints of the
+     *  reference element.
+     *
+     *  \param[in] localDofIndex
+     *    Index of the basis function to transform, or ALL_DOFS.
+     *  \param[in] geomData
+     *    Geometrical data of the points \p localPoints on the current
+     *    element.
+     *  \param[in] buffer
+     *    Storage used for the result if the transformations depend on
+     *    geometrical data.
+     *
+     *  The returned reference is either to \p buffer or to an array
+     *  collection owned by the cache. */
+    const CollectionOf3dArrays<BasisFunctionType>& transformedValues(
+            const CollectionOfBasisTransformations<CoordinateType>& transformations,
+            const Basis<BasisFunctionType>& basis,
+            const arma::Mat<CoordinateType>& localPoints,
+            LocalDofIndex localDofIndex,
+            const GeometricalData<CoordinateType>& geomData,
+            CollectionOf3dArrays<BasisFunctionType>& buffer) {
+        Key key;
+        key.transformations = &transformations;
+        key.basis = &basis;
+        key.localPoints = &localPoints;
+        key.localDofIndex = localDofIndex;
+        typename std::map<Key, Entry>::iterator it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            it = m_entries.insert(std::make_pair(key, Entry())).first;
+            Entry& entry = it->second;
+            size_t basisDeps = 0, geomDeps = 0;
+            transformations.addDependencies(basisDeps, geomDeps);
+            basis.evaluate(basisDeps, localPoints, localDofIndex,
+                           entry.basisData);
+            entry.elementIndependent = geomDeps == 0;
+            if (entry.elementIndependent)
+                transformations.evaluate(entry.basisData, geomData,
+                                         entry.transformedValues);
+        }
+        const Entry& entry = it->second;
+        if (entry.elementIndependent)
+            return entry.transformedValues;
+        transformations.evaluate(entry.basisData, geomData, buffer);
+        return buffer;
+    }
+
+    /** \brief Number of cache entries. */
+    size_t size() const {
+        return m_entries.size();
+    }
+
+    /** \brief Remove all cache entries. */
+    void clear() {
+        m_entries.clear();
+    }
+
+private:
+    /** \cond PRIVATE */
+    struct Key
+    {
+        const void* transformations;
+        const void* basis;
+        const void* localPoints;
+        LocalDofIndex localDofIndex;
+
+        bool operator<(const Key& other) const {
+            if (transformations != other.transformations)
+                return transformations < other.transformations;
+            if (basis != other.basis)
+                return basis < other.basis;
+            if (localPoints != other.localPoints)
+                return localPoints < other.localPoints;
+            return localDofIndex < other.localDofIndex;
+        }
+    };
+
+    struct Entry
+    {
+        Entry() : elementIndependent(false) {}
+
+        BasisData<BasisFunctionType> basisData;
+        bool elementIndependent;
+        CollectionOf3dArrays<BasisFunctionType> transformedValues;
+    };
+
+    std::map<Key, Entry> m_entries;
+    /** \endcond */
+};
+
+} // namespace Fiber
+
+#endif
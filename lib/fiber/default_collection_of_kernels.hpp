@@ -22,6 +22,9 @@
 #define fiber_default_collection_of_kernels_hpp
 
 #include "collection_of_kernels.hpp"
+#include "kernel_point_block.hpp"
+
+#include <tbb/enumerable_thread_specific.h>
 
 namespace Fiber
 {
@@ -77,6 +80,24 @@ namespace Fiber
         // defined, the kernel behaves as if its estimated magnitude was 1
         // everywhere.
         CoordinateType estimateRelativeScale(CoordinateType distance) const;
+
+        // (Optional; only for collections consisting of a single scalar
+        // kernel)
+        // Evaluate the kernel at all the point pairs formed from testPoints
+        // and trialPoints in the arrangement specified by layout (see
+        // KernelPointLayout) and store the values consecutively in result.
+        // If this function is defined, it is used by evaluateOnGrid() and
+        // evaluateAtPointPairs() instead of evaluate(); it can process many
+        // point pairs at a time with vector instructions (see
+        // evaluatePairGeometry()). Intermediate arrays should be taken from
+        // scratch, which is owned by the calling thread and reused between
+        // calls.
+        void evaluateBatch(
+                KernelPointLayout layout,
+                const KernelPointBlock<CoordinateType>& testPoints,
+                const KernelPointBlock<CoordinateType>& trialPoints,
+                KernelBatchScratch<CoordinateType>& scratch,
+                ValueType* result) const;
     };
     \endcode
 
@@ -123,6 +144,9 @@ public:
 
 private:
     Functor m_functor;
+    // Buffers of the batched kernel evaluation, one per thread
+    mutable tbb::enumerable_thread_specific<KernelBatchScratch<CoordinateType> >
+    m_batchScratch;
 };
 
 } // namespace Fiber
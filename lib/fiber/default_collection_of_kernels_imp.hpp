@@ -26,6 +26,7 @@
 #include "collection_of_3d_arrays.hpp"
 #include "collection_of_4d_arrays.hpp"
 #include "geometrical_data.hpp"
+#include "kernel_point_block.hpp"
 
 #include <boost/utility/enable_if.hpp>
 #include <stdexcept>
@@ -45,6 +46,7 @@ namespace Fiber
 {
 
 FIBER_HAS_MEM_FUNC(estimateRelativeScale, hasEstimateRelativeScale);
+FIBER_HAS_MEM_FUNC(evaluateBatch, hasEvaluateBatch);
 
 //template <class Type>
 //class TypeHasEstimateRelativeScale
@@ -92,6 +94,63 @@ estimateRelativeScaleInternal(const Functor& functor,
     return 1.;
 }
 
+template <typename Functor>
+struct EvaluateBatchSignature
+{
+    typedef void (Functor::*Type)(
+            KernelPointLayout,
+            const KernelPointBlock<typename Functor::CoordinateType>&,
+            const KernelPointBlock<typename Functor::CoordinateType>&,
+            KernelBatchScratch<typename Functor::CoordinateType>&,
+            typename Functor::ValueType*) const;
+};
+
+template <typename Functor>
+struct BatchScratchStorage
+{
+    typedef tbb::enumerable_thread_specific<
+    KernelBatchScratch<typename Functor::CoordinateType> > Type;
+};
+
+// Evaluate the kernel with the functor's evaluateBatch() method, using the
+// calling thread's buffers, and return true
+template<typename Functor>
+typename boost::enable_if<hasEvaluateBatch<Functor,
+                          typename EvaluateBatchSignature<Functor>::Type>,
+                          bool>::type
+evaluateBatchInternal(
+        const Functor& functor, KernelPointLayout layout,
+        const GeometricalData<typename Functor::CoordinateType>& testGeomData,
+        const GeometricalData<typename Functor::CoordinateType>& trialGeomData,
+        typename BatchScratchStorage<Functor>::Type& scratchStorage,
+        typename Functor::ValueType* result)
+{
+    typedef typename Functor::CoordinateType CoordinateType;
+    KernelBatchScratch<CoordinateType>& scratch = scratchStorage.local();
+    scratch.testGeomData.assign(testGeomData);
+    scratch.trialGeomData.assign(trialGeomData);
+    functor.evaluateBatch(layout, makeKernelPointBlock(scratch.testGeomData),
+                          makeKernelPointBlock(scratch.trialGeomData),
+                          scratch, result);
+    return true;
+}
+
+// Functor without evaluateBatch(): return false, so that the kernel is
+// evaluated pair by pair
+template<typename Functor>
+typename boost::disable_if<hasEvaluateBatch<Functor,
+                           typename EvaluateBatchSignature<Functor>::Type>,
+                           bool>::type
+evaluateBatchInternal(
+        const Functor& functor, KernelPointLayout layout,
+        const GeometricalData<typename Functor::CoordinateType>& testGeomData,
+        const GeometricalData<typename Functor::CoordinateType>& trialGeomData,
+        typename BatchScratchStorage<Functor>::Type& scratchStorage,
+        typename Functor::ValueType* result)
+{
+    return false;
+}
+
 //template<typename Functor>
 //typename boost::enable_if<TypeHasEstimateRelativeScale<Functor>,
 //                          typename Functor::CoordinateType>::type
@@ -133,7 +192,13 @@ void DefaultCollectionOfKernels<Functor>::evaluateAtPointPairs(
         result[k].set_size(m_functor.kernelRowCount(k),
                            m_functor.kernelColCount(k),
                            pointCount);
+    if (pointCount == 0)
+        return;
 
+    if (evaluateBatchInternal(m_functor, AT_POINT_PAIRS,
+                              testGeomData, trialGeomData, m_batchScratch,
+                              result[0].begin()))
+        return;
     for (size_t p = 0; p < pointCount; ++p)
         m_functor.evaluate(testGeomData.const_slice(p),
                            trialGeomData.const_slice(p),
@@ -155,7 +220,13 @@ void DefaultCollectionOfKernels<Functor>::evaluateOnGrid(
                            m_functor.kernelColCount(k),
                            testPointCount,
                            trialPointCount);
+    if (testPointCount == 0 || trialPointCount == 0)
+        return;
 
+    if (evaluateBatchInternal(m_functor, ON_GRID,
+                              testGeomData, trialGeomData, m_batchScratch,
+                              result[0].begin()))
+        return;
 #pragma ivdep
     for (size_t trialIndex = 0; trialIndex < trialPointCount; ++trialIndex)
         for (size_t testIndex = 0; testIndex < testPointCount; ++testIndex)
@@ -23,6 +23,8 @@
 // Keep IDEs happy
 #include "default_local_assembler_for_integral_operators_on_surfaces.hpp"
 
+#include "array_memory_pool.hpp"
+
 #include "nonseparable_numerical_test_kernel_trial_integrator.hpp"
 #include "separable_numerical_test_kernel_trial_integrator.hpp"
 #include "serial_blas_region.hpp"
@@ -270,6 +272,10 @@ evaluateLocalWeakForms(
         //     if (quadVariants[indexA] == activeQuadVariant)
         //         result[indexA] = localResult.slice(i++);
     }
+
+    // Give back to the system the array storage cached by this thread beyond
+    // the amount retained between calls
+    ArrayMemoryPool::releaseCachedMemory();
 }
 
 template <typename BasisFunctionType, typename KernelType,
@@ -368,6 +374,8 @@ evaluateLocalWeakForms(
         //         if (quadVariants(testIndex, trialIndex) == activeQuadVariant)
         //             result(testIndex, trialIndex) = localResult.slice(i++);
     }
+
+    ArrayMemoryPool::releaseCachedMemory();
 }
 
 template <typename BasisFunctionType, typename KernelType,
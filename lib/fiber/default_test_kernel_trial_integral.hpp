@@ -26,6 +26,16 @@
 namespace Fiber
 {
 
+/** \cond PRIVATE */
+// Overloaded for integrand functors evaluating the integrand described in
+// TestKernelTrialIntegral::isSimpleTestScalarKernelTrialIntegral()
+template <typename IntegrandFunctor>
+inline bool isSimpleTestScalarKernelTrialIntegrand(const IntegrandFunctor&)
+{
+    return false;
+}
+/** \endcond */
+
 /** \ingroup weak_form_elements
  *  \brief Default implementation of the TestKernelTrialIntegral interface.
 
@@ -129,6 +139,8 @@ public:
             const std::vector<CoordinateType>& trialQuadWeights,
             arma::Mat<ResultType>& result) const;
 
+    virtual bool isSimpleTestScalarKernelTrialIntegral() const;
+
     virtual void evaluateWithNontensorQuadratureRule(
             const GeometricalData<CoordinateType>& testGeomData,
             const GeometricalData<CoordinateType>& trialGeomData,
@@ -97,6 +97,13 @@ evaluateWithTensorQuadratureRule(
         }
 }
 
+template <typename IntegrandFunctor>
+bool DefaultTestKernelTrialIntegral<IntegrandFunctor>::
+isSimpleTestScalarKernelTrialIntegral() const
+{
+    return isSimpleTestScalarKernelTrialIntegrand(m_functor);
+}
+
 template <typename IntegrandFunctor>
 void DefaultTestKernelTrialIntegral<IntegrandFunctor>::
 evaluateWithNontensorQuadratureRule(
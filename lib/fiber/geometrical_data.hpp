@@ -134,6 +134,49 @@ private:
     int m_point;
 };
 
+/** \brief Copy the geometrical data of the points with indices
+ *  <tt>[begin, end)</tt> stored in \p source to \p dest. */
+template <typename CoordinateType>
+void extractPointRange(const GeometricalData<CoordinateType>& source,
+                       size_t begin, size_t end,
+                       GeometricalData<CoordinateType>& dest)
+{
+    assert(begin < end);
+    if (source.globals.is_empty())
+        dest.globals.reset();
+    else
+        dest.globals = source.globals.cols(begin, end - 1);
+    if (source.integrationElements.is_empty())
+        dest.integrationElements.reset();
+    else
+        dest.integrationElements =
+                source.integrationElements.cols(begin, end - 1);
+    if (source.normals.is_empty())
+        dest.normals.reset();
+    else
+        dest.normals = source.normals.cols(begin, end - 1);
+
+    const _3dArray<CoordinateType>* sourceArrays[2] = {
+        &source.jacobiansTransposed, &source.jacobianInversesTransposed
+    };
+    _3dArray<CoordinateType>* destArrays[2] = {
+        &dest.jacobiansTransposed, &dest.jacobianInversesTransposed
+    };
+    for (int a = 0; a < 2; ++a) {
+        const _3dArray<CoordinateType>& from = *sourceArrays[a];
+        _3dArray<CoordinateType>& to = *destArrays[a];
+        if (from.is_empty()) {
+            to.set_size(0, 0, 0);
+            continue;
+        }
+        to.set_size(from.extent(0), from.extent(1), end - begin);
+        for (size_t p = begin; p < end; ++p)
+            for (size_t j = 0; j < from.extent(1); ++j)
+                for (size_t i = 0; i < from.extent(0); ++i)
+                    to(i, j, p - begin) = from(i, j, p);
+    }
+}
+
 } // namespace Fiber
 
 #endif
@@ -0,0 +1,766 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_kernel_point_block_hpp
+#define fiber_kernel_point_block_hpp
+
+#include "../common/common.hpp"
+#include "bempp/common/config_simd.hpp"
+
+#include "soa_geometrical_data.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+// The instruction set is chosen with the WITH_AVX and WITH_AVX512 CMake
+// options, which also add the corresponding compiler flags. Code including
+// this header must be compiled with the same flags.
+#if defined(WITH_AVX512) && !defined(__AVX512F__)
+#error "BEM++ was configured with WITH_AVX512; compile with -mavx512f"
+#endif
+#if defined(WITH_AVX) && !(defined(__AVX2__) && defined(__FMA__))
+#error "BEM++ was configured with WITH_AVX; compile with -mavx2 -mfma"
+#endif
+
+#if defined(WITH_AVX512) || defined(WITH_AVX)
+#include <immintrin.h>
+#endif
+
+namespace Fiber
+{
+
+/** \brief Arrangement of the point pairs at which a batch of kernel values
+ *  is evaluated. */
+enum KernelPointLayout
+{
+    /** \brief All pairs (test point, trial point). The value for the
+     *  <em>i</em>th test point and <em>j</em>th trial point is stored at
+     *  position <tt>i + j * testPointCount</tt>. */
+    ON_GRID,
+    /** \brief Pairs (<em>i</em>th test point, <em>i</em>th trial point). The
+     *  value for the <em>i</em>th pair is stored at position \c i. */
+    AT_POINT_PAIRS
+};
+
+/** \brief Geometrical data of a set of points stored in the
+ *  structure-of-arrays layout.
+ *
+ *  <tt>globals[d][p]</tt> is the <em>d</em>th coordinate of the
+ *  <em>p</em>th point and <tt>normals[d][p]</tt> the <em>d</em>th component
+ *  of the unit normal at that point. The normals pointers are null if
+ *  normals are not available. Used by the batched kernel evaluation
+ *  interface (see DefaultCollectionOfKernels); usually points to the arrays
+ *  of a SoaGeometricalData object. */
+template <typename CoordinateType>
+struct KernelPointBlock
+{
+    size_t pointCount;
+    // Number of entries that may be read from each array (at least
+    // pointCount; larger if the arrays are padded)
+    size_t paddedPointCount;
+    const CoordinateType* globals[3];
+    const CoordinateType* normals[3];
+};
+
+/** \brief Make \p block point to the global coordinates and normals stored
+ *  in \p geomData.
+ *
+ *  No data are copied; \p block remains valid as long as \p geomData is
+ *  neither modified nor destroyed. */
+template <typename CoordinateType>
+KernelPointBlock<CoordinateType> makeKernelPointBlock(
+        const SoaGeometricalData<CoordinateType>& geomData)
+{
+    KernelPointBlock<CoordinateType> block;
+    block.pointCount = geomData.pointCount();
+    block.paddedPointCount = geomData.paddedPointCount();
+    assert(geomData.dimWorld() == 0 || geomData.dimWorld() == 3);
+    for (int dim = 0; dim < 3; ++dim) {
+        block.globals[dim] = geomData.hasGlobals() ? geomData.globals(dim) : 0;
+        block.normals[dim] = geomData.hasNormals() ? geomData.normals(dim) : 0;
+    }
+    return block;
+}
+
+/** \brief Points whose normals enter the products computed by
+ *  evaluatePairGeometry(). */
+enum PairNormalSource
+{
+    NO_NORMALS,
+    TEST_NORMALS,
+    TRIAL_NORMALS
+};
+
+/** \cond PRIVATE */
+// Vector operations used by evaluatePairGeometry() and
+// evaluateExponentials(), implemented with the instruction set selected by
+// the WITH_AVX512 or WITH_AVX option (the latter meaning AVX2 and FMA). If
+// neither is set, SimdTraits<T>::width is 0 and only the scalar code path is
+// compiled.
+//
+// round() rounds to the nearest integer, select(m, x, y) takes the lanes of
+// x where the mask m is set and those of y elsewhere, and pow2(n) returns
+// 2^n for integral n such that 2^n is a normal number.
+template <typename T>
+struct SimdTraits
+{
+    enum { width = 0 };
+};
+
+#if defined(WITH_AVX512)
+template <>
+struct SimdTraits<double>
+{
+    enum { width = 8 };
+    typedef __m512d Vector;
+    static Vector load(const double* p) { return _mm512_loadu_pd(p); }
+    static Vector broadcast(double x) { return _mm512_set1_pd(x); }
+    static void store(double* p, Vector x) { _mm512_storeu_pd(p, x); }
+    static Vector add(Vector x, Vector y) { return _mm512_add_pd(x, y); }
+    static Vector sub(Vector x, Vector y) { return _mm512_sub_pd(x, y); }
+    static Vector mul(Vector x, Vector y) { return _mm512_mul_pd(x, y); }
+    static Vector div(Vector x, Vector y) { return _mm512_div_pd(x, y); }
+    static Vector sqrt(Vector x) { return _mm512_sqrt_pd(x); }
+    static Vector fmadd(Vector x, Vector y, Vector z) {
+        return _mm512_fmadd_pd(x, y, z);
+    }
+    static Vector round(Vector x) {
+        return _mm512_roundscale_pd(
+                    x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    static Vector floor(Vector x) {
+        return _mm512_roundscale_pd(
+                    x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    }
+    static Vector pow2(Vector n) {
+        // The low bits of n + 1.5 * 2^52 hold the integer n, moved here into
+        // the exponent field
+        const Vector shifted = add(n, broadcast(1023. + 6755399441055744.));
+        return _mm512_castsi512_pd(
+                    _mm512_slli_epi64(_mm512_castpd_si512(shifted), 52));
+    }
+
+    typedef __mmask8 Mask;
+    static Mask greater(Vector x, Vector y) {
+        return _mm512_cmp_pd_mask(x, y, _CMP_GT_OQ);
+    }
+    static Vector select(Mask m, Vector x, Vector y) {
+        return _mm512_mask_blend_pd(m, y, x);
+    }
+    static bool any(Mask m) { return m != 0; }
+};
+
+template <>
+struct SimdTraits<float>
+{
+    enum { width = 16 };
+    typedef __m512 Vector;
+    static Vector load(const float* p) { return _mm512_loadu_ps(p); }
+    static Vector broadcast(float x) { return _mm512_set1_ps(x); }
+    static void store(float* p, Vector x) { _mm512_storeu_ps(p, x); }
+    static Vector add(Vector x, Vector y) { return _mm512_add_ps(x, y); }
+    static Vector sub(Vector x, Vector y) { return _mm512_sub_ps(x, y); }
+    static Vector mul(Vector x, Vector y) { return _mm512_mul_ps(x, y); }
+    static Vector div(Vector x, Vector y) { return _mm512_div_ps(x, y); }
+    static Vector sqrt(Vector x) { return _mm512_sqrt_ps(x); }
+    static Vector fmadd(Vector x, Vector y, Vector z) {
+        return _mm512_fmadd_ps(x, y, z);
+    }
+    static Vector round(Vector x) {
+        return _mm512_roundscale_ps(
+                    x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    static Vector floor(Vector x) {
+        return _mm512_roundscale_ps(
+                    x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    }
+    static Vector pow2(Vector n) {
+        const Vector shifted = add(n, broadcast(127.f + 12582912.f));
+        return _mm512_castsi512_ps(
+                    _mm512_slli_epi32(_mm512_castps_si512(shifted), 23));
+    }
+
+    typedef __mmask16 Mask;
+    static Mask greater(Vector x, Vector y) {
+        return _mm512_cmp_ps_mask(x, y, _CMP_GT_OQ);
+    }
+    static Vector select(Mask m, Vector x, Vector y) {
+        return _mm512_mask_blend_ps(m, y, x);
+    }
+    static bool any(Mask m) { return m != 0; }
+};
+#elif defined(WITH_AVX)
+template <>
+struct SimdTraits<double>
+{
+    enum { width = 4 };
+    typedef __m256d Vector;
+    static Vector load(const double* p) { return _mm256_loadu_pd(p); }
+    static Vector broadcast(double x) { return _mm256_set1_pd(x); }
+    static void store(double* p, Vector x) { _mm256_storeu_pd(p, x); }
+    static Vector add(Vector x, Vector y) { return _mm256_add_pd(x, y); }
+    static Vector sub(Vector x, Vector y) { return _mm256_sub_pd(x, y); }
+    static Vector mul(Vector x, Vector y) { return _mm256_mul_pd(x, y); }
+    static Vector div(Vector x, Vector y) { return _mm256_div_pd(x, y); }
+    static Vector sqrt(Vector x) { return _mm256_sqrt_pd(x); }
+    static Vector fmadd(Vector x, Vector y, Vector z) {
+        return _mm256_fmadd_pd(x, y, z);
+    }
+    static Vector round(Vector x) {
+        return _mm256_round_pd(
+                    x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    static Vector floor(Vector x) { return _mm256_floor_pd(x); }
+    static Vector pow2(Vector n) {
+        // The low bits of n + 1.5 * 2^52 hold the integer n, moved here into
+        // the exponent field
+        const Vector shifted = add(n, broadcast(1023. + 6755399441055744.));
+        return _mm256_castsi256_pd(
+                    _mm256_slli_epi64(_mm256_castpd_si256(shifted), 52));
+    }
+
+    typedef __m256d Mask;
+    static Mask greater(Vector x, Vector y) {
+        return _mm256_cmp_pd(x, y, _CMP_GT_OQ);
+    }
+    static Vector select(Mask m, Vector x, Vector y) {
+        return _mm256_blendv_pd(y, x, m);
+    }
+    static bool any(Mask m) { return _mm256_movemask_pd(m) != 0; }
+};
+
+template <>
+struct SimdTraits<float>
+{
+    enum { width = 8 };
+    typedef __m256 Vector;
+    static Vector load(const float* p) { return _mm256_loadu_ps(p); }
+    static Vector broadcast(float x) { return _mm256_set1_ps(x); }
+    static void store(float* p, Vector x) { _mm256_storeu_ps(p, x); }
+    static Vector add(Vector x, Vector y) { return _mm256_add_ps(x, y); }
+    static Vector sub(Vector x, Vector y) { return _mm256_sub_ps(x, y); }
+    static Vector mul(Vector x, Vector y) { return _mm256_mul_ps(x, y); }
+    static Vector div(Vector x, Vector y) { return _mm256_div_ps(x, y); }
+    static Vector sqrt(Vector x) { return _mm256_sqrt_ps(x); }
+    static Vector fmadd(Vector x, Vector y, Vector z) {
+        return _mm256_fmadd_ps(x, y, z);
+    }
+    static Vector round(Vector x) {
+        return _mm256_round_ps(
+                    x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    static Vector floor(Vector x) { return _mm256_floor_ps(x); }
+    static Vector pow2(Vector n) {
+        const Vector shifted = add(n, broadcast(127.f + 12582912.f));
+        return _mm256_castsi256_ps(
+                    _mm256_slli_epi32(_mm256_castps_si256(shifted), 23));
+    }
+
+    typedef __m256 Mask;
+    static Mask greater(Vector x, Vector y) {
+        return _mm256_cmp_ps(x, y, _CMP_GT_OQ);
+    }
+    static Vector select(Mask m, Vector x, Vector y) {
+        return _mm256_blendv_ps(y, x, m);
+    }
+    static bool any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+};
+#endif
+
+// Process the test points [0, n) in groups of SimdTraits<T>::width for a
+// single trial point; return the number of test points processed. Entries
+// up to index readableCount - 1 of the test point arrays may be read, so if
+// the arrays are padded, the last, incomplete group is processed too.
+template <typename T, int width = SimdTraits<T>::width>
+struct PairGeometryVectorLoop
+{
+    static size_t run(size_t n, size_t readableCount,
+                      const T* const x[3], const T y[3],
+                      const T* const testNormal[3], const T* trialNormal,
+                      T* distances, T* inverseDistances, T* normalProducts) {
+        typedef SimdTraits<T> S;
+        typedef typename S::Vector V;
+        const V one = S::broadcast(1);
+        const V y0 = S::broadcast(y[0]), y1 = S::broadcast(y[1]),
+                y2 = S::broadcast(y[2]);
+        size_t i = 0;
+        for (; i < n && i + width <= readableCount; i += width) {
+            const V d0 = S::sub(S::load(x[0] + i), y0);
+            const V d1 = S::sub(S::load(x[1] + i), y1);
+            const V d2 = S::sub(S::load(x[2] + i), y2);
+            const V r2 = S::add(S::add(S::mul(d0, d0), S::mul(d1, d1)),
+                                S::mul(d2, d2));
+            const V r = S::sqrt(r2);
+            const size_t count = std::min<size_t>(width, n - i);
+            if (distances)
+                store(distances + i, r, count);
+            if (inverseDistances)
+                store(inverseDistances + i, S::div(one, r), count);
+            if (normalProducts) {
+                V n0, n1, n2;
+                if (testNormal[0]) {
+                    n0 = S::load(testNormal[0] + i);
+                    n1 = S::load(testNormal[1] + i);
+                    n2 = S::load(testNormal[2] + i);
+                } else {
+                    n0 = S::broadcast(trialNormal[0]);
+                    n1 = S::broadcast(trialNormal[1]);
+                    n2 = S::broadcast(trialNormal[2]);
+                }
+                store(normalProducts + i,
+                      S::add(S::add(S::mul(d0, n0), S::mul(d1, n1)),
+                             S::mul(d2, n2)), count);
+            }
+        }
+        return std::min(i, n);
+    }
+
+private:
+    // Store the first count (at most width) elements of x at p
+    static void store(T* p, typename SimdTraits<T>::Vector x, size_t count) {
+        if (count == size_t(width))
+            SimdTraits<T>::store(p, x);
+        else {
+            T buffer[width];
+            SimdTraits<T>::store(buffer, x);
+            std::copy(buffer, buffer + count, p);
+        }
+    }
+};
+
+template <typename T>
+struct PairGeometryVectorLoop<T, 0>
+{
+    static size_t run(size_t, size_t, const T* const*, const T*,
+                      const T* const*, const T*, T*, T*, T*) {
+        return 0;
+    }
+};
+
+// Constants of the approximations used by SimdElementaryFunctions, taken
+// from the Cephes library. Polynomial coefficients are listed from the
+// highest degree down.
+template <typename T>
+struct SimdElementaryFunctionConstants;
+
+template <>
+struct SimdElementaryFunctionConstants<double>
+{
+    enum { EXP_DEGREE = 13, SIN_DEGREE = 5, COS_DEGREE = 5 };
+
+    // Arguments of larger magnitude are left to the scalar code
+    static double maxExpArgument() { return 708.; }
+    static double maxSinCosArgument() { return 1e5; }
+
+    static double log2e() { return 1.44269504088896340736; }
+    static double twoOverPi() { return 0.63661977236758134308; }
+    // ln 2 and pi / 2 split into parts whose products with the integers
+    // arising in argument reduction are exact
+    static double ln2Hi() { return 6.93145751953125e-1; }
+    static double ln2Lo() { return 1.42860682030941723212e-6; }
+    static double piOver2Hi() { return 1.57079625129699707031; }
+    static double piOver2Mid() { return 7.54978941586159635336e-8; }
+    static double piOver2Lo() { return 5.39030285815811905290e-15; }
+
+    // Taylor polynomial of exp(r) for |r| <= ln 2 / 2
+    static const double* expCoefficients() {
+        static const double c[EXP_DEGREE + 1] = {
+            1. / 6227020800., 1. / 479001600., 1. / 39916800.,
+            1. / 3628800., 1. / 362880., 1. / 40320., 1. / 5040., 1. / 720.,
+            1. / 120., 1. / 24., 1. / 6., 1. / 2., 1., 1. };
+        return c;
+    }
+    // sin(r) = r + r z S(z) and cos(r) = 1 - z / 2 + z^2 C(z), with z = r^2,
+    // for |r| <= pi / 4
+    static const double* sinCoefficients() {
+        static const double c[SIN_DEGREE + 1] = {
+            1.58962301576546568060e-10, -2.50507477628578072866e-8,
+            2.75573136213857245213e-6, -1.98412698295895385996e-4,
+            8.33333333332211858878e-3, -1.66666666666666307295e-1 };
+        return c;
+    }
+    static const double* cosCoefficients() {
+        static const double c[COS_DEGREE + 1] = {
+            -1.13585365213876817300e-11, 2.08757008419747316778e-9,
+            -2.75573141792967388112e-7, 2.48015872888517045348e-5,
+            -1.38888888888730564116e-3, 4.16666666666665929218e-2 };
+        return c;
+    }
+};
+
+template <>
+struct SimdElementaryFunctionConstants<float>
+{
+    enum { EXP_DEGREE = 7, SIN_DEGREE = 2, COS_DEGREE = 2 };
+
+    static float maxExpArgument() { return 87.f; }
+    static float maxSinCosArgument() { return 8192.f; }
+
+    static float log2e() { return 1.44269504088896341f; }
+    static float twoOverPi() { return 0.636619772367581343f; }
+    static float ln2Hi() { return 0.693359375f; }
+    static float ln2Lo() { return -2.12194440e-4f; }
+    static float piOver2Hi() { return 1.5703125f; }
+    static float piOver2Mid() { return 4.837512969970703125e-4f; }
+    static float piOver2Lo() { return 7.54978995489188216e-8f; }
+
+    static const float* expCoefficients() {
+        static const float c[EXP_DEGREE + 1] = {
+            1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+            4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f, 1.f, 1.f };
+        return c;
+    }
+    static const float* sinCoefficients() {
+        static const float c[SIN_DEGREE + 1] = {
+            -1.9515295891e-4f, 8.3321608736e-3f, -1.6666654611e-1f };
+        return c;
+    }
+    static const float* cosCoefficients() {
+        static const float c[COS_DEGREE + 1] = {
+            2.443315711809948e-5f, -1.388731625493765e-3f,
+            4.166664568298827e-2f };
+        return c;
+    }
+};
+
+// Vectorized exponential, sine and cosine. The argument is reduced by
+// subtracting the nearest multiple of ln 2 or pi / 2, and the functions are
+// approximated by polynomials on the reduced interval.
+template <typename T>
+struct SimdElementaryFunctions
+{
+    typedef SimdTraits<T> S;
+    typedef typename S::Vector V;
+    typedef SimdElementaryFunctionConstants<T> C;
+
+    // exp(x) for |x| <= C::maxExpArgument()
+    static V exp(V x) {
+        const V n = S::round(S::mul(x, S::broadcast(C::log2e())));
+        V r = S::fmadd(n, S::broadcast(-C::ln2Hi()), x);
+        r = S::fmadd(n, S::broadcast(-C::ln2Lo()), r);
+        return S::mul(polynomial(r, C::expCoefficients(), C::EXP_DEGREE),
+                      S::pow2(n));
+    }
+
+    // sin(x) and cos(x) for |x| <= C::maxSinCosArgument()
+    static void sincos(V x, V& sine, V& cosine) {
+        const V one = S::broadcast(1), half = S::broadcast(0.5);
+        const V q = S::round(S::mul(x, S::broadcast(C::twoOverPi())));
+        V r = S::fmadd(q, S::broadcast(-C::piOver2Hi()), x);
+        r = S::fmadd(q, S::broadcast(-C::piOver2Mid()), r);
+        r = S::fmadd(q, S::broadcast(-C::piOver2Lo()), r);
+        const V z = S::mul(r, r);
+        const V s = S::fmadd(
+                    S::mul(polynomial(z, C::sinCoefficients(), C::SIN_DEGREE),
+                           z), r, r);
+        const V c = S::fmadd(
+                    S::mul(polynomial(z, C::cosCoefficients(), C::COS_DEGREE),
+                           z), z, S::fmadd(S::broadcast(-0.5), z, one));
+
+        // x = q pi / 2 + r; the quadrant q mod 4 determines which of s and c
+        // gives the sine and the cosine, and their signs
+        const V quadrant = S::sub(q, S::mul(S::broadcast(4),
+                                            S::floor(S::mul(q, S::broadcast(0.25)))));
+        const V parity = S::sub(quadrant, S::mul(S::broadcast(2),
+                                                 S::floor(S::mul(quadrant, half))));
+        const typename S::Mask odd = S::greater(parity, half);
+        sine = S::select(odd, c, s);
+        cosine = S::select(odd, s, c);
+        // The sine is negative in quadrants 2 and 3, the cosine in 1 and 2
+        const V zero = S::broadcast(0);
+        sine = S::select(S::greater(quadrant, S::broadcast(1.5)),
+                         S::sub(zero, sine), sine);
+        const typename S::Mask cosineNegative =
+                S::greater(S::select(S::greater(quadrant, S::broadcast(2.5)),
+                                     zero, quadrant), half);
+        cosine = S::select(cosineNegative, S::sub(zero, cosine), cosine);
+    }
+
+private:
+    static V polynomial(V x, const T* coefficients, int degree) {
+        V y = S::broadcast(coefficients[0]);
+        for (int i = 1; i <= degree; ++i)
+            y = S::fmadd(y, x, S::broadcast(coefficients[i]));
+        return y;
+    }
+};
+
+// Process the arguments [0, n) in groups of SimdTraits<T>::width; return the
+// number of arguments processed. Processing stops before the first group
+// containing an argument outside the range of SimdElementaryFunctions or an
+// incomplete group; the caller handles the remaining arguments.
+template <typename T, int width = SimdTraits<T>::width>
+struct ExponentialVectorLoop
+{
+    // result[k] = exp(a x[k])
+    static size_t runReal(size_t n, T a, const T* x, T* result) {
+        typedef SimdTraits<T> S;
+        typedef typename S::Vector V;
+        typedef SimdElementaryFunctions<T> F;
+        const V va = S::broadcast(a);
+        const V maxArgument =
+                S::broadcast(SimdElementaryFunctionConstants<T>::maxExpArgument());
+        const V minArgument = S::sub(S::broadcast(0), maxArgument);
+        size_t i = 0;
+        for (; i + width <= n; i += width) {
+            const V argument = S::mul(va, S::load(x + i));
+            if (S::any(S::greater(argument, maxArgument)) ||
+                    S::any(S::greater(minArgument, argument)))
+                break;
+            S::store(result + i, F::exp(argument));
+        }
+        return i;
+    }
+
+    // realParts[k] + i imagParts[k] = exp((a + i b) x[k])
+    static size_t runComplex(size_t n, T a, T b, const T* x,
+                             T* realParts, T* imagParts) {
+        typedef SimdTraits<T> S;
+        typedef typename S::Vector V;
+        typedef SimdElementaryFunctions<T> F;
+        typedef SimdElementaryFunctionConstants<T> C;
+        const V va = S::broadcast(a), vb = S::broadcast(b);
+        const V zero = S::broadcast(0);
+        const V maxExpArgument = S::broadcast(C::maxExpArgument());
+        const V minExpArgument = S::sub(zero, maxExpArgument);
+        const V maxSinCosArgument = S::broadcast(C::maxSinCosArgument());
+        const V minSinCosArgument = S::sub(zero, maxSinCosArgument);
+        size_t i = 0;
+        for (; i + width <= n; i += width) {
+            const V xi = S::load(x + i);
+            const V expArgument = S::mul(va, xi);
+            const V sinCosArgument = S::mul(vb, xi);
+            if (S::any(S::greater(expArgument, maxExpArgument)) ||
+                    S::any(S::greater(minExpArgument, expArgument)) ||
+                    S::any(S::greater(sinCosArgument, maxSinCosArgument)) ||
+                    S::any(S::greater(minSinCosArgument, sinCosArgument)))
+                break;
+            V sine, cosine;
+            F::sincos(sinCosArgument, sine, cosine);
+            const V modulus = F::exp(expArgument);
+            S::store(realParts + i, S::mul(modulus, cosine));
+            S::store(imagParts + i, S::mul(modulus, sine));
+        }
+        return i;
+    }
+};
+
+template <typename T>
+struct ExponentialVectorLoop<T, 0>
+{
+    static size_t runReal(size_t, T, const T*, T*) {
+        return 0;
+    }
+    static size_t runComplex(size_t, T, T, const T*, T*, T*) {
+        return 0;
+    }
+};
+/** \endcond */
+
+/** \brief Evaluate the geometrical quantities entering simple kernels at a
+ *  batch of point pairs.
+ *
+ *  For each pair (test point \f$x\f$, trial point \f$y\f$) arranged as
+ *  specified by \p layout, the distance \f$r = |x - y|\f$, its inverse and
+ *  the product \f$(x - y) \cdot n\f$, with \f$n\f$ denoting the unit normal
+ *  at the test or trial point (depending on \p normalSource), are stored in
+ *  the arrays \p distances, \p inverseDistances and \p normalProducts,
+ *  respectively. Any of these pointers may be null, in which case the
+ *  corresponding quantity is not computed; \p normalProducts must be null if
+ *  \p normalSource is NO_NORMALS.
+ *
+ *  The ON_GRID layout is vectorized over test points with AVX-512 or AVX2
+ *  instructions if BEM++ is configured with the WITH_AVX512 or WITH_AVX
+ *  CMake option. If the test point
+ *  arrays are padded (see SoaGeometricalData), the last, incomplete group of
+ *  test points is vectorized as well. */
+template <typename CoordinateType>
+void evaluatePairGeometry(KernelPointLayout layout,
+                          const KernelPointBlock<CoordinateType>& testPoints,
+                          const KernelPointBlock<CoordinateType>& trialPoints,
+                          PairNormalSource normalSource,
+                          CoordinateType* distances,
+                          CoordinateType* inverseDistances,
+                          CoordinateType* normalProducts)
+{
+    typedef CoordinateType T;
+    assert(normalSource != NO_NORMALS || !normalProducts);
+    const T* const* x = testPoints.globals;
+    const T* const* y = trialPoints.globals;
+    const T* const noNormals[3] = { 0, 0, 0 };
+    const T* const* testNormal =
+            normalSource == TEST_NORMALS ? testPoints.normals : noNormals;
+    const T* const* trialNormal =
+            normalSource == TRIAL_NORMALS ? trialPoints.normals : noNormals;
+
+    const size_t testPointCount = testPoints.pointCount;
+    const size_t trialPointCount = trialPoints.pointCount;
+    if (layout == AT_POINT_PAIRS) {
+        assert(testPointCount == trialPointCount);
+#pragma ivdep
+        for (size_t i = 0; i < testPointCount; ++i) {
+            const T d0 = x[0][i] - y[0][i];
+            const T d1 = x[1][i] - y[1][i];
+            const T d2 = x[2][i] - y[2][i];
+            const T r = std::sqrt(d0 * d0 + d1 * d1 + d2 * d2);
+            if (distances)
+                distances[i] = r;
+            if (inverseDistances)
+                inverseDistances[i] = static_cast<T>(1) / r;
+            if (normalProducts) {
+                const T* const* n = testNormal[0] ? testNormal : trialNormal;
+                normalProducts[i] = d0 * n[0][i] + d1 * n[1][i] +
+                        d2 * n[2][i];
+            }
+        }
+        return;
+    }
+
+    for (size_t j = 0; j < trialPointCount; ++j) {
+        const size_t offset = j * testPointCount;
+        const T yj[3] = { y[0][j], y[1][j], y[2][j] };
+        T nj[3] = { 0, 0, 0 };
+        if (trialNormal[0])
+            for (int dim = 0; dim < 3; ++dim)
+                nj[dim] = trialNormal[dim][j];
+        size_t i = PairGeometryVectorLoop<T>::run(
+                    testPointCount, testPoints.paddedPointCount,
+                    x, yj, testNormal, nj,
+                    distances ? distances + offset : 0,
+                    inverseDistances ? inverseDistances + offset : 0,
+                    normalProducts ? normalProducts + offset : 0);
+        // Remainder (or all points, if no vector instructions are enabled)
+        for (; i < testPointCount; ++i) {
+            const T d0 = x[0][i] - yj[0];
+            const T d1 = x[1][i] - yj[1];
+            const T d2 = x[2][i] - yj[2];
+            const T r = std::sqrt(d0 * d0 + d1 * d1 + d2 * d2);
+            if (distances)
+                distances[offset + i] = r;
+            if (inverseDistances)
+                inverseDistances[offset + i] = static_cast<T>(1) / r;
+            if (normalProducts) {
+                if (testNormal[0])
+                    normalProducts[offset + i] = d0 * testNormal[0][i] +
+                            d1 * testNormal[1][i] + d2 * testNormal[2][i];
+                else
+                    normalProducts[offset + i] =
+                            d0 * nj[0] + d1 * nj[1] + d2 * nj[2];
+            }
+        }
+    }
+}
+
+/** \brief Reusable buffers of the batched kernel evaluation.
+ *
+ *  DefaultCollectionOfKernels keeps one object of this class per thread and
+ *  passes it to the evaluateBatch() method of kernel functors, so that
+ *  neither the structure-of-arrays copies of the geometrical data nor the
+ *  arrays of intermediate quantities are reallocated on every call.
+ *  Arrays 0 to 2 are at the disposal of the kernel functors; arrays 3 and 4
+ *  are used by evaluateExponentials(). */
+template <typename CoordinateType>
+struct KernelBatchScratch
+{
+    /** \brief Geometrical data of the test and trial points, filled with
+     *  SoaGeometricalData::assign(). */
+    SoaGeometricalData<CoordinateType> testGeomData;
+    SoaGeometricalData<CoordinateType> trialGeomData;
+
+    /** \brief Return a pointer to the <em>i</em>th of five arrays
+     *  (0 <= <em>i</em> < 5) of at least \p count elements.
+     *
+     *  The arrays only grow, so after the first few calls no memory is
+     *  allocated. Their contents are undefined. */
+    CoordinateType* array(int i, size_t count) {
+        assert(0 <= i && i < ARRAY_COUNT);
+        if (m_arrays[i].size() < count)
+            m_arrays[i].resize(count);
+        return count ? &m_arrays[i][0] : 0;
+    }
+
+private:
+    enum { ARRAY_COUNT = 5 };
+    std::vector<CoordinateType> m_arrays[ARRAY_COUNT];
+};
+
+/** \brief Evaluate \f$\exp(-\kappa r)\f$ at a batch of distances \f$r\f$.
+ *
+ *  Stores \f$\exp(-\kappa r_k)\f$, where \f$\kappa\f$ is \p waveNumber and
+ *  \f$r_k\f$ is <tt>distances[k]</tt>, in <tt>result[k]</tt> for
+ *  <tt>k = 0, ..., count - 1</tt>.
+ *
+ *  If BEM++ is configured with the WITH_AVX512 or WITH_AVX CMake option, the
+ *  exponential (and, for complex \p waveNumber, the sine and cosine) is
+ *  evaluated with vector instructions, using polynomial approximations after
+ *  argument reduction; the results agree with those of the standard library
+ *  to a few units in the last place. Arguments outside the range of these
+ *  approximations are handled by the standard library. */
+template <typename CoordinateType>
+void evaluateExponentials(size_t count, CoordinateType waveNumber,
+                          const CoordinateType* distances,
+                          KernelBatchScratch<CoordinateType>& /* scratch */,
+                          CoordinateType* result)
+{
+    size_t k = ExponentialVectorLoop<CoordinateType>::runReal(
+                count, -waveNumber, distances, result);
+    for (; k < count; ++k)
+        result[k] = std::exp(-waveNumber * distances[k]);
+}
+
+template <typename CoordinateType>
+void evaluateExponentials(size_t count,
+                          std::complex<CoordinateType> waveNumber,
+                          const CoordinateType* distances,
+                          KernelBatchScratch<CoordinateType>& scratch,
+                          std::complex<CoordinateType>* result)
+{
+    size_t k = 0;
+    if (SimdTraits<CoordinateType>::width != 0) {
+        CoordinateType* realParts = scratch.array(3, count);
+        CoordinateType* imagParts = scratch.array(4, count);
+        k = ExponentialVectorLoop<CoordinateType>::runComplex(
+                    count, -waveNumber.real(), -waveNumber.imag(), distances,
+                    realParts, imagParts);
+        for (size_t l = 0; l < k; ++l)
+            result[l] = std::complex<CoordinateType>(realParts[l],
+                                                     imagParts[l]);
+    }
+    for (; k < count; ++k)
+        result[k] = std::exp(-waveNumber * distances[k]);
+}
+
+/** \brief Number of point pairs in a batch with the given layout. */
+template <typename CoordinateType>
+size_t kernelPointPairCount(KernelPointLayout layout,
+                            const KernelPointBlock<CoordinateType>& testPoints,
+                            const KernelPointBlock<CoordinateType>& trialPoints)
+{
+    return layout == ON_GRID ?
+                testPoints.pointCount * trialPoints.pointCount :
+                testPoints.pointCount;
+}
+
+} // namespace Fiber
+
+#endif
@@ -24,6 +24,7 @@
 #include "../common/common.hpp"
 
 #include "geometrical_data.hpp"
+#include "kernel_point_block.hpp"
 #include "scalar_traits.hpp"
 
 namespace Fiber
@@ -74,6 +75,29 @@ public:
         result[0](0, 0) = static_cast<CoordinateType>(1. / (4. * M_PI)) /
                 sqrt(sum);
     }
+
+    /** \brief Evaluate the kernel at a batch of point pairs.
+     *
+     *  See DefaultCollectionOfKernels for a description of this interface. */
+    void evaluateBatch(
+            KernelPointLayout layout,
+            const KernelPointBlock<CoordinateType>& testPoints,
+            const KernelPointBlock<CoordinateType>& trialPoints,
+            KernelBatchScratch<CoordinateType>& scratch,
+            ValueType* result) const {
+        const size_t count =
+                kernelPointPairCount(layout, testPoints, trialPoints);
+        if (count == 0)
+            return;
+        CoordinateType* const none = 0;
+        CoordinateType* inverseDistances = scratch.array(0, count);
+        evaluatePairGeometry(layout, testPoints, trialPoints, NO_NORMALS,
+                             none, inverseDistances, none);
+        const CoordinateType factor =
+                static_cast<CoordinateType>(1. / (4. * M_PI));
+        for (size_t k = 0; k < count; ++k)
+            result[k] = factor * inverseDistances[k];
+    }
 };
 
 } // namespace Fiber
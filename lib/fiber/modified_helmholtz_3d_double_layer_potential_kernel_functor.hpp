@@ -24,6 +24,7 @@
 #include "../common/common.hpp"
 
 #include "geometrical_data.hpp"
+#include "kernel_point_block.hpp"
 #include "scalar_traits.hpp"
 
 #include "../common/complex_aux.hpp"
@@ -89,6 +90,35 @@ public:
                 exp(-m_waveNumber * distance);
     }
 
+    /** \brief Evaluate the kernel at a batch of point pairs.
+     *
+     *  See DefaultCollectionOfKernels for a description of this interface. */
+    void evaluateBatch(
+            KernelPointLayout layout,
+            const KernelPointBlock<CoordinateType>& testPoints,
+            const KernelPointBlock<CoordinateType>& trialPoints,
+            KernelBatchScratch<CoordinateType>& scratch,
+            ValueType* result) const {
+        const size_t count =
+                kernelPointPairCount(layout, testPoints, trialPoints);
+        if (count == 0)
+            return;
+        CoordinateType* distances = scratch.array(0, count);
+        CoordinateType* inverseDistances = scratch.array(1, count);
+        CoordinateType* normalProducts = scratch.array(2, count);
+        evaluatePairGeometry(layout, testPoints, trialPoints, TRIAL_NORMALS,
+                             distances, inverseDistances, normalProducts);
+        const CoordinateType factor =
+                static_cast<CoordinateType>(1. / (4. * M_PI));
+        evaluateExponentials(count, m_waveNumber, distances, scratch, result);
+        for (size_t k = 0; k < count; ++k) {
+            const CoordinateType inverseDistance = inverseDistances[k];
+            result[k] *= factor * normalProducts[k] *
+                    inverseDistance * inverseDistance *
+                    (m_waveNumber + inverseDistance);
+        }
+    }
+
     CoordinateType estimateRelativeScale(CoordinateType distance) const {
         return exp(-realPart(m_waveNumber) * distance);
     }
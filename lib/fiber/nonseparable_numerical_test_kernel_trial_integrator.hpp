@@ -23,6 +23,7 @@
 
 #include "../common/common.hpp"
 
+#include "basis_data_cache.hpp"
 #include "test_kernel_trial_integrator.hpp"
 
 #include <tbb/enumerable_thread_specific.h>
@@ -99,6 +100,9 @@ private:
     // is very time-consuming due to the presence of arma::Cube objects.
     mutable tbb::enumerable_thread_specific<GeometricalData<CoordinateType> > 
     m_testGeomData, m_trialGeomData;
+    // Basis function values at the quadrature points of the reference element
+    mutable tbb::enumerable_thread_specific<BasisDataCache<BasisFunctionType> >
+    m_basisDataCache;
 };
 
 } // namespace Fiber
@@ -29,6 +29,7 @@
 
 #include "basis.hpp"
 #include "basis_data.hpp"
+#include "basis_data_cache.hpp"
 #include "conjugate.hpp"
 #include "collection_of_basis_transformations.hpp"
 #include "geometrical_data.hpp"
@@ -117,7 +118,7 @@ integrate(
     const int testDofCount = callVariant == TEST_TRIAL ? dofCountA : dofCountB;
     const int trialDofCount = callVariant == TEST_TRIAL ? dofCountB : dofCountA;
 
-    BasisData<BasisFunctionType> testBasisData, trialBasisData;
+    BasisDataCache<BasisFunctionType>& basisDataCache = m_basisDataCache.local();
     GeometricalData<CoordinateType>& testGeomData = m_testGeomData.local();
     GeometricalData<CoordinateType>& trialGeomData = m_trialGeomData.local();
 
@@ -148,7 +149,9 @@ integrate(
         rawGeometryB = &m_testRawGeometry;
     }
 
-    CollectionOf3dArrays<BasisFunctionType> testValues, trialValues;
+    CollectionOf3dArrays<BasisFunctionType> testBuffer, trialBuffer;
+    const CollectionOf3dArrays<BasisFunctionType>* testValues = 0;
+    const CollectionOf3dArrays<BasisFunctionType>* trialValues = 0;
     CollectionOf3dArrays<KernelType> kernelValues;
 
     for (size_t i = 0; i < result.size(); ++i) {
@@ -159,17 +162,17 @@ integrate(
     rawGeometryB->setupGeometry(elementIndexB, *geometryB);
     if (callVariant == TEST_TRIAL)
     {
-        basisA.evaluate(testBasisDeps, m_localTestQuadPoints, ALL_DOFS, testBasisData);
-        basisB.evaluate(trialBasisDeps, m_localTrialQuadPoints, localDofIndexB, trialBasisData);
         geometryB->getData(trialGeomDeps, m_localTrialQuadPoints, trialGeomData);
-        m_trialTransformations.evaluate(trialBasisData, trialGeomData, trialValues);
+        trialValues = &basisDataCache.transformedValues(
+                    m_trialTransformations, basisB, m_localTrialQuadPoints,
+                    localDofIndexB, trialGeomData, trialBuffer);
     }
     else
     {
-        basisA.evaluate(trialBasisDeps, m_localTrialQuadPoints, ALL_DOFS, trialBasisData);
-        basisB.evaluate(testBasisDeps, m_localTestQuadPoints, localDofIndexB, testBasisData);
         geometryB->getData(testGeomDeps, m_localTestQuadPoints, testGeomData);
-        m_testTransformations.evaluate(testBasisData, testGeomData, testValues);
+        testValues = &basisDataCache.transformedValues(
+                    m_testTransformations, basisB, m_localTestQuadPoints,
+                    localDofIndexB, testGeomData, testBuffer);
     }
 
     // Iterate over the elements
@@ -179,17 +182,21 @@ integrate(
         if (callVariant == TEST_TRIAL)
         {
             geometryA->getData(testGeomDeps, m_localTestQuadPoints, testGeomData);
-            m_testTransformations.evaluate(testBasisData, testGeomData, testValues);
+            testValues = &basisDataCache.transformedValues(
+                        m_testTransformations, basisA, m_localTestQuadPoints,
+                        ALL_DOFS, testGeomData, testBuffer);
         }
         else
         {
             geometryA->getData(trialGeomDeps, m_localTrialQuadPoints, trialGeomData);
-            m_trialTransformations.evaluate(trialBasisData, trialGeomData, trialValues);
+            trialValues = &basisDataCache.transformedValues(
+                        m_trialTransformations, basisA, m_localTrialQuadPoints,
+                        ALL_DOFS, trialGeomData, trialBuffer);
         }
 
         m_kernels.evaluateAtPointPairs(testGeomData, trialGeomData, kernelValues);
         m_integral.evaluateWithNontensorQuadratureRule(
-                    testGeomData, trialGeomData, testValues, trialValues,
+                    testGeomData, trialGeomData, *testValues, *trialValues,
                     kernelValues, m_quadWeights,
                     *result[indexA]);
     }
@@ -222,7 +229,7 @@ integrate(
     const int testDofCount = testBasis.size();
     const int trialDofCount = trialBasis.size();
 
-    BasisData<BasisFunctionType> testBasisData, trialBasisData;
+    BasisDataCache<BasisFunctionType>& basisDataCache = m_basisDataCache.local();
     GeometricalData<CoordinateType>& testGeomData = m_testGeomData.local();
     GeometricalData<CoordinateType>& trialGeomData = m_trialGeomData.local();
 
@@ -238,7 +245,9 @@ integrate(
     std::auto_ptr<Geometry> testGeometry(m_testGeometryFactory.make());
     std::auto_ptr<Geometry> trialGeometry(m_trialGeometryFactory.make());
 
-    CollectionOf3dArrays<BasisFunctionType> testValues, trialValues;
+    CollectionOf3dArrays<BasisFunctionType> testBuffer, trialBuffer;
+    const CollectionOf3dArrays<BasisFunctionType>* testValues = 0;
+    const CollectionOf3dArrays<BasisFunctionType>* trialValues = 0;
     CollectionOf3dArrays<KernelType> kernelValues;
 
     for (size_t i = 0; i < result.size(); ++i) {
@@ -246,9 +255,6 @@ integrate(
         result[i]->set_size(testDofCount, trialDofCount);
     }
 
-    testBasis.evaluate(testBasisDeps, m_localTestQuadPoints, ALL_DOFS, testBasisData);
-    trialBasis.evaluate(trialBasisDeps, m_localTrialQuadPoints, ALL_DOFS, trialBasisData);
-
     // Iterate over the elements
     for (int pairIndex = 0; pairIndex < geometryPairCount; ++pairIndex)
     {
@@ -256,12 +262,16 @@ integrate(
         m_trialRawGeometry.setupGeometry(elementIndexPairs[pairIndex].second, *trialGeometry);
         testGeometry->getData(testGeomDeps, m_localTestQuadPoints, testGeomData);
         trialGeometry->getData(trialGeomDeps, m_localTrialQuadPoints, trialGeomData);
-        m_testTransformations.evaluate(testBasisData, testGeomData, testValues);
-        m_trialTransformations.evaluate(trialBasisData, trialGeomData, trialValues);
+        testValues = &basisDataCache.transformedValues(
+                    m_testTransformations, testBasis, m_localTestQuadPoints,
+                    ALL_DOFS, testGeomData, testBuffer);
+        trialValues = &basisDataCache.transformedValues(
+                    m_trialTransformations, trialBasis, m_localTrialQuadPoints,
+                    ALL_DOFS, trialGeomData, trialBuffer);
 
         m_kernels.evaluateAtPointPairs(testGeomData, trialGeomData, kernelValues);
         m_integral.evaluateWithNontensorQuadratureRule(
-                    testGeomData, trialGeomData, testValues, trialValues,
+                    testGeomData, trialGeomData, *testValues, *trialValues,
                     kernelValues, m_quadWeights,
                     *result[pairIndex]);
     }
@@ -25,6 +25,8 @@
 
 #include "bempp/common/config_opencl.hpp"
 
+#include "basis_data_cache.hpp"
+#include "geometrical_data.hpp"
 #include "test_kernel_trial_integrator.hpp"
 
 #include <tbb/enumerable_thread_specific.h>
@@ -34,6 +36,8 @@ namespace Fiber
 
 /** \cond FORWARD_DECL */
 class OpenClHandler;
+template <typename T> class CollectionOf3dArrays;
+template <typename T> class CollectionOf4dArrays;
 template <typename CoordinateType> class CollectionOfBasisTransformations;
 template <typename ValueType> class CollectionOfKernels;
 template <typename CoordinateType> class RawGridGeometry;
@@ -116,6 +120,26 @@ private:
             const Basis<BasisFunctionType>& trialBasis,
             const std::vector<arma::Mat<ResultType>*>& result) const;
 
+    // Integrate over a single pair of elements
+    void integrateOnElementPair(
+            const GeometricalData<CoordinateType>& testGeomData,
+            const GeometricalData<CoordinateType>& trialGeomData,
+            const CollectionOf3dArrays<BasisFunctionType>& testValues,
+            const CollectionOf3dArrays<BasisFunctionType>& trialValues,
+            CollectionOf4dArrays<KernelType>& kernelValues,
+            arma::Mat<ResultType>& result) const;
+
+    // Integrate over a single pair of elements an integral for which
+    // m_integral.isSimpleTestScalarKernelTrialIntegral() returns true,
+    // evaluating the kernel on tiles of trial points
+    void integrateSimpleIntegralOnElementPair(
+            const GeometricalData<CoordinateType>& testGeomData,
+            const GeometricalData<CoordinateType>& trialGeomData,
+            const CollectionOf3dArrays<BasisFunctionType>& testValues,
+            const CollectionOf3dArrays<BasisFunctionType>& trialValues,
+            CollectionOf4dArrays<KernelType>& kernelValues,
+            arma::Mat<ResultType>& result) const;
+
     void precalculateGeometricalData();
     void precalculateGeometricalDataOnSingleGrid(
             const arma::Mat<CoordinateType>& localQuadPoints,
@@ -152,6 +176,21 @@ private:
     std::vector<GeometricalData<CoordinateType> > m_cachedTrialGeomData;
     mutable tbb::enumerable_thread_specific<GeometricalData<CoordinateType> >
     m_testGeomData, m_trialGeomData;
+    // Basis function values at the quadrature points of the reference element
+    mutable tbb::enumerable_thread_specific<BasisDataCache<BasisFunctionType> >
+    m_basisDataCache;
+
+    // Buffers of integrateSimpleIntegralOnElementPair(), reused for all
+    // element pairs processed by a thread
+    struct SimpleIntegralScratch
+    {
+        std::vector<arma::Mat<ResultType> > weightedTestValues;
+        std::vector<arma::Mat<ResultType> > weightedTrialValues;
+        std::vector<arma::Mat<ResultType> > kernelTimesTrialValues;
+        GeometricalData<CoordinateType> tileGeomData;
+    };
+    mutable tbb::enumerable_thread_specific<SimpleIntegralScratch>
+    m_simpleIntegralScratch;
 
 
 #ifdef WITH_OPENCL
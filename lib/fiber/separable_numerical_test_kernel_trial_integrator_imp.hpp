@@ -30,6 +30,7 @@
 
 #include "basis.hpp"
 #include "basis_data.hpp"
+#include "basis_data_cache.hpp"
 #include "conjugate.hpp"
 #include "collection_of_basis_transformations.hpp"
 #include "geometrical_data.hpp"
@@ -42,6 +43,7 @@
 
 #include "../common/auto_timer.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 
@@ -223,7 +225,7 @@ integrateCpu(
     const int testDofCount = callVariant == TEST_TRIAL ? dofCountA : dofCountB;
     const int trialDofCount = callVariant == TEST_TRIAL ? dofCountB : dofCountA;
 
-    BasisData<BasisFunctionType> testBasisData, trialBasisData;
+    BasisDataCache<BasisFunctionType>& basisDataCache = m_basisDataCache.local();
     GeometricalData<CoordinateType>* testGeomData = &m_testGeomData.local();
     GeometricalData<CoordinateType>* trialGeomData = &m_trialGeomData.local();
     const GeometricalData<CoordinateType>* constTestGeomData = testGeomData;
@@ -257,7 +259,9 @@ integrateCpu(
         }
     }
 
-    CollectionOf3dArrays<BasisFunctionType> testValues, trialValues;
+    CollectionOf3dArrays<BasisFunctionType> testBuffer, trialBuffer;
+    const CollectionOf3dArrays<BasisFunctionType>* testValues = 0;
+    const CollectionOf3dArrays<BasisFunctionType>* trialValues = 0;
     CollectionOf4dArrays<KernelType> kernelValues;
 
     for (size_t i = 0; i < result.size(); ++i) {
@@ -269,23 +273,23 @@ integrateCpu(
         rawGeometryB->setupGeometry(elementIndexB, *geometryB);
     if (callVariant == TEST_TRIAL)
     {
-        basisA.evaluate(testBasisDeps, m_localTestQuadPoints, ALL_DOFS, testBasisData);
-        basisB.evaluate(trialBasisDeps, m_localTrialQuadPoints, localDofIndexB, trialBasisData);
         if (m_cacheGeometricalData)
             constTrialGeomData = &m_cachedTrialGeomData[elementIndexB];
         else
             geometryB->getData(trialGeomDeps, m_localTrialQuadPoints, *trialGeomData);
-        m_trialTransformations.evaluate(trialBasisData, *constTrialGeomData, trialValues);
+        trialValues = &basisDataCache.transformedValues(
+                    m_trialTransformations, basisB, m_localTrialQuadPoints,
+                    localDofIndexB, *constTrialGeomData, trialBuffer);
     }
     else
     {
-        basisA.evaluate(trialBasisDeps, m_localTrialQuadPoints, ALL_DOFS, trialBasisData);
-        basisB.evaluate(testBasisDeps, m_localTestQuadPoints, localDofIndexB, testBasisData);
         if (m_cacheGeometricalData)
             constTestGeomData = &m_cachedTestGeomData[elementIndexB];
         else
             geometryB->getData(testGeomDeps, m_localTestQuadPoints, *testGeomData);
-        m_testTransformations.evaluate(testBasisData, *constTestGeomData, testValues);
+        testValues = &basisDataCache.transformedValues(
+                    m_testTransformations, basisB, m_localTestQuadPoints,
+                    localDofIndexB, *constTestGeomData, testBuffer);
     }
 
     // Iterate over the elements
@@ -299,7 +303,9 @@ integrateCpu(
                 constTestGeomData = &m_cachedTestGeomData[elementIndicesA[indexA]];
             else
                 geometryA->getData(testGeomDeps, m_localTestQuadPoints, *testGeomData);
-            m_testTransformations.evaluate(testBasisData, *constTestGeomData, testValues);
+            testValues = &basisDataCache.transformedValues(
+                        m_testTransformations, basisA, m_localTestQuadPoints,
+                        ALL_DOFS, *constTestGeomData, testBuffer);
         }
         else
         {
@@ -307,17 +313,138 @@ integrateCpu(
                 constTrialGeomData = &m_cachedTrialGeomData[elementIndicesA[indexA]];
             else
                 geometryA->getData(trialGeomDeps, m_localTrialQuadPoints, *trialGeomData);
-            m_trialTransformations.evaluate(trialBasisData, *constTrialGeomData, trialValues);
+            trialValues = &basisDataCache.transformedValues(
+                        m_trialTransformations, basisA, m_localTrialQuadPoints,
+                        ALL_DOFS, *constTrialGeomData, trialBuffer);
         }
 
-        m_kernels.evaluateOnGrid(*constTestGeomData, *constTrialGeomData, kernelValues);
-        m_integral.evaluateWithTensorQuadratureRule(
-                    *constTestGeomData, *constTrialGeomData, testValues, trialValues,
-                    kernelValues, m_testQuadWeights, m_trialQuadWeights,
-                    *result[indexA]);
+        integrateOnElementPair(*constTestGeomData, *constTrialGeomData,
+                               *testValues, *trialValues, kernelValues,
+                               *result[indexA]);
     }
 }
 
+template <typename BasisFunctionType, typename KernelType,
+          typename ResultType, typename GeometryFactory>
+void SeparableNumericalTestKernelTrialIntegrator<
+BasisFunctionType, KernelType, ResultType, GeometryFactory>::
+integrateOnElementPair(
+        const GeometricalData<CoordinateType>& testGeomData,
+        const GeometricalData<CoordinateType>& trialGeomData,
+        const CollectionOf3dArrays<BasisFunctionType>& testValues,
+        const CollectionOf3dArrays<BasisFunctionType>& trialValues,
+        CollectionOf4dArrays<KernelType>& kernelValues,
+        arma::Mat<ResultType>& result) const
+{
+    if (m_integral.isSimpleTestScalarKernelTrialIntegral()) {
+        integrateSimpleIntegralOnElementPair(
+                    testGeomData, trialGeomData, testValues, trialValues,
+                    kernelValues, result);
+        return;
+    }
+    m_kernels.evaluateOnGrid(testGeomData, trialGeomData, kernelValues);
+    m_integral.evaluateWithTensorQuadratureRule(
+                testGeomData, trialGeomData, testValues, trialValues,
+                kernelValues, m_testQuadWeights, m_trialQuadWeights,
+                result);
+}
+
+template <typename BasisFunctionType, typename KernelType,
+          typename ResultType, typename GeometryFactory>
+void SeparableNumericalTestKernelTrialIntegrator<
+BasisFunctionType, KernelType, ResultType, GeometryFactory>::
+integrateSimpleIntegralOnElementPair(
+        const GeometricalData<CoordinateType>& testGeomData,
+        const GeometricalData<CoordinateType>& trialGeomData,
+        const CollectionOf3dArrays<BasisFunctionType>& testValues,
+        const CollectionOf3dArrays<BasisFunctionType>& trialValues,
+        CollectionOf4dArrays<KernelType>& kernelValues,
+        arma::Mat<ResultType>& result) const
+{
+    // The integral is
+    //   sum_d sum_p sum_q conj(phi_id(x_p)) w_p K(x_p, y_q) w_q psi_jd(y_q),
+    // where w_p and w_q include the integration elements. It is evaluated as
+    // sum_d A_d (K B_d), with A_d(i, p) = conj(phi_id(x_p)) w_p and
+    // B_d(q, j) = w_q psi_jd(y_q). The kernel is evaluated on tiles of trial
+    // points small enough to stay in cache, and each tile is multiplied by
+    // the corresponding rows of B_d immediately.
+    const _3dArray<BasisFunctionType>& testArray = testValues[0];
+    const _3dArray<BasisFunctionType>& trialArray = trialValues[0];
+    const size_t componentCount = testArray.extent(0);
+    const size_t testDofCount = testArray.extent(1);
+    const size_t trialDofCount = trialArray.extent(1);
+    const size_t testPointCount = m_testQuadWeights.size();
+    const size_t trialPointCount = m_trialQuadWeights.size();
+    assert(trialArray.extent(0) == componentCount);
+    assert(testArray.extent(2) == testPointCount);
+    assert(trialArray.extent(2) == trialPointCount);
+
+    // Maximum number of kernel values stored at a time
+    const size_t MAX_TILE_SIZE = 1024;
+    const size_t tileTrialPointCount =
+            std::max<size_t>(1, MAX_TILE_SIZE / testPointCount);
+
+    SimpleIntegralScratch& scratch = m_simpleIntegralScratch.local();
+    std::vector<arma::Mat<ResultType> >& weightedTestValues =
+            scratch.weightedTestValues;
+    std::vector<arma::Mat<ResultType> >& weightedTrialValues =
+            scratch.weightedTrialValues;
+    std::vector<arma::Mat<ResultType> >& kernelTimesTrialValues =
+            scratch.kernelTimesTrialValues;
+    weightedTestValues.resize(componentCount);
+    weightedTrialValues.resize(componentCount);
+    kernelTimesTrialValues.resize(componentCount);
+    for (size_t d = 0; d < componentCount; ++d) {
+        arma::Mat<ResultType>& a = weightedTestValues[d];
+        a.set_size(testDofCount, testPointCount);
+        for (size_t p = 0; p < testPointCount; ++p) {
+            const CoordinateType weight = m_testQuadWeights[p] *
+                    testGeomData.integrationElements(p);
+            for (size_t i = 0; i < testDofCount; ++i)
+                a(i, p) = conjugate(testArray(d, i, p)) * weight;
+        }
+        arma::Mat<ResultType>& b = weightedTrialValues[d];
+        b.set_size(trialPointCount, trialDofCount);
+        for (size_t j = 0; j < trialDofCount; ++j)
+            for (size_t q = 0; q < trialPointCount; ++q)
+                b(q, j) = trialArray(d, j, q) * (m_trialQuadWeights[q] *
+                        trialGeomData.integrationElements(q));
+        kernelTimesTrialValues[d].zeros(testPointCount, trialDofCount);
+    }
+
+    for (size_t begin = 0; begin < trialPointCount;
+         begin += tileTrialPointCount) {
+        const size_t end = std::min(begin + tileTrialPointCount,
+                                    trialPointCount);
+        const size_t tileSize = end - begin;
+        if (begin == 0 && end == trialPointCount)
+            m_kernels.evaluateOnGrid(testGeomData, trialGeomData,
+                                     kernelValues);
+        else {
+            extractPointRange(trialGeomData, begin, end, scratch.tileGeomData);
+            m_kernels.evaluateOnGrid(testGeomData, scratch.tileGeomData,
+                                     kernelValues);
+        }
+        // The values of a scalar kernel are stored in the same order as the
+        // elements of a column-major testPointCount x tileSize matrix, so
+        // the kernel array is used as the tile without copying
+        _4dArray<KernelType>& kernelArray = kernelValues[0];
+        assert(kernelArray.extent(0) == 1 && kernelArray.extent(1) == 1);
+        assert(kernelArray.extent(2) == testPointCount &&
+               kernelArray.extent(3) == tileSize);
+        const arma::Mat<KernelType> kernelTile(
+                    kernelArray.begin(), testPointCount, tileSize,
+                    false /* copy_aux_mem */, true /* strict */);
+        for (size_t d = 0; d < componentCount; ++d)
+            kernelTimesTrialValues[d] += kernelTile *
+                    weightedTrialValues[d].rows(begin, end - 1);
+    }
+
+    result = weightedTestValues[0] * kernelTimesTrialValues[0];
+    for (size_t d = 1; d < componentCount; ++d)
+        result += weightedTestValues[d] * kernelTimesTrialValues[d];
+}
+
 template <typename BasisFunctionType, typename KernelType,
           typename ResultType, typename GeometryFactory>
 void
@@ -699,7 +826,7 @@ integrateCpu(
     const int testDofCount = testBasis.size();
     const int trialDofCount = trialBasis.size();
 
-    BasisData<BasisFunctionType> testBasisData, trialBasisData;
+    BasisDataCache<BasisFunctionType>& basisDataCache = m_basisDataCache.local();
     GeometricalData<CoordinateType>* testGeomData = &m_testGeomData.local();
     GeometricalData<CoordinateType>* trialGeomData = &m_trialGeomData.local();
     const GeometricalData<CoordinateType>* constTestGeomData = testGeomData;
@@ -721,7 +848,9 @@ integrateCpu(
         trialGeometry = m_trialGeometryFactory.make();
     }
 
-    CollectionOf3dArrays<BasisFunctionType> testValues, trialValues;
+    CollectionOf3dArrays<BasisFunctionType> testBuffer, trialBuffer;
+    const CollectionOf3dArrays<BasisFunctionType>* testValues = 0;
+    const CollectionOf3dArrays<BasisFunctionType>* trialValues = 0;
     CollectionOf4dArrays<KernelType> kernelValues;
 
     for (size_t i = 0; i < result.size(); ++i) {
@@ -729,9 +858,6 @@ integrateCpu(
         result[i]->set_size(testDofCount, trialDofCount);
     }
 
-    testBasis.evaluate(testBasisDeps, m_localTestQuadPoints, ALL_DOFS, testBasisData);
-    trialBasis.evaluate(trialBasisDeps, m_localTrialQuadPoints, ALL_DOFS, trialBasisData);
-
     // Iterate over the elements
     for (int pairIndex = 0; pairIndex < geometryPairCount; ++pairIndex)
     {
@@ -744,14 +870,16 @@ integrateCpu(
             testGeometry->getData(testGeomDeps, m_localTestQuadPoints, *testGeomData);
             trialGeometry->getData(trialGeomDeps, m_localTrialQuadPoints, *trialGeomData);
         }
-        m_testTransformations.evaluate(testBasisData, *constTestGeomData, testValues);
-        m_trialTransformations.evaluate(trialBasisData, *constTrialGeomData, trialValues);
-
-        m_kernels.evaluateOnGrid(*constTestGeomData, *constTrialGeomData, kernelValues);
-        m_integral.evaluateWithTensorQuadratureRule(
-                    *constTestGeomData, *constTrialGeomData, testValues, trialValues,
-                    kernelValues, m_testQuadWeights, m_trialQuadWeights,
-                    *result[pairIndex]);
+        testValues = &basisDataCache.transformedValues(
+                    m_testTransformations, testBasis, m_localTestQuadPoints,
+                    ALL_DOFS, *constTestGeomData, testBuffer);
+        trialValues = &basisDataCache.transformedValues(
+                    m_trialTransformations, trialBasis, m_localTrialQuadPoints,
+                    ALL_DOFS, *constTrialGeomData, trialBuffer);
+
+        integrateOnElementPair(*constTestGeomData, *constTrialGeomData,
+                               *testValues, *trialValues, kernelValues,
+                               *result[pairIndex]);
     }
 }
 
@@ -85,6 +85,16 @@ public:
     }
 };
 
+/** \cond PRIVATE */
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+inline bool isSimpleTestScalarKernelTrialIntegrand(
+        const SimpleTestScalarKernelTrialIntegrandFunctor<
+        BasisFunctionType, KernelType, ResultType>&)
+{
+    return true;
+}
+/** \endcond */
+
 } // namespace Fiber
 
 #endif
@@ -0,0 +1,245 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_soa_geometrical_data_hpp
+#define fiber_soa_geometrical_data_hpp
+
+#include "../common/common.hpp"
+
+#include "geometrical_data.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace Fiber
+{
+
+/** \cond FORWARD_DECL */
+template <typename CoordinateType> class ConstSoaGeometricalDataSlice;
+/** \endcond */
+
+/** \brief Global coordinates, normals and integration elements of a set of
+ *  points stored in the structure-of-arrays layout.
+ *
+ *  GeometricalData stores the coordinates of each point next to each other,
+ *  so loops over points access each coordinate with a stride and are hard
+ *  to vectorize. This class stores each coordinate of all points (and each
+ *  component of the normals, and the integration elements) in a separate
+ *  contiguous array. Each array starts at a 64-byte boundary and is padded
+ *  to a multiple of 64 bytes; the padding entries repeat the data of the
+ *  last point, so vector loops may run over paddedPointCount() points
+ *  without producing infinities or NaNs.
+ *
+ *  Objects of this class are filled from GeometricalData objects with
+ *  assign() and can be reused to avoid memory reallocations. */
+template <typename CoordinateType>
+class SoaGeometricalData
+{
+public:
+    /** \brief Alignment (in bytes) of the arrays. */
+    enum { ALIGNMENT = 64 };
+
+    SoaGeometricalData() :
+        m_pointCount(0), m_paddedPointCount(0), m_dimWorld(0),
+        m_hasGlobals(false), m_hasNormals(false),
+        m_hasIntegrationElements(false), m_data(0)
+    {}
+
+    explicit SoaGeometricalData(const GeometricalData<CoordinateType>& geomData) :
+        m_pointCount(0), m_paddedPointCount(0), m_dimWorld(0),
+        m_hasGlobals(false), m_hasNormals(false),
+        m_hasIntegrationElements(false), m_data(0)
+    {
+        assign(geomData);
+    }
+
+    SoaGeometricalData(const SoaGeometricalData& other) :
+        m_pointCount(0), m_paddedPointCount(0), m_dimWorld(0),
+        m_hasGlobals(false), m_hasNormals(false),
+        m_hasIntegrationElements(false), m_data(0)
+    {
+        *this = other;
+    }
+
+    SoaGeometricalData& operator=(const SoaGeometricalData& other) {
+        if (this == &other)
+            return *this;
+        m_pointCount = other.m_pointCount;
+        m_paddedPointCount = other.m_paddedPointCount;
+        m_dimWorld = other.m_dimWorld;
+        m_hasGlobals = other.m_hasGlobals;
+        m_hasNormals = other.m_hasNormals;
+        m_hasIntegrationElements = other.m_hasIntegrationElements;
+        allocate(arrayCount());
+        if (m_data)
+            std::copy(other.m_data,
+                      other.m_data + arrayCount() * m_paddedPointCount,
+                      m_data);
+        return *this;
+    }
+
+    /** \brief Copy the global coordinates, normals and integration elements
+     *  stored in \p geomData. Fields that are empty in \p geomData are left
+     *  empty. */
+    void assign(const GeometricalData<CoordinateType>& geomData) {
+        m_hasGlobals = !geomData.globals.is_empty();
+        m_hasNormals = !geomData.normals.is_empty();
+        m_hasIntegrationElements = !geomData.integrationElements.is_empty();
+        m_pointCount = (m_hasGlobals || m_hasNormals ||
+                        m_hasIntegrationElements) ? geomData.pointCount() : 0;
+        m_dimWorld = (m_hasGlobals || m_hasNormals) ? geomData.dimWorld() : 0;
+        assert(m_dimWorld <= 3);
+        const size_t block = ALIGNMENT / sizeof(CoordinateType);
+        m_paddedPointCount = (m_pointCount + block - 1) / block * block;
+        allocate(arrayCount());
+
+        for (int dim = 0; dim < m_dimWorld; ++dim) {
+            if (m_hasGlobals)
+                fillArray(globalsArray(dim),
+                          geomData.globals.memptr() + dim, m_dimWorld);
+            if (m_hasNormals)
+                fillArray(normalsArray(dim),
+                          geomData.normals.memptr() + dim, m_dimWorld);
+        }
+        if (m_hasIntegrationElements)
+            fillArray(integrationElementsArray(),
+                      geomData.integrationElements.memptr(), 1);
+    }
+
+    /** \brief Number of points. */
+    size_t pointCount() const { return m_pointCount; }
+    /** \brief Length of each array, including padding. */
+    size_t paddedPointCount() const { return m_paddedPointCount; }
+    /** \brief Dimension of the space containing the points. */
+    int dimWorld() const { return m_dimWorld; }
+
+    bool hasGlobals() const { return m_hasGlobals; }
+    bool hasNormals() const { return m_hasNormals; }
+    bool hasIntegrationElements() const { return m_hasIntegrationElements; }
+
+    /** \brief Array of the <tt>dim</tt>th coordinates of all points. */
+    const CoordinateType* globals(int dim) const {
+        assert(m_hasGlobals && dim < m_dimWorld);
+        return globalsArray(dim);
+    }
+    /** \brief Array of the <tt>dim</tt>th components of the normals at all
+     *  points. */
+    const CoordinateType* normals(int dim) const {
+        assert(m_hasNormals && dim < m_dimWorld);
+        return normalsArray(dim);
+    }
+    /** \brief Array of the integration elements at all points. */
+    const CoordinateType* integrationElements() const {
+        assert(m_hasIntegrationElements);
+        return integrationElementsArray();
+    }
+
+    /** \brief View of the data of a single point. */
+    ConstSoaGeometricalDataSlice<CoordinateType> const_slice(int point) const {
+        return ConstSoaGeometricalDataSlice<CoordinateType>(*this, point);
+    }
+
+private:
+    /** \cond PRIVATE */
+    size_t arrayCount() const {
+        return (m_hasGlobals ? m_dimWorld : 0) +
+                (m_hasNormals ? m_dimWorld : 0) +
+                (m_hasIntegrationElements ? 1 : 0);
+    }
+
+    void allocate(size_t arrayCount) {
+        const size_t extra = ALIGNMENT / sizeof(CoordinateType);
+        m_buffer.resize(arrayCount * m_paddedPointCount + extra);
+        const size_t address = reinterpret_cast<size_t>(&m_buffer[0]);
+        const size_t misalignment = address % ALIGNMENT;
+        m_data = &m_buffer[0] + (misalignment ?
+                    (ALIGNMENT - misalignment) / sizeof(CoordinateType) : 0);
+    }
+
+    // Copy m_pointCount values read with the given stride and repeat the
+    // last one in the padding
+    void fillArray(CoordinateType* dest, const CoordinateType* source,
+                   size_t stride) {
+        for (size_t p = 0; p < m_pointCount; ++p)
+            dest[p] = source[p * stride];
+        const CoordinateType last = m_pointCount ? dest[m_pointCount - 1] : 0;
+        std::fill(dest + m_pointCount, dest + m_paddedPointCount, last);
+    }
+
+    CoordinateType* globalsArray(int dim) const {
+        return m_data + dim * m_paddedPointCount;
+    }
+    CoordinateType* normalsArray(int dim) const {
+        return m_data + ((m_hasGlobals ? m_dimWorld : 0) + dim) *
+                m_paddedPointCount;
+    }
+    CoordinateType* integrationElementsArray() const {
+        return m_data + ((m_hasGlobals ? m_dimWorld : 0) +
+                         (m_hasNormals ? m_dimWorld : 0)) * m_paddedPointCount;
+    }
+
+    size_t m_pointCount;
+    size_t m_paddedPointCount;
+    int m_dimWorld;
+    bool m_hasGlobals;
+    bool m_hasNormals;
+    bool m_hasIntegrationElements;
+    std::vector<CoordinateType> m_buffer;
+    CoordinateType* m_data; // aligned start of m_buffer
+    /** \endcond */
+};
+
+/** \brief View of the data of a single point stored in a
+ *  SoaGeometricalData object.
+ *
+ *  Provides the same accessors for global coordinates, normals and
+ *  integration elements as ConstGeometricalDataSlice, so code written
+ *  against these accessors can be instantiated for either layout. */
+template <typename CoordinateType>
+class ConstSoaGeometricalDataSlice
+{
+public:
+    ConstSoaGeometricalDataSlice(const SoaGeometricalData<CoordinateType>& geomData,
+                                 int point) :
+        m_geomData(geomData), m_point(point) {}
+
+    CoordinateType global(int dim) const {
+        return m_geomData.globals(dim)[m_point];
+    }
+    CoordinateType integrationElement() const {
+        return m_geomData.integrationElements()[m_point];
+    }
+    CoordinateType normal(int dim) const {
+        return m_geomData.normals(dim)[m_point];
+    }
+
+    int dimWorld() const {
+        return m_geomData.dimWorld();
+    }
+
+private:
+    const SoaGeometricalData<CoordinateType>& m_geomData;
+    int m_point;
+};
+
+} // namespace Fiber
+
+#endif
@@ -181,6 +181,21 @@ public:
             const std::vector<CoordinateType>& trialQuadWeights,
             arma::Mat<ResultType>& result) const = 0;
 
+    /** \brief Return true if the integrand has the form
+     *  \f$\overline{\phi(x)} \cdot \psi(y) \, K(x, y)\f$, where \f$\phi\f$
+     *  and \f$\psi\f$ are the first test and trial basis function
+     *  transformations and \f$K\f$ is the first kernel, which is
+     *  scalar-valued.
+     *
+     *  Integrators may then evaluate such integrals on tensor-product
+     *  quadrature rules by contracting the kernel values with the weighted
+     *  basis function values as matrix products, without calling
+     *  evaluateWithTensorQuadratureRule(). The default implementation returns
+     *  false. */
+    virtual bool isSimpleTestScalarKernelTrialIntegral() const {
+        return false;
+    }
+
     virtual void evaluateWithNontensorQuadratureRule(
             const GeometricalData<CoordinateType>& testGeomData,
             const GeometricalData<CoordinateType>& trialGeomData,
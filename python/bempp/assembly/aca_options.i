@@ -12,12 +12,23 @@ namespace Bempp
 %feature("autodoc", "reactionToUnsupportedMode -> \"ignore\", \"warning\" or \"error\"")
      AcaOptions::reactionToUnsupportedMode;
 %feature("autodoc", "maximumBlockSize -> int") AcaOptions::maximumBlockSize;
+%feature("autodoc", "clusterSplitting -> \"bounding_box\" or \"principal_component\"")
+     AcaOptions::clusterSplitting;
 %feature("autodoc", "maximumRank -> int") AcaOptions::maximumRank;
 %feature("autodoc", "minimumBlockSize -> int") AcaOptions::minimumBlockSize;
 %feature("autodoc", "outputFname -> string") AcaOptions::outputFname;
 %feature("autodoc", "outputPostscript -> bool") AcaOptions::outputPostscript;
 %feature("autodoc", "recompress -> bool") AcaOptions::recompress;
+%feature("autodoc", "recompressLowRankBlocks -> bool")
+     AcaOptions::recompressLowRankBlocks;
+%feature("autodoc", "singlePrecisionLowRankBlocks -> bool")
+     AcaOptions::singlePrecisionLowRankBlocks;
+%feature("autodoc", "maximumDofListsCacheMemory -> int")
+     AcaOptions::maximumDofListsCacheMemory;
+%feature("autodoc", "memoryBudget -> int") AcaOptions::memoryBudget;
 %feature("autodoc", "scaling -> float") AcaOptions::scaling;
+%feature("autodoc", "useAcaPlus -> bool") AcaOptions::useAcaPlus;
+%feature("autodoc", "pivotBatchSize -> int") AcaOptions::pivotBatchSize;
 %feature("autodoc", "firstClusterIndex -> int") AcaOptions::firstClusterIndex;
 %feature("autodoc", "globalAssemblyBeforeCompression (deprecated) -> bool")
      AcaOptions::globalAssemblyBeforeCompression;
@@ -114,6 +125,48 @@ namespace Bempp
     }
 }
 
+// Handle the enum AcaOptions::ClusterSplitting like a string
+%typemap(typecheck) AcaOptions::ClusterSplitting
+{
+    $1 = PyString_Check($input);
+}
+%typemap(in) AcaOptions::ClusterSplitting
+{
+    if (!PyString_Check($input))
+    {
+        PyErr_SetString(PyExc_TypeError, 
+                        "in method '$symname', argument $argnum: expected a string");
+        SWIG_fail;
+    }
+    const std::string s(PyString_AsString($input));
+    if (s == "bounding_box")
+        $1 = Bempp::AcaOptions::BOUNDING_BOX_SPLITTING;
+    else if (s == "principal_component")
+        $1 = Bempp::AcaOptions::PRINCIPAL_COMPONENT_SPLITTING;
+    else
+    {
+        PyErr_SetString(PyExc_ValueError,
+                        "in method '$symname', argument $argnum: "
+                        "expected one of 'bounding_box' or "
+                        "'principal_component'");
+        SWIG_fail;
+    }
+}
+
+%typemap(out) AcaOptions::ClusterSplitting
+{
+    if ($1 == Bempp::AcaOptions::BOUNDING_BOX_SPLITTING)
+        $result = PyString_FromString("bounding_box");
+    else if ($1 == Bempp::AcaOptions::PRINCIPAL_COMPONENT_SPLITTING)
+        $result = PyString_FromString("principal_component");
+    else
+    {
+        PyErr_SetString(PyExc_ValueError, 
+                        "in method '$symname', unknown cluster splitting strategy.");
+        SWIG_fail;
+    }
+}
+
 } // namespace Bempp
 
 %include "assembly/aca_options.hpp"
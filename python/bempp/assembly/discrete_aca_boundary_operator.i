@@ -21,6 +21,8 @@ namespace Bempp
 {
     %template(acaOperatorApproximateLuInverse_## PY_VALUE) 
         acaOperatorApproximateLuInverse< VALUE >;
+    %template(acaOperatorApproximateCholeskyInverse_## PY_VALUE) 
+        acaOperatorApproximateCholeskyInverse< VALUE >;
     %template(scaledAcaOperator_## PY_VALUE)
          scaledAcaOperator< VALUE >;
     %template(acaOperatorSum_## PY_VALUE) 
@@ -1990,6 +1990,28 @@ if core._withAhmed:
         return _constructObjectTemplatedOnValue(
             core, name, operator.valueType(), operator, delta)
 
+    def acaOperatorApproximateCholeskyInverse(operator, delta):
+        """
+        Create and return a discrete boundary operator representing an approximate
+        inverse of a Hermitian positive-definite H-matrix.
+
+        *Parameters:*
+           - operator (DiscreteBoundaryOperator)
+                A discrete boundary operator stored in the form of a Hermitian
+                H-matrix (e.g. a real-valued operator assembled in ACA mode with
+                the SYMMETRIC flag).
+           - delta (float)
+                Approximation accuracy.
+
+        *Returns* a DiscreteBoundaryOperator_ValueType object representing an
+        approximate inverse of the operator supplied in the 'operator' argument,
+        stored in the form of an approximate H-matrix Cholesky decomposition.
+        ValueType is set to operator.valueType().
+        """
+        name = 'acaOperatorApproximateCholeskyInverse'
+        return _constructObjectTemplatedOnValue(
+            core, name, operator.valueType(), operator, delta)
+
     def createAcaApproximateLuInverse(operator, delta):
         """
         Deprecated. Superseded by acaOperatorApproximateLuInverse().
@@ -25,6 +25,7 @@ entities_templated_on_VT = [
     "PythonSurfaceNormalDependentFunctor",
     "acaBlockDiagonalPreconditioner",
     "acaOperatorApproximateLuInverse",
+    "acaOperatorApproximateCholeskyInverse",
     "acaOperatorSum",
     "scaledAcaOperator",
     "discreteSparseInverse",
@@ -24,14 +24,23 @@
 
 #include "../type_template.hpp"
 #include "../check_arrays_are_close.hpp"
+#include "../random_arrays.hpp"
 
+#include "create_regular_grid.hpp"
+
+#include "assembly/aca_cluster_tree_cache.hpp"
+#include "assembly/ahmed_aux.hpp"
 #include "assembly/context.hpp"
+#include "assembly/discrete_aca_boundary_operator.hpp"
 #include "assembly/discrete_boundary_operator.hpp"
+#include "assembly/discrete_h2_boundary_operator.hpp"
 #include "assembly/laplace_3d_adjoint_double_layer_boundary_operator.hpp"
 #include "assembly/laplace_3d_double_layer_boundary_operator.hpp"
 #include "assembly/laplace_3d_hypersingular_boundary_operator.hpp"
 #include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
+#include "assembly/local_dof_lists_cache.hpp"
 #include "assembly/helmholtz_3d_hypersingular_boundary_operator.hpp"
+#include "assembly/helmholtz_3d_single_layer_boundary_operator.hpp"
 #include "assembly/numerical_quadrature_strategy.hpp"
 #include "grid/grid_factory.hpp"
 #include "space/piecewise_constant_scalar_space.hpp"
@@ -42,8 +51,162 @@
 #include <boost/type_traits/is_complex.hpp>
 #include "grid/grid.hpp"
 
+#include <map>
+#include <stdexcept>
+#include <vector>
+
 using namespace Bempp;
 
+namespace
+{
+
+// Operators compared in the tests below, all discretised on the same grid
+enum TestOperator
+{
+    // Laplace single-layer operator, piecewise constants on both sides
+    LAPLACE_SINGLE_LAYER_P0,
+    // Laplace double-layer operator, piecewise-linear trial functions and
+    // piecewise-constant test functions
+    LAPLACE_DOUBLE_LAYER_P1_P0,
+    // Laplace adjoint double-layer operator, the same spaces as above
+    LAPLACE_ADJOINT_DOUBLE_LAYER_P1_P0
+};
+
+shared_ptr<Grid> loadSphereGrid()
+{
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    return GridFactory::importGmshGrid(
+        params, "../../examples/meshes/sphere-h-0.2.msh", false /* verbose */);
+}
+
+AssemblyOptions acaAssemblyOptions(const AcaOptions& acaOptions)
+{
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    assemblyOptions.switchToAcaMode(acaOptions);
+    return assemblyOptions;
+}
+
+// Spaces and quadrature strategy shared by the weak forms assembled in a
+// test, together with the dense weak forms used as reference
+template <typename RT>
+class AcaTestProblem
+{
+public:
+    typedef typename ScalarTraits<RT>::RealType BFT;
+
+    explicit AcaTestProblem(const shared_ptr<Grid>& grid = loadSphereGrid()) :
+        m_grid(grid),
+        m_pwiseConstants(new PiecewiseConstantScalarSpace<BFT>(grid)),
+        m_pwiseLinears(new PiecewiseLinearContinuousScalarSpace<BFT>(grid))
+    {
+        AccuracyOptions accuracyOptions;
+        accuracyOptions.doubleRegular.setRelativeQuadratureOrder(1);
+        m_quadStrategy.reset(
+                    new NumericalQuadratureStrategy<BFT, RT>(accuracyOptions));
+    }
+
+    shared_ptr<Context<BFT, RT> > makeContext(
+            const AssemblyOptions& assemblyOptions) const {
+        return shared_ptr<Context<BFT, RT> >(
+                    new Context<BFT, RT>(m_quadStrategy, assemblyOptions));
+    }
+
+    BoundaryOperator<BFT, RT> makeOperator(
+            TestOperator op,
+            const shared_ptr<Context<BFT, RT> >& context) const {
+        switch (op) {
+        case LAPLACE_SINGLE_LAYER_P0:
+            return laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+                        context, m_pwiseConstants, m_pwiseConstants,
+                        m_pwiseConstants);
+        case LAPLACE_DOUBLE_LAYER_P1_P0:
+            return laplace3dDoubleLayerBoundaryOperator<BFT, RT>(
+                        context, m_pwiseLinears, m_pwiseLinears,
+                        m_pwiseConstants);
+        case LAPLACE_ADJOINT_DOUBLE_LAYER_P1_P0:
+            return laplace3dAdjointDoubleLayerBoundaryOperator<BFT, RT>(
+                        context, m_pwiseLinears, m_pwiseLinears,
+                        m_pwiseConstants);
+        default:
+            throw std::invalid_argument("AcaTestProblem::makeOperator(): "
+                                        "unknown operator");
+        }
+    }
+
+    BoundaryOperator<BFT, RT> makeOperator(
+            TestOperator op, const AssemblyOptions& assemblyOptions) const {
+        return makeOperator(op, makeContext(assemblyOptions));
+    }
+
+    // Weak form of op assembled in the dense mode (computed once per
+    // operator)
+    const arma::Mat<RT>& denseWeakForm(TestOperator op) {
+        typename std::map<TestOperator, arma::Mat<RT> >::iterator it =
+                m_denseWeakForms.find(op);
+        if (it == m_denseWeakForms.end()) {
+            AssemblyOptions assemblyOptions;
+            assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+            it = m_denseWeakForms.insert(std::make_pair(
+                    op, makeOperator(op, assemblyOptions).weakForm()->
+                    asMatrix())).first;
+        }
+        return it->second;
+    }
+
+    // Assemble op with the given options, check that its weak form agrees
+    // with the dense one to the given tolerance and return the operator
+    BoundaryOperator<BFT, RT> assembleAndCompareWithDense(
+            TestOperator op, const AssemblyOptions& assemblyOptions,
+            double tolerance) {
+        BoundaryOperator<BFT, RT> result = makeOperator(op, assemblyOptions);
+        BOOST_CHECK(check_arrays_are_close<RT>(
+                        denseWeakForm(op), result.weakForm()->asMatrix(),
+                        tolerance));
+        return result;
+    }
+
+    // Shorthand for the ACA mode, with the tolerance 2 * acaOptions.eps
+    BoundaryOperator<BFT, RT> assembleAcaAndCompareWithDense(
+            TestOperator op, const AcaOptions& acaOptions) {
+        return assembleAndCompareWithDense(
+                    op, acaAssemblyOptions(acaOptions), 2. * acaOptions.eps);
+    }
+
+    const shared_ptr<Grid>& grid() const { return m_grid; }
+    const shared_ptr<Space<BFT> >& pwiseConstants() const {
+        return m_pwiseConstants;
+    }
+    const shared_ptr<Space<BFT> >& pwiseLinears() const {
+        return m_pwiseLinears;
+    }
+
+private:
+    shared_ptr<Grid> m_grid;
+    shared_ptr<Space<BFT> > m_pwiseConstants;
+    shared_ptr<Space<BFT> > m_pwiseLinears;
+    shared_ptr<NumericalQuadratureStrategy<BFT, RT> > m_quadStrategy;
+    std::map<TestOperator, arma::Mat<RT> > m_denseWeakForms;
+};
+
+// Memory taken by the values stored in the mblocks of an ACA operator, as
+// accounted for by AcaOptions::memoryBudget
+template <typename RT>
+size_t acaOperatorValueMemory(const DiscreteBoundaryOperator<RT>& op)
+{
+    const DiscreteAcaBoundaryOperator<RT>& acaOp =
+            DiscreteAcaBoundaryOperator<RT>::castToAca(op);
+    typename DiscreteAcaBoundaryOperator<RT>::AhmedMblockArray blocks =
+            acaOp.blocks();
+    size_t result = 0;
+    for (size_t i = 0; i < acaOp.blockCount(); ++i)
+        result += blocks[i]->nvals() * sizeof(RT);
+    return result;
+}
+
+} // namespace
+
 // Tests
 
 BOOST_AUTO_TEST_SUITE(AcaAssembly)
@@ -344,6 +507,315 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(aca_of_disassembled_helmholtz_hypersingular_operat
                     weakFormDense, weakFormAca, 2. * acaOptions.eps));
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_recompressed_low_rank_blocks_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    AcaOptions acaOptions;
+    acaOptions.recompressLowRankBlocks = true;
+    AcaTestProblem<ValueType> problem;
+    problem.assembleAcaAndCompareWithDense(LAPLACE_SINGLE_LAYER_P0, acaOptions);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_single_precision_low_rank_blocks_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    std::srand(1);
+
+    AcaOptions acaOptions;
+    acaOptions.singlePrecisionLowRankBlocks = true;
+    AcaTestProblem<RT> problem;
+    BoundaryOperator<typename AcaTestProblem<RT>::BFT, RT> opAca =
+            problem.assembleAcaAndCompareWithDense(
+                LAPLACE_SINGLE_LAYER_P0, acaOptions);
+
+    // Matrix-vector products use the single-precision factors directly
+    const arma::Mat<RT>& weakFormDense =
+            problem.denseWeakForm(LAPLACE_SINGLE_LAYER_P0);
+    arma::Col<RT> x = generateRandomVector<RT>(weakFormDense.n_cols);
+    arma::Col<RT> y(weakFormDense.n_rows);
+    opAca.weakForm()->apply(NO_TRANSPOSE, x, y, 1., 0.);
+    arma::Col<RT> expected = weakFormDense * x;
+    BOOST_CHECK(check_arrays_are_close<ValueType>(
+                    y, expected, 2. * acaOptions.eps));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(hybrid_aca_with_single_precision_low_rank_blocks_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename AcaTestProblem<RT>::BFT BFT;
+
+    AcaOptions acaOptions;
+    acaOptions.mode = AcaOptions::HYBRID_ASSEMBLY;
+    acaOptions.singlePrecisionLowRankBlocks = true;
+    AcaTestProblem<RT> problem;
+    BoundaryOperator<BFT, RT> opAca =
+            problem.assembleAcaAndCompareWithDense(
+                LAPLACE_DOUBLE_LAYER_P1_P0, acaOptions);
+
+    // In the hybrid mode the mblocks are also referenced by the block
+    // coalescer; the conversion must nevertheless take place
+    const DiscreteAcaBoundaryOperator<RT>& discreteAca =
+            DiscreteAcaBoundaryOperator<RT>::castToAca(*opAca.weakForm());
+    if (sizeof(BFT) == sizeof(double))
+        BOOST_CHECK(discreteAca.singlePrecisionSavedBytes() > 0);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_principal_component_splitting_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    AcaOptions acaOptions;
+    acaOptions.clusterSplitting = AcaOptions::PRINCIPAL_COMPONENT_SPLITTING;
+    AcaTestProblem<ValueType> problem;
+    problem.assembleAcaAndCompareWithDense(LAPLACE_DOUBLE_LAYER_P1_P0,
+                                           acaOptions);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_principal_component_splitting_agrees_with_dense_assembly_for_elongated_mesh,
+                              ValueType, result_types)
+{
+    // A 10 x 1 strip, whose clusters are split many times along the same
+    // axis before their bounding boxes become roughly isotropic
+    AcaOptions acaOptions;
+    acaOptions.clusterSplitting = AcaOptions::PRINCIPAL_COMPONENT_SPLITTING;
+    AcaTestProblem<ValueType> problem(
+                createRegularTriangularGrid(40, 4, 10., 1.));
+    problem.assembleAcaAndCompareWithDense(LAPLACE_SINGLE_LAYER_P0,
+                                           acaOptions);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_batched_pivots_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    AcaOptions acaOptions;
+    acaOptions.pivotBatchSize = 4;
+    AcaTestProblem<ValueType> problem;
+    problem.assembleAcaAndCompareWithDense(LAPLACE_DOUBLE_LAYER_P1_P0,
+                                           acaOptions);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_operators_assembled_in_same_context_share_cluster_trees,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename AcaTestProblem<RT>::BFT BFT;
+
+    AcaOptions acaOptions;
+    AcaTestProblem<RT> problem;
+    shared_ptr<Context<BFT, RT> > contextAca =
+            problem.makeContext(acaAssemblyOptions(acaOptions));
+    shared_ptr<AcaClusterTreeCache<BFT> > cache =
+            contextAca->acaClusterTreeCache();
+
+    BoundaryOperator<BFT, RT> op1Aca = problem.makeOperator(
+                LAPLACE_DOUBLE_LAYER_P1_P0, contextAca);
+    op1Aca.weakForm();
+    BOOST_CHECK_EQUAL(cache->clusterTreeCount(), 2u);
+    BOOST_CHECK_EQUAL(cache->blockClusterTreeCount(), 1u);
+    const size_t missCount = cache->missCount();
+    const size_t hitCount = cache->hitCount();
+
+    // The second operator is discretized with the same spaces, so it should
+    // reuse all trees constructed for the first one
+    BoundaryOperator<BFT, RT> op2Aca = problem.makeOperator(
+                LAPLACE_ADJOINT_DOUBLE_LAYER_P1_P0, contextAca);
+    arma::Mat<RT> weakFormAca = op2Aca.weakForm()->asMatrix();
+    BOOST_CHECK_EQUAL(cache->clusterTreeCount(), 2u);
+    BOOST_CHECK_EQUAL(cache->blockClusterTreeCount(), 1u);
+    BOOST_CHECK_EQUAL(cache->missCount(), missCount);
+    BOOST_CHECK(cache->hitCount() > hitCount);
+
+    BOOST_CHECK(check_arrays_are_close<ValueType>(
+                    problem.denseWeakForm(LAPLACE_ADJOINT_DOUBLE_LAYER_P1_P0),
+                    weakFormAca, 2. * acaOptions.eps));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_cluster_tree_cache_drops_trees_of_destroyed_spaces,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename AcaTestProblem<RT>::BFT BFT;
+
+    AcaOptions acaOptions;
+    AcaTestProblem<RT> problem;
+    shared_ptr<Context<BFT, RT> > contextAca =
+            problem.makeContext(acaAssemblyOptions(acaOptions));
+    shared_ptr<AcaClusterTreeCache<BFT> > cache =
+            contextAca->acaClusterTreeCache();
+
+    {
+        AcaTestProblem<RT> otherProblem(problem.grid());
+        otherProblem.makeOperator(LAPLACE_DOUBLE_LAYER_P1_P0, contextAca)
+                .weakForm();
+        BOOST_CHECK_EQUAL(cache->clusterTreeCount(), 2u);
+        BOOST_CHECK_EQUAL(cache->blockClusterTreeCount(), 1u);
+    }
+
+    // The spaces of otherProblem no longer exist, so their trees are removed
+    // on the next request
+    cache->clusterTree(problem.pwiseConstants(), true /*indexWithGlobalDofs*/,
+                       acaOptions);
+    BOOST_CHECK_EQUAL(cache->clusterTreeCount(), 1u);
+    BOOST_CHECK_EQUAL(cache->blockClusterTreeCount(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_bounded_dof_lists_cache_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename AcaTestProblem<RT>::BFT BFT;
+
+    AcaOptions acaOptions;
+    acaOptions.maximumDofListsCacheMemory = 16 * 1024;
+    AcaTestProblem<RT> problem;
+    shared_ptr<Context<BFT, RT> > contextAca =
+            problem.makeContext(acaAssemblyOptions(acaOptions));
+    BoundaryOperator<BFT, RT> opAca = problem.makeOperator(
+                LAPLACE_DOUBLE_LAYER_P1_P0, contextAca);
+    arma::Mat<RT> weakFormAca = opAca.weakForm()->asMatrix();
+    BOOST_CHECK(check_arrays_are_close<ValueType>(
+                    problem.denseWeakForm(LAPLACE_DOUBLE_LAYER_P1_P0),
+                    weakFormAca, 2. * acaOptions.eps));
+
+    // Request the DOF lists of consecutive index ranges twice, in the
+    // permuted ordering used during assembly
+    const std::vector<unsigned int>& p2o =
+            contextAca->acaClusterTreeCache()->clusterTree(
+                problem.pwiseLinears(), true /*indexWithGlobalDofs*/,
+                acaOptions).p2oPermutation->permutedIndices();
+    LocalDofListsCache<BFT> dofListsCache(
+                *problem.pwiseLinears(), p2o, true /*indexWithGlobalDofs*/,
+                acaOptions.maximumDofListsCacheMemory);
+    const int rangeSize = 16;
+    const int rangeCount = p2o.size() / rangeSize;
+    for (int pass = 0; pass < 2; ++pass)
+        for (int i = 0; i < rangeCount; ++i)
+            dofListsCache.get(i * rangeSize, rangeSize);
+    // The most recently used list must have survived
+    dofListsCache.get((rangeCount - 1) * rangeSize, rangeSize);
+
+    BOOST_CHECK(dofListsCache.evictionCount() > 0);
+    BOOST_CHECK(dofListsCache.memoryUsage() <=
+                acaOptions.maximumDofListsCacheMemory);
+    BOOST_CHECK(dofListsCache.hitCount() > 0);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_generous_memory_budget_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    AcaOptions acaOptions;
+    acaOptions.memoryBudget = 64 * 1024 * 1024;
+    AcaTestProblem<ValueType> problem;
+    problem.assembleAcaAndCompareWithDense(LAPLACE_DOUBLE_LAYER_P1_P0,
+                                           acaOptions);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_tight_memory_budget_reduces_memory_and_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename AcaTestProblem<RT>::BFT BFT;
+
+    AcaOptions acaOptions;
+    AcaTestProblem<RT> problem;
+    const size_t unbudgetedMemory = acaOperatorValueMemory(
+                *problem.assembleAcaAndCompareWithDense(
+                    LAPLACE_DOUBLE_LAYER_P1_P0, acaOptions).weakForm());
+
+    // The budget is reached after the recompression threshold (75%), so
+    // the last blocks are recompressed and possibly truncated
+    acaOptions.memoryBudget = size_t(0.9 * unbudgetedMemory);
+    BoundaryOperator<BFT, RT> opAca = problem.makeOperator(
+                LAPLACE_DOUBLE_LAYER_P1_P0, acaAssemblyOptions(acaOptions));
+    shared_ptr<const DiscreteBoundaryOperator<RT> > weakFormAca;
+    BOOST_REQUIRE_NO_THROW(weakFormAca = opAca.weakForm());
+    const size_t budgetedMemory = acaOperatorValueMemory(*weakFormAca);
+    BOOST_CHECK(budgetedMemory < unbudgetedMemory);
+    BOOST_CHECK(budgetedMemory <= acaOptions.memoryBudget);
+
+    // Truncated blocks are only accurate to 10 * eps
+    BOOST_CHECK(check_arrays_are_close<ValueType>(
+                    problem.denseWeakForm(LAPLACE_DOUBLE_LAYER_P1_P0),
+                    weakFormAca->asMatrix(), 20. * acaOptions.eps));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_with_too_small_memory_budget_throws,
+                              ValueType, result_types)
+{
+    AcaOptions acaOptions;
+    acaOptions.memoryBudget = 1024;
+    AcaTestProblem<ValueType> problem;
+    BOOST_CHECK_THROW(problem.makeOperator(
+                          LAPLACE_DOUBLE_LAYER_P1_P0,
+                          acaAssemblyOptions(acaOptions)).weakForm(),
+                      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_plus_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    AcaOptions acaOptions;
+    acaOptions.useAcaPlus = true;
+    AcaTestProblem<ValueType> problem;
+    problem.assembleAcaAndCompareWithDense(LAPLACE_DOUBLE_LAYER_P1_P0,
+                                           acaOptions);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_plus_stores_no_more_admissible_blocks_densely_than_aca_for_helmholtz_operator,
+                              ValueType, complex_result_types)
+{
+    typedef ValueType RT;
+    typedef typename AcaTestProblem<RT>::BFT BFT;
+
+    AcaTestProblem<RT> problem;
+    const RT waveNumber = 5.;
+
+    AssemblyOptions assemblyOptionsDense;
+    assemblyOptionsDense.setVerbosityLevel(VerbosityLevel::LOW);
+    arma::Mat<RT> weakFormDense =
+            helmholtz3dSingleLayerBoundaryOperator<BFT>(
+                problem.makeContext(assemblyOptionsDense),
+                problem.pwiseConstants(), problem.pwiseConstants(),
+                problem.pwiseConstants(), waveNumber).weakForm()->asMatrix();
+
+    size_t denseAdmissibleBlockCounts[2];
+    for (int plus = 0; plus < 2; ++plus) {
+        AcaOptions acaOptions;
+        acaOptions.useAcaPlus = (plus == 1);
+        BoundaryOperator<BFT, RT> opAca =
+                helmholtz3dSingleLayerBoundaryOperator<BFT>(
+                    problem.makeContext(acaAssemblyOptions(acaOptions)),
+                    problem.pwiseConstants(), problem.pwiseConstants(),
+                    problem.pwiseConstants(), waveNumber);
+        BOOST_CHECK(check_arrays_are_close<ValueType>(
+                        weakFormDense, opAca.weakForm()->asMatrix(),
+                        2. * acaOptions.eps));
+        denseAdmissibleBlockCounts[plus] =
+                DiscreteAcaBoundaryOperator<RT>::castToAca(
+                    *opAca.weakForm()).denseAdmissibleBlockCount();
+    }
+    BOOST_CHECK(denseAdmissibleBlockCounts[1] <= denseAdmissibleBlockCounts[0]);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(h2_mode_agrees_with_dense_assembly_for_614_element_mesh,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename AcaTestProblem<RT>::BFT BFT;
+
+    AcaOptions acaOptions;
+    AssemblyOptions assemblyOptionsH2;
+    assemblyOptionsH2.setVerbosityLevel(VerbosityLevel::LOW);
+    assemblyOptionsH2.switchToH2Mode(acaOptions);
+    AcaTestProblem<RT> problem;
+    BoundaryOperator<BFT, RT> opH2 = problem.assembleAndCompareWithDense(
+                LAPLACE_SINGLE_LAYER_P0, assemblyOptionsH2,
+                4. * acaOptions.eps);
+    BOOST_CHECK(boost::dynamic_pointer_cast<
+                const DiscreteH2BoundaryOperator<RT> >(opH2.weakForm()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #endif // WITH_AHMED
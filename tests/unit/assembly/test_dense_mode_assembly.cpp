@@ -0,0 +1,119 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../type_template.hpp"
+
+#include "assembly/assembly_options.hpp"
+#include "assembly/boundary_operator.hpp"
+#include "assembly/context.hpp"
+#include "assembly/discrete_boundary_operator.hpp"
+#include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
+#include "assembly/numerical_quadrature_strategy.hpp"
+#include "grid/grid.hpp"
+#include "grid/grid_factory.hpp"
+#include "space/piecewise_linear_continuous_scalar_space.hpp"
+
+#include "common/armadillo_fwd.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+using namespace Bempp;
+
+namespace
+{
+
+template <typename RT>
+arma::Mat<RT> assembleSingleLayerOperator(int maxThreadCount,
+                                          int symmetry = NO_SYMMETRY)
+{
+    typedef typename ScalarTraits<RT>::RealType BFT;
+
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "../../examples/meshes/sphere-h-0.2.msh", false /* verbose */);
+
+    shared_ptr<Space<BFT> > pwiseLinears(
+        new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+
+    AccuracyOptions accuracyOptions;
+    accuracyOptions.doubleRegular.setRelativeQuadratureOrder(1);
+    shared_ptr<NumericalQuadratureStrategy<BFT, RT> > quadStrategy(
+                new NumericalQuadratureStrategy<BFT, RT>(accuracyOptions));
+
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    assemblyOptions.setMaxThreadCount(maxThreadCount);
+    shared_ptr<Context<BFT, RT> > context(
+        new Context<BFT, RT>(quadStrategy, assemblyOptions));
+
+    BoundaryOperator<BFT, RT> op =
+            laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+                context, pwiseLinears, pwiseLinears, pwiseLinears,
+                "", symmetry);
+    return op.weakForm()->asMatrix();
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(DenseAssembly)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(parallel_dense_assembly_is_bitwise_identical_to_serial_assembly,
+                              ValueType, result_types)
+{
+    arma::Mat<ValueType> serial = assembleSingleLayerOperator<ValueType>(1);
+    arma::Mat<ValueType> parallel = assembleSingleLayerOperator<ValueType>(4);
+
+    BOOST_REQUIRE_EQUAL(serial.n_rows, parallel.n_rows);
+    BOOST_REQUIRE_EQUAL(serial.n_cols, parallel.n_cols);
+    size_t mismatchCount = 0;
+    for (size_t i = 0; i < serial.n_elem; ++i)
+        if (serial[i] != parallel[i])
+            ++mismatchCount;
+    BOOST_CHECK_EQUAL(mismatchCount, 0u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(symmetric_dense_assembly_agrees_with_unsymmetric_assembly,
+                              ValueType, result_types)
+{
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+
+    arma::Mat<ValueType> full = assembleSingleLayerOperator<ValueType>(
+                AssemblyOptions::AUTO, NO_SYMMETRY);
+    arma::Mat<ValueType> symmetric = assembleSingleLayerOperator<ValueType>(
+                AssemblyOptions::AUTO, SYMMETRIC);
+
+    BOOST_REQUIRE_EQUAL(full.n_rows, symmetric.n_rows);
+    BOOST_REQUIRE_EQUAL(full.n_cols, symmetric.n_cols);
+    // The mirrored entries are copied, not recomputed
+    size_t asymmetryCount = 0;
+    for (size_t c = 0; c < symmetric.n_cols; ++c)
+        for (size_t r = 0; r < c; ++r)
+            if (symmetric(r, c) != symmetric(c, r))
+                ++asymmetryCount;
+    BOOST_CHECK_EQUAL(asymmetryCount, 0u);
+    const RealType relativeDifference =
+            arma::norm(full - symmetric, "fro") / arma::norm(full, "fro");
+    BOOST_CHECK_SMALL(relativeDifference, RealType(1e-5));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -28,6 +28,7 @@
 
 #include "create_regular_grid.hpp"
 
+#include "assembly/aca_matvec_plan.hpp"
 #include "assembly/assembly_options.hpp"
 #include "assembly/discrete_aca_boundary_operator.hpp"
 #include "assembly/discrete_boundary_operator.hpp"
@@ -54,6 +55,7 @@
 #include <boost/test/floating_point_comparison.hpp>
 #include <boost/version.hpp>
 #include <complex>
+#include <cstdio>
 
 // Tests
 
@@ -172,6 +174,17 @@ struct DiscreteComplexSymmetricAcaBoundaryOperatorFixture
     BoundaryOperator<BFT, RT> op;
 };
 
+// Suffix distinguishing the files written by tests instantiated for
+// different value types (sizeof() alone does not tell double from
+// std::complex<float>)
+template <typename RT> const char* valueTypeSuffix();
+template <> const char* valueTypeSuffix<float>() { return "float"; }
+template <> const char* valueTypeSuffix<double>() { return "double"; }
+template <> const char* valueTypeSuffix<std::complex<float> >()
+{ return "complex_float"; }
+template <> const char* valueTypeSuffix<std::complex<double> >()
+{ return "complex_double"; }
+
 } // namespace
 
 BOOST_AUTO_TEST_SUITE(DiscreteAcaBoundaryOperator)
@@ -230,6 +243,245 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(builtin_apply_works_correctly_for_alpha_equal_to_2
                                            10. * std::numeric_limits<CT>::epsilon()));
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(builtin_apply_gives_identical_results_when_called_repeatedly, ResultType, result_types)
+{
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+
+    DiscreteAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+
+    RT alpha = static_cast<RT>(2.);
+    RT beta = static_cast<RT>(0.);
+
+    arma::Col<RT> x = generateRandomVector<RT>(dop->columnCount());
+    arma::Col<RT> expected = alpha * dop->asMatrix() * x;
+
+    // The first call builds the matvec plan, the following ones reuse it
+    for (int i = 0; i < 3; ++i) {
+        arma::Col<RT> y(dop->rowCount());
+        y.fill(std::numeric_limits<CT>::quiet_NaN());
+        dop->apply(NO_TRANSPOSE, x, y, alpha, beta);
+        BOOST_CHECK(check_arrays_are_close<RT>(y, expected,
+                                               10. * std::numeric_limits<CT>::epsilon()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(matvec_plans_with_leaf_and_row_partitioning_give_identical_results, ResultType, result_types)
+{
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+    typedef AcaMatvecPlan<RT> Plan;
+
+    DiscreteAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteAcaBoundaryOperator<RT> > acaOp =
+            DiscreteAcaBoundaryOperator<RT>::castToAca(fixture.op.weakForm());
+    blcluster* blockCluster =
+            const_cast<typename DiscreteAcaBoundaryOperator<RT>::
+            AhmedBemBlcluster*>(acaOp->blockCluster().get());
+
+    // More work units than threads, so that the row ranges are cut through
+    // several mblocks
+    const size_t workUnitCount = 4;
+    Plan leafPlan(blockCluster, acaOp->blocks(), acaOp->symmetry(),
+                  workUnitCount, Plan::LEAF_PARTITIONING);
+    Plan rowPlan(blockCluster, acaOp->blocks(), acaOp->symmetry(),
+                 workUnitCount, Plan::ROW_PARTITIONING);
+    BOOST_CHECK_EQUAL(leafPlan.scheduling(NO_TRANSPOSE), Plan::LEAF_PARTITIONING);
+    BOOST_CHECK_EQUAL(rowPlan.scheduling(NO_TRANSPOSE), Plan::ROW_PARTITIONING);
+    BOOST_CHECK_EQUAL(rowPlan.scheduling(CONJUGATE_TRANSPOSE),
+                      Plan::ROW_PARTITIONING);
+
+    const RT alpha = static_cast<RT>(2.);
+    const int vectorCount = 3;
+    const TranspositionMode modes[] = {NO_TRANSPOSE, CONJUGATE_TRANSPOSE};
+    for (int m = 0; m < 2; ++m) {
+        const bool transposed = modes[m] != NO_TRANSPOSE;
+        const size_t inputLength =
+                transposed ? acaOp->rowCount() : acaOp->columnCount();
+        const size_t outputLength =
+                transposed ? acaOp->columnCount() : acaOp->rowCount();
+        const arma::Mat<RT> x =
+                generateRandomMatrix<RT>(inputLength, vectorCount);
+        const arma::Mat<RT> y =
+                generateRandomMatrix<RT>(outputLength, vectorCount);
+
+        arma::Mat<RT> xLeaf = x, yLeaf = y;
+        leafPlan.apply(modes[m], alpha, xLeaf, yLeaf);
+        arma::Mat<RT> xRow = x, yRow = y;
+        rowPlan.apply(modes[m], alpha, xRow, yRow);
+        BOOST_CHECK(check_arrays_are_close<RT>(
+                        yRow, yLeaf, 10. * std::numeric_limits<CT>::epsilon()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(matvec_plans_with_leaf_and_row_partitioning_give_identical_results_for_real_symmetric_operator, ResultType, result_types)
+{
+    if (boost::is_same<ResultType, std::complex<float> >())
+        return; // this type is not supported because of a deficiency in AHMED
+
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+    typedef AcaMatvecPlan<RT> Plan;
+
+    DiscreteRealSymmetricAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteAcaBoundaryOperator<RT> > acaOp =
+            DiscreteAcaBoundaryOperator<RT>::castToAca(fixture.op.weakForm());
+    blcluster* blockCluster =
+            const_cast<typename DiscreteAcaBoundaryOperator<RT>::
+            AhmedBemBlcluster*>(acaOp->blockCluster().get());
+
+    const size_t workUnitCount = 4;
+    Plan leafPlan(blockCluster, acaOp->blocks(), acaOp->symmetry(),
+                  workUnitCount, Plan::LEAF_PARTITIONING);
+    Plan rowPlan(blockCluster, acaOp->blocks(), acaOp->symmetry(),
+                 workUnitCount, Plan::ROW_PARTITIONING);
+    BOOST_CHECK_EQUAL(rowPlan.scheduling(), Plan::ROW_PARTITIONING);
+
+    const RT alpha = static_cast<RT>(2.);
+    const int vectorCount = 3;
+    const arma::Mat<RT> x =
+            generateRandomMatrix<RT>(acaOp->columnCount(), vectorCount);
+    const arma::Mat<RT> y =
+            generateRandomMatrix<RT>(acaOp->rowCount(), vectorCount);
+
+    arma::Mat<RT> xLeaf = x, yLeaf = y;
+    leafPlan.apply(NO_TRANSPOSE, alpha, xLeaf, yLeaf);
+    arma::Mat<RT> xRow = x, yRow = y;
+    rowPlan.apply(NO_TRANSPOSE, alpha, xRow, yRow);
+    BOOST_CHECK(check_arrays_are_close<RT>(
+                    yRow, yLeaf, 10. * std::numeric_limits<CT>::epsilon()));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(builtin_apply_works_correctly_for_multiple_vectors_and_alpha_equal_to_2_and_beta_equal_to_3_and_transpose, ResultType, result_types)
+{
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+
+    DiscreteAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+
+    RT alpha = static_cast<RT>(2.);
+    RT beta = static_cast<RT>(3.);
+    const int vectorCount = 5;
+
+    arma::Mat<RT> x = generateRandomMatrix<RT>(dop->columnCount(), vectorCount);
+    arma::Mat<RT> y = generateRandomMatrix<RT>(dop->rowCount(), vectorCount);
+    arma::Mat<RT> expected = alpha * dop->asMatrix() * x + beta * y;
+    dop->apply(NO_TRANSPOSE, x, y, alpha, beta);
+    BOOST_CHECK(check_arrays_are_close<RT>(y, expected,
+                                           10. * std::numeric_limits<CT>::epsilon()));
+
+    x = generateRandomMatrix<RT>(dop->rowCount(), vectorCount);
+    y = generateRandomMatrix<RT>(dop->columnCount(), vectorCount);
+    expected = alpha * dop->asMatrix().st() * x + beta * y;
+    dop->apply(TRANSPOSE, x, y, alpha, beta);
+    BOOST_CHECK(check_arrays_are_close<RT>(y, expected,
+                                           10. * std::numeric_limits<CT>::epsilon()));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(builtin_apply_works_correctly_for_multiple_vectors_and_real_symmetric_operator, ResultType, result_types)
+{
+    if (boost::is_same<ResultType, std::complex<float> >())
+        return; // this type is not supported because of a deficiency in AHMED
+
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+
+    DiscreteRealSymmetricAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+
+    RT alpha = static_cast<RT>(2.);
+    RT beta = static_cast<RT>(3.);
+    const int vectorCount = 5;
+
+    arma::Mat<RT> x = generateRandomMatrix<RT>(dop->columnCount(), vectorCount);
+    arma::Mat<RT> y = generateRandomMatrix<RT>(dop->rowCount(), vectorCount);
+
+    arma::Mat<RT> expected = alpha * dop->asMatrix() * x + beta * y;
+
+    dop->apply(NO_TRANSPOSE, x, y, alpha, beta);
+
+    BOOST_CHECK(check_arrays_are_close<RT>(y, expected,
+                                           10. * std::numeric_limits<CT>::epsilon()));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(loaded_operator_agrees_with_saved_operator, ResultType, result_types)
+{
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+
+    DiscreteAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+
+    const std::string fileName = std::string("test_aca_operator_") +
+            valueTypeSuffix<RT>() + ".hmat";
+    saveAcaOperator(dop, fileName);
+    shared_ptr<const DiscreteBoundaryOperator<RT> > loadedDop =
+            loadAcaOperator<RT>(fileName);
+    std::remove(fileName.c_str());
+
+    BOOST_CHECK_EQUAL(loadedDop->rowCount(), dop->rowCount());
+    BOOST_CHECK_EQUAL(loadedDop->columnCount(), dop->columnCount());
+    BOOST_CHECK(check_arrays_are_close<RT>(loadedDop->asMatrix(),
+                                           dop->asMatrix(),
+                                           std::numeric_limits<CT>::epsilon()));
+
+    RT alpha = static_cast<RT>(2.);
+    RT beta = static_cast<RT>(0.);
+    arma::Col<RT> x = generateRandomVector<RT>(dop->columnCount());
+    arma::Col<RT> expected(dop->rowCount());
+    arma::Col<RT> y(dop->rowCount());
+    dop->apply(NO_TRANSPOSE, x, expected, alpha, beta);
+    loadedDop->apply(NO_TRANSPOSE, x, y, alpha, beta);
+    BOOST_CHECK(check_arrays_are_close<RT>(y, expected,
+                                           10. * std::numeric_limits<CT>::epsilon()));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(loaded_operator_agrees_with_saved_operator_for_real_symmetric_operator, ResultType, result_types)
+{
+    if (boost::is_same<ResultType, std::complex<float> >())
+        return; // this type is not supported because of a deficiency in AHMED
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+
+    DiscreteRealSymmetricAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+
+    const std::string fileName = std::string("test_symmetric_aca_operator_") +
+            valueTypeSuffix<RT>() + ".hmat";
+    saveAcaOperator(dop, fileName);
+    shared_ptr<const DiscreteBoundaryOperator<RT> > loadedDop =
+            loadAcaOperator<RT>(fileName);
+    std::remove(fileName.c_str());
+
+    BOOST_CHECK_EQUAL(DiscreteAcaBoundaryOperator<RT>::castToAca(loadedDop)->symmetry(),
+                      DiscreteAcaBoundaryOperator<RT>::castToAca(dop)->symmetry());
+    BOOST_CHECK(check_arrays_are_close<RT>(loadedDop->asMatrix(),
+                                           dop->asMatrix(),
+                                           std::numeric_limits<CT>::epsilon()));
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(builtin_apply_works_correctly_for_alpha_equal_to_2_and_beta_equal_to_3, ResultType, result_types)
 {
     std::srand(1);
@@ -908,6 +1160,91 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(scaledAcaOperator_works_correctly_for_complex_symm
                                            10. * std::numeric_limits<CT>::epsilon()));
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(acaOperatorApproximateLuInverse_solves_system_for_nonsymmetric_operator,
+                              ResultType, result_types)
+{
+    if (boost::is_same<ResultType, std::complex<float> >())
+        return; // this type is not supported because of a deficiency in AHMED
+
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+
+    shared_ptr<Grid> grid = createRegularTriangularGrid(10, 10);
+
+    shared_ptr<Space<BFT> > pwiseConstants(
+        new PiecewiseConstantScalarSpace<BFT>(grid));
+
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    AcaOptions acaOptions;
+    acaOptions.minimumBlockSize = 2;
+    acaOptions.eps = 1e-6;
+    assemblyOptions.switchToAcaMode(acaOptions);
+    shared_ptr<NumericalQuadratureStrategy<BFT, RT> > quadStrategy(
+        new NumericalQuadratureStrategy<BFT, RT>);
+    shared_ptr<Context<BFT, RT> > context(
+        new Context<BFT, RT>(quadStrategy, assemblyOptions));
+
+    BoundaryOperator<BFT, RT> op =
+            laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+                context, pwiseConstants, pwiseConstants, pwiseConstants);
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = op.weakForm();
+    BOOST_REQUIRE_EQUAL(
+                DiscreteAcaBoundaryOperator<RT>::castToAca(dop)->symmetry(),
+                (int)NO_SYMMETRY);
+
+    shared_ptr<const DiscreteBoundaryOperator<RT> > luInverse =
+            acaOperatorApproximateLuInverse(dop, 1e-6);
+
+    arma::Col<RT> b = generateRandomVector<RT>(dop->rowCount());
+    arma::Col<RT> x(dop->columnCount());
+    luInverse->apply(NO_TRANSPOSE, b, x, 1., 0.);
+    arma::Col<RT> product = dop->asMatrix() * x;
+
+    BOOST_CHECK(check_arrays_are_close<RT>(product, b, 1e-3));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(acaOperatorApproximateCholeskyInverse_solves_system_for_real_symmetric_operator,
+                              ResultType, real_result_types)
+{
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+
+    DiscreteRealSymmetricAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+
+    shared_ptr<const DiscreteBoundaryOperator<RT> > choleskyInverse =
+            acaOperatorApproximateCholeskyInverse(dop, 1e-6);
+
+    arma::Col<RT> b = generateRandomVector<RT>(dop->rowCount());
+    arma::Col<RT> x(dop->columnCount());
+    choleskyInverse->apply(NO_TRANSPOSE, b, x, 1., 0.);
+    arma::Col<RT> product = dop->asMatrix() * x;
+
+    BOOST_CHECK(check_arrays_are_close<RT>(product, b, 1e-3));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(acaOperatorApproximateCholeskyInverse_throws_for_nonsymmetric_operator,
+                              ResultType, result_types)
+{
+    if (boost::is_same<ResultType, std::complex<float> >())
+        return; // this type is not supported because of a deficiency in AHMED
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+
+    DiscreteAcaBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+
+    BOOST_CHECK_THROW(acaOperatorApproximateCholeskyInverse(dop, 1e-6),
+                      std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #endif // WITH_AHMED
@@ -0,0 +1,107 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "fiber/_3d_array.hpp"
+#include "fiber/_4d_array.hpp"
+#include "fiber/array_memory_pool.hpp"
+
+#include "../type_template.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_case_template.hpp>
+#include <boost/version.hpp>
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(ArrayMemoryPool)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(storage_of_destroyed_arrays_is_reused,
+                              ValueType, result_types)
+{
+    Fiber::ArrayMemoryPool::resetStatistics();
+    for (int i = 0; i < 10; ++i) {
+        Fiber::_3dArray<ValueType> a(3, 4, 5);
+        std::fill(a.begin(), a.end(), ValueType(i));
+    }
+    const Fiber::ArrayMemoryPoolStatistics stats =
+            Fiber::ArrayMemoryPool::statistics();
+    BOOST_CHECK_EQUAL(stats.allocationCount, 10u);
+    BOOST_CHECK_EQUAL(stats.deallocationCount, 10u);
+    BOOST_CHECK_GE(stats.reuseCount, 9u);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(set_size_returns_old_storage_to_pool,
+                              ValueType, result_types)
+{
+    Fiber::_4dArray<ValueType> a(2, 3, 4, 5);
+    Fiber::ArrayMemoryPool::resetStatistics();
+    a.set_size(2, 3, 4, 6);
+    const Fiber::ArrayMemoryPoolStatistics stats =
+            Fiber::ArrayMemoryPool::statistics();
+    BOOST_CHECK_EQUAL(stats.allocationCount, 1u);
+    BOOST_CHECK_EQUAL(stats.deallocationCount, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(releaseCachedMemory_respects_limit)
+{
+    Fiber::ArrayMemoryPool::resetStatistics();
+    {
+        Fiber::_3dArray<double> a(10, 10, 10);
+        Fiber::_3dArray<double> b(20, 20, 20);
+    }
+    Fiber::ArrayMemoryPool::releaseCachedMemory(0);
+    BOOST_CHECK_GE(Fiber::ArrayMemoryPool::statistics().releasedBlockCount, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(deallocate_respects_cache_limit)
+{
+    typedef Fiber::ArrayMemoryPool Pool;
+    Pool::releaseCachedMemory(0);
+    Pool::resetStatistics();
+
+    const size_t blockSize = Pool::maxPooledBlockSize();
+    const size_t cachedBlockCount = Pool::defaultCacheLimit() / blockSize;
+    const size_t blockCount = cachedBlockCount + 4;
+    std::vector<void*> blocks(blockCount);
+    for (size_t i = 0; i < blockCount; ++i)
+        blocks[i] = Pool::allocate(blockSize);
+    for (size_t i = 0; i < blockCount; ++i)
+        Pool::deallocate(blocks[i], blockSize);
+
+    BOOST_CHECK_EQUAL(Pool::statistics().releasedBlockCount,
+                      blockCount - cachedBlockCount);
+    Pool::releaseCachedMemory(0);
+}
+
+BOOST_AUTO_TEST_CASE(complex_elements_are_zero_initialised)
+{
+    {
+        Fiber::_3dArray<std::complex<double> > a(2, 2, 2);
+        std::fill(a.begin(), a.end(), std::complex<double>(1., 2.));
+    }
+    Fiber::_3dArray<std::complex<double> > b(2, 2, 2);
+    for (size_t i = 0; i < 8; ++i)
+        BOOST_CHECK_EQUAL(b.begin()[i], std::complex<double>(0., 0.));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "fiber/basis_data_cache.hpp"
+#include "fiber/default_collection_of_basis_transformations.hpp"
+#include "fiber/piecewise_linear_continuous_scalar_basis.hpp"
+#include "fiber/scalar_function_value_functor.hpp"
+#include "fiber/scalar_function_value_times_normal_functor.hpp"
+#include "fiber/scalar_traits.hpp"
+
+#include "../check_arrays_are_close.hpp"
+#include "../type_template.hpp"
+
+#include "common/armadillo_fwd.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_case_template.hpp>
+#include <boost/version.hpp>
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(BasisDataCache)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(element_independent_transformations_are_evaluated_once,
+                              ValueType, basis_function_types)
+{
+    typedef typename Fiber::ScalarTraits<ValueType>::RealType CoordinateType;
+    typedef Fiber::ScalarFunctionValueFunctor<CoordinateType> Functor;
+    Fiber::DefaultCollectionOfBasisTransformations<Functor> transformations(
+                (Functor()));
+    Fiber::PiecewiseLinearContinuousScalarBasis<3, ValueType> basis;
+    arma::Mat<CoordinateType> points(2, 4);
+    points.randu();
+    Fiber::GeometricalData<CoordinateType> geomData;
+
+    Fiber::BasisDataCache<ValueType> cache;
+    Fiber::CollectionOf3dArrays<ValueType> buffer;
+    const Fiber::CollectionOf3dArrays<ValueType>& first =
+            cache.transformedValues(transformations, basis, points,
+                                    Fiber::ALL_DOFS, geomData, buffer);
+    const Fiber::CollectionOf3dArrays<ValueType>& second =
+            cache.transformedValues(transformations, basis, points,
+                                    Fiber::ALL_DOFS, geomData, buffer);
+    BOOST_CHECK_EQUAL(&first, &second);
+    BOOST_CHECK(&first != &buffer);
+    BOOST_CHECK_EQUAL(cache.size(), size_t(1));
+
+    Fiber::BasisData<ValueType> basisData;
+    basis.evaluate(Fiber::VALUES, points, Fiber::ALL_DOFS, basisData);
+    Fiber::CollectionOf3dArrays<ValueType> expected;
+    transformations.evaluate(basisData, geomData, expected);
+    BOOST_CHECK(check_arrays_are_close<ValueType>(first[0], expected[0], 1e-10));
+
+    // A different local DOF index needs a separate entry
+    cache.transformedValues(transformations, basis, points, 1,
+                            geomData, buffer);
+    BOOST_CHECK_EQUAL(cache.size(), size_t(2));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(geometry_dependent_transformations_are_evaluated_on_each_element,
+                              ValueType, basis_function_types)
+{
+    typedef typename Fiber::ScalarTraits<ValueType>::RealType CoordinateType;
+    typedef Fiber::ScalarFunctionValueTimesNormalFunctor<CoordinateType> Functor;
+    Fiber::DefaultCollectionOfBasisTransformations<Functor> transformations(
+                (Functor()));
+    Fiber::PiecewiseLinearContinuousScalarBasis<3, ValueType> basis;
+    const int pointCount = 4;
+    arma::Mat<CoordinateType> points(2, pointCount);
+    points.randu();
+
+    Fiber::BasisDataCache<ValueType> cache;
+    Fiber::CollectionOf3dArrays<ValueType> buffer;
+    Fiber::BasisData<ValueType> basisData;
+    basis.evaluate(Fiber::VALUES, points, Fiber::ALL_DOFS, basisData);
+    for (int element = 0; element < 2; ++element) {
+        Fiber::GeometricalData<CoordinateType> geomData;
+        geomData.normals.zeros(3, pointCount);
+        geomData.normals.row(element).fill(1.);
+
+        const Fiber::CollectionOf3dArrays<ValueType>& values =
+                cache.transformedValues(transformations, basis, points,
+                                        Fiber::ALL_DOFS, geomData, buffer);
+        BOOST_CHECK_EQUAL(&values, &buffer);
+
+        Fiber::CollectionOf3dArrays<ValueType> expected;
+        transformations.evaluate(basisData, geomData, expected);
+        BOOST_CHECK(check_arrays_are_close<ValueType>(values[0], expected[0],
+                                                      1e-10));
+    }
+    BOOST_CHECK_EQUAL(cache.size(), size_t(1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
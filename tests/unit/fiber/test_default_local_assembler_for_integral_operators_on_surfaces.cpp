@@ -26,6 +26,7 @@
 #include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
 #include "assembly/numerical_quadrature_strategy.hpp"
 #include "common/scalar_traits.hpp"
+#include "fiber/array_memory_pool.hpp"
 #include "fiber/geometrical_data.hpp"
 #include "fiber/local_assembler_for_operators.hpp"
 #include "grid/grid.hpp"
@@ -44,6 +45,7 @@
 #include <boost/test/floating_point_comparison.hpp>
 #include <boost/version.hpp>
 #include <complex>
+#include <vector>
 
 using namespace Bempp;
 
@@ -391,4 +393,38 @@ evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_res
                     resultWithCaching, resultWithoutCaching, 1e-6));
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(
+        evaluateLocalWeakForms_releases_array_storage_cached_beyond_retained_size,
+        ResultType, result_types)
+{
+    typedef Fiber::ArrayMemoryPool Pool;
+    DefaultLocalAssemblerForIntegralOperatorsOnSurfacesManager<
+            typename ScalarTraits<ResultType>::RealType, ResultType> mgr(false);
+
+    const int elementCount = N_ELEMENTS_X * N_ELEMENTS_Y * 2;
+    std::vector<int> indices(elementCount);
+    for (int i = 0; i < elementCount; ++i)
+        indices[i] = i;
+
+    // Fill the cache of this thread up to its limit
+    Pool::releaseCachedMemory(0);
+    const size_t blockSize = Pool::maxPooledBlockSize();
+    const size_t blockCount = Pool::defaultCacheLimit() / blockSize;
+    std::vector<void*> blocks(blockCount);
+    for (size_t i = 0; i < blockCount; ++i)
+        blocks[i] = Pool::allocate(blockSize);
+    for (size_t i = 0; i < blockCount; ++i)
+        Pool::deallocate(blocks[i], blockSize);
+    Pool::resetStatistics();
+
+    Fiber::_2dArray<arma::Mat<ResultType> > result;
+    mgr.assembler->evaluateLocalWeakForms(indices, indices, result);
+
+    const size_t retainedBlockCount =
+            Pool::defaultRetainedCacheSize() / blockSize;
+    BOOST_CHECK_GE(Pool::statistics().releasedBlockCount,
+                   blockCount - retainedBlockCount);
+    Pool::releaseCachedMemory(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -203,4 +203,51 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(evaluateOnGrid_agrees_with_evaluateAtPointPairs,
                     convertedResultAtPointPairs, convertedResultOnGrid, 1e-6));
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(evaluateOnGrid_agrees_with_evaluate_for_many_points,
+                              ValueType, kernel_types)
+{
+    // evaluateOnGrid() uses the functor's evaluateBatch() method; compare
+    // its results with those of evaluate(). The point counts are chosen so
+    // that both the vectorized loop and its remainder are exercised.
+    typedef Fiber::Laplace3dDoubleLayerPotentialKernelFunctor<ValueType> Functor;
+    typedef Fiber::DefaultCollectionOfKernels<Functor> Kernels;
+    Functor functor;
+    Kernels kernels(functor);
+
+    typedef typename Functor::CoordinateType CoordinateType;
+    Fiber::GeometricalData<CoordinateType> testGeomData, trialGeomData;
+    const int worldDim = 3;
+    const int testPointCount = 37, trialPointCount = 5;
+    testGeomData.globals.set_size(worldDim, testPointCount);
+    for (int p = 0; p < testPointCount; ++p) {
+        testGeomData.globals(0, p) = 0.1 * p;
+        testGeomData.globals(1, p) = 0.05 * (p % 7);
+        testGeomData.globals(2, p) = -0.3;
+    }
+    trialGeomData.globals.set_size(worldDim, trialPointCount);
+    trialGeomData.normals.set_size(worldDim, trialPointCount);
+    for (int p = 0; p < trialPointCount; ++p) {
+        trialGeomData.globals(0, p) = 0.2 * p;
+        trialGeomData.globals(1, p) = 0.7;
+        trialGeomData.globals(2, p) = 0.1 * p;
+        trialGeomData.normals(0, p) = 0.6;
+        trialGeomData.normals(1, p) = 0.;
+        trialGeomData.normals(2, p) = (p % 2 ? -0.8 : 0.8);
+    }
+
+    Fiber::CollectionOf4dArrays<ValueType> result;
+    kernels.evaluateOnGrid(testGeomData, trialGeomData, result);
+
+    Fiber::CollectionOf4dArrays<ValueType> expected;
+    expected.set_size(1);
+    expected[0].set_size(1, 1, testPointCount, trialPointCount);
+    for (int trialPoint = 0; trialPoint < trialPointCount; ++trialPoint)
+        for (int testPoint = 0; testPoint < testPointCount; ++testPoint)
+            functor.evaluate(testGeomData.const_slice(testPoint),
+                             trialGeomData.const_slice(trialPoint),
+                             expected.slice(testPoint, trialPoint).self());
+
+    BOOST_CHECK(check_arrays_are_close<ValueType>(result[0], expected[0], 1e-5));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,103 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "fiber/geometrical_data.hpp"
+#include "fiber/modified_helmholtz_3d_single_layer_potential_kernel_functor.hpp"
+#include "fiber/default_collection_of_kernels.hpp"
+
+#include "../type_template.hpp"
+#include "../check_arrays_are_close.hpp"
+
+#include "common/armadillo_fwd.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <boost/version.hpp>
+#include <complex>
+#include <limits>
+
+namespace
+{
+
+// Compare the results of evaluateOnGrid(), which uses the functor's
+// evaluateBatch() method, with those of evaluate(). The point counts are
+// chosen so that both the vectorized loops and their remainders are
+// exercised, and the distances so that the exponential is evaluated over a
+// few wavelengths.
+template <typename ValueType>
+void checkEvaluateOnGridAgreesWithEvaluate(ValueType waveNumber)
+{
+    typedef Fiber::ModifiedHelmholtz3dSingleLayerPotentialKernelFunctor<ValueType>
+            Functor;
+    typedef Fiber::DefaultCollectionOfKernels<Functor> Kernels;
+    Functor functor(waveNumber);
+    Kernels kernels(functor);
+
+    typedef typename Functor::CoordinateType CoordinateType;
+    Fiber::GeometricalData<CoordinateType> testGeomData, trialGeomData;
+    const int worldDim = 3;
+    const int testPointCount = 37, trialPointCount = 5;
+    testGeomData.globals.set_size(worldDim, testPointCount);
+    for (int p = 0; p < testPointCount; ++p) {
+        testGeomData.globals(0, p) = 0.1 * p;
+        testGeomData.globals(1, p) = 0.05 * (p % 7);
+        testGeomData.globals(2, p) = -0.3;
+    }
+    trialGeomData.globals.set_size(worldDim, trialPointCount);
+    for (int p = 0; p < trialPointCount; ++p) {
+        trialGeomData.globals(0, p) = 0.2 * p;
+        trialGeomData.globals(1, p) = 0.7;
+        trialGeomData.globals(2, p) = 0.1 * p;
+    }
+
+    Fiber::CollectionOf4dArrays<ValueType> result;
+    kernels.evaluateOnGrid(testGeomData, trialGeomData, result);
+
+    Fiber::CollectionOf4dArrays<ValueType> expected;
+    expected.set_size(1);
+    expected[0].set_size(1, 1, testPointCount, trialPointCount);
+    for (int trialPoint = 0; trialPoint < trialPointCount; ++trialPoint)
+        for (int testPoint = 0; testPoint < testPointCount; ++testPoint)
+            functor.evaluate(testGeomData.const_slice(testPoint),
+                             trialGeomData.const_slice(trialPoint),
+                             expected.slice(testPoint, trialPoint).self());
+
+    const CoordinateType tol = 100 * std::numeric_limits<CoordinateType>::epsilon();
+    BOOST_CHECK(check_arrays_are_close<ValueType>(result[0], expected[0], tol));
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(ModifiedHelmholtz3dSingleLayerPotentialKernelFunctor)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(evaluateOnGrid_agrees_with_evaluate_for_real_wave_number,
+                              ValueType, kernel_types)
+{
+    checkEvaluateOnGridAgreesWithEvaluate<ValueType>(ValueType(1.7));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(evaluateOnGrid_agrees_with_evaluate_for_complex_wave_number,
+                              ValueType, complex_kernel_types)
+{
+    checkEvaluateOnGridAgreesWithEvaluate<ValueType>(ValueType(0.31, -12.3));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
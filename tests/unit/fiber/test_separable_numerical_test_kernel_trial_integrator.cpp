@@ -0,0 +1,222 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../check_arrays_are_close.hpp"
+#include "../type_template.hpp"
+#include "../assembly/create_regular_grid.hpp"
+
+#include "assembly/boundary_operator.hpp"
+#include "assembly/context.hpp"
+#include "assembly/discrete_boundary_operator.hpp"
+#include "assembly/general_elementary_singular_integral_operator_imp.hpp"
+#include "assembly/helmholtz_3d_single_layer_boundary_operator.hpp"
+#include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
+#include "assembly/numerical_quadrature_strategy.hpp"
+
+#include "common/scalar_traits.hpp"
+
+#include "fiber/laplace_3d_single_layer_potential_kernel_functor.hpp"
+#include "fiber/modified_helmholtz_3d_single_layer_potential_kernel_functor.hpp"
+#include "fiber/scalar_function_value_functor.hpp"
+#include "fiber/simple_test_scalar_kernel_trial_integrand_functor.hpp"
+
+#include "grid/grid.hpp"
+
+#include "space/piecewise_constant_scalar_space.hpp"
+#include "space/piecewise_linear_continuous_scalar_space.hpp"
+
+#include "common/armadillo_fwd.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_case_template.hpp>
+#include <boost/version.hpp>
+#include <complex>
+#include <limits>
+
+using namespace Bempp;
+
+namespace
+{
+
+// Evaluates the same integrand as SimpleTestScalarKernelTrialIntegrandFunctor,
+// but is not recognized as simple, so that the integrator takes the path
+// evaluating the kernel on the full grid of quadrature points
+template <typename BasisFunctionType_, typename KernelType_,
+          typename ResultType_>
+class UnfusedIntegrandFunctor
+{
+public:
+    typedef BasisFunctionType_ BasisFunctionType;
+    typedef KernelType_ KernelType;
+    typedef ResultType_ ResultType;
+    typedef typename ScalarTraits<ResultType>::RealType CoordinateType;
+
+    void addGeometricalDependencies(size_t& testGeomDeps,
+                                    size_t& trialGeomDeps) const {
+        m_functor.addGeometricalDependencies(testGeomDeps, trialGeomDeps);
+    }
+
+    template <template <typename T> class CollectionOf2dSlicesOfConstNdArrays>
+    ResultType evaluate(
+            const Fiber::ConstGeometricalDataSlice<CoordinateType>& testGeomData,
+            const Fiber::ConstGeometricalDataSlice<CoordinateType>& trialGeomData,
+            const Fiber::CollectionOf1dSlicesOfConst3dArrays<BasisFunctionType>&
+            testValues,
+            const Fiber::CollectionOf1dSlicesOfConst3dArrays<BasisFunctionType>&
+            trialValues,
+            const CollectionOf2dSlicesOfConstNdArrays<KernelType>&
+            kernelValues) const {
+        return m_functor.evaluate(testGeomData, trialGeomData,
+                                  testValues, trialValues, kernelValues);
+    }
+
+private:
+    Fiber::SimpleTestScalarKernelTrialIntegrandFunctor<
+    BasisFunctionType, KernelType, ResultType> m_functor;
+};
+
+enum TestSpace
+{
+    PIECEWISE_CONSTANTS,
+    PIECEWISE_LINEARS
+};
+
+template <typename BFT>
+shared_ptr<Space<BFT> > makeSpace(TestSpace space,
+                                  const shared_ptr<Grid>& grid)
+{
+    if (space == PIECEWISE_CONSTANTS)
+        return shared_ptr<Space<BFT> >(
+                    new PiecewiseConstantScalarSpace<BFT>(grid));
+    else
+        return shared_ptr<Space<BFT> >(
+                    new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+}
+
+// Context whose regular integrals are evaluated with the given quadrature
+// order on both elements
+template <typename BFT, typename RT>
+shared_ptr<Context<BFT, RT> > makeContext(int regularOrder)
+{
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    AccuracyOptions accuracyOptions;
+    accuracyOptions.doubleRegular.setAbsoluteQuadratureOrder(regularOrder);
+    shared_ptr<NumericalQuadratureStrategy<BFT, RT> > quadStrategy(
+                new NumericalQuadratureStrategy<BFT, RT>(accuracyOptions));
+    return shared_ptr<Context<BFT, RT> >(
+                new Context<BFT, RT>(quadStrategy, assemblyOptions));
+}
+
+// Weak form of the single-layer operator with the given kernel, assembled
+// without the fused evaluation of simple integrals
+template <typename BFT, typename KT, typename RT, typename KernelFunctor>
+arma::Mat<RT> unfusedWeakForm(
+        const shared_ptr<const Context<BFT, RT> >& context,
+        const shared_ptr<const Space<BFT> >& space,
+        const KernelFunctor& kernelFunctor)
+{
+    typedef typename ScalarTraits<RT>::RealType CT;
+    typedef Fiber::ScalarFunctionValueFunctor<CT> TransformationFunctor;
+    typedef UnfusedIntegrandFunctor<BFT, KT, RT> IntegrandFunctor;
+    typedef GeneralElementarySingularIntegralOperator<BFT, KT, RT> Op;
+    shared_ptr<Op> op(new Op(space, space, space, "", NO_SYMMETRY,
+                             kernelFunctor,
+                             TransformationFunctor(),
+                             TransformationFunctor(),
+                             IntegrandFunctor()));
+    BoundaryOperator<BFT, RT> boundaryOp(context, op);
+    return boundaryOp.weakForm()->asMatrix();
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(SeparableNumericalTestKernelTrialIntegrator)
+
+// The regular quadrature orders used below give 3 x 3 points per element
+// pair, evaluated in a single tile of kernel values, and 48 x 48 points,
+// which are split into several tiles, the last of them incomplete
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(fused_and_unfused_laplace_3d_single_layer_agree,
+                              ResultType, result_types)
+{
+    typedef ResultType RT;
+    typedef typename ScalarTraits<RT>::RealType BFT;
+    typedef typename ScalarTraits<RT>::RealType KT;
+    typedef typename ScalarTraits<RT>::RealType CT;
+
+    shared_ptr<Grid> grid = createRegularTriangularGrid();
+    const TestSpace spaces[] = { PIECEWISE_CONSTANTS, PIECEWISE_LINEARS };
+    const int orders[] = { 2, 15 };
+    for (int s = 0; s < 2; ++s)
+        for (int o = 0; o < 2; ++o) {
+            shared_ptr<Space<BFT> > space = makeSpace<BFT>(spaces[s], grid);
+            shared_ptr<Context<BFT, RT> > context =
+                    makeContext<BFT, RT>(orders[o]);
+
+            BoundaryOperator<BFT, RT> fusedOp =
+                    laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+                        context, space, space, space);
+            arma::Mat<RT> fused = fusedOp.weakForm()->asMatrix();
+            arma::Mat<RT> unfused = unfusedWeakForm<BFT, KT, RT>(
+                        context, space,
+                        Fiber::Laplace3dSingleLayerPotentialKernelFunctor<KT>());
+
+            const CT eps = std::numeric_limits<CT>::epsilon();
+            BOOST_CHECK(check_arrays_are_close<RT>(fused, unfused, 100 * eps));
+        }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(fused_and_unfused_helmholtz_3d_single_layer_agree,
+                              BasisFunctionType, basis_function_types)
+{
+    typedef BasisFunctionType BFT;
+    typedef typename ScalarTraits<BFT>::ComplexType RT;
+    typedef typename ScalarTraits<BFT>::ComplexType KT;
+    typedef typename ScalarTraits<BFT>::RealType CT;
+
+    const KT waveNumber(3.23, 0.31);
+    shared_ptr<Grid> grid = createRegularTriangularGrid();
+    const TestSpace spaces[] = { PIECEWISE_CONSTANTS, PIECEWISE_LINEARS };
+    const int orders[] = { 2, 15 };
+    for (int s = 0; s < 2; ++s)
+        for (int o = 0; o < 2; ++o) {
+            shared_ptr<Space<BFT> > space = makeSpace<BFT>(spaces[s], grid);
+            shared_ptr<Context<BFT, RT> > context =
+                    makeContext<BFT, RT>(orders[o]);
+
+            BoundaryOperator<BFT, RT> fusedOp =
+                    helmholtz3dSingleLayerBoundaryOperator<BFT>(
+                        context, space, space, space, waveNumber);
+            arma::Mat<RT> fused = fusedOp.weakForm()->asMatrix();
+            // The Helmholtz operator is the modified Helmholtz operator with
+            // wave number -i k
+            arma::Mat<RT> unfused = unfusedWeakForm<BFT, KT, RT>(
+                        context, space,
+                        Fiber::ModifiedHelmholtz3dSingleLayerPotentialKernelFunctor<KT>(
+                            waveNumber / KT(0., 1.)));
+
+            const CT eps = std::numeric_limits<CT>::epsilon();
+            BOOST_CHECK(check_arrays_are_close<RT>(fused, unfused, 100 * eps));
+        }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
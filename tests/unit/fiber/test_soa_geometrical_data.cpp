@@ -0,0 +1,89 @@
+// Copyright (C) 2011-2013 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "fiber/soa_geometrical_data.hpp"
+#include "../type_template.hpp"
+
+#include "common/armadillo_fwd.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_case_template.hpp>
+#include <boost/version.hpp>
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(SoaGeometricalData)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(assign_copies_globals_normals_and_integration_elements,
+                              CoordinateType, real_numeric_types)
+{
+    const int worldDim = 3, pointCount = 5;
+    Fiber::GeometricalData<CoordinateType> geomData;
+    geomData.globals.set_size(worldDim, pointCount);
+    geomData.normals.set_size(worldDim, pointCount);
+    geomData.integrationElements.set_size(pointCount);
+    for (int p = 0; p < pointCount; ++p) {
+        for (int dim = 0; dim < worldDim; ++dim) {
+            geomData.globals(dim, p) = 10 * p + dim;
+            geomData.normals(dim, p) = -10 * p - dim;
+        }
+        geomData.integrationElements(p) = p + 0.5;
+    }
+
+    Fiber::SoaGeometricalData<CoordinateType> soaData(geomData);
+    BOOST_CHECK_EQUAL(soaData.pointCount(), size_t(pointCount));
+    BOOST_CHECK_EQUAL(soaData.dimWorld(), worldDim);
+    for (int p = 0; p < pointCount; ++p) {
+        for (int dim = 0; dim < worldDim; ++dim) {
+            BOOST_CHECK_EQUAL(soaData.globals(dim)[p], geomData.globals(dim, p));
+            BOOST_CHECK_EQUAL(soaData.normals(dim)[p], geomData.normals(dim, p));
+            BOOST_CHECK_EQUAL(soaData.const_slice(p).global(dim),
+                              geomData.const_slice(p).global(dim));
+        }
+        BOOST_CHECK_EQUAL(soaData.integrationElements()[p],
+                          geomData.integrationElements(p));
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(arrays_are_aligned_and_padded_with_last_point,
+                              CoordinateType, real_numeric_types)
+{
+    const int worldDim = 3, pointCount = 7;
+    Fiber::GeometricalData<CoordinateType> geomData;
+    geomData.globals.randu(worldDim, pointCount);
+
+    const Fiber::SoaGeometricalData<CoordinateType> original(geomData);
+    // The copy must be aligned independently of the original
+    const Fiber::SoaGeometricalData<CoordinateType> soaData(original);
+    const size_t alignment = Fiber::SoaGeometricalData<CoordinateType>::ALIGNMENT;
+    BOOST_CHECK_EQUAL(soaData.paddedPointCount() * sizeof(CoordinateType) %
+                      alignment, size_t(0));
+    BOOST_CHECK(soaData.paddedPointCount() >= size_t(pointCount));
+    BOOST_CHECK(!soaData.hasNormals());
+    BOOST_CHECK(!soaData.hasIntegrationElements());
+    for (int dim = 0; dim < worldDim; ++dim) {
+        const CoordinateType* array = soaData.globals(dim);
+        BOOST_CHECK_EQUAL(reinterpret_cast<size_t>(array) % alignment,
+                          size_t(0));
+        for (size_t p = pointCount; p < soaData.paddedPointCount(); ++p)
+            BOOST_CHECK_EQUAL(array[p], geomData.globals(dim, pointCount - 1));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()